@@ -8,6 +8,7 @@
 
 #include "llvm/Support/CommandLine.h"
 #include "klee/Config/config.h"
+#include "klee/Solver.h"
 
 namespace klee {
 
@@ -19,6 +20,12 @@ extern llvm::cl::opt<bool> UseCache;
 
 extern llvm::cl::opt<bool> UseIndependentSolver; 
 
+extern llvm::cl::opt<bool> UseCanonicalSolver;
+
+extern llvm::cl::opt<bool> UseAdaptiveTimeout;
+
+extern llvm::cl::opt<bool> UseBitBlastSolver;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
   
 extern llvm::cl::opt<int> MinQueryTimeToLog;
@@ -29,6 +36,15 @@ extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
+extern llvm::cl::opt<klee::CoreSolverType> CoreSolverToUse;
+
+extern llvm::cl::list<klee::CoreSolverType> CoreSolverPortfolio;
+
+/// createCoreSolverFromOptions - Create the core solver selected by
+/// --solver-backend or --solver-portfolio, or null if it is not supported.
+Solver *createCoreSolverFromOptions(bool useForkedSolver,
+                                    bool optimizeDivides);
+
 extern llvm::cl::opt<std::string> TargetFuntion;
 
 ///The different query logging solvers that can switched on/off
@@ -21,20 +21,33 @@ namespace klee {
 
 class ExprVisitor;
   
+/// The constraints are shared between copies of a ConstraintManager (e.g.
+/// the constraints of forked states) and only copied when one is written.
 class ConstraintManager {
 public:
   typedef std::vector< ref<Expr> > constraints_ty;
   typedef constraints_ty::iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
-  ConstraintManager() {}
+  ConstraintManager() : storage(0) {}
 
   // create from constraints with no optimization
   explicit
-  ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+  ConstraintManager(const std::vector< ref<Expr> > &_constraints);
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager(const ConstraintManager &cs) : storage(cs.storage) {
+    if (storage)
+      ++storage->refCount;
+  }
+  ~ConstraintManager() { release(); }
+
+  ConstraintManager &operator=(const ConstraintManager &cs) {
+    if (cs.storage)
+      ++cs.storage->refCount;
+    release();
+    storage = cs.storage;
+    return *this;
+  }
 
   typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
 
@@ -47,35 +60,71 @@ public:
   void addConstraint(ref<Expr> e);
   
   bool empty() const {
-    return constraints.empty();
+    return !storage || storage->constraints.empty();
   }
   ref<Expr> back() const {
-    return constraints.back();
+    return storage->constraints.back();
   }
   constraint_iterator begin() const {
-    return constraints.begin();
+    return getConstraints().begin();
   }
   constraint_iterator end() const {
-    return constraints.end();
+    return getConstraints().end();
   }
   size_t size() const {
-    return constraints.size();
+    return storage ? storage->constraints.size() : 0;
+  }
+
+  /// hash - Return a hash of the constraints, in order. It is kept up to
+  /// date as constraints are added.
+  unsigned hash() const {
+    return storage ? storage->hashValue : 0;
+  }
+
+  /// generation - Return an identifier of the current constraints. Two
+  /// managers with the same generation have the same constraints, and a
+  /// generation is never reused once its constraints are written or freed,
+  /// so it can be kept without keeping the constraints alive.
+  uint64_t generation() const {
+    return storage ? storage->generation : 0;
   }
 
   bool operator==(const ConstraintManager &other) const {
-    return constraints == other.constraints;
+    if (storage == other.storage)
+      return true;
+    return size() == other.size() && hash() == other.hash() &&
+      getConstraints() == other.getConstraints();
   }
   
   void dumpConstraints() const{
 	  printf("Constraints are:\n");
-	  for(std::vector< ref<Expr> >::const_iterator it=constraints.begin();it!=constraints.end();it++){
+	  for(std::vector< ref<Expr> >::const_iterator it=begin();it!=end();it++){
 		  it->get()->dump();
 	  }
 	  printf("Constraints done.\n");
   }
 
 private:
-  std::vector< ref<Expr> > constraints;
+  struct Storage {
+    unsigned refCount;
+    constraints_ty constraints;
+    unsigned hashValue;
+    uint64_t generation;
+
+    Storage() : refCount(1), hashValue(0), generation(0) {}
+  };
+
+  Storage *storage;
+  static uint64_t lastGeneration;
+
+  const constraints_ty &getConstraints() const;
+  void release() {
+    if (storage && --storage->refCount == 0)
+      delete storage;
+  }
+  /// Make the constraints private to this manager, so they can be written.
+  void makeUnique();
+  void push(ref<Expr> e);
 
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
@@ -12,10 +12,13 @@
 
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/CoverageBitmap.h"
 #include "klee/Internal/ADT/TreeStream.h"
+#include "klee/util/ByteRanges.h"
 
 // FIXME: We do not want to be exposing these? :(
 #include "../../lib/Core/AddressSpace.h"
+#include "klee/Internal/Module/Cell.h"
 #include "klee/Internal/Module/KInstIterator.h"
 
 #include <map>
@@ -25,7 +28,6 @@
 namespace klee {
 class Array;
 class CallPathNode;
-struct Cell;
 struct KFunction;
 struct KInstruction;
 class MemoryObject;
@@ -34,13 +36,41 @@ struct InstructionInfo;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
+/// The registers of a stack frame. Frames copied when a state forks
+/// share them until one of the states writes a register, and the memory
+/// of released ones is kept for the next frames of the same size.
+class RegisterFile {
+  unsigned refCount;
+  unsigned size;
+
+  explicit RegisterFile(unsigned _size);
+  ~RegisterFile();
+  RegisterFile(const RegisterFile &);
+  RegisterFile &operator=(const RegisterFile &);
+
+public:
+  static RegisterFile *create(unsigned size);
+
+  void retain() { ++refCount; }
+  void release();
+  bool isShared() const { return refCount > 1; }
+
+  /// Return a copy that is not shared in place of this one.
+  RegisterFile *unshare();
+
+  Cell *cells() { return reinterpret_cast<Cell*>(this + 1); }
+  const Cell *cells() const {
+    return reinterpret_cast<const Cell*>(this + 1);
+  }
+};
+
 struct StackFrame {
   KInstIterator caller;
   KFunction *kf;
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+  RegisterFile *locals;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -58,7 +88,20 @@ struct StackFrame {
 
   StackFrame(KInstIterator caller, KFunction *kf);
   StackFrame(const StackFrame &s);
+  StackFrame &operator=(const StackFrame &s);
   ~StackFrame();
+
+  const Cell &getLocal(unsigned index) const {
+    return locals->cells()[index];
+  }
+
+  /// Return the register for writing, first copying the registers if
+  /// they are shared with another state.
+  Cell &getLocalForWrite(unsigned index) {
+    if (locals->isShared())
+      locals = locals->unshare();
+    return locals->cells()[index];
+  }
 };
 
 /// @brief ExecutionState representing a path under exploration
@@ -99,6 +142,10 @@ public:
   /// @brief Constraints collected so far
   ConstraintManager constraints;
 
+  /// @brief Ranges of the symbolic bytes implied by the constraints, used
+  /// to decide simple branch conditions without the solver
+  ByteRanges byteRanges;
+
   /// Statistics and information
 
   /// @brief Costs for all queries issued for this state, in seconds
@@ -119,6 +166,10 @@ public:
   /// taken to reach/create this state
   TreeOStream symPathOS;
 
+  /// @brief Branch decisions taken by this state in a seed worker
+  /// process (only recorded there), see Executor::runSeedWorkers()
+  std::vector<unsigned> seedPath;
+
   /// @brief Counts how many instructions were executed since the last new
   /// instruction was covered.
   unsigned instsSinceCovNew;
@@ -129,8 +180,12 @@ public:
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled;
 
-  /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<unsigned> > coveredLines;
+  /// @brief Ids of all instructions executed on the path of this state,
+  /// shared with the states it was forked from until written
+  CoverageBitmap instructionCoverage;
+
+  /// @brief Ids of the instructions first covered globally by this state
+  CoverageBitmap newCoverage;
 
   /// @brief Pointer to the process tree of the current state
   PTreeNode *ptreeNode;
@@ -177,11 +232,11 @@ public:
 		  }
 	  };
 
-	  ObjectPair getBuffer(){
+	  ObjectPair getBuffer() const{
 		  return targetBuffer;
 	  }
 
-	  int getoffset (){
+	  int getoffset () const{
 		  return offset;
 	  }
 
@@ -200,6 +255,9 @@ public:
 	  void incOffset(){
 		  offset++;
 	  }
+	  void incOffset(unsigned n){
+		  offset += n;
+	  }
 	  void decOffset(){
 		  offset--;
 	  }
@@ -296,7 +354,10 @@ public:
   void popFrame();
 
   void addSymbolic(const MemoryObject *mo, const Array *array);
-  void addConstraint(ref<Expr> e) { constraints.addConstraint(e); }
+  void addConstraint(ref<Expr> e) {
+    constraints.addConstraint(e);
+    byteRanges.addConstraint(e);
+  }
 
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
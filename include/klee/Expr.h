@@ -12,6 +12,7 @@
 
 #include "klee/util/Bits.h"
 #include "klee/util/Ref.h"
+#include "klee/util/SlabAllocator.h"
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/APFloat.h"
@@ -178,6 +179,13 @@ public:
   Expr() : refCount(0) { Expr::count++; }
   virtual ~Expr() { Expr::count--; } 
 
+  static void *operator new(size_t size) {
+    return SlabAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    SlabAllocator::deallocate(p, size);
+  }
+
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
   
@@ -589,6 +597,13 @@ public:
 
   unsigned getSize() const { return size; }
 
+  static void *operator new(size_t size) {
+    return SlabAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    SlabAllocator::deallocate(p, size);
+  }
+
   int compare(const UpdateNode &b) const;  
   unsigned hash() const { return hashValue; }
 
@@ -0,0 +1,202 @@
+//===-- CoverageBitmap.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COVERAGEBITMAP_H
+#define KLEE_COVERAGEBITMAP_H
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include <stdint.h>
+
+namespace klee {
+
+  /// A set of instruction ids stored as a bitmap. The bitmap is split in
+  /// fixed size chunks which are shared between copies and only copied
+  /// when written, so copying a bitmap (e.g. on fork) is constant time
+  /// and a write after a copy costs the chunk table plus a single chunk.
+  class CoverageBitmap {
+    static const unsigned ChunkWords = 16;
+    static const unsigned ChunkBits = ChunkWords * 64;
+
+    struct Chunk {
+      unsigned refCount;
+      uint64_t words[ChunkWords];
+    };
+
+    struct Table {
+      unsigned refCount;
+      std::vector<Chunk*> chunks;
+    };
+
+    Table *table;
+
+    static void release(Chunk *c) {
+      if (c && --c->refCount == 0)
+        delete c;
+    }
+
+    static void release(Table *t) {
+      if (t && --t->refCount == 0) {
+        for (std::vector<Chunk*>::iterator it = t->chunks.begin(),
+               ie = t->chunks.end(); it != ie; ++it)
+          release(*it);
+        delete t;
+      }
+    }
+
+    /// Make the chunk table private to this bitmap, with room for at
+    /// least numChunks chunks.
+    void makeTableUnique(unsigned numChunks) {
+      if (!table) {
+        table = new Table();
+        table->refCount = 1;
+      } else if (table->refCount > 1) {
+        Table *t = new Table();
+        t->refCount = 1;
+        t->chunks = table->chunks;
+        for (std::vector<Chunk*>::iterator it = t->chunks.begin(),
+               ie = t->chunks.end(); it != ie; ++it)
+          if (*it)
+            ++(*it)->refCount;
+        --table->refCount;
+        table = t;
+      }
+      if (table->chunks.size() < numChunks)
+        table->chunks.resize(numChunks, 0);
+    }
+
+    /// Return a chunk private to this bitmap, table must be unique.
+    Chunk *getWritableChunk(unsigned index) {
+      Chunk *&c = table->chunks[index];
+      if (!c) {
+        c = new Chunk();
+        c->refCount = 1;
+        memset(c->words, 0, sizeof(c->words));
+      } else if (c->refCount > 1) {
+        Chunk *copy = new Chunk();
+        copy->refCount = 1;
+        memcpy(copy->words, c->words, sizeof(c->words));
+        --c->refCount;
+        c = copy;
+      }
+      return c;
+    }
+
+  public:
+    CoverageBitmap() : table(0) {}
+    CoverageBitmap(const CoverageBitmap &b) : table(b.table) {
+      if (table)
+        ++table->refCount;
+    }
+    ~CoverageBitmap() { release(table); }
+
+    CoverageBitmap &operator=(const CoverageBitmap &b) {
+      if (b.table)
+        ++b.table->refCount;
+      release(table);
+      table = b.table;
+      return *this;
+    }
+
+    bool test(unsigned id) const {
+      unsigned index = id / ChunkBits;
+      if (!table || index >= table->chunks.size())
+        return false;
+      const Chunk *c = table->chunks[index];
+      unsigned bit = id % ChunkBits;
+      return c && ((c->words[bit / 64] >> (bit % 64)) & 1);
+    }
+
+    /// Add id to the set, returning true if it was not in it before.
+    bool set(unsigned id) {
+      if (test(id))
+        return false;
+      unsigned index = id / ChunkBits, bit = id % ChunkBits;
+      makeTableUnique(index + 1);
+      Chunk *c = getWritableChunk(index);
+      c->words[bit / 64] |= (uint64_t) 1 << (bit % 64);
+      return true;
+    }
+
+    /// Add all ids in b to this set. Chunks missing here are shared
+    /// with b rather than copied.
+    void unionWith(const CoverageBitmap &b) {
+      if (!b.table || b.table == table)
+        return;
+      makeTableUnique(b.table->chunks.size());
+      for (unsigned i=0, e=b.table->chunks.size(); i != e; ++i) {
+        Chunk *other = b.table->chunks[i];
+        Chunk *&mine = table->chunks[i];
+        if (!other || other == mine)
+          continue;
+        if (!mine) {
+          ++other->refCount;
+          mine = other;
+        } else {
+          Chunk *c = getWritableChunk(i);
+          for (unsigned j=0; j<ChunkWords; ++j)
+            c->words[j] |= other->words[j];
+        }
+      }
+    }
+
+    /// Return the number of ids in the set.
+    unsigned count() const {
+      unsigned res = 0;
+      if (table)
+        for (std::vector<Chunk*>::const_iterator it = table->chunks.begin(),
+               ie = table->chunks.end(); it != ie; ++it)
+          if (*it)
+            for (unsigned j=0; j<ChunkWords; ++j)
+              res += __builtin_popcountll((*it)->words[j]);
+      return res;
+    }
+
+    /// Append the ids in the set to ids, in increasing order.
+    void getIds(std::vector<unsigned> &ids) const {
+      if (!table)
+        return;
+      for (unsigned i=0, e=table->chunks.size(); i != e; ++i) {
+        const Chunk *c = table->chunks[i];
+        if (!c)
+          continue;
+        for (unsigned j=0; j<ChunkWords; ++j)
+          for (uint64_t w = c->words[j]; w; w &= w - 1)
+            ids.push_back(i * ChunkBits + j * 64 + __builtin_ctzll(w));
+      }
+    }
+
+    /// Write the set as an AFL style coverage map of mapSize bytes (a
+    /// power of two). Each id is hashed to a map location which is set
+    /// to 1, ids below mapSize never collide.
+    void toAFLMap(unsigned char *map, unsigned mapSize) const {
+      assert(mapSize && !(mapSize & (mapSize - 1)) &&
+             "map size must be a power of two");
+      memset(map, 0, mapSize);
+      if (!table)
+        return;
+      for (unsigned i=0, e=table->chunks.size(); i != e; ++i) {
+        const Chunk *c = table->chunks[i];
+        if (!c)
+          continue;
+        for (unsigned j=0; j<ChunkWords; ++j) {
+          for (uint64_t w = c->words[j]; w; w &= w - 1) {
+            unsigned id = i * ChunkBits + j * 64 + __builtin_ctzll(w);
+            map[(id * 2654435761u) & (mapSize - 1)] = 1;
+          }
+        }
+      }
+    }
+  };
+
+}
+
+#endif
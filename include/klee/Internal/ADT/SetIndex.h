@@ -0,0 +1,264 @@
+//===-- SetIndex.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SETINDEX_H
+#define KLEE_SETINDEX_H
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <stdint.h>
+
+namespace klee {
+
+  /// SetIndex - A map from sets to values supporting subset and superset
+  /// queries, with the same interface as MapOfSets.
+  ///
+  /// Elements are numbered and each set is stored as a sorted vector of
+  /// element numbers with a 64-bit signature (one bit per element). Subset
+  /// queries scan the signatures, which are stored contiguously, and only
+  /// compare the sets whose signature fits. Superset queries walk the
+  /// posting list of the rarest element of the query set.
+  ///
+  /// If a maximum size is given, the least recently used sets are evicted
+  /// when it is exceeded.
+  template<class K, class V>
+  class SetIndex {
+    typedef std::vector<unsigned> key_ty;
+
+    struct Entry {
+      key_ty key;
+      V value;
+      uint64_t lastUse;
+    };
+
+    std::map<K, unsigned> elementIDs;
+    std::vector<Entry> entries;
+    std::vector<uint64_t> signatures;
+    std::map<key_ty, unsigned> exact;
+    /// The entries containing each element, indexed by element id.
+    std::vector< std::vector<unsigned> > postings;
+
+    unsigned maxSize;
+    uint64_t clock;
+
+    static uint64_t getBit(unsigned id) {
+      return (uint64_t) 1 << ((id * 2654435761u) >> 26);
+    }
+
+    static uint64_t getSignature(const key_ty &key) {
+      uint64_t sig = 0;
+      for (key_ty::const_iterator it = key.begin(), ie = key.end();
+           it != ie; ++it)
+        sig |= getBit(*it);
+      return sig;
+    }
+
+    /// Translate a set to element ids, returning the number of elements
+    /// which are not in any stored set. Those are not added to the key.
+    unsigned getKey(const std::set<K> &set, key_ty &key) const {
+      unsigned unknown = 0;
+      key.clear();
+      for (typename std::set<K>::const_iterator it = set.begin(),
+             ie = set.end(); it != ie; ++it) {
+        typename std::map<K, unsigned>::const_iterator id =
+          elementIDs.find(*it);
+        if (id == elementIDs.end()) {
+          ++unknown;
+        } else {
+          key.push_back(id->second);
+        }
+      }
+      std::sort(key.begin(), key.end());
+      return unknown;
+    }
+
+    V *use(unsigned index) {
+      Entry &e = entries[index];
+      e.lastUse = ++clock;
+      return &e.value;
+    }
+
+    void add(const key_ty &key, const V &value) {
+      unsigned index = entries.size();
+      entries.push_back(Entry());
+      Entry &e = entries.back();
+      e.key = key;
+      e.value = value;
+      e.lastUse = ++clock;
+      signatures.push_back(getSignature(key));
+      exact.insert(std::make_pair(key, index));
+      for (key_ty::const_iterator it = key.begin(), ie = key.end();
+           it != ie; ++it)
+        postings[*it].push_back(index);
+    }
+
+    /// Drop the least recently used eighth of the entries, and renumber
+    /// the remaining entries and elements.
+    void evict() {
+      std::vector<uint64_t> uses;
+      uses.reserve(entries.size());
+      for (unsigned i = 0, e = entries.size(); i != e; ++i)
+        uses.push_back(entries[i].lastUse);
+      std::vector<uint64_t>::iterator nth =
+        uses.begin() + std::max(uses.size() / 8, (size_t) 1);
+      std::nth_element(uses.begin(), nth, uses.end());
+      uint64_t threshold = *nth;
+
+      std::vector<Entry> old;
+      old.swap(entries);
+      std::map<K, unsigned> oldIDs;
+      oldIDs.swap(elementIDs);
+      std::vector<K> elements(oldIDs.size());
+      for (typename std::map<K, unsigned>::iterator it = oldIDs.begin(),
+             ie = oldIDs.end(); it != ie; ++it)
+        elements[it->second] = it->first;
+      oldIDs.clear();
+
+      signatures.clear();
+      exact.clear();
+      postings.clear();
+
+      std::vector<unsigned> newIDs(elements.size(), ~0U);
+      for (unsigned i = 0, e = old.size(); i != e; ++i) {
+        if (old[i].lastUse < threshold)
+          continue;
+        key_ty key;
+        for (key_ty::iterator it = old[i].key.begin(),
+               ie = old[i].key.end(); it != ie; ++it) {
+          unsigned &id = newIDs[*it];
+          if (id == ~0U) {
+            id = postings.size();
+            postings.push_back(std::vector<unsigned>());
+            elementIDs.insert(std::make_pair(elements[*it], id));
+          }
+          key.push_back(id);
+        }
+        std::sort(key.begin(), key.end());
+        add(key, old[i].value);
+        entries.back().lastUse = old[i].lastUse;
+      }
+    }
+
+  public:
+    explicit SetIndex(unsigned _maxSize = 0) : maxSize(_maxSize), clock(0) {}
+
+    void clear() {
+      elementIDs.clear();
+      entries.clear();
+      signatures.clear();
+      exact.clear();
+      postings.clear();
+    }
+
+    unsigned size() const { return entries.size(); }
+
+    /// Append the values of all stored sets to \a values.
+    void getValues(std::vector<V> &values) const {
+      values.reserve(values.size() + entries.size());
+      for (typename std::vector<Entry>::const_iterator it = entries.begin(),
+             ie = entries.end(); it != ie; ++it)
+        values.push_back(it->value);
+    }
+
+    void insert(const std::set<K> &set, const V &value) {
+      key_ty key;
+      key.reserve(set.size());
+      for (typename std::set<K>::const_iterator it = set.begin(),
+             ie = set.end(); it != ie; ++it) {
+        std::pair<typename std::map<K, unsigned>::iterator, bool> res =
+          elementIDs.insert(std::make_pair(*it, postings.size()));
+        if (res.second)
+          postings.push_back(std::vector<unsigned>());
+        key.push_back(res.first->second);
+      }
+      std::sort(key.begin(), key.end());
+
+      typename std::map<key_ty, unsigned>::iterator it = exact.find(key);
+      if (it != exact.end()) {
+        *use(it->second) = value;
+        return;
+      }
+
+      add(key, value);
+      if (maxSize && entries.size() > maxSize)
+        evict();
+    }
+
+    V *lookup(const std::set<K> &set) {
+      key_ty key;
+      if (getKey(set, key))
+        return 0;
+      typename std::map<key_ty, unsigned>::iterator it = exact.find(key);
+      return it == exact.end() ? 0 : use(it->second);
+    }
+
+    /// findSubset - Return the value of a stored subset of \a set which
+    /// satisfies \a p, trying the most recently added sets first.
+    template<class Predicate>
+    V *findSubset(const std::set<K> &set, const Predicate &p) {
+      key_ty key;
+      getKey(set, key);
+      uint64_t outside = ~getSignature(key);
+      for (unsigned i = entries.size(); i != 0; --i) {
+        if (signatures[i - 1] & outside)
+          continue;
+        Entry &e = entries[i - 1];
+        if (e.key.size() <= key.size() &&
+            std::includes(key.begin(), key.end(),
+                          e.key.begin(), e.key.end()) &&
+            p(e.value))
+          return use(i - 1);
+      }
+      return 0;
+    }
+
+    /// findSuperset - Return the value of a stored superset of \a set which
+    /// satisfies \a p, trying the most recently added sets first.
+    template<class Predicate>
+    V *findSuperset(const std::set<K> &set, const Predicate &p) {
+      key_ty key;
+      if (getKey(set, key))
+        return 0;
+
+      if (key.empty()) {
+        for (unsigned i = entries.size(); i != 0; --i)
+          if (p(entries[i - 1].value))
+            return use(i - 1);
+        return 0;
+      }
+
+      // Any superset is in the posting list of every element of the set,
+      // walk the shortest one.
+      const std::vector<unsigned> *candidates = &postings[key[0]];
+      for (key_ty::iterator it = key.begin(), ie = key.end(); it != ie; ++it)
+        if (postings[*it].size() < candidates->size())
+          candidates = &postings[*it];
+
+      uint64_t sig = getSignature(key);
+      for (unsigned i = candidates->size(); i != 0; --i) {
+        unsigned index = (*candidates)[i - 1];
+        if ((signatures[index] & sig) != sig)
+          continue;
+        Entry &e = entries[index];
+        if (std::includes(e.key.begin(), e.key.end(),
+                          key.begin(), key.end()) &&
+            p(e.value))
+          return use(index);
+      }
+      return 0;
+    }
+  };
+
+}
+
+#endif
@@ -24,6 +24,8 @@ namespace klee {
     friend class TreeOStream;
 
   private:
+    struct AsyncOutput;
+
     char buffer[bufferSize];
     unsigned lastID, bufferCount;
 
@@ -31,11 +33,21 @@ namespace klee {
     std::ofstream *output;
     unsigned ids;
 
+    /// The parent of each stream, indexed by stream id.
+    std::vector<TreeStreamID> parents;
+
+    /// If non-null, records are batched in blocks which a separate thread
+    /// writes to the output.
+    AsyncOutput *async;
+
     void write(TreeOStream &os, const char *s, unsigned size);
+    void writeRecord(unsigned id, const char *s, unsigned size);
+    void emit(const char *s, unsigned size);
     void flushBuffer();
 
   public:
-    TreeStreamWriter(const std::string &_path);
+    /// If \a asyncOutput is set, the file is written by a separate thread.
+    TreeStreamWriter(const std::string &_path, bool asyncOutput = false);
     ~TreeStreamWriter();
 
     bool good();
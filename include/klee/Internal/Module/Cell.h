@@ -11,12 +11,55 @@
 #define KLEE_CELL_H
 
 #include <klee/Expr.h>
+#include <klee/util/Bits.h>
 
 namespace klee {
   class MemoryObject;
 
+  /// Cell - The value of a register or constant.
+  ///
+  /// Concrete integers of up to 64 bits are also kept inline, so that the
+  /// interpreter can compute on them directly; the ConstantExpr for such a
+  /// value is only built once somebody asks for the expression.
   struct Cell {
-    ref<Expr> value;
+  private:
+    /// The value, or null if it has only been set inline (or not at all).
+    mutable ref<Expr> expr;
+    uint64_t concrete;
+    /// The width of the inline value, 0 if there is none.
+    Expr::Width concreteWidth;
+
+  public:
+    Cell() : concrete(0), concreteWidth(0) {}
+
+    bool isConcrete() const { return concreteWidth != 0; }
+    /// getConcrete - The inline value, zero extended.
+    uint64_t getConcrete() const { return concrete; }
+    Expr::Width getConcreteWidth() const { return concreteWidth; }
+
+    const ref<Expr> &getValue() const {
+      if (expr.isNull() && concreteWidth)
+        expr = ConstantExpr::create(concrete, concreteWidth);
+      return expr;
+    }
+
+    void setValue(const ref<Expr> &value) {
+      expr = value;
+      concreteWidth = 0;
+      if (!value.isNull())
+        if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value))
+          if (CE->getWidth() <= Expr::Int64) {
+            concrete = CE->getZExtValue();
+            concreteWidth = CE->getWidth();
+          }
+    }
+
+    void setConcrete(uint64_t value, Expr::Width width) {
+      assert(width && width <= Expr::Int64 && "invalid inline width");
+      expr = ref<Expr>();
+      concrete = bits64::truncateToNBits(value, width);
+      concreteWidth = width;
+    }
   };
 }
 
@@ -10,35 +10,46 @@
 #ifndef KLEE_LIB_INSTRUCTIONINFOTABLE_H
 #define KLEE_LIB_INSTRUCTIONINFOTABLE_H
 
-#include <map>
+#include "llvm/ADT/DenseMap.h"
+
+#include <cassert>
+#include <iosfwd>
 #include <string>
 #include <set>
+#include <vector>
 
 namespace llvm {
   class Function;
   class Instruction;
   class Module; 
+  class raw_ostream;
 }
 
 namespace klee {
+  class InstructionInfoTable;
 
   /* Stores debug information for a KInstruction */
   struct InstructionInfo {
     unsigned id;
     const std::string &file;
     unsigned line;
-    unsigned assemblyLine;
+    /// The table the information belongs to, or null for the dummy entry.
+    const InstructionInfoTable *table;
 
   public:
     InstructionInfo(unsigned _id,
                     const std::string &_file,
                     unsigned _line,
-                    unsigned _assemblyLine)
+                    const InstructionInfoTable *_table)
       : id(_id), 
         file(_file),
         line(_line),
-        assemblyLine(_assemblyLine) {
+        table(_table) {
     }
+
+    /// Return the line of assembly.ll the instruction is on, or 0 if it
+    /// is unknown.
+    unsigned getAssemblyLine() const;
   };
 
   class InstructionInfoTable {
@@ -50,10 +61,19 @@ namespace klee {
 
     std::string dummyString;
     InstructionInfo dummyInfo;
-    std::map<const llvm::Instruction*, InstructionInfo> infos;
+    /// The information of each instruction, indexed by its id.
+    std::vector<InstructionInfo> infos;
+    llvm::DenseMap<const llvm::Instruction*, unsigned> ids;
     std::set<const std::string *, ltstr> internedStrings;
+    llvm::Module *module;
+    /// The assembly line of each instruction, indexed by its id. Empty until
+    /// the module is first printed, which only happens when a line is asked
+    /// for or assembly.ll is written.
+    mutable std::vector<unsigned> assemblyLines;
 
   private:
+    InstructionInfoTable();
+
     const std::string *internString(std::string s);
     bool getInstructionDebugInfo(const llvm::Instruction *I,
                                  const std::string *&File, unsigned &Line);
@@ -64,7 +84,25 @@ namespace klee {
 
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction*) const;
+    /// Return the information of the instruction with the given id.
+    const InstructionInfo &getInfo(unsigned id) const {
+      assert(id < infos.size() && "invalid instruction id");
+      return infos[id];
+    }
     const InstructionInfo &getFunctionInfo(const llvm::Function*) const;
+    /// Return the line of assembly.ll the instruction with the given id is
+    /// on, printing the module to count lines on the first call.
+    unsigned getAssemblyLine(unsigned id) const;
+
+    /// Print the module as assembly.ll to os, recording the line of each
+    /// instruction on the way.
+    void printModule(llvm::raw_ostream &os) const;
+
+    /// Write the table, to be read back by read().
+    void write(std::ostream &os) const;
+    /// Read the table written by write() for a module with the same
+    /// instructions, or return null if it does not fit the module.
+    static InstructionInfoTable *read(llvm::Module *m, std::istream &is);
   };
 
 }
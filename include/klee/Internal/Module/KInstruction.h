@@ -15,6 +15,7 @@
 #include <vector>
 
 namespace llvm {
+  class Function;
   class Instruction;
 }
 
@@ -22,6 +23,7 @@ namespace klee {
   class Executor;
   struct InstructionInfo;
   class KModule;
+  struct MergePoint;
 
 
   /// KInstruction - Intermediate instruction representation used
@@ -38,6 +40,23 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// The decoded instruction, so that executing it need not go back to
+    /// the LLVM instruction for these.
+    ///
+    /// opcode - The LLVM opcode.
+    unsigned opcode;
+    /// predicate - The predicate of a comparison, 0 otherwise.
+    unsigned predicate;
+    /// width - The width of the result in bits, 0 if it has no sized type.
+    unsigned width;
+    /// callee - The function a call calls, if it is known without looking
+    /// at the function aliases of the state.
+    llvm::Function *callee;
+
+    /// mergePoint - Set if states may be merged when they reach this
+    /// instruction, see KModule::computeMergePoints.
+    MergePoint *mergePoint;
+
   public:
     virtual ~KInstruction(); 
   };
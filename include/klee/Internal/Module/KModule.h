@@ -15,6 +15,7 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -40,6 +41,24 @@ namespace klee {
   class KModule;
   template<class T> class ref;
 
+  /// MergePoint - The first instruction after the PHI nodes of a block
+  /// where the paths of a conditional branch join again.
+  struct MergePoint {
+    /// The estimated number of queries issued after the merge point,
+    /// counted as the conditional branches the function may still take.
+    unsigned totalQueries;
+
+    /// For each register live at the merge point that the conditions of
+    /// those branches depend on, the number of them that do.
+    std::map<unsigned, unsigned> queries;
+
+    /// The registers whose value is not read again before being written,
+    /// which may hold a different value in every state.
+    std::vector<unsigned> deadRegisters;
+
+    MergePoint() : totalQueries(0) {}
+  };
+
   struct KFunction {
     llvm::Function *function;
 
@@ -54,6 +73,10 @@ namespace klee {
     /// "coverable" for statistics and search heuristics.
     bool trackCoverage;
 
+    /// The merge points of the function, empty unless they have been
+    /// computed.
+    std::vector<MergePoint*> mergePoints;
+
   private:
     KFunction(const KFunction&);
     KFunction &operator=(const KFunction&);
@@ -63,6 +86,8 @@ namespace klee {
     ~KFunction();
 
     unsigned getArgRegister(unsigned index) { return index; }
+
+    void computeMergePoints();
   };
 
 
@@ -117,6 +142,16 @@ namespace klee {
     // Mark function with functionName as part of the KLEE runtime
     void addInternalFunction(const char* functionName);
 
+    /// Link the runtime into the module and run the passes which put it
+    /// into the form the interpreter expects.
+    void transform(const Interpreter::ModuleOptions &opts);
+
+    /// Write the prepared module, its instruction info table and (given
+    /// the path of the assembly.ll written) its assembly to the module
+    /// cache entry at path. Each file is moved into place once complete,
+    /// so runs sharing the cache never read a partial entry.
+    void writeCache(const std::string &path, const std::string &assemblyPath);
+
   public:
     KModule(llvm::Module *_module);
     ~KModule();
@@ -127,8 +162,18 @@ namespace klee {
     void prepare(const Interpreter::ModuleOptions &opts, 
                  InterpreterHandler *ihandler);
 
+    /// Find the merge points of every function: the points where the
+    /// paths of a conditional branch join again, at the immediate
+    /// post-dominator of the branch. Each gets an estimate of the queries
+    /// that follow it, for deciding whether merging states there pays.
+    void computeMergePoints();
+
     /// Return an id for the given constant, creating a new one if necessary.
     unsigned getConstantID(llvm::Constant *c, KInstruction* ki);
+
+    /// Return a description of the options prepare() depends on, and of
+    /// the runtime it links in, for keying a module cache entry.
+    static std::string getCacheKey(const Interpreter::ModuleOptions &opts);
   };
 } // End klee namespace
 
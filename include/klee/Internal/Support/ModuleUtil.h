@@ -10,6 +10,7 @@
 #ifndef KLEE_TRANSFORM_UTIL_H
 #define KLEE_TRANSFORM_UTIL_H
 
+#include <stdint.h>
 #include <string>
 
 namespace llvm {
@@ -36,6 +37,13 @@ namespace klee {
   /// terminates in a direct call).
   bool functionEscapes(const llvm::Function *f);
 
+  /// Return a hash of a string, for keying cached artifacts.
+  uint64_t getStringHash(const std::string &s);
+
+  /// Return a hash of the contents of a file, for keying cached
+  /// artifacts derived from it, or 0 if the file cannot be read.
+  uint64_t getFileHash(const std::string &fileName);
+
 }
 
 #endif
@@ -43,6 +43,12 @@ public:
   virtual void processTestCase(const ExecutionState &state,
                                const char *err, 
                                const char *suffix) = 0;
+
+  /// Take the numbers of test cases from a counter shared with processes
+  /// forked after this call, so that they can write test cases into the
+  /// same output directory. Returns false if this is not supported.
+  virtual bool shareTestIndex() { return false; }
+
   virtual const std::vector<std::string>& getTargetFunction() = 0;
 
   virtual const bool ifConstructSeedForTarget() = 0;
@@ -57,12 +63,19 @@ public:
     bool Optimize;
     bool CheckDivZero;
     bool CheckOvershift;
+    /// Base name of the module cache entry for the module, empty if it is
+    /// not cached.
+    std::string CachePath;
+    /// Whether the module was read from the cache entry, and so has
+    /// already been prepared.
+    bool Cached;
 
     ModuleOptions(const std::string& _LibraryDir, 
                   bool _Optimize, bool _CheckDivZero,
                   bool _CheckOvershift)
       : LibraryDir(_LibraryDir), Optimize(_Optimize), 
-        CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift) {}
+        CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift),
+        Cached(false) {}
   };
 
   enum LogType
@@ -98,6 +111,11 @@ public:
   static Interpreter *create(const InterpreterOptions &_interpreterOpts,
                              InterpreterHandler *ih);
 
+  /// Return a description of everything besides the module and the
+  /// libraries linked into it that setModule() prepares it according to,
+  /// for keying a module cache entry.
+  static std::string getModuleCacheKey(const ModuleOptions &opts);
+
   /// Register the module to be executed.  
   ///
   /// \return The final module after it has been optimized, checks
@@ -156,6 +174,12 @@ public:
 
   virtual void getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) = 0;
+
+  /// Fill res with an AFL style coverage map of the instructions
+  /// executed on the path of state. The size of res must be a power of
+  /// two.
+  virtual void getCoverageMap(const ExecutionState &state,
+                              std::vector<unsigned char> &res) = 0;
 };
 
 } // End klee namespace
@@ -10,6 +10,7 @@
 #ifndef KLEE_SOLVER_H
 #define KLEE_SOLVER_H
 
+#include "klee/Config/config.h"
 #include "klee/Expr.h"
 
 #include <vector>
@@ -234,6 +235,32 @@ namespace klee {
 
 #endif /* SUPPORT_METASMT */
 
+#ifdef SUPPORT_Z3
+
+  /// Z3Solver - A complete solver using the Z3 library in-process. Queries
+  /// are solved incrementally, reusing the constraints of the previous
+  /// query, and timeouts are handled by Z3 itself.
+  class Z3Solver : public Solver {
+  public:
+    Z3Solver();
+
+    /// getConstraintLog - Return the constraint log for the given state in
+    /// SMT-LIBv2 format.
+    virtual char *getConstraintLog(const Query&);
+
+    /// setCoreSolverTimeout - Set constraint solver timeout delay to the given
+    /// value; 0 is off.
+    virtual void setCoreSolverTimeout(double timeout);
+  };
+
+#endif /* SUPPORT_Z3 */
+
+  /// The core solvers which can be selected with --solver-backend.
+  enum CoreSolverType {
+    STP_SOLVER,
+    Z3_SOLVER
+  };
+
   /* *** */
 
   /// createValidatingSolver - Create a solver which will validate all query
@@ -272,6 +299,29 @@ namespace klee {
   ///
   /// \param s - The underlying solver to use.
   Solver *createIndependentSolver(Solver *s);
+
+  /// createCanonicalSolver - Create a solver which renames the arrays of each
+  /// query canonically and orders commutative operands before propagating the
+  /// query to the underlying solver, so that caches below it share the
+  /// entries of alpha-equivalent queries.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createCanonicalSolver(Solver *s);
+
+  /// createAdaptiveTimeoutSolver - Create a solver which learns how long
+  /// queries of each shape take, lowers the timeout of shapes which are
+  /// always answered quickly and fails shapes which always time out without
+  /// propagating them to the underlying solver.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createAdaptiveTimeoutSolver(Solver *s);
+
+  /// createBitBlastSolver - Create a solver which bit-blasts queries reading
+  /// arrays only at constant indices into an embedded SAT solver, and
+  /// propagates all other queries to the underlying solver.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createBitBlastSolver(Solver *s);
   
   /// createPCLoggingSolver - Create a solver which will forward all queries
   /// after writing them to the given path in .pc format.
@@ -287,6 +337,22 @@ namespace klee {
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
+
+  /// createCoreSolver - Create the core solver of the given type, or return
+  /// null if KLEE was built without support for it.
+  ///
+  /// \param useForkedSolver - Whether STP should be run in a separate
+  /// process. The Z3 backend always runs in-process.
+  /// \param optimizeDivides - Whether STP should optimize constant divides.
+  Solver *createCoreSolver(CoreSolverType type, bool useForkedSolver,
+                           bool optimizeDivides = true);
+
+  /// createPortfolioSolver - Create a solver which runs each query on the
+  /// given core solvers at once, in forked worker processes, and returns
+  /// the first answer. Returns null if one of the core solvers is not
+  /// supported.
+  Solver *createPortfolioSolver(const std::vector<CoreSolverType> &types,
+                                bool optimizeDivides = true);
   
 }
 
@@ -10,6 +10,8 @@
 #ifndef KLEE_UTIL_BITARRAY_H
 #define KLEE_UTIL_BITARRAY_H
 
+#include "klee/util/SlabAllocator.h"
+
 namespace klee {
 
   // XXX would be nice not to have
@@ -17,19 +19,33 @@ namespace klee {
   // BitArrays
 class BitArray {
 private:
+  uint32_t words;
   uint32_t *bits;
   
 protected:
   static uint32_t length(unsigned size) { return (size+31)/32; }
 
+  uint32_t *allocateBits() {
+    return static_cast<uint32_t*>(SlabAllocator::allocate(sizeof(*bits)*words));
+  }
+
 public:
-  BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]) {
-    memset(bits, value?0xFF:0, sizeof(*bits)*length(size));
+  BitArray(unsigned size, bool value = false)
+    : words(length(size)), bits(allocateBits()) {
+    memset(bits, value?0xFF:0, sizeof(*bits)*words);
+  }
+  BitArray(const BitArray &b, unsigned size)
+    : words(length(size)), bits(allocateBits()) {
+    memcpy(bits, b.bits, sizeof(*bits)*words);
+  }
+  ~BitArray() { SlabAllocator::deallocate(bits, sizeof(*bits)*words); }
+
+  static void *operator new(size_t size) {
+    return SlabAllocator::allocate(size);
   }
-  BitArray(const BitArray &b, unsigned size) : bits(new uint32_t[length(size)]) {
-    memcpy(bits, b.bits, sizeof(*bits)*length(size));
+  static void operator delete(void *p, size_t size) {
+    SlabAllocator::deallocate(p, size);
   }
-  ~BitArray() { delete[] bits; }
 
   bool get(unsigned idx) { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
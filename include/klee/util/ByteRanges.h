@@ -0,0 +1,70 @@
+//===-- ByteRanges.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_BYTERANGES_H
+#define KLEE_UTIL_BYTERANGES_H
+
+#include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+
+#include <utility>
+
+namespace klee {
+  class Array;
+
+  /// ByteRanges - An over-approximation of the values the symbolic bytes
+  /// can take under a set of constraints, kept as an interval and known bits
+  /// for each byte. Facts are learned from simple constraints as they are
+  /// added, and used to decide conditions over those bytes without asking
+  /// the solver.
+  ///
+  /// Copies share their storage, so copying the ranges of a state on a fork
+  /// is cheap.
+  class ByteRanges {
+  public:
+    struct Byte {
+      uint8_t min, max;
+      /// Bits known to be zero and one respectively.
+      uint8_t zeros, ones;
+
+      Byte() : min(0), max(255), zeros(0), ones(0) {}
+    };
+
+  private:
+    typedef std::pair<const Array*, unsigned> key_ty;
+    typedef ImmutableMap<key_ty, Byte> bytes_ty;
+
+    /// The bytes something is known about.
+    bytes_ty bytes;
+
+    void restrict(const ref<Expr> &e, uint64_t min, uint64_t max);
+    void exclude(const ref<Expr> &e, uint64_t value);
+    void learn(const ref<Expr> &e, bool value);
+
+  public:
+    ByteRanges() {}
+
+    /// getByte - Return what is known about the byte at the given index of
+    /// a symbolic array.
+    Byte getByte(const Array *array, unsigned index) const;
+
+    /// setByte - Narrow the known values of a byte, ignoring narrowings
+    /// which would leave no value.
+    void setByte(const Array *array, unsigned index, Byte b);
+
+    /// addConstraint - Learn from a constraint which holds from now on.
+    void addConstraint(const ref<Expr> &e) { learn(e, true); }
+
+    /// evaluate - Try to decide a boolean expression, returning true and its
+    /// value if it has the same value for all bytes in the ranges.
+    bool evaluate(const ref<Expr> &e, bool &value) const;
+  };
+}
+
+#endif
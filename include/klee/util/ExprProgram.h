@@ -0,0 +1,100 @@
+//===-- ExprProgram.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_EXPRPROGRAM_H
+#define KLEE_UTIL_EXPRPROGRAM_H
+
+#include "klee/Expr.h"
+
+#include <map>
+#include <vector>
+
+namespace klee {
+  class Assignment;
+
+  /// ExprProgram - A set of boolean expressions compiled to a flat,
+  /// topologically ordered instruction sequence, for checking whether
+  /// many assignments satisfy all of them.
+  ///
+  /// Only expressions whose values fit in 64 bits are compiled. Anything
+  /// the program cannot evaluate exactly like AssignmentEvaluator
+  /// (e.g. division by zero) gives Unknown, and the caller should fall
+  /// back to Assignment::satisfies.
+  class ExprProgram {
+  public:
+    enum Result { False, True, Unknown };
+
+  private:
+    struct Instruction {
+      Expr::Kind kind;
+      Expr::Width width;
+      unsigned a, b, c;
+      uint64_t imm;
+    };
+
+    /// Node of an update list, next is ~0U at the end of the list.
+    struct Update {
+      unsigned index, value, next;
+    };
+
+    /// Pseudo kind checking that a compiled root expression is true.
+    static const Expr::Kind CheckKind = Expr::InvalidKind;
+
+    bool valid;
+    std::vector<Instruction> instructions;
+    std::vector<Update> updates;
+    std::vector<const Array*> arrays;
+
+    /// The contents of the constant arrays, laid out contiguously.
+    std::vector<unsigned char> constants;
+    std::vector<unsigned> constantOffsets;
+
+    /// The values of the instructions and the bindings of the arrays in
+    /// the assignment being evaluated.
+    std::vector<uint64_t> values;
+    std::vector<const unsigned char*> arrayData;
+    std::vector<unsigned> arraySizes;
+    bool allowFreeValues;
+
+    std::map<const Expr*, unsigned> exprSlots;
+    std::map<const UpdateNode*, unsigned> updateIndices;
+    std::map<const Array*, unsigned> arrayIndices;
+
+    unsigned compile(const ref<Expr> &e);
+    unsigned compileUpdates(const UpdateNode *un);
+    unsigned getArrayIndex(const Array *array);
+    unsigned emit(Expr::Kind kind, Expr::Width width,
+                  unsigned a=0, unsigned b=0, unsigned c=0, uint64_t imm=0);
+    void add(const ref<Expr> &e);
+
+    void loadArrays(const Assignment &a);
+    bool readArray(unsigned array, unsigned index, uint64_t &result) const;
+
+  public:
+    template<typename InputIterator>
+    ExprProgram(InputIterator begin, InputIterator end)
+      : valid(true), allowFreeValues(false) {
+      for (; begin != end && valid; ++begin)
+        add(*begin);
+      exprSlots.clear();
+      updateIndices.clear();
+      arrayIndices.clear();
+    }
+
+    /// isValid - Return false if the expressions could not be compiled, in
+    /// which case evaluate always returns Unknown.
+    bool isValid() const { return valid; }
+
+    /// evaluate - Return whether all expressions are true under the
+    /// assignment.
+    Result evaluate(const Assignment &a);
+  };
+}
+
+#endif
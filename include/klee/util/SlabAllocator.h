@@ -0,0 +1,48 @@
+//===-- SlabAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_UTIL_SLABALLOCATOR_H
+#define KLEE_UTIL_SLABALLOCATOR_H
+
+#include "klee/Statistic.h"
+
+#include <cstddef>
+
+namespace klee {
+namespace stats {
+  /// Objects handed out by the slab allocator.
+  extern Statistic slabAllocations;
+
+  /// Bytes of memory reserved for slabs.
+  extern Statistic slabBytes;
+}
+
+  /// SlabAllocator - Allocator for the small objects that are created and
+  /// freed most, such as expressions, update nodes and object states.
+  ///
+  /// Objects are carved out of large slabs by size class. A freed object
+  /// goes to the free list of its size class in the freeing thread, which
+  /// that thread allocates from first. Slabs are never given back. Larger
+  /// objects, and all objects with --use-system-allocator, come from the
+  /// system allocator.
+  class SlabAllocator {
+  public:
+    static void *allocate(size_t size);
+
+    /// Free an object, which must be given the size it was allocated
+    /// with.
+    static void deallocate(void *p, size_t size);
+
+    /// The bytes in the free lists of the calling thread, which the
+    /// system allocator counts as in use.
+    static size_t getFreeBytes();
+  };
+}
+
+#endif
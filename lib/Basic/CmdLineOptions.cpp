@@ -27,6 +27,26 @@ UseIndependentSolver("use-independent-solver",
                      llvm::cl::init(true),
                      llvm::cl::desc("Use constraint independence (default=on)"));
 
+llvm::cl::opt<bool>
+UseCanonicalSolver("use-canonical-solver",
+                   llvm::cl::init(false),
+                   llvm::cl::desc("Rename arrays canonically before the caches, so that queries differing "
+                                  "only in array names share cache entries. Every query is rewritten, "
+                                  "which only pays off when many queries are alpha-equivalent (default=off)"));
+
+llvm::cl::opt<bool>
+UseAdaptiveTimeout("use-adaptive-timeout",
+                   llvm::cl::init(true),
+                   llvm::cl::desc("Pick the solver timeout of each query from the time queries of the same "
+                                  "shape took, giving up on shapes which always time out. Only has an effect "
+                                  "with --max-solver-time (default=on)"));
+
+llvm::cl::opt<bool>
+UseBitBlastSolver("use-bit-blast-solver",
+                  llvm::cl::init(true),
+                  llvm::cl::desc("Answer queries which read arrays only at constant indices with the built-in "
+                                 "bit-blasting SAT solver instead of the core solver (default=on)"));
+
 llvm::cl::opt<bool>
 DebugValidateSolver("debug-validate-solver",
 		             llvm::cl::init(false));
@@ -55,6 +75,22 @@ CoreSolverOptimizeDivides("solver-optimize-divides",
                  llvm::cl::desc("Optimize constant divides into add/shift/multiplies before passing to core SMT solver (default=on)"),
                  llvm::cl::init(true));
 
+llvm::cl::opt<CoreSolverType>
+CoreSolverToUse("solver-backend",
+                llvm::cl::desc("Specify the core solver backend to use (default=stp)"),
+                llvm::cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+                                 clEnumValN(Z3_SOLVER, "z3", "Z3, in-process (requires a build with --with-z3)"),
+                                 clEnumValEnd),
+                llvm::cl::init(STP_SOLVER));
+
+llvm::cl::list<CoreSolverType>
+CoreSolverPortfolio("solver-portfolio",
+                    llvm::cl::desc("Race the given core solver backends on each query and use the first answer, "
+                                   "e.g. stp,z3 (default=off)"),
+                    llvm::cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+                                     clEnumValN(Z3_SOLVER, "z3", "Z3, in-process (requires a build with --with-z3)"),
+                                     clEnumValEnd),
+                    llvm::cl::CommaSeparated);
 
 /* Using cl::list<> instead of cl::bits<> results in quite a bit of ugliness when it comes to checking
  * if an option is set. Unfortunately with gcc4.7 cl::bits<> is broken with LLVM2.9 and I doubt everyone
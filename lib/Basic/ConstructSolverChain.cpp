@@ -42,6 +42,9 @@ namespace klee
 			  << baseSolverQuerySMT2LogPath.c_str() << "\n";
 	  }
 
+	  if (UseAdaptiveTimeout)
+		solver = createAdaptiveTimeoutSolver(solver);
+
 	  if (UseFastCexSolver)
 		solver = createFastCexSolver(solver);
 
@@ -51,6 +54,9 @@ namespace klee
 	  if (UseCache)
 		solver = createCachingSolver(solver);
 
+	  if (UseCanonicalSolver)
+		solver = createCanonicalSolver(solver);
+
 	  if (UseIndependentSolver)
 		solver = createIndependentSolver(solver);
 
@@ -77,6 +83,25 @@ namespace klee
 	  return solver;
 	}
 
+	Solver *createCoreSolverFromOptions(bool useForkedSolver,
+	                                    bool optimizeDivides)
+	{
+	  Solver *solver;
+	  if (CoreSolverPortfolio.empty()) {
+		solver = createCoreSolver(CoreSolverToUse, useForkedSolver,
+		                          optimizeDivides);
+	  } else {
+		std::vector<CoreSolverType> types(CoreSolverPortfolio.begin(),
+		                                  CoreSolverPortfolio.end());
+		solver = createPortfolioSolver(types, optimizeDivides);
+	  }
+
+	  if (solver && UseBitBlastSolver)
+		solver = createBitBlastSolver(solver);
+
+	  return solver;
+	}
+
 }
 
 
@@ -319,6 +319,7 @@ bool AddressSpace::copyInConcretes() {
         } else {
           ObjectState *wos = getWriteable(mo, os);
           memcpy(wos->concreteStore, address, mo->size);
+          wos->bumpVersion();
         }
       }
     }
@@ -21,7 +21,9 @@ Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
+Statistic stats::rangeFastPathHits("RangeFastPathHits", "RFhits");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
+Statistic stats::recentQueryHits("RecentQueryHits", "RQhits");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
 Statistic stats::solverTime("SolverTime", "Stime");
 Statistic stats::states("States", "States");
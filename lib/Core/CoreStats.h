@@ -27,6 +27,14 @@ namespace stats {
   extern Statistic forkTime;
   extern Statistic solverTime;
 
+  /// The number of queries decided from the byte ranges of the state,
+  /// without calling the solver.
+  extern Statistic rangeFastPathHits;
+
+  /// The number of queries answered by an identical query recently issued
+  /// in the same or another state.
+  extern Statistic recentQueryHits;
+
   /// The number of process forks.
   extern Statistic forks;
 
@@ -25,7 +25,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <iomanip>
+#include <new>
 #include <sstream>
 #include <cassert>
 #include <map>
@@ -42,10 +44,61 @@ namespace {
 
 /***/
 
+/// The memory of released register files, by the number of registers.
+static std::vector<std::vector<void*> > freeRegisterFiles;
+
+/// The most register files of one size kept for reuse.
+static const unsigned MaxFreeRegisterFiles = 1024;
+
+RegisterFile::RegisterFile(unsigned _size) : refCount(1), size(_size) {
+  Cell *c = cells();
+  for (unsigned i=0; i<size; i++)
+    new (&c[i]) Cell();
+}
+
+RegisterFile::~RegisterFile() {
+  Cell *c = cells();
+  for (unsigned i=0; i<size; i++)
+    c[i].~Cell();
+}
+
+RegisterFile *RegisterFile::create(unsigned size) {
+  void *memory;
+  if (size < freeRegisterFiles.size() && !freeRegisterFiles[size].empty()) {
+    memory = freeRegisterFiles[size].back();
+    freeRegisterFiles[size].pop_back();
+  } else {
+    memory = ::operator new(sizeof(RegisterFile) + size * sizeof(Cell));
+  }
+  return new (memory) RegisterFile(size);
+}
+
+void RegisterFile::release() {
+  assert(refCount > 0);
+  if (--refCount)
+    return;
+
+  unsigned n = size;
+  this->~RegisterFile();
+  if (n >= freeRegisterFiles.size())
+    freeRegisterFiles.resize(n + 1);
+  if (freeRegisterFiles[n].size() < MaxFreeRegisterFiles)
+    freeRegisterFiles[n].push_back(this);
+  else
+    ::operator delete(this);
+}
+
+RegisterFile *RegisterFile::unshare() {
+  RegisterFile *copy = create(size);
+  std::copy(cells(), cells() + size, copy->cells());
+  release();
+  return copy;
+}
+
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
+    locals(RegisterFile::create(kf->numRegisters)),
     minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
 }
 
 StackFrame::StackFrame(const StackFrame &s) 
@@ -53,15 +106,27 @@ StackFrame::StackFrame(const StackFrame &s)
     kf(s.kf),
     callPathNode(s.callPathNode),
     allocas(s.allocas),
+    locals(s.locals),
     minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
     varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
+  locals->retain();
+}
+
+StackFrame &StackFrame::operator=(const StackFrame &s) {
+  s.locals->retain();
+  locals->release();
+  caller = s.caller;
+  kf = s.kf;
+  callPathNode = s.callPathNode;
+  allocas = s.allocas;
+  locals = s.locals;
+  minDistToUncoveredOnReturn = s.minDistToUncoveredOnReturn;
+  varargs = s.varargs;
+  return *this;
 }
 
 StackFrame::~StackFrame() { 
-  delete[] locals; 
+  locals->release();
 }
 
 /***/
@@ -84,7 +149,11 @@ ExecutionState::ExecutionState(KFunction *kf) :
 }
 
 ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
-    : constraints(assumptions), queryCost(0.), ptreeNode(0) {}
+    : constraints(assumptions), queryCost(0.), ptreeNode(0) {
+  for (std::vector<ref<Expr> >::const_iterator it = assumptions.begin(),
+         ie = assumptions.end(); it != ie; ++it)
+    byteRanges.addConstraint(*it);
+}
 
 ExecutionState::~ExecutionState() {
   for (unsigned int i=0; i<symbolics.size(); i++)
@@ -109,6 +178,7 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     addressSpace(state.addressSpace),
     constraints(state.constraints),
+    byteRanges(state.byteRanges),
 
     queryCost(state.queryCost),
     weight(state.weight),
@@ -116,11 +186,13 @@ ExecutionState::ExecutionState(const ExecutionState& state):
 
     pathOS(state.pathOS),
     symPathOS(state.symPathOS),
+    seedPath(state.seedPath),
 
     instsSinceCovNew(state.instsSinceCovNew),
     coveredNew(state.coveredNew),
     forkDisabled(state.forkDisabled),
-    coveredLines(state.coveredLines),
+    instructionCoverage(state.instructionCoverage),
+    newCoverage(state.newCoverage),
     ptreeNode(state.ptreeNode),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames),
@@ -139,7 +211,7 @@ ExecutionState *ExecutionState::branch() {
 
   ExecutionState *falseState = new ExecutionState(*this);
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->newCoverage = CoverageBitmap();
 
   weight *= .5;
   falseState->weight -= weight;
@@ -221,6 +293,28 @@ bool ExecutionState::merge(const ExecutionState &b) {
       return false;
   }
 
+  // The modelled IO state is not part of the memory that gets merged, so the
+  // states have to agree on it: same open files at the same offsets, and the
+  // same partially scanned number.
+  if (FscanfBytesRead != b.FscanfBytesRead ||
+      ioBuffer.getNeg() != b.ioBuffer.getNeg() ||
+      ioBuffer.getBuffer() != b.ioBuffer.getBuffer() ||
+      bufferList.size() != b.bufferList.size() ||
+      fileDescriptor.size() != b.fileDescriptor.size()) {
+    if (DebugLogStateMerge)
+      llvm::errs() << "\tIO state differs\n";
+    return false;
+  }
+  for (unsigned i = 0, e = fileDescriptor.size(); i != e; ++i) {
+    const fileDesc &fa = fileDescriptor[i], &fb = b.fileDescriptor[i];
+    if (fa.getoffset() != fb.getoffset() ||
+        fa.getBuffer().first != fb.getBuffer().first) {
+      if (DebugLogStateMerge)
+        llvm::errs() << "\tfile descriptor " << i + 1 << " differs\n";
+      return false;
+    }
+  }
+
   std::set< ref<Expr> > aConstraints(constraints.begin(), constraints.end());
   std::set< ref<Expr> > bConstraints(b.constraints.begin(), 
                                      b.constraints.end());
@@ -319,13 +413,13 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      const ref<Expr> &av = af.getLocal(i).getValue();
+      const ref<Expr> &bv = bf.getLocal(i).getValue();
       if (av.isNull() || bv.isNull()) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
-      } else {
-        av = SelectExpr::create(inA, av, bv);
+      } else if (av != bv) {
+        af.getLocalForWrite(i).setValue(SelectExpr::create(inA, av, bv));
       }
     }
   }
@@ -347,12 +441,20 @@ bool ExecutionState::merge(const ExecutionState &b) {
     }
   }
 
+  // The ranges of either state may not hold in the merged one, so they are
+  // rebuilt from the constraints common to both.
   constraints = ConstraintManager();
+  byteRanges = ByteRanges();
   for (std::set< ref<Expr> >::iterator it = commonConstraints.begin(), 
          ie = commonConstraints.end(); it != ie; ++it)
-    constraints.addConstraint(*it);
+    addConstraint(*it);
   constraints.addConstraint(OrExpr::create(inA, inB));
 
+  // The merged state stands for the paths of both.
+  instructionCoverage.unionWith(b.instructionCoverage);
+  newCoverage.unionWith(b.newCoverage);
+  coveredNew |= b.coveredNew;
+
   return true;
 }
 
@@ -367,7 +469,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
     const InstructionInfo &ii = *target->info;
     out << "\t#" << idx++;
     std::stringstream AssStream;
-    AssStream << std::setw(8) << std::setfill('0') << ii.assemblyLine;
+    AssStream << std::setw(8) << std::setfill('0') << ii.getAssemblyLine();
     out << AssStream.str();
     out << " in " << f->getName().str() << " (";
     // Yawn, we could go up and print varargs if we wanted to.
@@ -378,7 +480,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value; 
+      ref<Expr> value = sf.getLocal(sf.kf->getArgRegister(index++)).getValue();
       if (isa<ConstantExpr>(value))
         out << "=" << value;
     }
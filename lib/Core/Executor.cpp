@@ -37,6 +37,7 @@
 #include "klee/util/ExprSMTLIBPrinter.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/GetElementPtrTypeIterator.h"
+#include "klee/util/SlabAllocator.h"
 #include "klee/Config/Version.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/ADT/RNG.h"
@@ -267,6 +268,23 @@ namespace {
   MaxMemoryInhibit("max-memory-inhibit",
             cl::desc("Inhibit forking at memory cap (vs. random terminate) (default=on)"),
             cl::init(true));
+
+  cl::opt<unsigned>
+  SelectBatchSize("select-batch-size",
+                  cl::desc("Number of states the searcher selects per round, each is stepped once (default=1)"),
+                  cl::init(1));
+
+  cl::opt<bool>
+  UseConcreteFastPath("use-concrete-fast-path",
+                      cl::desc("Execute integer instructions over concrete operands on machine integers, "
+                               "without building expressions (default=on)"),
+                      cl::init(true));
+
+  cl::opt<bool>
+  UseBulkMemory("use-bulk-memory",
+                cl::desc("Run memcpy, memmove and memset calls with concrete arguments "
+                         "in one step instead of interpreting the runtime's loops (default=on)"),
+                cl::init(true));
 }
 
 
@@ -290,6 +308,8 @@ Executor::Executor(const InterpreterOptions &opts,
     replayOut(0),
     replayPath(0),    
     usingSeeds(0),
+    recordSeedPaths(false),
+    seedWorkerShared(0),
     atMemoryLimit(false),
     inhibitForking(false),
     haltExecution(false),
@@ -327,11 +347,15 @@ Executor::Executor(const InterpreterOptions &opts,
     llvm::errs() << "Starting MetaSMTSolver(" << backend << ") ...\n";
   }
   else {
-    coreSolver = new STPSolver(UseForkedCoreSolver, CoreSolverOptimizeDivides);
+    coreSolver = createCoreSolverFromOptions(UseForkedCoreSolver,
+                                             CoreSolverOptimizeDivides);
   }
 #else
-  coreSolver = new STPSolver(UseForkedCoreSolver, CoreSolverOptimizeDivides);
+  coreSolver = createCoreSolverFromOptions(UseForkedCoreSolver,
+                                           CoreSolverOptimizeDivides);
 #endif /* SUPPORT_METASMT */
+  if (!coreSolver)
+    klee_error("Unsupported solver backend, rebuild KLEE with its library");
   
    
   Solver *solver = 
@@ -368,6 +392,9 @@ const Module *Executor::setModule(llvm::Module *module,
   kmodule->prepare(opts, interpreterHandler);
   specialFunctionHandler->bind();
 
+  if (userSearcherRequiresMergePoints())
+    kmodule->computeMergePoints();
+
   if (StatsTracker::useStatistics()) {
     statsTracker = 
       new StatsTracker(*this,
@@ -700,6 +727,25 @@ void Executor::branch(ExecutionState &state,
     }
   }
 
+  std::map<ExecutionState*, SeedPathNode*>::iterator rit = 
+    seedReplayNodes.find(&state);
+  SeedPathNode *replayNode = 
+    rit != seedReplayNodes.end() ? rit->second : 0;
+  for (unsigned i=0; i<N; ++i) {
+    if (result[i]) {
+      if (recordSeedPaths)
+        result[i]->seedPath.push_back(i);
+      if (replayNode) {
+        seedReplayNodes[result[i]] = replayNode;
+        if (!advanceSeedReplay(*result[i], i)) {
+          // The worker finished every path below this branch.
+          discardState(*result[i]);
+          result[i] = NULL;
+        }
+      }
+    }
+  }
+
   for (unsigned i=0; i<N; ++i)
     if (result[i])
       addConstraint(*result[i], conditions[i]);
@@ -744,16 +790,39 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     }
   }
 
-  double timeout = coreSolverTimeout;
-  if (isSeeding)
-    timeout *= it->second.size();
-  solver->setTimeout(timeout);
-  bool success = solver->evaluate(current, condition, res);
-  solver->setTimeout(0);
-  if (!success) {
-    current.pc = current.prevPC;
-    terminateStateEarly(current, "Query timed out (fork).");
-    return StatePair(0, 0);
+  // When following the decisions of a seed worker the solver is not
+  // needed, the worker already checked which sides are feasible. Internal
+  // forks are followed too, a side the worker did not keep must not be
+  // explored (and its test case written) again.
+  std::map<ExecutionState*, SeedPathNode*>::iterator rit = 
+    seedReplayNodes.end();
+  if (!isa<ConstantExpr>(condition))
+    rit = seedReplayNodes.find(&current);
+
+  if (rit != seedReplayNodes.end()) {
+    SeedPathNode *node = rit->second;
+    bool hasTrue = node->children.count(1), hasFalse = node->children.count(0);
+    if (hasTrue && hasFalse) {
+      res = Solver::Unknown;
+    } else if (hasTrue) {
+      res = Solver::True;
+      addConstraint(current, condition);
+    } else {
+      res = Solver::False;
+      addConstraint(current, Expr::createIsZero(condition));
+    }
+  } else {
+    double timeout = coreSolverTimeout;
+    if (isSeeding)
+      timeout *= it->second.size();
+    solver->setTimeout(timeout);
+    bool success = solver->evaluate(current, condition, res);
+    solver->setTimeout(0);
+    if (!success) {
+      current.pc = current.prevPC;
+      terminateStateEarly(current, "Query timed out (fork).");
+      return StatePair(0, 0);
+    }
   }
 
   if (!isSeeding) {
@@ -850,6 +919,9 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         current.pathOS << "1";
       }
     }
+    if (recordSeedPaths)
+      current.seedPath.push_back(1);
+    advanceSeedReplay(current, 1);
 
     return StatePair(&current, 0);
   } else if (res==Solver::False) {
@@ -858,6 +930,9 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         current.pathOS << "0";
       }
     }
+    if (recordSeedPaths)
+      current.seedPath.push_back(0);
+    advanceSeedReplay(current, 0);
 
     return StatePair(0, &current);
   } else {
@@ -902,7 +977,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       }
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
-        std::swap(trueState->coveredLines, falseState->coveredLines);
+        std::swap(trueState->newCoverage, falseState->newCoverage);
       }
     }
 
@@ -924,6 +999,15 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
         falseState->symPathOS << "0";
       }
     }
+    if (recordSeedPaths) {
+      trueState->seedPath.push_back(1);
+      falseState->seedPath.push_back(0);
+    }
+    if (rit != seedReplayNodes.end()) {
+      seedReplayNodes[falseState] = seedReplayNodes[trueState] = rit->second;
+      advanceSeedReplay(*trueState, 1);
+      advanceSeedReplay(*falseState, 0);
+    }
 
     addConstraint(*trueState, condition);
     addConstraint(*falseState, Expr::createIsZero(condition));
@@ -1049,18 +1133,18 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
   } else {
     unsigned index = vnumber;
     StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    return sf.getLocal(index);
   }
 }
 
 void Executor::bindLocal(KInstruction *target, ExecutionState &state, 
                          ref<Expr> value) {
-  getDestCell(state, target).value = value;
+  getDestCell(state, target).setValue(value);
 }
 
 void Executor::bindArgument(KFunction *kf, unsigned index, 
                             ExecutionState &state, ref<Expr> value) {
-  getArgumentCell(state, kf, index).value = value;
+  getArgumentCell(state, kf, index).setValue(value);
 }
 
 ref<Expr> Executor::toUnique(const ExecutionState &state, 
@@ -1243,6 +1327,13 @@ void Executor::executeCall(ExecutionState &state,
     if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
   } else {
+    if (UseBulkMemory &&
+        specialFunctionHandler->handleBulkMemory(state, f, ki, arguments)) {
+      if (InvokeInst *ii = dyn_cast<InvokeInst>(i))
+        transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
+      return;
+    }
+
     // FIXME: I'm not really happy about this reliance on prevPC but it is ok, I
     // guess. This just done to avoid having to pass KInstIterator everywhere
     // instead of the actual instruction, since we can't make a KInstIterator
@@ -1428,12 +1519,191 @@ static inline const llvm::fltSemantics * fpWidthToSemantics(unsigned width) {
   }
 }
 
+/// Sign extend the low \a width bits of \a value.
+static inline int64_t sextConcrete(uint64_t value, Expr::Width width) {
+  unsigned shift = 64 - width;
+  return (int64_t) (value << shift) >> shift;
+}
+
+/// executeConcrete - Execute integer arithmetic, comparisons, casts, GEPs
+/// and selects whose operands are held inline in their cells, storing the
+/// result inline too. Returns false if the instruction needs the general
+/// path, which is then taken without any side effect having happened.
+bool Executor::executeConcrete(ExecutionState &state, KInstruction *ki) {
+  unsigned opcode = ki->opcode;
+
+  switch (opcode) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+  case Instruction::ICmp: {
+    const Cell &lc = eval(ki, 0, state), &rc = eval(ki, 1, state);
+    if (!lc.isConcrete() || !rc.isConcrete())
+      return false;
+    Expr::Width width = lc.getConcreteWidth();
+    uint64_t left = lc.getConcrete(), right = rc.getConcrete();
+    int64_t sleft = sextConcrete(left, width);
+    int64_t sright = sextConcrete(right, width);
+    uint64_t result;
+
+    switch (opcode) {
+    case Instruction::Add: result = left + right; break;
+    case Instruction::Sub: result = left - right; break;
+    case Instruction::Mul: result = left * right; break;
+    case Instruction::And: result = left & right; break;
+    case Instruction::Or: result = left | right; break;
+    case Instruction::Xor: result = left ^ right; break;
+
+    // Division by zero and overshifts keep the semantics of the general
+    // path, whatever they are.
+    case Instruction::UDiv:
+      if (!right)
+        return false;
+      result = left / right;
+      break;
+    case Instruction::URem:
+      if (!right)
+        return false;
+      result = left % right;
+      break;
+    case Instruction::SDiv:
+      if (!right)
+        return false;
+      // Dividing the smallest value by -1 overflows on the host.
+      result = sright == -1 ? 0 - left : (uint64_t) (sleft / sright);
+      break;
+    case Instruction::SRem:
+      if (!right)
+        return false;
+      result = sright == -1 ? 0 : (uint64_t) (sleft % sright);
+      break;
+    case Instruction::Shl:
+      if (right >= width)
+        return false;
+      result = left << right;
+      break;
+    case Instruction::LShr:
+      if (right >= width)
+        return false;
+      result = left >> right;
+      break;
+    case Instruction::AShr:
+      if (right >= width)
+        return false;
+      result = (uint64_t) (sleft >> right);
+      break;
+
+    default: {
+      switch (ki->predicate) {
+      case ICmpInst::ICMP_EQ: result = left == right; break;
+      case ICmpInst::ICMP_NE: result = left != right; break;
+      case ICmpInst::ICMP_UGT: result = left > right; break;
+      case ICmpInst::ICMP_UGE: result = left >= right; break;
+      case ICmpInst::ICMP_ULT: result = left < right; break;
+      case ICmpInst::ICMP_ULE: result = left <= right; break;
+      case ICmpInst::ICMP_SGT: result = sleft > sright; break;
+      case ICmpInst::ICMP_SGE: result = sleft >= sright; break;
+      case ICmpInst::ICMP_SLT: result = sleft < sright; break;
+      case ICmpInst::ICMP_SLE: result = sleft <= sright; break;
+      default:
+        return false;
+      }
+      width = Expr::Bool;
+    }
+    }
+
+    getDestCell(state, ki).setConcrete(result, width);
+    return true;
+  }
+
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::IntToPtr:
+  case Instruction::PtrToInt: {
+    const Cell &arg = eval(ki, 0, state);
+    if (!arg.isConcrete())
+      return false;
+    Expr::Width width = ki->width;
+    if (width > Expr::Int64)
+      return false;
+    uint64_t result = arg.getConcrete();
+    if (opcode == Instruction::SExt)
+      result = sextConcrete(result, arg.getConcreteWidth());
+    getDestCell(state, ki).setConcrete(result, width);
+    return true;
+  }
+
+  case Instruction::GetElementPtr: {
+    KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
+    const Cell &base = eval(ki, 0, state);
+    if (!base.isConcrete())
+      return false;
+    // Wrapping around at 64 bits is the same as at the pointer width, once
+    // truncated.
+    uint64_t result = base.getConcrete() + kgepi->offset;
+    for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
+           it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
+         it != ie; ++it) {
+      const Cell &index = eval(ki, it->first, state);
+      if (!index.isConcrete())
+        return false;
+      result += (uint64_t) sextConcrete(index.getConcrete(),
+                                        index.getConcreteWidth()) * it->second;
+    }
+    getDestCell(state, ki).setConcrete(result,
+                                       Context::get().getPointerWidth());
+    return true;
+  }
+
+  case Instruction::Select: {
+    // Any value can be passed on, only the condition has to be concrete.
+    const Cell &cond = eval(ki, 0, state);
+    if (!cond.isConcrete())
+      return false;
+    getDestCell(state, ki) = eval(ki, cond.getConcrete() ? 1 : 2, state);
+    return true;
+  }
+
+  default:
+    return false;
+  }
+}
+
+/// executeStep - Execute the instruction at the pc of a state. A concrete
+/// instruction does not fork, terminate or jump, nor does it need the
+/// searcher or timers, so the state carries on with the next one, until it
+/// reaches one which needs the general path.
+void Executor::executeStep(ExecutionState &state) {
+  for (;;) {
+    KInstruction *ki = state.pc;
+    stepInstruction(state);
+    if (!UseConcreteFastPath || !executeConcrete(state, ki)) {
+      executeInstruction(state, ki);
+      return;
+    }
+    // Give the searcher a chance to merge the state where paths join.
+    if (haltExecution || state.pc->mergePoint)
+      return;
+  }
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
   //i->getParent()->getParent()->dump();
   //i->dump();//Gladtbx:switch
   //klee_warning(i->getNameStr().c_str());
-  switch (i->getOpcode()) {
+  switch (ki->opcode) {
     // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -1444,7 +1714,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     ref<Expr> result = ConstantExpr::alloc(0, Expr::Bool);
     
     if (!isVoidReturn) {
-      result = eval(ki, 0, state).value;
+      result = eval(ki, 0, state).getValue();
     }
     
     if (state.stack.size() <= 1) {
@@ -1533,7 +1803,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       // FIXME: Find a way that we don't have this hidden dependency.
       assert(bi->getCondition() == bi->getOperand(0) &&
              "Wrong operand index!");
-      ref<Expr> cond = eval(ki, 0, state).value;
+      ref<Expr> cond = eval(ki, 0, state).getValue();
       Executor::StatePair branches = fork(state, cond, false);
 
       // NOTE: There is a hidden dependency here, markBranchVisited
@@ -1552,7 +1822,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::Switch: {
     SwitchInst *si = cast<SwitchInst>(i);
-    ref<Expr> cond = eval(ki, 0, state).value;
+    ref<Expr> cond = eval(ki, 0, state).getValue();
     BasicBlock *bb = si->getParent();
 
     cond = toUnique(state, cond);
@@ -1574,42 +1844,46 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     else {
       std::map<BasicBlock*, ref<Expr> > targets;
       ref<Expr> isDefault = ConstantExpr::alloc(1, Expr::Bool);
+      std::vector< ref<Expr> > matches;
+      std::vector<BasicBlock*> successors;
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)      
       for (SwitchInst::CaseIt i = si->case_begin(), e = si->case_end();
            i != e; ++i) {
         ref<Expr> value = evalConstant(i.getCaseValue());
+        successors.push_back(i.getCaseSuccessor());
 #else
       for (unsigned i=1, cases = si->getNumCases(); i<cases; ++i) {
         ref<Expr> value = evalConstant(si->getCaseValue(i));
+        successors.push_back(si->getSuccessor(i));
 #endif
         //Gladtbx: match = condition evaluated to value
         ref<Expr> match = EqExpr::create(cond, value);
         //Gladtbx: isDefault = match = zero. default can be reached when nothing can be matched.
         isDefault = AndExpr::create(isDefault, Expr::createIsZero(match));
-        bool result;
-        bool success = solver->mayBeTrue(state, match, result);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
+        matches.push_back(match);
+      }
+      //Gladtbx: see if default can be reached.
+      matches.push_back(isDefault);
+
+      // Ask about all the cases together, they share the constraints of
+      // the state.
+      std::vector<const ExecutionState*> states(matches.size(), &state);
+      std::vector<bool> feasible;
+      bool success = solver->mayBeTrue(states, matches, feasible);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void) success;
+
+      for (unsigned i = 0, e = successors.size(); i != e; ++i) {
         //Gladtbx: when match can be solved.
-        if (result) {
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 1)
-          BasicBlock *caseSuccessor = i.getCaseSuccessor();
-#else
-          BasicBlock *caseSuccessor = si->getSuccessor(i);
-#endif
+        if (feasible[i]) {
           std::map<BasicBlock*, ref<Expr> >::iterator it =
-            targets.insert(std::make_pair(caseSuccessor,
+            targets.insert(std::make_pair(successors[i],
                            ConstantExpr::alloc(0, Expr::Bool))).first;
 
-          it->second = OrExpr::create(match, it->second);//Gladtbx: seems redoundent, don't know why
+          it->second = OrExpr::create(matches[i], it->second);//Gladtbx: seems redoundent, don't know why
         }
       }
-      bool res;
-      //Gladtbx: see if default can be reached.
-      bool success = solver->mayBeTrue(state, isDefault, res);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res)
+      if (feasible.back())
         targets.insert(std::make_pair(si->getDefaultDest(), isDefault));
       
       std::vector< ref<Expr> > conditions;
@@ -1647,7 +1921,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     unsigned numArgs = cs.arg_size();
     Value *fp = cs.getCalledValue();
-    Function *f = getTargetFunction(fp, state);
+    Function *f = state.fnAliases.empty() ? ki->callee :
+      getTargetFunction(fp, state);
 
     // Skip debug intrinsics, we can't evaluate their metadata arguments.
     if (f && isDebugIntrinsic(f, kmodule))
@@ -1675,7 +1950,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     arguments.reserve(numArgs);
 
     for (unsigned j=0; j<numArgs; ++j)
-      arguments.push_back(eval(ki, j+1, state).value);
+      arguments.push_back(eval(ki, j+1, state).getValue());
 
     if (f) {
       const FunctionType *fType = 
@@ -1722,7 +1997,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 //Gladtbx: Execute call, may be special functions.
       executeCall(state, ki, f, arguments);
     } else {
-      ref<Expr> v = eval(ki, 0, state).value;
+      ref<Expr> v = eval(ki, 0, state).getValue();
 
       ExecutionState *free = &state;
       bool hasInvalid = false, first = true;
@@ -1764,9 +2039,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::PHI: {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
-    ref<Expr> result = eval(ki, state.incomingBBIndex, state).value;
+    ref<Expr> result = eval(ki, state.incomingBBIndex, state).getValue();
 #else
-    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).value;
+    ref<Expr> result = eval(ki, state.incomingBBIndex * 2, state).getValue();
 #endif
     bindLocal(ki, state, result);
     break;
@@ -1774,9 +2049,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Special instructions
   case Instruction::Select: {
-    ref<Expr> cond = eval(ki, 0, state).value;
-    ref<Expr> tExpr = eval(ki, 1, state).value;
-    ref<Expr> fExpr = eval(ki, 2, state).value;
+    ref<Expr> cond = eval(ki, 0, state).getValue();
+    ref<Expr> tExpr = eval(ki, 1, state).getValue();
+    ref<Expr> fExpr = eval(ki, 2, state).getValue();
     ref<Expr> result = SelectExpr::create(cond, tExpr, fExpr);
     bindLocal(ki, state, result);
     break;
@@ -1789,101 +2064,101 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Arithmetic / logical
 
   case Instruction::Add: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     bindLocal(ki, state, AddExpr::create(left, right));
     break;
   }
 
   case Instruction::Sub: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     bindLocal(ki, state, SubExpr::create(left, right));
     break;
   }
  
   case Instruction::Mul: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     bindLocal(ki, state, MulExpr::create(left, right));
     break;
   }
 
   case Instruction::UDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = UDivExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::SDiv: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = SDivExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::URem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = URemExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
  
   case Instruction::SRem: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = SRemExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::And: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = AndExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Or: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = OrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Xor: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = XorExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::Shl: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = ShlExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::LShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = LShrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::AShr: {
-    ref<Expr> left = eval(ki, 0, state).value;
-    ref<Expr> right = eval(ki, 1, state).value;
+    ref<Expr> left = eval(ki, 0, state).getValue();
+    ref<Expr> right = eval(ki, 1, state).getValue();
     ref<Expr> result = AShrExpr::create(left, right);
     bindLocal(ki, state, result);
     break;
@@ -1892,85 +2167,82 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Compare
 
   case Instruction::ICmp: {
-    CmpInst *ci = cast<CmpInst>(i);
-    ICmpInst *ii = cast<ICmpInst>(ci);
- 
-    switch(ii->getPredicate()) {
+    switch(ki->predicate) {
     case ICmpInst::ICMP_EQ: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = EqExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_NE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = NeExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_UGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UgtExpr::create(left, right);
       bindLocal(ki, state,result);
       break;
     }
 
     case ICmpInst::ICMP_UGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UgeExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UltExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_ULE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = UleExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SgtExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SGE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SgeExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLT: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SltExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
     }
 
     case ICmpInst::ICMP_SLE: {
-      ref<Expr> left = eval(ki, 0, state).value;
-      ref<Expr> right = eval(ki, 1, state).value;
+      ref<Expr> left = eval(ki, 0, state).getValue();
+      ref<Expr> right = eval(ki, 1, state).getValue();
       ref<Expr> result = SleExpr::create(left, right);
       bindLocal(ki, state, result);
       break;
@@ -1989,7 +2261,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
     ref<Expr> size = Expr::createPointer(elementSize);
     if (ai->isArrayAllocation()) {
-      ref<Expr> count = eval(ki, 0, state).value;
+      ref<Expr> count = eval(ki, 0, state).getValue();
       count = Expr::createZExtToPointerWidth(count);
       size = MulExpr::create(size, count);
     }
@@ -1999,26 +2271,26 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::Load: {
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
     executeMemoryOperation(state, false, base, 0, ki);
     break;
   }
   case Instruction::Store: {
-    ref<Expr> base = eval(ki, 1, state).value;
-    ref<Expr> value = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 1, state).getValue();
+    ref<Expr> value = eval(ki, 0, state).getValue();
     executeMemoryOperation(state, true, base, value, 0);
     break;
   }
 
   case Instruction::GetElementPtr: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
-    ref<Expr> base = eval(ki, 0, state).value;
+    ref<Expr> base = eval(ki, 0, state).getValue();
 
     for (std::vector< std::pair<unsigned, uint64_t> >::iterator 
            it = kgepi->indices.begin(), ie = kgepi->indices.end(); 
          it != ie; ++it) {
       uint64_t elementSize = it->second;
-      ref<Expr> index = eval(ki, it->first, state).value;
+      ref<Expr> index = eval(ki, it->first, state).getValue();
       base = AddExpr::create(base,
                              MulExpr::create(Expr::createSExtToPointerWidth(index),
                                              Expr::createPointer(elementSize)));
@@ -2032,45 +2304,38 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
+    ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).getValue(),
                                            0,
-                                           getWidthForLLVMType(ci->getType()));
+                                           ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).getValue(),
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
-    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+    ref<Expr> result = SExtExpr::create(eval(ki, 0, state).getValue(),
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, pType));
+    ref<Expr> arg = eval(ki, 0, state).getValue();
+    bindLocal(ki, state, ZExtExpr::create(arg, ki->width));
     break;
   } 
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
-    ref<Expr> arg = eval(ki, 0, state).value;
-    bindLocal(ki, state, ZExtExpr::create(arg, iType));
+    ref<Expr> arg = eval(ki, 0, state).getValue();
+    bindLocal(ki, state, ZExtExpr::create(arg, ki->width));
     break;
   }
 
   case Instruction::BitCast: {
-    ref<Expr> result = eval(ki, 0, state).value;
+    ref<Expr> result = eval(ki, 0, state).getValue();
     bindLocal(ki, state, result);
     break;
   }
@@ -2078,9 +2343,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     // Floating point instructions
 
   case Instruction::FAdd: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2098,9 +2363,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FSub: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2117,9 +2382,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
  
   case Instruction::FMul: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2137,9 +2402,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FDiv: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2157,9 +2422,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FRem: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2177,9 +2442,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
       return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
@@ -2198,9 +2462,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
       return terminateStateOnExecError(state, "Unsupported FPExt operation");
@@ -2218,9 +2481,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToUI operation");
@@ -2239,9 +2501,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToSI operation");
@@ -2260,9 +2521,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -2276,9 +2536,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    Expr::Width resultType = ki->width;
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -2292,10 +2551,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FCmp: {
-    FCmpInst *fi = cast<FCmpInst>(i);
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -2311,7 +2569,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     APFloat::cmpResult CmpRes = LHS.compare(RHS);
 
     bool Result = false;
-    switch( fi->getPredicate() ) {
+    switch( ki->predicate ) {
       // Predicates which only care about whether or not the operands are NaNs.
     case FCmpInst::FCMP_ORD:
       Result = CmpRes != APFloat::cmpUnordered;
@@ -2391,8 +2649,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::InsertValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
-    ref<Expr> val = eval(ki, 1, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
+    ref<Expr> val = eval(ki, 1, state).getValue();
 
     ref<Expr> l = NULL, r = NULL;
     unsigned lOffset = kgepi->offset*8, rOffset = kgepi->offset*8 + val->getWidth();
@@ -2418,9 +2676,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::ExtractValue: {
     KGEPInstruction *kgepi = static_cast<KGEPInstruction*>(ki);
 
-    ref<Expr> agg = eval(ki, 0, state).value;
+    ref<Expr> agg = eval(ki, 0, state).getValue();
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
+    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, ki->width);
 
     bindLocal(ki, state, result);
     break;
@@ -2456,10 +2714,15 @@ void Executor::updateStates(ExecutionState *current) {
     std::set<ExecutionState*>::iterator it2 = states.find(es);
     assert(it2!=states.end());
     states.erase(it2);
+    if (!selectedStates.empty())
+      selectedStates.erase(std::remove(selectedStates.begin(),
+                                       selectedStates.end(), es),
+                           selectedStates.end());
     std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
       seedMap.find(es);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    seedReplayNodes.erase(es);
     processTree->remove(es->ptreeNode);
     delete es;
   }
@@ -2524,7 +2787,53 @@ void Executor::bindModuleConstants() {
   kmodule->constantTable = new Cell[kmodule->constants.size()];
   for (unsigned i=0; i<kmodule->constants.size(); ++i) {
     Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+    c.setValue(evalConstant(kmodule->constants[i]));
+  }
+}
+
+bool Executor::seedTimeExpired(double startTime) {
+  return SeedTime>0. && util::getWallTime() > startTime + SeedTime;
+}
+
+void Executor::runSeeds(double startTime) {
+  int lastNumSeeds = usingSeeds->size()+10;
+  double lastTime = util::getWallTime();
+  ExecutionState *lastState = 0;
+  while (!seedMap.empty()) {
+    if (haltExecution) return;
+
+    std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it = 
+      seedMap.upper_bound(lastState);
+    if (it == seedMap.end())
+      it = seedMap.begin();
+    lastState = it->first;
+    unsigned numSeeds = it->second.size();
+    ExecutionState &state = *lastState;
+    executeStep(state);
+    processTimers(&state, MaxInstructionTime * numSeeds);
+    updateStates(&state);
+
+    if ((stats::instructions % 1000) == 0) {
+      int numSeeds = 0, numStates = 0;
+      for (std::map<ExecutionState*, std::vector<SeedInfo> >::iterator
+             it = seedMap.begin(), ie = seedMap.end();
+           it != ie; ++it) {
+        numSeeds += it->second.size();
+        numStates++;
+      }
+      double time = util::getWallTime();
+      if (seedTimeExpired(startTime)) {
+        klee_warning("seed time expired, %d seeds remain over %d states",
+                     numSeeds, numStates);
+        break;
+      } else if (numSeeds<=lastNumSeeds-10 ||
+                 time >= lastTime+10) {
+        lastTime = time;
+        lastNumSeeds = numSeeds;          
+        klee_message("%d seeds remaining over: %d states", 
+                     numSeeds, numStates);
+      }
+    }
   }
 }
 
@@ -2538,55 +2847,18 @@ void Executor::run(ExecutionState &initialState) {
   states.insert(&initialState);
 
   if (usingSeeds) {
-    std::vector<SeedInfo> &v = seedMap[&initialState];
+    if (!runSeedWorkers(initialState)) {
+      std::vector<SeedInfo> &v = seedMap[&initialState];
     
-    for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
-           ie = usingSeeds->end(); it != ie; ++it)
-      v.push_back(SeedInfo(*it));
-
-    int lastNumSeeds = usingSeeds->size()+10;
-    double lastTime, startTime = lastTime = util::getWallTime();
-    ExecutionState *lastState = 0;
-    while (!seedMap.empty()) {
-      if (haltExecution) goto dump;
-
-      std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it = 
-        seedMap.upper_bound(lastState);
-      if (it == seedMap.end())
-        it = seedMap.begin();
-      lastState = it->first;
-      unsigned numSeeds = it->second.size();
-      ExecutionState &state = *lastState;
-      KInstruction *ki = state.pc;
-      stepInstruction(state);
+      for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
+             ie = usingSeeds->end(); it != ie; ++it)
+        v.push_back(SeedInfo(*it));
 
-      executeInstruction(state, ki);
-      processTimers(&state, MaxInstructionTime * numSeeds);
-      updateStates(&state);
-
-      if ((stats::instructions % 1000) == 0) {
-        int numSeeds = 0, numStates = 0;
-        for (std::map<ExecutionState*, std::vector<SeedInfo> >::iterator
-               it = seedMap.begin(), ie = seedMap.end();
-             it != ie; ++it) {
-          numSeeds += it->second.size();
-          numStates++;
-        }
-        double time = util::getWallTime();
-        if (SeedTime>0. && time > startTime + SeedTime) {
-          klee_warning("seed time expired, %d seeds remain over %d states",
-                       numSeeds, numStates);
-          break;
-        } else if (numSeeds<=lastNumSeeds-10 ||
-                   time >= lastTime+10) {
-          lastTime = time;
-          lastNumSeeds = numSeeds;          
-          klee_message("%d seeds remaining over: %d states", 
-                       numSeeds, numStates);
-        }
-      }
+      runSeeds(util::getWallTime());
     }
 
+    if (haltExecution) goto dump;
+
     klee_message("seeding done (%d states remain)", (int) states.size());
 
     // XXX total hack, just because I like non uniform better but want
@@ -2606,11 +2878,24 @@ void Executor::run(ExecutionState &initialState) {
   searcher->update(0, states, std::set<ExecutionState*>());
 
   while (!states.empty() && !haltExecution) {
-    ExecutionState &state = searcher->selectState();
-    KInstruction *ki = state.pc;
-    stepInstruction(state);
+    ExecutionState *next;
+    if (SelectBatchSize > 1) {
+      if (selectedStates.empty()) {
+        searcher->selectStates(SelectBatchSize, selectedStates);
+        std::reverse(selectedStates.begin(), selectedStates.end());
+      }
+      next = selectedStates.back();
+      selectedStates.pop_back();
+      // A searcher may terminate states while selecting them (e.g. when
+      // merging), they are only removed once the next step is done.
+      if (removedStates.count(next))
+        continue;
+    } else {
+      next = &searcher->selectState();
+    }
 
-    executeInstruction(state, ki);
+    ExecutionState &state = *next;
+    executeStep(state);
     processTimers(&state, MaxInstructionTime);
 
     if (MaxMemory) {
@@ -2618,7 +2903,11 @@ void Executor::run(ExecutionState &initialState) {
         // We need to avoid calling GetMallocUsage() often because it
         // is O(elts on freelist). This is really bad since we start
         // to pummel the freelist once we hit the memory cap.
-        unsigned mbs = util::GetTotalMallocUsage() >> 20;
+        // Memory in the free lists of the slab allocator is handed out
+        // again before any more is taken from the system.
+        size_t usage = util::GetTotalMallocUsage();
+        size_t unused = SlabAllocator::getFreeBytes();
+        unsigned mbs = (usage > unused ? usage - unused : 0) >> 20;
         if (mbs > MaxMemory) {
           if (mbs > MaxMemory + 100) {
             // just guess at how many to kill
@@ -2654,6 +2943,10 @@ void Executor::run(ExecutionState &initialState) {
   searcher = 0;
   
  dump:
+  dumpStatesOnHalt();
+}
+
+void Executor::dumpStatesOnHalt() {
   if (DumpStatesOnHalt && !states.empty()) {
     llvm::errs() << "KLEE: halting execution, dumping remaining states\n";
     for (std::set<ExecutionState*>::iterator
@@ -2724,7 +3017,10 @@ void Executor::terminateState(ExecutionState &state) {
   }
 
   interpreterHandler->incPathsExplored();
+  discardState(state);
+}
 
+void Executor::discardState(ExecutionState &state) {
   std::set<ExecutionState*>::iterator it = addedStates.find(&state);
   if (it==addedStates.end()) {
     state.pc = state.prevPC;
@@ -2736,6 +3032,7 @@ void Executor::terminateState(ExecutionState &state) {
       seedMap.find(&state);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    seedReplayNodes.erase(&state);
     addedStates.erase(it);
     processTree->remove(state.ptreeNode);
     delete &state;
@@ -2810,7 +3107,8 @@ void Executor::terminateStateOnError(ExecutionState &state,
   const InstructionInfo &ii = getLastNonKleeInternalInstruction(state, &lastInst);
   
   if (EmitAllErrors ||
-      emittedErrors.insert(std::make_pair(lastInst, message)).second) {
+      (emittedErrors.insert(std::make_pair(lastInst, message)).second &&
+       (!seedWorkerShared || claimSeedWorkerError(lastInst, message)))) {
     if (ii.file != "") {
       klee_message("ERROR: %s:%d: %s", ii.file.c_str(), ii.line, message.c_str());
     } else {
@@ -2825,7 +3123,7 @@ void Executor::terminateStateOnError(ExecutionState &state,
     if (ii.file != "") {
       msg << "File: " << ii.file << "\n";
       msg << "Line: " << ii.line << "\n";
-      msg << "assembly.ll line: " << ii.assemblyLine << "\n";
+      msg << "assembly.ll line: " << ii.getAssemblyLine() << "\n";
     }
     msg << "Stack: \n";
     state.dumpStack(msg);
@@ -3568,7 +3866,19 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  std::vector<unsigned> ids;
+  state.newCoverage.getIds(ids);
+  for (std::vector<unsigned>::iterator it = ids.begin(), ie = ids.end();
+       it != ie; ++it) {
+    const InstructionInfo &ii = kmodule->infos->getInfo(*it);
+    res[&ii.file].insert(ii.line);
+  }
+}
+
+void Executor::getCoverageMap(const ExecutionState &state,
+                              std::vector<unsigned char> &res) {
+  assert(!res.empty() && "empty coverage map");
+  state.instructionCoverage.toAFLMap(&res[0], res.size());
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
@@ -3615,3 +3925,12 @@ Interpreter *Interpreter::create(const InterpreterOptions &opts,
                                  InterpreterHandler *ih) {
   return new Executor(opts, ih);
 }
+
+extern cl::opt<bool> symbolicFileIO;
+
+std::string Interpreter::getModuleCacheKey(const ModuleOptions &opts) {
+  // SpecialFunctionHandler::prepare() deletes the bodies of the file
+  // functions it handles, which depend on --symbolicFileIO.
+  return KModule::getCacheKey(opts) +
+    (symbolicFileIO ? " symbolic-file-io" : "");
+}
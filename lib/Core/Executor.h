@@ -65,6 +65,8 @@ namespace klee {
   class PTree;
   class Searcher;
   class SeedInfo;
+  struct SeedPathNode;
+  struct SeedWorkerShared;
   class SpecialFunctionHandler;
   struct StackFrame;
   class StatsTracker;
@@ -80,6 +82,7 @@ namespace klee {
 
 class Executor : public Interpreter {
   friend class BumpMergingSearcher;
+  friend class DynamicMergingSearcher;
   friend class MergingSearcher;
   friend class RandomPathSearcher;
   friend class OwningSearcher;
@@ -127,6 +130,11 @@ private:
   /// \invariant \ref addedStates and \ref removedStates are disjoint.
   std::set<ExecutionState*> removedStates;
 
+  /// States selected for the current round (see --select-batch-size)
+  /// which have not been stepped yet, in reverse order. States are
+  /// dropped from it when they are removed.
+  std::vector<ExecutionState*> selectedStates;
+
   /// When non-empty the Executor is running in "seed" mode. The
   /// states in this map will be executed in an arbitrary order
   /// (outside the normal search interface) until they terminate. When
@@ -160,6 +168,18 @@ private:
   /// drive execution.
   const std::vector<struct KTest *> *usingSeeds;  
 
+  /// Whether branch decisions are recorded in ExecutionState::seedPath,
+  /// set in seed worker processes. \see runSeedWorkers()
+  bool recordSeedPaths;
+
+  /// States which are following the branch decisions reported by the
+  /// seed workers, mapped to their position in the decision tree.
+  std::map<ExecutionState*, SeedPathNode*> seedReplayNodes;
+
+  /// Memory shared with the seed workers, kept for the rest of the run
+  /// once they were started. \see runSeedWorkers()
+  SeedWorkerShared *seedWorkerShared;
+
   /// Disables forking, instead a random path is chosen. Enabled as
   /// needed to control memory usage. \see fork()
   bool atMemoryLimit;
@@ -182,12 +202,47 @@ private:
   llvm::Function* getTargetFunction(llvm::Value *calledVal,
                                     ExecutionState &state);
   
+  void executeStep(ExecutionState &state);
   void executeInstruction(ExecutionState &state, KInstruction *ki);
+  bool executeConcrete(ExecutionState &state, KInstruction *ki);
 
   void printFileLine(ExecutionState &state, KInstruction *ki);
 
   void run(ExecutionState &initialState);
 
+  /// Execute the states in \ref seedMap until they run out of seeds or
+  /// the seed time, counted from startTime, expires.
+  void runSeeds(double startTime);
+
+  /// Whether the seed time, counted from startTime, has expired.
+  bool seedTimeExpired(double startTime);
+
+  /// Partition the seeds over --seed-workers worker processes which each
+  /// run the seeding phase for their share and write the test cases of
+  /// the paths they finish. The states they leave are then rebuilt by
+  /// following the branch decisions they report, without querying the
+  /// solver at branches. Returns false (and does nothing) if seeds
+  /// should be run in this process instead.
+  bool runSeedWorkers(ExecutionState &initialState);
+
+  /// Body of a seed worker process, never returns.
+  void runSeedWorker(ExecutionState &initialState, unsigned index,
+                     unsigned numWorkers, double startTime);
+
+  /// Move a state that follows a seed worker path along the given branch,
+  /// releasing it to normal execution once the end of the path is reached.
+  /// Returns false if no state the worker left is below the branch, in
+  /// which case the state should be discarded.
+  bool advanceSeedReplay(ExecutionState &state, unsigned branch);
+
+  /// Give a state the seeds with the given indices in \ref usingSeeds.
+  void addSeeds(ExecutionState &state, const std::vector<unsigned> &seeds);
+
+  /// Record an error in the memory shared with the seed workers, returning
+  /// false if this or another process has already emitted it.
+  bool claimSeedWorkerError(llvm::Instruction *lastInst,
+                            const std::string &message);
+
   // Given a concrete object in our [klee's] address space, add it to 
   // objects checked code can reference.
   MemoryObject *addExternalObject(ExecutionState &state, void *addr, 
@@ -303,12 +358,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().getLocalForWrite(kf->getArgRegister(index));
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getLocalForWrite(target->dest);
   }
 
   void bindLocal(KInstruction *target, 
@@ -349,6 +404,11 @@ private:
 
   // remove state from queue and delete
   void terminateState(ExecutionState &state);
+  // remove state from queue and delete, without counting it as an
+  // explored path
+  void discardState(ExecutionState &state);
+  // terminate the remaining states if --dump-states-on-halt is set
+  void dumpStatesOnHalt();
   // call exit handler and terminate state
   void terminateStateEarly(ExecutionState &state, const llvm::Twine &message);
   // call exit handler and terminate state
@@ -482,6 +542,9 @@ public:
   virtual void getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res);
 
+  virtual void getCoverageMap(const ExecutionState &state,
+                              std::vector<unsigned char> &res);
+
   Expr::Width getWidthForLLVMType(LLVM_TYPE_Q llvm::Type *type) const;
 };
   
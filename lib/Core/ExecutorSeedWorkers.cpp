@@ -0,0 +1,486 @@
+//===-- ExecutorSeedWorkers.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Parallel seeding. The seeds are partitioned over worker processes which
+// each run the seeding phase for their share. Workers write the test cases
+// of the paths they finish themselves and report their coverage, and the
+// branch decisions of the states they leave. The coordinating process then
+// rebuilds those states by following the reported decisions, which does not
+// need the solver at branches, and continues with the normal search.
+//
+// The test case numbers, the errors emitted so far and whether to halt are
+// shared between all the processes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Common.h"
+
+#include "CoreStats.h"
+#include "Executor.h"
+#include "PTree.h"
+#include "SeedInfo.h"
+#include "StatsTracker.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Interpreter.h"
+#include "klee/Internal/ADT/KTest.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::opt<unsigned>
+  SeedWorkers("seed-workers",
+              cl::desc("Number of worker processes to partition the seeds over during seeding (default=0 (off))"),
+              cl::init(0));
+
+  /// Handler used in seed worker processes. Test cases are written by the
+  /// handler of the coordinating process, which takes their numbers from a
+  /// counter shared with the workers. Explored paths are counted here and
+  /// reported to the coordinator.
+  class SeedWorkerHandler : public InterpreterHandler {
+    InterpreterHandler *handler;
+
+  public:
+    unsigned pathsExplored;
+
+    explicit SeedWorkerHandler(InterpreterHandler *_handler)
+      : handler(_handler), pathsExplored(0) {}
+
+    llvm::raw_ostream &getInfoStream() const {
+      return handler->getInfoStream();
+    }
+    std::string getOutputFilename(const std::string &filename) {
+      return handler->getOutputFilename(filename);
+    }
+    llvm::raw_fd_ostream *openOutputFile(const std::string &filename) {
+      return handler->openOutputFile(filename);
+    }
+    void incPathsExplored() { ++pathsExplored; }
+    void processTestCase(const ExecutionState &state,
+                         const char *err,
+                         const char *suffix) {
+      handler->processTestCase(state, err, suffix);
+    }
+    bool shareTestIndex() { return handler->shareTestIndex(); }
+    const std::vector<std::string>& getTargetFunction() {
+      return handler->getTargetFunction();
+    }
+    const bool ifConstructSeedForTarget() {
+      return handler->ifConstructSeedForTarget();
+    }
+  };
+
+  /// What a seed worker reports back to the coordinating process.
+  struct SeedWorkerReport {
+    unsigned pathsExplored;
+    uint64_t instructions;
+    /// Ids of the instructions covered in the worker.
+    std::vector<unsigned> covered;
+    /// The paths of the states the worker left.
+    SeedPathNode root;
+    bool hasStates;
+
+    SeedWorkerReport() : pathsExplored(0), instructions(0), hasStates(false) {}
+  };
+}
+
+namespace klee {
+  /// Memory shared by the seed workers and the coordinating process.
+  struct SeedWorkerShared {
+    /// Set once any of the processes halts, the others follow.
+    volatile unsigned halt;
+    /// Hashes of the errors emitted so far, an open addressing table in
+    /// which 0 marks a free slot. Errors that do not fit are emitted
+    /// again rather than lost.
+    uint64_t errors[4096];
+  };
+}
+
+namespace {
+  /// Makes a seed worker halt when another process did, and the other
+  /// processes halt when this one does (e.g. after --stop-after-n-tests).
+  class SeedWorkerHaltTimer : public Executor::Timer {
+    Executor *executor;
+    const bool &haltExecution;
+    SeedWorkerShared *shared;
+
+  public:
+    SeedWorkerHaltTimer(Executor *_executor, const bool &_haltExecution,
+                        SeedWorkerShared *_shared)
+      : executor(_executor), haltExecution(_haltExecution), shared(_shared) {}
+
+    void run() {
+      if (haltExecution)
+        shared->halt = 1;
+      else if (shared->halt)
+        executor->setHaltExecution(true);
+    }
+  };
+}
+
+static std::string getSeedWorkerReportName(unsigned index) {
+  std::stringstream name;
+  name << "seed-worker-" << index << ".report";
+  return name.str();
+}
+
+/// Read the report of a seed worker, the format is written by
+/// Executor::runSeedWorker().
+static bool readSeedWorkerReport(const std::string &path, unsigned numSeeds,
+                                 SeedWorkerReport &report) {
+  std::ifstream is(path.c_str());
+  std::string key;
+  while (is >> key) {
+    if (key == "paths") {
+      is >> report.pathsExplored;
+    } else if (key == "instructions") {
+      is >> report.instructions;
+    } else if (key == "covered") {
+      unsigned n;
+      is >> n;
+      report.covered.resize(n);
+      for (unsigned i=0; i<n; ++i)
+        is >> report.covered[i];
+    } else if (key == "state") {
+      unsigned n;
+      is >> n;
+      std::vector<unsigned> seeds(n);
+      for (unsigned i=0; i<n; ++i) {
+        is >> seeds[i];
+        if (seeds[i] >= numSeeds)
+          return false;
+      }
+      is >> n;
+      std::vector<unsigned> decisions(n);
+      for (unsigned i=0; i<n; ++i)
+        is >> decisions[i];
+      report.root.insert(decisions)->seeds = seeds;
+      report.hasStates = true;
+    } else {
+      return false;
+    }
+    if (is.fail())
+      return false;
+  }
+  return is.eof();
+}
+
+void Executor::runSeedWorker(ExecutionState &initialState, unsigned index,
+                             unsigned numWorkers, double startTime) {
+  // Interval timers are not inherited across fork(), processTimers() sets
+  // them up again after a while.
+  SeedWorkerHandler *handler = new SeedWorkerHandler(interpreterHandler);
+  interpreterHandler = handler;
+  recordSeedPaths = true;
+  uint64_t startInstructions = stats::instructions;
+  addTimer(new SeedWorkerHaltTimer(this, haltExecution, seedWorkerShared),
+           .1);
+
+  std::vector<SeedInfo> &v = seedMap[&initialState];
+  for (unsigned i=index; i<usingSeeds->size(); i+=numWorkers)
+    v.push_back(SeedInfo((*usingSeeds)[i]));
+
+  runSeeds(startTime);
+  if (haltExecution) {
+    seedWorkerShared->halt = 1;
+    dumpStatesOnHalt();
+  }
+
+  llvm::raw_fd_ostream *report =
+    interpreterHandler->openOutputFile(getSeedWorkerReportName(index));
+  if (!report)
+    _exit(1);
+  llvm::raw_fd_ostream &os = *report;
+
+  os << "paths " << handler->pathsExplored << "\n";
+  os << "instructions " << (stats::instructions - startInstructions) << "\n";
+
+  std::vector<unsigned> covered;
+  if (statsTracker)
+    statsTracker->getGlobalCoverage().getIds(covered);
+  os << "covered " << covered.size();
+  for (std::vector<unsigned>::iterator it = covered.begin(),
+         ie = covered.end(); it != ie; ++it)
+    os << " " << *it;
+  os << "\n";
+
+  // The states left, with the seeds they still have.
+  std::map<const KTest*, unsigned> seedIndices;
+  for (unsigned i=0; i<usingSeeds->size(); ++i)
+    seedIndices[(*usingSeeds)[i]] = i;
+  for (std::set<ExecutionState*>::iterator it = states.begin(),
+         ie = states.end(); it != ie; ++it) {
+    ExecutionState &state = **it;
+    std::vector<unsigned> seeds;
+    std::map<ExecutionState*, std::vector<SeedInfo> >::iterator sit =
+      seedMap.find(&state);
+    if (sit != seedMap.end())
+      for (std::vector<SeedInfo>::iterator siit = sit->second.begin(),
+             siie = sit->second.end(); siit != siie; ++siit)
+        seeds.push_back(seedIndices[siit->input]);
+
+    os << "state " << seeds.size();
+    for (std::vector<unsigned>::iterator sit = seeds.begin(),
+           sie = seeds.end(); sit != sie; ++sit)
+      os << " " << *sit;
+    os << " " << state.seedPath.size();
+    for (std::vector<unsigned>::const_iterator pit = state.seedPath.begin(),
+           pie = state.seedPath.end(); pit != pie; ++pit)
+      os << " " << *pit;
+    os << "\n";
+  }
+
+  delete report;
+  _exit(haltExecution ? 2 : 0);
+}
+
+bool Executor::runSeedWorkers(ExecutionState &initialState) {
+  unsigned numWorkers = std::min(SeedWorkers.getValue(),
+                                 (unsigned) usingSeeds->size());
+  if (numWorkers < 2)
+    return false;
+
+  // The path streams are buffered (and possibly written by a separate
+  // thread) in this process, they cannot be shared with the workers.
+  if (pathWriter || symPathWriter) {
+    klee_warning("seed workers do not support writing paths, "
+                 "seeding in a single process");
+    return false;
+  }
+  if (!interpreterHandler->shareTestIndex()) {
+    klee_warning("seed workers cannot number test cases, "
+                 "seeding in a single process");
+    return false;
+  }
+
+  void *shared = mmap(0, sizeof(SeedWorkerShared), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANON, -1, 0);
+  if (shared == MAP_FAILED) {
+    klee_warning("unable to share memory with seed workers, "
+                 "seeding in a single process");
+    return false;
+  }
+  seedWorkerShared = static_cast<SeedWorkerShared*>(shared);
+  memset(shared, 0, sizeof(SeedWorkerShared));
+
+  klee_message("seeding with %u worker processes", numWorkers);
+  double startTime = util::getWallTime();
+
+  // Don't duplicate buffered output into the workers.
+  fflush(0);
+  llvm::errs().flush();
+  llvm::outs().flush();
+
+  std::vector<pid_t> pids;
+  for (unsigned i=0; i<numWorkers; ++i) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      klee_warning("unable to fork seed worker: %s", strerror(errno));
+      break;
+    }
+    if (pid == 0)
+      runSeedWorker(initialState, i, numWorkers, startTime);
+    pids.push_back(pid);
+  }
+
+  // Take over the results of each worker. The seeds of a worker that
+  // failed (or could not be started) are run in this process.
+  std::vector<SeedWorkerReport*> reports(numWorkers);
+  uint64_t workerInstructions = 0;
+  for (unsigned i=0; i<numWorkers; ++i) {
+    bool ok = false;
+    if (i < pids.size()) {
+      int status;
+      pid_t res;
+      do {
+        res = waitpid(pids[i], &status, 0);
+      } while (res < 0 && errno == EINTR);
+
+      if (res >= 0 && WIFEXITED(status)) {
+        if (WEXITSTATUS(status) == 2)
+          haltExecution = true;
+        ok = WEXITSTATUS(status) == 0 || WEXITSTATUS(status) == 2;
+      }
+    }
+
+    std::string path =
+      interpreterHandler->getOutputFilename(getSeedWorkerReportName(i));
+    if (ok) {
+      reports[i] = new SeedWorkerReport();
+      if (!readSeedWorkerReport(path, usingSeeds->size(), *reports[i])) {
+        delete reports[i];
+        reports[i] = 0;
+      }
+    }
+    unlink(path.c_str());
+
+    if (!reports[i]) {
+      klee_warning("seed worker %u failed, running its seeds in this process",
+                   i);
+      continue;
+    }
+
+    for (unsigned j=0; j<reports[i]->pathsExplored; ++j)
+      interpreterHandler->incPathsExplored();
+    workerInstructions += reports[i]->instructions;
+    if (statsTracker)
+      statsTracker->markCovered(reports[i]->covered);
+  }
+
+  // Start a copy of the initial state for each worker which left states
+  // (or failed), and let it follow the decisions of that worker. When
+  // halting, the states left by the workers are dropped.
+  bool initialStateUsed = false;
+  for (unsigned i=0; i<numWorkers && !haltExecution; ++i) {
+    SeedWorkerReport *report = reports[i];
+    if (report && !report->hasStates)
+      continue;
+
+    ExecutionState *es = &initialState;
+    if (initialStateUsed) {
+      es = initialState.branch();
+      addedStates.insert(es);
+      initialState.ptreeNode->data = 0;
+      std::pair<PTree::Node*,PTree::Node*> res =
+        processTree->split(initialState.ptreeNode, es, &initialState);
+      es->ptreeNode = res.first;
+      initialState.ptreeNode = res.second;
+      if (pathWriter)
+        es->pathOS = pathWriter->open(initialState.pathOS);
+      if (symPathWriter)
+        es->symPathOS = symPathWriter->open(initialState.symPathOS);
+    }
+    initialStateUsed = true;
+
+    if (!report) {
+      std::vector<SeedInfo> &v = seedMap[es];
+      for (unsigned j=i; j<usingSeeds->size(); j+=numWorkers)
+        v.push_back(SeedInfo((*usingSeeds)[j]));
+    } else if (report->root.children.empty()) {
+      addSeeds(*es, report->root.seeds);
+    } else {
+      seedReplayNodes[es] = &report->root;
+    }
+  }
+  if (!initialStateUsed)
+    discardState(initialState);
+  updateStates(0);
+
+  // The workers already counted the instructions on the paths followed
+  // here.
+  uint64_t replayStart = stats::instructions;
+  ExecutionState *lastState = 0;
+  while (!seedReplayNodes.empty() && !haltExecution) {
+    std::map<ExecutionState*, SeedPathNode*>::iterator it =
+      seedReplayNodes.upper_bound(lastState);
+    if (it == seedReplayNodes.end())
+      it = seedReplayNodes.begin();
+    lastState = it->first;
+    ExecutionState &state = *lastState;
+    executeStep(state);
+    processTimers(&state, 0);
+    updateStates(&state);
+
+    if ((stats::instructions % 1000) == 0 && seedTimeExpired(startTime)) {
+      klee_warning("seed time expired, %d states did not reach the end "
+                   "of their seed worker path", (int) seedReplayNodes.size());
+      break;
+    }
+  }
+  seedReplayNodes.clear();
+  uint64_t replayed = stats::instructions - replayStart;
+  if (workerInstructions > replayed)
+    stats::instructions += workerInstructions - replayed;
+
+  for (std::vector<SeedWorkerReport*>::iterator it = reports.begin(),
+         ie = reports.end(); it != ie; ++it)
+    delete *it;
+
+  if (!seedMap.empty() && !haltExecution)
+    runSeeds(startTime);
+
+  return true;
+}
+
+bool Executor::advanceSeedReplay(ExecutionState &state, unsigned branch) {
+  std::map<ExecutionState*, SeedPathNode*>::iterator it =
+    seedReplayNodes.find(&state);
+  if (it == seedReplayNodes.end())
+    return true;
+
+  std::map<unsigned, SeedPathNode*>::iterator child =
+    it->second->children.find(branch);
+  if (child == it->second->children.end()) {
+    seedReplayNodes.erase(it);
+    return false;
+  }
+
+  if (child->second->children.empty()) {
+    // End of the reported path, this is where the worker left the state.
+    seedReplayNodes.erase(it);
+    addSeeds(state, child->second->seeds);
+  } else {
+    it->second = child->second;
+  }
+  return true;
+}
+
+void Executor::addSeeds(ExecutionState &state,
+                        const std::vector<unsigned> &seeds) {
+  if (seeds.empty())
+    return;
+  std::vector<SeedInfo> &v = seedMap[&state];
+  for (std::vector<unsigned>::const_iterator it = seeds.begin(),
+         ie = seeds.end(); it != ie; ++it)
+    v.push_back(SeedInfo((*usingSeeds)[*it]));
+}
+
+bool Executor::claimSeedWorkerError(Instruction *lastInst,
+                                    const std::string &message) {
+  // FNV-1a over the instruction, which is at the same address in all the
+  // processes, and the message.
+  uint64_t hash = 14695981039346656037ULL;
+  uintptr_t inst = (uintptr_t) lastInst;
+  for (unsigned i=0; i<sizeof(inst); ++i)
+    hash = (hash ^ ((inst >> (8 * i)) & 0xff)) * 1099511628211ULL;
+  for (std::string::const_iterator it = message.begin(),
+         ie = message.end(); it != ie; ++it)
+    hash = (hash ^ (unsigned char) *it) * 1099511628211ULL;
+  if (!hash)
+    hash = 1;
+
+  const unsigned numSlots = sizeof(seedWorkerShared->errors) /
+    sizeof(seedWorkerShared->errors[0]);
+  for (unsigned i=0; i<numSlots; ++i) {
+    uint64_t &slot = seedWorkerShared->errors[(hash + i) % numSlots];
+    uint64_t old = __sync_val_compare_and_swap(&slot, 0, hash);
+    if (old == 0)
+      return true;
+    if (old == hash)
+      return false;
+  }
+  return true;
+}
@@ -15,6 +15,7 @@
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 #include "klee/util/BitArray.h"
+#include "klee/util/SlabAllocator.h"
 
 #include "ObjectHolder.h"
 #include "MemoryManager.h"
@@ -98,15 +99,18 @@ void MemoryObject::getAllocInfo(std::string &result) const {
 
 /***/
 
+uint64_t ObjectState::nextVersion = 0;
+
 ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(static_cast<uint8_t*>(SlabAllocator::allocate(mo->size))),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(0, 0),
+    version(++nextVersion),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
@@ -124,11 +128,12 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
   : copyOnWriteOwner(0),
     refCount(0),
     object(mo),
-    concreteStore(new uint8_t[mo->size]),
+    concreteStore(static_cast<uint8_t*>(SlabAllocator::allocate(mo->size))),
     concreteMask(0),
     flushMask(0),
     knownSymbolics(0),
     updates(array, 0),
+    version(++nextVersion),
     size(mo->size),
     readOnly(false) {
   mo->refCount++;
@@ -140,11 +145,12 @@ ObjectState::ObjectState(const ObjectState &os)
   : copyOnWriteOwner(0),
     refCount(0),
     object(os.object),
-    concreteStore(new uint8_t[os.size]),
+    concreteStore(static_cast<uint8_t*>(SlabAllocator::allocate(os.size))),
     concreteMask(os.concreteMask ? new BitArray(*os.concreteMask, os.size) : 0),
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
     knownSymbolics(0),
     updates(os.updates),
+    version(os.version),
     size(os.size),
     readOnly(false) {
   assert(!os.readOnly && "no need to copy read only object?");
@@ -164,7 +170,7 @@ ObjectState::~ObjectState() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
   if (knownSymbolics) delete[] knownSymbolics;
-  delete[] concreteStore;
+  SlabAllocator::deallocate(concreteStore, size);
 
   if (object)
   {
@@ -259,10 +265,12 @@ void ObjectState::makeSymbolic() {
 void ObjectState::initializeToZero() {
   makeConcrete();
   memset(concreteStore, 0, size);
+  bumpVersion();
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
+  bumpVersion();
   for (unsigned i=0; i<size; i++) {
     // randomly selected by 256 sided die
     concreteStore[i] = 0xAB;
@@ -418,6 +426,7 @@ void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
   concreteStore[offset] = value;
   setKnownSymbolic(offset, 0);
+  bumpVersion();
 
   markByteConcrete(offset);
   markByteUnflushed(offset);
@@ -429,6 +438,7 @@ void ObjectState::write8(unsigned offset, ref<Expr> value) {
     write8(offset, (uint8_t) CE->getZExtValue(8));
   } else {
     setKnownSymbolic(offset, value.get());
+    bumpVersion();
       
     markByteSymbolic(offset);
     markByteUnflushed(offset);
@@ -450,6 +460,7 @@ void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
   }
   
   updates.extend(ZExtExpr::create(offset, Expr::Int32), value);
+  bumpVersion();
 }
 
 /***/
@@ -583,6 +594,93 @@ void ObjectState::write64(unsigned offset, uint64_t value) {
   }
 }
 
+void ObjectState::markRangeConcrete(unsigned offset, unsigned len) {
+  // Nothing to do while every byte is concrete and unflushed.
+  if (!concreteMask && !flushMask && !knownSymbolics)
+    return;
+  for (unsigned i = offset; i < offset + len; i++) {
+    setKnownSymbolic(i, 0);
+    markByteConcrete(i);
+    markByteUnflushed(i);
+  }
+}
+
+void ObjectState::copyRange(unsigned offset, const ObjectState &src,
+                            unsigned srcOffset, unsigned len) {
+  assert(offset + len <= size && srcOffset + len <= src.size &&
+         "copy out of bounds");
+  // Copy back to front when the destination is behind the source in the
+  // same object, so that no byte is overwritten before it is copied.
+  bool backwards = &src == this && srcOffset < offset;
+  unsigned done = 0;
+  while (done < len) {
+    // Find the next run [start, start + n) of bytes that are all concrete
+    // or all symbolic in the source.
+    unsigned start, n = 1;
+    bool concrete;
+    if (backwards) {
+      start = len - done - 1;
+      concrete = src.isByteConcrete(srcOffset + start);
+      while (start > 0 &&
+             src.isByteConcrete(srcOffset + start - 1) == concrete) {
+        --start;
+        ++n;
+      }
+    } else {
+      start = done;
+      concrete = src.isByteConcrete(srcOffset + start);
+      while (start + n < len &&
+             src.isByteConcrete(srcOffset + start + n) == concrete)
+        ++n;
+    }
+
+    if (concrete) {
+      memmove(concreteStore + offset + start,
+              src.concreteStore + srcOffset + start, n);
+      markRangeConcrete(offset + start, n);
+    } else if (backwards) {
+      for (unsigned i = start + n; i-- > start;)
+        write8(offset + i, src.read8(srcOffset + i));
+    } else {
+      for (unsigned i = start; i < start + n; i++)
+        write8(offset + i, src.read8(srcOffset + i));
+    }
+    done += n;
+  }
+  bumpVersion();
+}
+
+void ObjectState::fillRange(unsigned offset, ref<Expr> value, unsigned len) {
+  assert(offset + len <= size && "fill out of bounds");
+  assert(value->getWidth() == Expr::Int8 && "fill with a non-byte value");
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+    memset(concreteStore + offset, (uint8_t) CE->getZExtValue(8), len);
+    markRangeConcrete(offset, len);
+  } else {
+    for (unsigned i = offset; i < offset + len; i++)
+      write8(i, value);
+  }
+  bumpVersion();
+}
+
+ref<Expr> ObjectState::compareRange(unsigned offset, const uint8_t *bytes,
+                                    unsigned len) const {
+  assert(offset + len <= size && "compare out of bounds");
+  ref<Expr> result = ConstantExpr::alloc(1, Expr::Bool);
+  for (unsigned i = 0; i < len; i++) {
+    if (isByteConcrete(offset + i)) {
+      if (concreteStore[offset + i] != bytes[i])
+        return ConstantExpr::alloc(0, Expr::Bool);
+    } else {
+      result = AndExpr::create(result,
+                               EqExpr::create(read8(offset + i),
+                                              ConstantExpr::create(bytes[i],
+                                                                   Expr::Int8)));
+    }
+  }
+  return result;
+}
+
 void ObjectState::print() {
   llvm::errs() << "-- ObjectState --\n";
   llvm::errs() << "\tMemoryObject ID: " << object->id << "\n";
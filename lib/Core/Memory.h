@@ -12,6 +12,7 @@
 
 #include "Context.h"
 #include "klee/Expr.h"
+#include "klee/util/SlabAllocator.h"
 
 #include "llvm/ADT/StringExtras.h"
 
@@ -167,6 +168,12 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// Identifies the contents. Every new object state and every write
+  /// takes a fresh version, while a copy keeps the version of its
+  /// original, so equal versions mean equal contents.
+  uint64_t version;
+  static uint64_t nextVersion;
+
 public:
   unsigned size;
 
@@ -185,8 +192,17 @@ public:
   ObjectState(const ObjectState &os);
   ~ObjectState();
 
+  static void *operator new(size_t size) {
+    return SlabAllocator::allocate(size);
+  }
+  static void operator delete(void *p, size_t size) {
+    SlabAllocator::deallocate(p, size);
+  }
+
   const MemoryObject *getObject() const { return object; }
 
+  uint64_t getVersion() const { return version; }
+
   void setReadOnly(bool ro) { readOnly = ro; }
 
   // make contents all concrete and zero
@@ -207,9 +223,23 @@ public:
   void write32(unsigned offset, uint32_t value);
   void write64(unsigned offset, uint64_t value);
 
+  /// Copy \a len bytes of \a src at \a srcOffset to \a offset. Concrete
+  /// runs are copied as bytes and symbolic ones as expressions, and
+  /// overlapping ranges of one object are copied as by memmove.
+  void copyRange(unsigned offset, const ObjectState &src, unsigned srcOffset,
+                 unsigned len);
+  /// Set \a len bytes at \a offset to the byte \a value.
+  void fillRange(unsigned offset, ref<Expr> value, unsigned len);
+  /// Return a condition for the \a len bytes at \a offset being equal to
+  /// \a bytes, which is false if a concrete byte differs.
+  ref<Expr> compareRange(unsigned offset, const uint8_t *bytes,
+                         unsigned len) const;
+
 private:
   const UpdateList &getUpdates() const;
 
+  void bumpVersion() { version = ++nextVersion; }
+
   void makeConcrete();
 
   void makeSymbolic();
@@ -228,6 +258,8 @@ private:
   bool isByteKnownSymbolic(unsigned offset) const;
 
   void markByteConcrete(unsigned offset);
+  /// Mark a range whose concrete bytes have been stored directly.
+  void markRangeConcrete(unsigned offset, unsigned len);
   void markByteSymbolic(unsigned offset);
   void markByteFlushed(unsigned offset);
   void markByteUnflushed(unsigned offset);
@@ -19,18 +19,101 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <sys/mman.h>
+
+using namespace llvm;
 using namespace klee;
 
+namespace {
+  cl::opt<bool>
+  DeterministicAllocation("deterministic-allocation",
+                          cl::desc("Give objects addresses from a reserved range, so they are the same across runs (default=off)"),
+                          cl::init(false));
+
+  cl::opt<unsigned>
+  DeterministicAllocationSize("deterministic-allocation-size",
+                              cl::desc("Size in MB of the range reserved for --deterministic-allocation (default=1024)"),
+                              cl::init(1024));
+}
+
+/// Where the range for --deterministic-allocation is asked for. It is
+/// only a hint, the range is not forced over existing mappings.
+static void *const deterministicStartAddress = (void*) 0x7ff30000000ULL;
+
+/// Slots are aligned like malloc's blocks.
+static const uint64_t slotAlignment = 16;
+
+/// The size of the slot for an object of the given size. An unused
+/// alignment unit is left after each object, so a pointer one past its end
+/// does not point into the next one.
+static uint64_t slotSize(unsigned size) {
+  uint64_t rounded = ((uint64_t) size + slotAlignment - 1) & ~(slotAlignment - 1);
+  return rounded + slotAlignment;
+}
+
 /***/
 
+MemoryManager::MemoryManager()
+  : deterministicSpace(0), spaceSize(0), nextFreeSlot(0) {
+  if (!DeterministicAllocation)
+    return;
+
+  spaceSize = (uint64_t) DeterministicAllocationSize * 1024 * 1024;
+  void *space = mmap(deterministicStartAddress, spaceSize,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+  if (space == MAP_FAILED)
+    klee_error("unable to reserve %u MB for deterministic allocation",
+               (unsigned) DeterministicAllocationSize);
+  if (space != deterministicStartAddress)
+    klee_warning("deterministic allocation range placed at %p instead of %p, "
+                 "addresses may differ between runs",
+                 space, deterministicStartAddress);
+  deterministicSpace = nextFreeSlot = (char*) space;
+}
+
 MemoryManager::~MemoryManager() { 
   while (!objects.empty()) {
     MemoryObject *mo = *objects.begin();
-    if (!mo->isFixed)
-      free((void *)mo->address);
+    releaseAddress(mo);
     objects.erase(mo);
     delete mo;
   }
+
+  if (deterministicSpace)
+    munmap(deterministicSpace, spaceSize);
+}
+
+uint64_t MemoryManager::allocateSlot(unsigned size) {
+  uint64_t slot = slotSize(size);
+
+  // Reuse the lowest freed slot of the same size, so the address only
+  // depends on the sequence of allocations and frees.
+  std::map<uint64_t, std::set<uint64_t> >::iterator it = freeSlots.find(slot);
+  if (it != freeSlots.end()) {
+    uint64_t address = *it->second.begin();
+    it->second.erase(it->second.begin());
+    if (it->second.empty())
+      freeSlots.erase(it);
+    return address;
+  }
+
+  if (slot > (uint64_t) (deterministicSpace + spaceSize - nextFreeSlot))
+    return 0;
+  uint64_t address = (uint64_t) (unsigned long) nextFreeSlot;
+  nextFreeSlot += slot;
+  return address;
+}
+
+void MemoryManager::releaseAddress(const MemoryObject *mo) {
+  if (mo->isFixed)
+    return;
+
+  char *p = (char*) (unsigned long) mo->address;
+  if (deterministicSpace && p >= deterministicSpace && p < nextFreeSlot)
+    freeSlots[slotSize(mo->size)].insert(mo->address);
+  else
+    free(p);
 }
 
 MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal, 
@@ -39,7 +122,15 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
   if (size>10*1024*1024)
     klee_warning_once(0, "Large alloc: %u bytes.  KLEE may run out of memory.", (unsigned) size);
   
-  uint64_t address = (uint64_t) (unsigned long) malloc((unsigned) size);
+  uint64_t address = 0;
+  if (deterministicSpace) {
+    address = allocateSlot((unsigned) size);
+    if (!address)
+      klee_warning_once(0, "deterministic allocation range exhausted, "
+                        "using malloc");
+  }
+  if (!address)
+    address = (uint64_t) (unsigned long) malloc((unsigned) size);
   if (!address)
     return 0;
   
@@ -75,8 +166,7 @@ void MemoryManager::deallocate(const MemoryObject *mo) {
 void MemoryManager::markFreed(MemoryObject *mo) {
   if (objects.find(mo) != objects.end())
   {
-    if (!mo->isFixed)
-      free((void *)mo->address);
+    releaseAddress(mo);
     objects.erase(mo);
   }
 }
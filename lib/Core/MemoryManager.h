@@ -10,6 +10,7 @@
 #ifndef KLEE_MEMORYMANAGER_H
 #define KLEE_MEMORYMANAGER_H
 
+#include <map>
 #include <set>
 #include <stdint.h>
 
@@ -25,8 +26,24 @@ namespace klee {
     typedef std::set<MemoryObject*> objects_ty;
     objects_ty objects;
 
+    /// The range reserved for --deterministic-allocation, or null.
+    char *deterministicSpace;
+    /// The size of the reserved range.
+    uint64_t spaceSize;
+    /// The first byte of the reserved range never handed out.
+    char *nextFreeSlot;
+    /// Start addresses of the freed slots in the reserved range, by slot
+    /// size.
+    std::map<uint64_t, std::set<uint64_t> > freeSlots;
+
+    /// Return the address of a slot in the reserved range for an object of
+    /// the given size, or 0 if the range is exhausted.
+    uint64_t allocateSlot(unsigned size);
+    /// Give back the host memory of a non-fixed object.
+    void releaseAddress(const MemoryObject *mo);
+
   public:
-    MemoryManager() {}
+    MemoryManager();
     ~MemoryManager();
 
     MemoryObject *allocate(uint64_t size, bool isLocal, bool isGlobal,
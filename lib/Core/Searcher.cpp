@@ -42,6 +42,7 @@
 #include "llvm/IR/CallSite.h"
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <climits>
@@ -52,6 +53,21 @@ using namespace llvm;
 namespace {
   cl::opt<bool>
   DebugLogMerge("debug-log-merge");
+
+  cl::opt<bool>
+  LazyWeightUpdate("lazy-weight-update",
+                   cl::desc("Only recompute NURS state weights when they are sampled or the statistics they depend on change (default=off)"),
+                   cl::init(false));
+
+  cl::opt<unsigned>
+  WeightRefreshBatch("weight-refresh-batch",
+                     cl::desc("Number of stale NURS weights refreshed per update with --lazy-weight-update (default=16)"),
+                     cl::init(16));
+
+  cl::opt<unsigned>
+  MaxStaleDraws("max-stale-draws",
+                cl::desc("Number of times a NURS selection is redrawn after hitting a stale weight with --lazy-weight-update (default=8)"),
+                cl::init(8));
 }
 
 namespace klee {
@@ -213,7 +229,10 @@ void RandomSearcher::update(ExecutionState *current,
 
 WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   : states(new DiscretePDF<ExecutionState*>()),
-    type(_type) {
+    type(_type),
+    lastEpoch(getStatsEpoch()),
+    pendingRefresh(0),
+    refreshPos(weightEpochs.end()) {
   switch(type) {
   case Depth: 
     updateWeights = false;
@@ -228,6 +247,7 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   default:
     assert(0 && "invalid weight type");
   }
+  lazyWeights = updateWeights && LazyWeightUpdate;
 }
 
 WeightedRandomSearcher::~WeightedRandomSearcher() {
@@ -235,9 +255,23 @@ WeightedRandomSearcher::~WeightedRandomSearcher() {
 }
 
 ExecutionState &WeightedRandomSearcher::selectState() {
+  if (lazyWeights)
+    return *chooseFresh();
   return *states->choose(theRNG.getDoubleL());
 }
 
+void WeightedRandomSearcher::selectStates(unsigned n,
+                                          std::vector<ExecutionState*> &result) {
+  // Draw with replacement and drop duplicates, a state that is picked
+  // twice is simply stepped once in this round.
+  std::set<ExecutionState*> seen;
+  for (unsigned i=0; i<n; ++i) {
+    ExecutionState *es = &selectState();
+    if (seen.insert(es).second)
+      result.push_back(es);
+  }
+}
+
 double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   switch(type) {
   default:
@@ -275,22 +309,89 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   }
 }
 
+bool WeightedRandomSearcher::isStale(ExecutionState *es) {
+  return weightEpochs[es] != getStatsEpoch();
+}
+
+void WeightedRandomSearcher::refreshWeight(ExecutionState *es) {
+  states->update(es, getWeight(es));
+  weightEpochs[es] = getStatsEpoch();
+}
+
+/// Refresh a bounded number of weights, continuing the sweep over all
+/// states that was started when the stats epoch last changed. This
+/// keeps priorities of states which are rarely sampled from going
+/// stale, without paying for a full recomputation at once.
+void WeightedRandomSearcher::refreshSomeWeights() {
+  uint64_t epoch = getStatsEpoch();
+  if (epoch != lastEpoch) {
+    lastEpoch = epoch;
+    pendingRefresh = weightEpochs.size();
+  }
+
+  for (unsigned i=0; pendingRefresh && i<WeightRefreshBatch; 
+       ++i, --pendingRefresh) {
+    if (refreshPos == weightEpochs.end())
+      refreshPos = weightEpochs.begin();
+    if (refreshPos->second != epoch) {
+      states->update(refreshPos->first, getWeight(refreshPos->first));
+      refreshPos->second = epoch;
+    }
+    ++refreshPos;
+  }
+}
+
+/// Choose a state, recomputing the weight of any stale state that is
+/// hit. Since refreshing changes the distribution the choice is redrawn,
+/// up to MaxStaleDraws times.
+ExecutionState *WeightedRandomSearcher::chooseFresh() {
+  for (unsigned draws=0;; ++draws) {
+    ExecutionState *es = states->choose(theRNG.getDoubleL());
+    if (!isStale(es))
+      return es;
+    refreshWeight(es);
+    if (draws == MaxStaleDraws)
+      return es;
+  }
+}
+
 void WeightedRandomSearcher::update(ExecutionState *current,
                                     const std::set<ExecutionState*> &addedStates,
                                     const std::set<ExecutionState*> &removedStates) {
-  if (current && updateWeights && !removedStates.count(current))
-    states->update(current, getWeight(current));
+  if (current && updateWeights && !removedStates.count(current)) {
+    if (lazyWeights) {
+      // The weight is recomputed when the state is next sampled.
+      std::map<ExecutionState*, uint64_t>::iterator it =
+        weightEpochs.find(current);
+      if (it != weightEpochs.end())
+        it->second = 0;
+    } else {
+      states->update(current, getWeight(current));
+    }
+  }
   
   for (std::set<ExecutionState*>::const_iterator it = addedStates.begin(),
          ie = addedStates.end(); it != ie; ++it) {
     ExecutionState *es = *it;
     states->insert(es, getWeight(es));
+    if (lazyWeights)
+      weightEpochs[es] = getStatsEpoch();
   }
 
   for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
          ie = removedStates.end(); it != ie; ++it) {
     states->remove(*it);
+    if (lazyWeights) {
+      std::map<ExecutionState*, uint64_t>::iterator eit =
+        weightEpochs.find(*it);
+      if (eit == refreshPos)
+        ++refreshPos;
+      weightEpochs.erase(eit);
+    }
   }
+
+  if (lazyWeights && !states->empty())
+    refreshSomeWeights();
 }
 
 bool WeightedRandomSearcher::empty() { 
@@ -409,6 +510,22 @@ entry:
   }
 }
 
+void BumpMergingSearcher::selectStates(unsigned n,
+                                       std::vector<ExecutionState*> &result) {
+  // Only the first state goes through the merging, the round is filled
+  // with states of the base searcher that are not at a merge point.
+  ExecutionState *first = &selectState();
+  result.push_back(first);
+  if (n > 1) {
+    std::vector<ExecutionState*> rest;
+    baseSearcher->selectStates(n - 1, rest);
+    for (std::vector<ExecutionState*>::iterator it = rest.begin(),
+           ie = rest.end(); it != ie; ++it)
+      if (*it != first && !getMergePoint(**it))
+        result.push_back(*it);
+  }
+}
+
 void BumpMergingSearcher::update(ExecutionState *current,
                                  const std::set<ExecutionState*> &addedStates,
                                  const std::set<ExecutionState*> &removedStates) {
@@ -523,6 +640,21 @@ ExecutionState &MergingSearcher::selectState() {
   return selectState();
 }
 
+void MergingSearcher::selectStates(unsigned n,
+                                   std::vector<ExecutionState*> &result) {
+  // As for BumpMergingSearcher::selectStates().
+  ExecutionState *first = &selectState();
+  result.push_back(first);
+  if (n > 1) {
+    std::vector<ExecutionState*> rest;
+    baseSearcher->selectStates(n - 1, rest);
+    for (std::vector<ExecutionState*>::iterator it = rest.begin(),
+           ie = rest.end(); it != ie; ++it)
+      if (*it != first && !getMergePoint(**it))
+        result.push_back(*it);
+  }
+}
+
 void MergingSearcher::update(ExecutionState *current,
                              const std::set<ExecutionState*> &addedStates,
                              const std::set<ExecutionState*> &removedStates) {
@@ -545,6 +677,170 @@ void MergingSearcher::update(ExecutionState *current,
 
 ///
 
+DynamicMergingSearcher::DynamicMergingSearcher(Executor &_executor,
+                                               Searcher *_baseSearcher,
+                                               unsigned _window,
+                                               double _ratio)
+  : executor(_executor),
+    baseSearcher(_baseSearcher),
+    window(_window),
+    ratio(_ratio),
+    round(0) {
+}
+
+DynamicMergingSearcher::~DynamicMergingSearcher() {
+  delete baseSearcher;
+}
+
+bool DynamicMergingSearcher::shouldMerge(ExecutionState &a,
+                                         ExecutionState &b) {
+  if (a.stack.back().kf != b.stack.back().kf)
+    return false;
+
+  // A register that differs becomes a select over the two values, which
+  // every query depending on it has to take apart again.
+  const MergePoint *mp = a.pc->mergePoint;
+  const StackFrame &af = a.stack.back(), &bf = b.stack.back();
+  for (std::map<unsigned, unsigned>::const_iterator
+         it = mp->queries.begin(), ie = mp->queries.end(); it != ie; ++it) {
+    if (it->second <= ratio * mp->totalQueries)
+      continue;
+    const ref<Expr> &av = af.getLocal(it->first).getValue();
+    const ref<Expr> &bv = bf.getLocal(it->first).getValue();
+    if (!av.isNull() && !bv.isNull() && av != bv)
+      return false;
+  }
+  return true;
+}
+
+void DynamicMergingSearcher::clearDeadRegisters(ExecutionState &es) {
+  const std::vector<unsigned> &dead = es.pc->mergePoint->deadRegisters;
+  StackFrame &sf = es.stack.back();
+  for (std::vector<unsigned>::const_iterator it = dead.begin(),
+         ie = dead.end(); it != ie; ++it)
+    if (!sf.getLocal(*it).getValue().isNull())
+      sf.getLocalForWrite(*it).setValue(ref<Expr>());
+}
+
+void DynamicMergingSearcher::hold(ExecutionState &es) {
+  baseSearcher->removeState(&es, &es);
+  held[&es] = round + window;
+  deadlines.insert(std::make_pair(round + window, &es));
+  waiting[es.pc].push_back(&es);
+}
+
+void DynamicMergingSearcher::release(ExecutionState &es) {
+  std::map<ExecutionState*, unsigned>::iterator it = held.find(&es);
+  assert(it != held.end() && "state is not held");
+  deadlines.erase(std::make_pair(it->second, &es));
+  held.erase(it);
+
+  std::vector<ExecutionState*> &states = waiting[es.pc];
+  states.erase(std::find(states.begin(), states.end(), &es));
+  if (states.empty())
+    waiting.erase(es.pc);
+}
+
+ExecutionState &DynamicMergingSearcher::selectState() {
+  ++round;
+  while (!deadlines.empty() && deadlines.begin()->first <= round) {
+    ExecutionState *es = deadlines.begin()->second;
+    release(*es);
+    released[es] = es->pc;
+    baseSearcher->addState(es);
+  }
+
+  for (;;) {
+    // Nothing else can arrive, so let the held states go.
+    if (baseSearcher->empty()) {
+      while (!deadlines.empty()) {
+        ExecutionState *es = deadlines.begin()->second;
+        release(*es);
+        released[es] = es->pc;
+        baseSearcher->addState(es);
+      }
+    }
+
+    ExecutionState &es = baseSearcher->selectState();
+    if (!es.pc->mergePoint)
+      return es;
+
+    std::map<ExecutionState*, KInstruction*>::iterator rit =
+      released.find(&es);
+    if (rit != released.end()) {
+      bool waited = rit->second == es.pc;
+      released.erase(rit);
+      if (waited)
+        return es;
+    }
+
+    // Registers not read again before being written would only add
+    // selects to the merged state.
+    clearDeadRegisters(es);
+
+    std::map<KInstruction*, std::vector<ExecutionState*> >::iterator it =
+      waiting.find(es.pc);
+    if (it != waiting.end()) {
+      for (std::vector<ExecutionState*>::iterator sit = it->second.begin(),
+             sie = it->second.end(); sit != sie; ++sit) {
+        ExecutionState *base = *sit;
+        if (shouldMerge(*base, es) && base->merge(es)) {
+          if (DebugLogMerge)
+            llvm::errs() << "-- merged " << &es << " into " << base
+                         << " --\n";
+          baseSearcher->removeState(&es, &es);
+          merged.insert(&es);
+          executor.terminateState(es);
+          break;
+        }
+      }
+      if (merged.count(&es))
+        continue;
+    }
+
+    hold(es);
+  }
+}
+
+void DynamicMergingSearcher::selectStates(unsigned n,
+                                          std::vector<ExecutionState*> &result) {
+  // As for BumpMergingSearcher::selectStates().
+  ExecutionState *first = &selectState();
+  result.push_back(first);
+  if (n > 1) {
+    std::vector<ExecutionState*> rest;
+    baseSearcher->selectStates(n - 1, rest);
+    for (std::vector<ExecutionState*>::iterator it = rest.begin(),
+           ie = rest.end(); it != ie; ++it)
+      if (*it != first && !(*it)->pc->mergePoint)
+        result.push_back(*it);
+  }
+}
+
+void DynamicMergingSearcher::update(ExecutionState *current,
+                                    const std::set<ExecutionState*> &addedStates,
+                                    const std::set<ExecutionState*> &removedStates) {
+  if (!removedStates.empty()) {
+    std::set<ExecutionState *> alt = removedStates;
+    for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+           ie = removedStates.end(); it != ie; ++it) {
+      ExecutionState *es = *it;
+      released.erase(es);
+      if (held.count(es)) {
+        release(*es);
+        alt.erase(es);
+      } else if (merged.erase(es)) {
+        alt.erase(es);
+      }
+    }
+    baseSearcher->update(current, addedStates, alt);
+  } else {
+    baseSearcher->update(current, addedStates, removedStates);
+  }
+}
+
+///
+
 BatchingSearcher::BatchingSearcher(Searcher *_baseSearcher,
                                    double _timeBudget,
                                    unsigned _instructionBudget) 
@@ -559,7 +855,7 @@ BatchingSearcher::~BatchingSearcher() {
   delete baseSearcher;
 }
 
-ExecutionState &BatchingSearcher::selectState() {
+bool BatchingSearcher::batchOver() {
   if (!lastState || 
       (util::getWallTime()-lastStartTime)>timeBudget ||
       (stats::instructions-lastStartInstructions)>instructionBudget) {
@@ -571,12 +867,33 @@ ExecutionState &BatchingSearcher::selectState() {
         timeBudget = delta;
       }
     }
-    lastState = &baseSearcher->selectState();
-    lastStartTime = util::getWallTime();
-    lastStartInstructions = stats::instructions;
-    return *lastState;
+    return true;
+  }
+  return false;
+}
+
+void BatchingSearcher::startBatch(ExecutionState *es) {
+  lastState = es;
+  lastStartTime = util::getWallTime();
+  lastStartInstructions = stats::instructions;
+}
+
+ExecutionState &BatchingSearcher::selectState() {
+  if (batchOver())
+    startBatch(&baseSearcher->selectState());
+  return *lastState;
+}
+
+void BatchingSearcher::selectStates(unsigned n,
+                                    std::vector<ExecutionState*> &result) {
+  // A running batch keeps its state to itself, a new one starts with the
+  // round of the base searcher.
+  if (batchOver()) {
+    size_t first = result.size();
+    baseSearcher->selectStates(n, result);
+    startBatch(result[first]);
   } else {
-    return *lastState;
+    result.push_back(lastState);
   }
 }
 
@@ -605,6 +922,12 @@ ExecutionState &IterativeDeepeningTimeSearcher::selectState() {
   return res;
 }
 
+void IterativeDeepeningTimeSearcher::selectStates(unsigned n,
+                                                  std::vector<ExecutionState*> &result) {
+  baseSearcher->selectStates(n, result);
+  startTime = util::getWallTime();
+}
+
 void IterativeDeepeningTimeSearcher::update(ExecutionState *current,
                                             const std::set<ExecutionState*> &addedStates,
                                             const std::set<ExecutionState*> &removedStates) {
@@ -658,6 +981,13 @@ ExecutionState &InterleavedSearcher::selectState() {
   return s->selectState();
 }
 
+void InterleavedSearcher::selectStates(unsigned n,
+                                       std::vector<ExecutionState*> &result) {
+  Searcher *s = searchers[--index];
+  if (index==0) index = searchers.size();
+  s->selectStates(n, result);
+}
+
 void InterleavedSearcher::update(ExecutionState *current,
                                  const std::set<ExecutionState*> &addedStates,
                                  const std::set<ExecutionState*> &removedStates) {
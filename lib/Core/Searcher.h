@@ -27,6 +27,7 @@ namespace klee {
   template<class T> class DiscretePDF;
   class ExecutionState;
   class Executor;
+  struct KInstruction;
 
   class Searcher {
   public:
@@ -34,6 +35,14 @@ namespace klee {
 
     virtual ExecutionState &selectState() = 0;
 
+    // Select up to n states to be stepped in one round. The states are
+    // appended to result in the order they should be run. Searchers
+    // that cannot do better just return the state selectState() would.
+    virtual void selectStates(unsigned n,
+                              std::vector<ExecutionState*> &result) {
+      result.push_back(&selectState());
+    }
+
     virtual void update(ExecutionState *current,
                         const std::set<ExecutionState*> &addedStates,
                         const std::set<ExecutionState*> &removedStates) = 0;
@@ -152,14 +161,30 @@ namespace klee {
     DiscretePDF<ExecutionState*> *states;
     WeightType type;
     bool updateWeights;
+
+    // When weights are updated lazily, each state is tagged with the
+    // stats epoch (see getStatsEpoch()) its weight in this searcher was
+    // computed in, or 0 if it is stale. Other searchers keep their own.
+    bool lazyWeights;
+    std::map<ExecutionState*, uint64_t> weightEpochs;
+    uint64_t lastEpoch;
+    // Number of states still to be visited by the incremental refresh
+    // started when the epoch last changed, and where it continues.
+    unsigned pendingRefresh;
+    std::map<ExecutionState*, uint64_t>::iterator refreshPos;
     
     double getWeight(ExecutionState*);
+    bool isStale(ExecutionState *es);
+    void refreshWeight(ExecutionState *es);
+    void refreshSomeWeights();
+    ExecutionState *chooseFresh();
 
   public:
     WeightedRandomSearcher(WeightType type);
     ~WeightedRandomSearcher();
 
     ExecutionState &selectState();
+    void selectStates(unsigned n, std::vector<ExecutionState*> &result);
     void update(ExecutionState *current,
                 const std::set<ExecutionState*> &addedStates,
                 const std::set<ExecutionState*> &removedStates);
@@ -209,6 +234,7 @@ namespace klee {
     ~MergingSearcher();
 
     ExecutionState &selectState();
+    void selectStates(unsigned n, std::vector<ExecutionState*> &result);
     void update(ExecutionState *current,
                 const std::set<ExecutionState*> &addedStates,
                 const std::set<ExecutionState*> &removedStates);
@@ -232,6 +258,7 @@ namespace klee {
     ~BumpMergingSearcher();
 
     ExecutionState &selectState();
+    void selectStates(unsigned n, std::vector<ExecutionState*> &result);
     void update(ExecutionState *current,
                 const std::set<ExecutionState*> &addedStates,
                 const std::set<ExecutionState*> &removedStates);
@@ -241,6 +268,51 @@ namespace klee {
     }
   };
 
+  /// Holds states that reach a merge point of the module for a number of
+  /// selections, and merges the states that arrive at the same point in
+  /// the meantime unless they differ in registers that many of the later
+  /// queries depend on.
+  class DynamicMergingSearcher : public Searcher {
+    Executor &executor;
+    Searcher *baseSearcher;
+    unsigned window;
+    double ratio;
+    unsigned round;
+
+    /// The held states and the round they are released in.
+    std::map<ExecutionState*, unsigned> held;
+    std::set<std::pair<unsigned, ExecutionState*> > deadlines;
+    std::map<KInstruction*, std::vector<ExecutionState*> > waiting;
+    /// States released at the merge point they are still at.
+    std::map<ExecutionState*, KInstruction*> released;
+    /// States merged into others, until the executor removes them.
+    std::set<ExecutionState*> merged;
+
+  private:
+    bool shouldMerge(ExecutionState &a, ExecutionState &b);
+    void clearDeadRegisters(ExecutionState &es);
+    void hold(ExecutionState &es);
+    void release(ExecutionState &es);
+
+  public:
+    DynamicMergingSearcher(Executor &executor, Searcher *baseSearcher,
+                           unsigned window, double ratio);
+    ~DynamicMergingSearcher();
+
+    ExecutionState &selectState();
+    void selectStates(unsigned n, std::vector<ExecutionState*> &result);
+    void update(ExecutionState *current,
+                const std::set<ExecutionState*> &addedStates,
+                const std::set<ExecutionState*> &removedStates);
+    bool empty() { return baseSearcher->empty() && held.empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "<DynamicMergingSearcher> window: " << window
+         << ", ratio: " << ratio << ", baseSearcher:\n";
+      baseSearcher->printName(os);
+      os << "</DynamicMergingSearcher>\n";
+    }
+  };
+
   class BatchingSearcher : public Searcher {
     Searcher *baseSearcher;
     double timeBudget;
@@ -250,6 +322,10 @@ namespace klee {
     double lastStartTime;
     unsigned lastStartInstructions;
 
+  private:
+    bool batchOver();
+    void startBatch(ExecutionState *es);
+
   public:
     BatchingSearcher(Searcher *baseSearcher, 
                      double _timeBudget,
@@ -257,6 +333,7 @@ namespace klee {
     ~BatchingSearcher();
 
     ExecutionState &selectState();
+    void selectStates(unsigned n, std::vector<ExecutionState*> &result);
     void update(ExecutionState *current,
                 const std::set<ExecutionState*> &addedStates,
                 const std::set<ExecutionState*> &removedStates);
@@ -280,6 +357,7 @@ namespace klee {
     ~IterativeDeepeningTimeSearcher();
 
     ExecutionState &selectState();
+    void selectStates(unsigned n, std::vector<ExecutionState*> &result);
     void update(ExecutionState *current,
                 const std::set<ExecutionState*> &addedStates,
                 const std::set<ExecutionState*> &removedStates);
@@ -300,6 +378,7 @@ namespace klee {
     ~InterleavedSearcher();
 
     ExecutionState &selectState();
+    void selectStates(unsigned n, std::vector<ExecutionState*> &result);
     void update(ExecutionState *current,
                 const std::set<ExecutionState*> &addedStates,
                 const std::set<ExecutionState*> &removedStates);
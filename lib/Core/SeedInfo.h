@@ -12,6 +12,9 @@
 
 #include "klee/util/Assignment.h"
 
+#include <map>
+#include <vector>
+
 extern "C" {
   struct KTest;
   struct KTestObject;
@@ -43,6 +46,42 @@ namespace klee {
                    ref<Expr> condition,
                    TimingSolver *solver);
   };
+
+  /// A node in the tree of branch decisions taken by the states a seed
+  /// worker process left when it finished seeding. Edges are labelled
+  /// with the index of the branch taken (1/0 for the true/false side of a
+  /// fork, the condition index for a multi-way branch), each leaf is the
+  /// end of the path of one state.
+  struct SeedPathNode {
+    std::map<unsigned, SeedPathNode*> children;
+    /// For a leaf, the indices of the seeds the state still had.
+    std::vector<unsigned> seeds;
+
+    SeedPathNode() {}
+    ~SeedPathNode() {
+      for (std::map<unsigned, SeedPathNode*>::iterator it = children.begin(),
+             ie = children.end(); it != ie; ++it)
+        delete it->second;
+    }
+
+    /// Add a path below this node, creating nodes as necessary, and
+    /// return the node at its end.
+    SeedPathNode *insert(const std::vector<unsigned> &path) {
+      SeedPathNode *n = this;
+      for (std::vector<unsigned>::const_iterator it = path.begin(),
+             ie = path.end(); it != ie; ++it) {
+        SeedPathNode *&child = n->children[*it];
+        if (!child)
+          child = new SeedPathNode();
+        n = child;
+      }
+      return n;
+    }
+
+  private:
+    SeedPathNode(const SeedPathNode&);
+    void operator=(const SeedPathNode&);
+  };
 }
 
 #endif
@@ -288,6 +288,15 @@ void SpecialFunctionHandler::bind() {
     if (f && (!hi.doNotOverride || f->isDeclaration()))
       handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
   }
+
+  // These keep their runtime definitions, which still handle the calls
+  // that handleBulkMemory leaves alone.
+  if (Function *f = executor.kmodule->module->getFunction("memcpy"))
+    bulkMemoryOps[f] = Memcpy;
+  if (Function *f = executor.kmodule->module->getFunction("memmove"))
+    bulkMemoryOps[f] = Memmove;
+  if (Function *f = executor.kmodule->module->getFunction("memset"))
+    bulkMemoryOps[f] = Memset;
 }
 
 
@@ -312,6 +321,72 @@ bool SpecialFunctionHandler::handle(ExecutionState &state,
   }
 }
 
+bool SpecialFunctionHandler::resolveRange(ExecutionState &state,
+                                          ref<Expr> address, uint64_t len,
+                                          ObjectPair &op, unsigned &offset) {
+  ConstantExpr *CE = dyn_cast<ConstantExpr>(address);
+  if (!CE || !state.addressSpace.resolveOne(CE, op))
+    return false;
+  uint64_t start = CE->getZExtValue() - op.first->address;
+  if (start > op.first->size || len > op.first->size - start)
+    return false;
+  offset = start;
+  return true;
+}
+
+bool SpecialFunctionHandler::handleBulkMemory(ExecutionState &state,
+                                              Function *f,
+                                              KInstruction *target,
+                                              std::vector<ref<Expr> >
+                                                &arguments) {
+  std::map<const Function*, BulkMemoryOp>::iterator it =
+    bulkMemoryOps.find(f);
+  if (it == bulkMemoryOps.end() || arguments.size() != 3)
+    return false;
+
+  // Anything symbolic, out of bounds or read only is left to the runtime
+  // implementation, which forks or reports the error at the right byte.
+  ConstantExpr *len = dyn_cast<ConstantExpr>(arguments[2]);
+  if (!len || len->getWidth() > Expr::Int64)
+    return false;
+  uint64_t n = len->getZExtValue();
+
+  if (n) {
+    ObjectPair dst;
+    unsigned dstOffset;
+    if (!resolveRange(state, arguments[0], n, dst, dstOffset) ||
+        dst.second->readOnly)
+      return false;
+
+    if (it->second == Memset) {
+      ObjectState *wos = state.addressSpace.getWriteable(dst.first,
+                                                         dst.second);
+      wos->fillRange(dstOffset,
+                     ExtractExpr::create(arguments[1], 0, Expr::Int8), n);
+    } else {
+      ObjectPair src;
+      unsigned srcOffset;
+      if (!resolveRange(state, arguments[1], n, src, srcOffset))
+        return false;
+      bool same = src.first == dst.first;
+      // memcpy copies forward, which repeats the source when the
+      // destination overlaps it from behind.
+      if (it->second == Memcpy && same && srcOffset < dstOffset &&
+          dstOffset < srcOffset + n)
+        return false;
+      if (!same || srcOffset != dstOffset) {
+        ObjectState *wos = state.addressSpace.getWriteable(dst.first,
+                                                           dst.second);
+        wos->copyRange(dstOffset, same ? *wos : *src.second, srcOffset, n);
+      }
+    }
+  }
+
+  if (!target->inst->getType()->isVoidTy())
+    executor.bindLocal(target, state, arguments[0]);
+  return true;
+}
+
 /****/
 
 // reads a concrete string from memory
@@ -1195,6 +1270,186 @@ void SpecialFunctionHandler::processScanHex(ExecutionState *current_state,Expr::
 	}
 }
 
+template<typename Step>
+const std::vector<Step> &
+SpecialFunctionHandler::getFormatPlan(ExecutionState &state,
+                                      KInstruction *target,
+                                      ref<Expr> addressExpr,
+                                      std::map<const KInstruction*,
+                                               FormatPlan<Step> > &plans,
+                                      void (*build)(const std::string &,
+                                                    std::vector<Step> &)) {
+  FormatPlan<Step> &plan = plans[target];
+  addressExpr = executor.toUnique(state, addressExpr);
+  ref<ConstantExpr> address = cast<ConstantExpr>(addressExpr);
+  ObjectPair op;
+  if (state.addressSpace.resolveOne(address, op) &&
+      address->getZExtValue() == op.first->address &&
+      op.first == plan.object && op.second->getVersion() == plan.version)
+    return plan.steps;
+
+  // Reading the string checks the address the way every other handler
+  // does, so only a plan of a properly resolved format is kept.
+  std::string format = readStringAtAddress(state, address);
+  plan.object = op.first;
+  plan.version = op.second->getVersion();
+  plan.steps.clear();
+  build(format, plan.steps);
+  return plan.steps;
+}
+
+static bool isScanSpace(char c) {
+  return c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r' ||
+         c == ' ';
+}
+
+static bool isLengthModifier(char c) {
+  return c == 'l' || c == 'h' || c == 'j' || c == 'z' || c == 't' || c == 'L';
+}
+
+void SpecialFunctionHandler::buildScanPlan(const std::string &format,
+                                           std::vector<ScanStep> &steps) {
+  for (unsigned i = 0, n = format.size(); i < n; ++i) {
+    char c = format[i];
+    if (isScanSpace(c)) {
+      steps.push_back(ScanStep(ScanStep::Space));
+    } else if (c != '%') {
+      if (steps.empty() || steps.back().kind != ScanStep::Literal)
+        steps.push_back(ScanStep(ScanStep::Literal));
+      steps.back().text += c;
+    } else {
+      ScanStep step(ScanStep::Conversion);
+      unsigned next = i + 1;
+      if (next == n) {
+        step.warning = "Nothing behind % sign!";
+        step.incomplete = true;
+      } else {
+        // FIXME: Widths are skipped, not honored.
+        while (next < n && format[next] >= '0' && format[next] <= '9')
+          if (++next == n)
+            step.warning = "Nothing behind % sign!";
+        step.specifier[0] = next < n ? format[next] : '\0';
+        if (isLengthModifier(step.specifier[0])) {
+          if (++next == n) {
+            step.warning =
+              "Fscanf missing indicator before reaching end of string";
+            step.incomplete = true;
+          } else {
+            step.specifier[1] = format[next];
+            // 'hh' or 'll' still needs one more char.
+            if (step.specifier[0] == step.specifier[1]) {
+              ++next;
+              step.specifier[2] = next < n ? format[next] : '\0';
+            }
+          }
+        }
+      }
+
+      // The scan goes on after the '%' and at most one length modifier,
+      // anything else behind them is matched as literal characters.
+      // FIXME: Only consider 1 bit width indicator.
+      unsigned resume = i + 1;
+      if (resume == n ||
+          (isLengthModifier(format[resume]) && ++resume == n))
+        step.last = true;
+      steps.push_back(step);
+      if (step.last)
+        break;
+      i = resume;
+    }
+  }
+}
+
+void SpecialFunctionHandler::buildPrintPlan(const std::string &format,
+                                            std::vector<PrintStep> &steps) {
+  for (unsigned i = 0, n = format.size(); i < n; ++i) {
+    PrintStep step(PrintStep::Literal);
+    if (format[i] != '%') {
+      step.text = format[i];
+    } else if (++i == n) {
+      step.text = "%";
+      step.warning = "Missing indicator after % sign in fprintf!";
+    } else if (format[i] == 'd' || format[i] == 'x' || format[i] == 'X' ||
+               format[i] == 'o') {
+      step.kind = PrintStep::Int32;
+    } else if (format[i] == 'c') {
+      step.kind = PrintStep::Char;
+    } else {
+      step.text = "%";
+      step.text += format[i];
+    }
+
+    if (step.kind == PrintStep::Literal && !step.warning && !steps.empty() &&
+        steps.back().kind == PrintStep::Literal && !steps.back().warning)
+      steps.back().text += step.text;
+    else
+      steps.push_back(step);
+  }
+}
+
+void SpecialFunctionHandler::bindScanResult(ExecutionState &state,
+                                            KInstruction *target) {
+  LLVM_TYPE_Q llvm::Type *resultType = target->inst->getType();
+  if (!resultType->isVoidTy()) {
+    unsigned width = resultType->getPrimitiveSizeInBits();
+    ref<Expr> e;
+    if (state.getBytesRead() == 0)
+      e = ConstantExpr::alloc(EOF, width);
+    else
+      e = ConstantExpr::alloc(state.getBytesRead(), width);
+    executor.bindLocal(target, state, e);
+  }
+}
+
+bool SpecialFunctionHandler::matchScanLiteral(ExecutionState &state,
+                                              const std::string &text,
+                                              const int fileid, int size,
+                                              const ObjectState *os,
+                                              KInstruction *target) {
+  ExecutionState::fileDesc *descriptor = state.getBuffer(fileid);
+  bool result;
+
+  // Try the whole run with one query, the common case being input that
+  // matches.
+  if (text.size() > 1 && descriptor->getoffset() + (int) text.size() <= size) {
+    ref<Expr> cond =
+      os->compareRange(descriptor->getoffset(),
+                       reinterpret_cast<const uint8_t *>(text.data()),
+                       text.size());
+    bool success = executor.solver->mustBeTrue(state, cond, result);
+    assert(success && "fscanf solver failure");
+    if (result) {
+      descriptor->incOffset(text.size());
+      return true;
+    }
+  }
+
+  // Go char by char to find where the input ends or stops matching.
+  for (unsigned i = 0; i < text.size(); i++) {
+    if (descriptor->getoffset() >= size) {
+      //return EOF
+      bindScanResult(state, target);
+      return false;
+    }
+    ref<Expr> bufferchar = os->read8(descriptor->getoffset());
+    descriptor->incOffset();
+    ref<ConstantExpr> formatchar =
+      ConstantExpr::create((uint64_t) text[i], ConstantExpr::Int8);
+    bool success = executor.solver->mustBeTrue(state,
+                                               EqExpr::create(formatchar,
+                                                              bufferchar),
+                                               result);
+    assert(success && "fscanf solver failure");
+    if (!result) {
+      klee_warning("Fscanf found string not able to match!!");
+      //return num of chars read.
+      bindScanResult(state, target);
+      return false;
+    }
+  }
+  return true;
+}
+
 void SpecialFunctionHandler::handleSscanf(ExecutionState &state,
 		KInstruction *target,
         std::vector<ref<Expr> > &arguments){
@@ -1222,7 +1477,9 @@ void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
         KInstruction *target,
         std::vector<ref<Expr> > &arguments){
 		assert(arguments.size()>1 && "Wrong number of arguments for fscanf");
-		std::string format = readStringAtAddress(state,arguments[1]);
+		const std::vector<ScanStep> &plan =
+			getFormatPlan(state, target, arguments[1], scanPlans,
+			              &SpecialFunctionHandler::buildScanPlan);
 		ref<ConstantExpr> value;
 		executor.solver->getValue(state,arguments[0],value);
 		int fileid = value.get()->getZExtValue();
@@ -1235,7 +1492,6 @@ void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
 		ObjectPair op = descriptor->getBuffer();
 		const MemoryObject* mo = op.first;
 		int size = descriptor->getsize();
-		std::string::iterator it;
 		ref<ConstantExpr> bufferLocation = mo->getBaseExpr();
 
 		/*
@@ -1260,10 +1516,15 @@ void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
 			/*
 			 * After resolving symbolic input, we start reading one by one.
 			 */
-			for(it = format.begin();it!=format.end();it++){
+			for(std::vector<ScanStep>::const_iterator step = plan.begin(); step != plan.end(); step++){
 				for(std::vector<ExecutionState*>::iterator s= stateNotProcessed.begin(); s != stateNotProcessed.end();s++){
 					//for(every s in stateNotProcessed)
 					descriptor = (*s)->getBuffer(fileid);
+					if(step->kind == ScanStep::Literal){
+						if(matchScanLiteral(**s,step->text,fileid,size,op.second,target))
+							stateProcessed.push_back(*s);
+						continue;
+					}
 					if(descriptor->getoffset()>=size){
 								//return EOF
 						LLVM_TYPE_Q llvm::Type *resultType = target->inst->getType();
@@ -1281,7 +1542,7 @@ void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
 					//if we are not out of buffer, we read the content of the buffer.
 					ref<Expr> bufferchar = op.second->read8(descriptor->getoffset());
 					descriptor->incOffset();
-					if(*it == '%'){//Read to dest
+					if(step->kind == ScanStep::Conversion){//Read to dest
 						//Remove all the spaces
 						result = true;
 						while (result) {
@@ -1345,42 +1606,15 @@ void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
 						/*
 						 * We need to check if the dest buffer have the correct type.
 						 */
-						//it now is the first char of specifier
-						char specifier[3]={'\0','\0','\0'};
-						int index = 0;
-						std::string::iterator nextit = it+1;//if it points out of bound?
-
-						if(nextit == format.end()){
+						//the specifier was parsed with the plan
+						if(step->warning){
 							//warning.Gladtbx:Maybe should be error?!
-							klee_warning("Nothing behind % sign!");
-							continue;
+							klee_warning("%s", step->warning);
 						}
-						while(*nextit == '0' ||*nextit == '1' ||*nextit == '2' ||*nextit == '3' ||*nextit == '4' ||*nextit == '5' ||*nextit == '6' ||*nextit == '7' ||*nextit == '8' ||*nextit == '9'){
-							nextit++;//Fixme:Add support for numbers here;Gladtbx
-							if(nextit == format.end()){
-								//warning.Gladtbx:Maybe should be error?!
-								klee_warning("Nothing behind % sign!");
-								continue;
-							}
-						}
-						specifier[index] = *nextit;
-						//first check if it is length. include'l','ll','L','h','hh','j','z','t'
-						if(*nextit == 'l' || *nextit == 'h' || *nextit == 'j' || *nextit == 'z' || *nextit == 't' || *nextit == 'L'){
-							nextit++;//add checking for it not out of bound
-							if(nextit == format.end()){
-								klee_warning("Fscanf missing indicator before reaching end of string");
-								continue;
-								//return
-							}
-							index++;
-							specifier[index] = *nextit;
-							if(specifier[0] == specifier[1]){
-								//we have 'hh' or 'll' and still need one more char
-								nextit++;
-								index++;
-								specifier[index] = *nextit;
-							}
+						if(step->incomplete){
+							continue;
 						}
+						const char *specifier = step->specifier;
 
 						//clear neg flag and previous read data
 						(*s)->ioBuffer.clear();
@@ -1483,7 +1717,7 @@ void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
 						}
 					}
 
-					else if(*it =='\t'||*it == '\n' ||*it == '\v' || *it== '\f' || *it == '\r' || *it == ' '){//add tab space etc..
+					else{//white space: tab space etc..
 						//if((it+1)==format.end()){//if last white space, we need to get rid of all white spaces after current pointer in file
 							result = true;
 							while (result) {
@@ -1529,42 +1763,9 @@ void SpecialFunctionHandler::handleFscanf(ExecutionState &state,
 						descriptor->decOffset();//Because we have already incremented, and now it is a skip, we need to avoid over reading...
 						stateProcessed.push_back(*s);
 					}
-					else{
-						ref<ConstantExpr> formatchar = ConstantExpr::create((uint64_t)*it,ConstantExpr::Int8);
-						bool success =	executor.solver->mustBeTrue(**s,EqExpr::create(formatchar,bufferchar),result);//Gladtbx: Must be true OR May be true, it is a question.
-						assert(success && "fscanf solver failure");
-						if(result){
-							//a match can be found so we move on...
-
-							stateProcessed.push_back(*s);
-						}
-						else{
-							klee_warning("Fscanf found string not able to match!!");
-							//return num of chars read.
-							LLVM_TYPE_Q llvm::Type *resultType = target->inst->getType();
-							if (!resultType->isVoidTy()) {
-								unsigned width = resultType->getPrimitiveSizeInBits();
-								ref<Expr> e;
-								if((*s)->getBytesRead() == 0)
-									e = ConstantExpr::alloc(EOF,width);
-								else
-									e = ConstantExpr::alloc((*s)->getBytesRead(),width);
-								executor.bindLocal(target, **s, e);
-							 }
-						}
-					}
 				}
-				if(*it == '%'){//if it is percent, we need it++
-					it++;
-					if(it == format.end()){
-						break;
-					}
-					if((*it == 'l' || *it == 'h' || *it == 'j' || *it == 'z' || *it == 't' || *it == 'L')){
-						it++;//FIXME:Only consider 1 bit width indicator.
-						if(it== format.end()){
-							break;
-						}
-					}
+				if(step->last){
+					break;
 				}
 				//now switch buffer.
 				stateNotProcessed.swap(stateProcessed);
@@ -1599,7 +1800,9 @@ void SpecialFunctionHandler::handleFprintf(ExecutionState &state,
         KInstruction *target,
         std::vector<ref<Expr> > &arguments){
 	assert(arguments.size()>1 && "Wrong number of arguments for fprintf");
-	std::string format = readStringAtAddress(state,arguments[1]);
+	const std::vector<PrintStep> &plan =
+		getFormatPlan(state, target, arguments[1], printPlans,
+		              &SpecialFunctionHandler::buildPrintPlan);
 	ref<ConstantExpr> value;
 	executor.solver->getValue(state,arguments[0],value);
 	int fileid = value.get()->getZExtValue();
@@ -1612,7 +1815,6 @@ void SpecialFunctionHandler::handleFprintf(ExecutionState &state,
 	ObjectPair op = descriptor->getBuffer();
 	const MemoryObject* mo = op.first;
 	int size = descriptor->getsize();
-	std::string::iterator it;
 	ref<ConstantExpr> bufferLocation = mo->getBaseExpr();
 	/*
 	 * First we resolve the content of the symbolic input.
@@ -1620,72 +1822,58 @@ void SpecialFunctionHandler::handleFprintf(ExecutionState &state,
 	 * We do not need to resolve the buffers that are read to as it is going to be written any way
 	 */
 	int byteswrite = 0;
-	for(it = format.begin();it!=format.end();it++){
-		if(*it != '%'){//not a variable
+	for(std::vector<PrintStep>::const_iterator step = plan.begin(); step != plan.end(); step++){
+		if(step->warning){
+			klee_warning("%s", step->warning);
+		}
+		if(step->kind == PrintStep::Literal){//not a variable
 			if(descriptor->getoffset()>=size){//too much to put into the target buffer
 				klee_error("Targetbuffer overflow, check Fprintf or allocate larger buffer");
 			}
-			ref<Expr> writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
-			ref<Expr> writtenChar = ConstantExpr::create(*it,ConstantExpr::Int8);
-			executor.executeMemoryOperation(state,true,writtenLoc,writtenChar,0);
-			descriptor->incOffset();
-			if(descriptor->getoffset()>=descriptor->getsize()){
+			if(descriptor->getoffset()+(int)step->text.size()>=descriptor->getsize()){
 				klee_error("Output buffer over flow!!");
 			}
-		}
-		else{
-			it++;
-			if(it == format.end()){
-				klee_warning("Missing indicator after \% sign in fprintf!");
-				ref<Expr> writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
-				ref<Expr> writtenChar = ConstantExpr::create('%',ConstantExpr::Int8);
-				executor.executeMemoryOperation(state,true,writtenLoc,writtenChar,0);
-				descriptor->incOffset();
-				if(descriptor->getoffset()>=descriptor->getsize()){
-					klee_error("Output buffer over flow!!");
+			//write the whole run straight into the buffer if we can
+			const ObjectState *os = state.addressSpace.findObject(mo);
+			if(os && !os->readOnly &&
+			   descriptor->getoffset()+step->text.size()<=mo->size){
+				ObjectState *wos = state.addressSpace.getWriteable(mo, os);
+				for(unsigned i = 0; i < step->text.size(); i++){
+					wos->write8(descriptor->getoffset(), (uint8_t) step->text[i]);
+					descriptor->incOffset();
 				}
 				continue;
 			}
-			if(*it == 'd' || *it == 'x' || *it == 'X' || *it == 'o'){//if 32 bit width
-				//check if argument is the correct width
-				ref<Expr> character = ZExtExpr::create(arguments[byteswrite+2],Expr::Int32);
+			for(unsigned i = 0; i < step->text.size(); i++){
 				ref<Expr> writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
-				executor.executeMemoryOperation(state,true,writtenLoc,character,0);
-				byteswrite++;
-				descriptor->incOffset();
-				descriptor->incOffset();
-				descriptor->incOffset();
+				ref<Expr> writtenChar = ConstantExpr::create(step->text[i],ConstantExpr::Int8);
+				executor.executeMemoryOperation(state,true,writtenLoc,writtenChar,0);
 				descriptor->incOffset();
-				if(descriptor->getoffset()>=descriptor->getsize()){
-					klee_error("Output buffer over flow!!");
-				}
 			}
-			else if(*it == 'c'){//if 8 bit width
-				//check if argument is the correct width
-				ref<Expr> character = ZExtExpr::create(arguments[byteswrite+2],Expr::Int8);
-				ref<Expr> writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
-				executor.executeMemoryOperation(state,true,writtenLoc,character,0);
-				byteswrite++;
-				descriptor->incOffset();
-				if(descriptor->getoffset()>=descriptor->getsize()){
-					klee_error("Output buffer over flow!!");
-				}
+		}
+		else if(step->kind == PrintStep::Int32){//if 32 bit width
+			//check if argument is the correct width
+			ref<Expr> character = ZExtExpr::create(arguments[byteswrite+2],Expr::Int32);
+			ref<Expr> writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
+			executor.executeMemoryOperation(state,true,writtenLoc,character,0);
+			byteswrite++;
+			descriptor->incOffset();
+			descriptor->incOffset();
+			descriptor->incOffset();
+			descriptor->incOffset();
+			if(descriptor->getoffset()>=descriptor->getsize()){
+				klee_error("Output buffer over flow!!");
 			}
-			else{
-				ref<Expr> writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
-				ref<Expr> writtenChar = ConstantExpr::create('%',ConstantExpr::Int8);
-				executor.executeMemoryOperation(state,true,writtenLoc,writtenChar,0);
-				descriptor->incOffset();
-				if(descriptor->getoffset()>=descriptor->getsize()){
-					klee_error("Output buffer over flow!!");
-				}
-				writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
-				writtenChar = ConstantExpr::create(*it,ConstantExpr::Int8);
-				executor.executeMemoryOperation(state,true,writtenLoc,writtenChar,0);
-				descriptor->incOffset();
-				if(descriptor->getoffset()>=descriptor->getsize()){
-					klee_error("Output buffer over flow!!");
-				}
+		}
+		else{//if 8 bit width
+			//check if argument is the correct width
+			ref<Expr> character = ZExtExpr::create(arguments[byteswrite+2],Expr::Int8);
+			ref<Expr> writtenLoc = AddExpr::create(bufferLocation,ConstantExpr::create(descriptor->getoffset(),bufferLocation->getWidth()));
+			executor.executeMemoryOperation(state,true,writtenLoc,character,0);
+			byteswrite++;
+			descriptor->incOffset();
+			if(descriptor->getoffset()>=descriptor->getsize()){
+				klee_error("Output buffer over flow!!");
 			}
 		}
 	}
@@ -1760,6 +1948,19 @@ void SpecialFunctionHandler::handleFread(ExecutionState &state,
 			int bytesRead = 0;
 			const ObjectState* os = op.second;
 			ref<Expr> buffer;
+			//bytes that all fit go to a concrete target in one copy
+			ObjectPair dst;
+			unsigned dstOffset;
+			if(size == 1 && count >= 0 &&
+			   descriptor->getoffset() + count <= desc_size &&
+			   descriptor->getoffset() + count <= (int) os->size &&
+			   resolveRange(state, targetBuf, count, dst, dstOffset) &&
+			   !dst.second->readOnly){
+				ObjectState *wos = state.addressSpace.getWriteable(dst.first, dst.second);
+				wos->copyRange(dstOffset, dst.first == op.first ? *wos : *os, descriptor->getoffset(), count);
+				descriptor->incOffset(count);
+				continue;
+			}
 			for(int i = 0; i < count; i++){
 				switch (size){
 				case 1:
@@ -1970,6 +2171,22 @@ void SpecialFunctionHandler::handleFwrite(ExecutionState &state,
 			ref<Expr> offset = opit->first.second;
 			ref<ConstantExpr> bufferLocation = descriptor->getBuffer().first->getBaseExpr();
 
+			//bytes that all fit go from a concrete offset in one copy
+			const MemoryObject *bmo = descriptor->getBuffer().first;
+			const ObjectState *src = opit->first.first.second;
+			const ObjectState *bos = opit->second->addressSpace.findObject(bmo);
+			ConstantExpr *coffset = dyn_cast<ConstantExpr>(offset);
+			if(coffset && count * size >= 0 && bos && !bos->readOnly &&
+			   descriptor->getoffset() + count * size <= desc_size &&
+			   descriptor->getoffset() + count * size <= (int) bos->size &&
+			   coffset->getZExtValue() + count * size <= src->size){
+				ObjectState *wos = opit->second->addressSpace.getWriteable(bmo, bos);
+				wos->copyRange(descriptor->getoffset(), src->getObject() == bmo ? *wos : *src,
+				               coffset->getZExtValue(), count * size);
+				descriptor->incOffset(count * size);
+				continue;
+			}
+
 
 			for(int i = 0; i < count * size; i++){
 				if(descriptor->getoffset() >= desc_size){//eof reached, number of bytes read returned;
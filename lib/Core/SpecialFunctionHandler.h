@@ -95,6 +95,84 @@ namespace klee {
     		const ObjectPair& op, std::vector<ExecutionState*> *stateProcessed,
     		KInstruction *target);
 
+    /// One step of a parsed scanf format: a run of literal characters
+    /// that must be matched, a white space character or a conversion.
+    struct ScanStep {
+      enum Kind { Literal, Space, Conversion };
+      Kind kind;
+      /// The characters of a literal run.
+      std::string text;
+      /// The conversion, with its length modifier if there is one.
+      char specifier[3];
+      /// Warning to report when the conversion is reached, or null.
+      const char *warning;
+      /// The conversion has no specifier, so it is skipped.
+      bool incomplete;
+      /// The scan stops after this step.
+      bool last;
+
+      ScanStep(Kind _kind)
+        : kind(_kind), warning(0), incomplete(false), last(false) {
+        specifier[0] = specifier[1] = specifier[2] = '\0';
+      }
+    };
+
+    /// One step of a parsed printf format: a run of literal characters or
+    /// a conversion.
+    struct PrintStep {
+      enum Kind { Literal, Int32, Char };
+      Kind kind;
+      /// The characters of a literal run.
+      std::string text;
+      /// Warning to report when the step is reached, or null.
+      const char *warning;
+
+      PrintStep(Kind _kind) : kind(_kind), warning(0) {}
+    };
+
+    /// The parsed format last seen at a call site. It stays valid while
+    /// the object holding the format keeps its version.
+    template<typename Step>
+    struct FormatPlan {
+      const MemoryObject *object;
+      uint64_t version;
+      std::vector<Step> steps;
+
+      FormatPlan() : object(0), version(0) {}
+    };
+
+    std::map<const KInstruction*, FormatPlan<ScanStep> > scanPlans;
+    std::map<const KInstruction*, FormatPlan<PrintStep> > printPlans;
+
+    /// Return the parsed format at the given address, reusing the plan of
+    /// the call site if the format has not been written since.
+    template<typename Step>
+    const std::vector<Step> &
+    getFormatPlan(ExecutionState &state, KInstruction *target,
+                  ref<Expr> address,
+                  std::map<const KInstruction*, FormatPlan<Step> > &plans,
+                  void (*build)(const std::string &, std::vector<Step> &));
+    static void buildScanPlan(const std::string &format,
+                              std::vector<ScanStep> &steps);
+    static void buildPrintPlan(const std::string &format,
+                               std::vector<PrintStep> &steps);
+    /// Match a literal run of a scanf format against the input, binding
+    /// the result of the call and returning false if it does not match.
+    bool matchScanLiteral(ExecutionState &state, const std::string &text,
+                          const int fileid, int size, const ObjectState *os,
+                          KInstruction *target);
+    void bindScanResult(ExecutionState &state, KInstruction *target);
+
+    enum BulkMemoryOp { Memcpy, Memmove, Memset };
+    /// The runtime's memcpy, memmove and memset, which handleBulkMemory
+    /// may run in one step.
+    std::map<const llvm::Function*, BulkMemoryOp> bulkMemoryOps;
+
+    /// Find the object holding the \a len bytes at \a address, which must
+    /// be concrete.
+    bool resolveRange(ExecutionState &state, ref<Expr> address, uint64_t len,
+                      ObjectPair &op, unsigned &offset);
+
   public:
     SpecialFunctionHandler(Executor &_executor);
 
@@ -113,6 +191,14 @@ namespace klee {
                 KInstruction *target,
                 std::vector< ref<Expr> > &arguments);
 
+    /// Copy or fill memory for a call to the runtime's memcpy, memmove or
+    /// memset with concrete arguments, instead of interpreting its loop.
+    /// Returns false if the call must run the function.
+    bool handleBulkMemory(ExecutionState &state,
+                          llvm::Function *f,
+                          KInstruction *target,
+                          std::vector< ref<Expr> > &arguments);
+
     /* Convenience routines */
 
     std::string readStringAtAddress(ExecutionState &state, ref<Expr> address);
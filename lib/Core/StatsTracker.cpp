@@ -52,9 +52,11 @@
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/CFG.h"
+#include "llvm/Support/InstIterator.h"
 #else
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/InstIterator.h"
 #endif
 
 #include <fstream>
@@ -81,6 +83,11 @@ namespace {
                cl::desc("Write instruction level statistics (in callgrind format)"),
                cl::init(true));
 
+  cl::opt<bool>
+  BinaryIStats("binary-istats",
+               cl::desc("Log instruction level statistics as binary deltas to run.istats.bin instead of rewriting run.istats, use klee-istats to convert (default=off)"),
+               cl::init(false));
+
   cl::opt<double>
   StatsWriteInterval("stats-write-interval",
                      cl::desc("Approximate number of seconds between stats writes (default: 1.0)"),
@@ -112,6 +119,12 @@ namespace {
 
 ///
 
+static uint64_t statsEpoch = 1;
+
+uint64_t klee::getStatsEpoch() {
+  return statsEpoch;
+}
+
 bool StatsTracker::useStatistics() {
   return OutputStats || OutputIStats;
 }
@@ -243,8 +256,11 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   }
 
   if (OutputIStats) {
-    istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
+    istatsFile = executor.interpreterHandler->openOutputFile(
+      BinaryIStats ? "run.istats.bin" : "run.istats");
     assert(istatsFile && "unable to open istats file");
+    if (BinaryIStats)
+      writeIStatsLayout();
 
     executor.addTimer(new WriteIStatsTimer(this), IStatsWriteInterval);
   }
@@ -294,14 +310,17 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     if (es.instsSinceCovNew)
       ++es.instsSinceCovNew;
 
-    if (sf.kf->trackCoverage && instructionIsCoverable(inst)) {
-      if (!theStatisticManager->getIndexedValue(stats::coveredInstructions, ii.id)) {
+    // An instruction already on the path of this state cannot be new
+    // globally, so the global check is only done on the first visit.
+    if (es.instructionCoverage.set(ii.id) &&
+        sf.kf->trackCoverage && instructionIsCoverable(inst)) {
+      if (globalCoverage.set(ii.id)) {
         // Checking for actual stoppoints avoids inconsistencies due
         // to line number propogation.
         //
         // FIXME: This trick no longer works, we should fix this in the line
         // number propogation.
-          es.coveredLines[&ii.file].insert(ii.line);
+        es.newCoverage.set(ii.id);
 	es.coveredNew = true;
         es.instsSinceCovNew = 1;
 	++stats::coveredInstructions;
@@ -311,6 +330,19 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
   }
 }
 
+void StatsTracker::markCovered(const std::vector<unsigned> &ids) {
+  unsigned index = theStatisticManager->getIndex();
+  for (std::vector<unsigned>::const_iterator it = ids.begin(),
+         ie = ids.end(); it != ie; ++it) {
+    if (globalCoverage.set(*it)) {
+      theStatisticManager->setIndex(*it);
+      ++stats::coveredInstructions;
+      stats::uncoveredInstructions += (uint64_t)-1;
+    }
+  }
+  theStatisticManager->setIndex(index);
+}
+
 ///
 
 /* Should be called _after_ the es->pushFrame() */
@@ -387,6 +419,9 @@ void StatsTracker::writeStatsHeader() {
              << "'CexCacheTime',"
              << "'ForkTime',"
              << "'ResolveTime',"
+             << "'SolverGiveUps',"
+             << "'SolverShortenedBudgets',"
+             << "'SolverTimeSaved',"
 #ifdef DEBUG
 	     << "'ArrayHashTime',"
 #endif
@@ -399,6 +434,10 @@ double StatsTracker::elapsed() {
 }
 
 void StatsTracker::writeStatsLine() {
+  // Instruction counts have moved on since the last line, invalidate
+  // weights computed from them.
+  ++statsEpoch;
+
   *statsFile << "(" << stats::instructions
              << "," << fullBranches
              << "," << partialBranches
@@ -421,6 +460,9 @@ void StatsTracker::writeStatsLine() {
              << "," << stats::cexCacheTime / 1000000.
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
+             << "," << stats::adaptiveTimeoutGiveUps
+             << "," << stats::adaptiveTimeoutShortened
+             << "," << stats::adaptiveTimeoutSavedTime / 1000000.
 #ifdef DEBUG
              << "," << stats::arrayHashTime / 1000000.
 #endif
@@ -439,9 +481,36 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
+/// Return the mask of the statistics written to the istats file.
+static uint64_t getIStatsMask() {
+  StatisticManager &sm = *theStatisticManager;
+  uint64_t istatsMask = 0;
+
+  // Max is 13, sadly
+  istatsMask |= 1<<sm.getStatisticID("Queries");
+  istatsMask |= 1<<sm.getStatisticID("QueriesValid");
+  istatsMask |= 1<<sm.getStatisticID("QueriesInvalid");
+  istatsMask |= 1<<sm.getStatisticID("QueryTime");
+  istatsMask |= 1<<sm.getStatisticID("ResolveTime");
+  istatsMask |= 1<<sm.getStatisticID("Instructions");
+  istatsMask |= 1<<sm.getStatisticID("InstructionTimes");
+  istatsMask |= 1<<sm.getStatisticID("InstructionRealTimes");
+  istatsMask |= 1<<sm.getStatisticID("Forks");
+  istatsMask |= 1<<sm.getStatisticID("CoveredInstructions");
+  istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
+  istatsMask |= 1<<sm.getStatisticID("States");
+  istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+
+  return istatsMask;
+}
+
 void StatsTracker::writeIStats() {
+  if (BinaryIStats) {
+    writeIStatsDelta();
+    return;
+  }
+
   Module *m = executor.kmodule->module;
-  uint64_t istatsMask = 0;
   llvm::raw_fd_ostream &of = *istatsFile;
   
   // We assume that we didn't move the file pointer
@@ -457,21 +526,7 @@ void StatsTracker::writeIStats() {
   
   StatisticManager &sm = *theStatisticManager;
   unsigned nStats = sm.getNumStatistics();
-
-  // Max is 13, sadly
-  istatsMask |= 1<<sm.getStatisticID("Queries");
-  istatsMask |= 1<<sm.getStatisticID("QueriesValid");
-  istatsMask |= 1<<sm.getStatisticID("QueriesInvalid");
-  istatsMask |= 1<<sm.getStatisticID("QueryTime");
-  istatsMask |= 1<<sm.getStatisticID("ResolveTime");
-  istatsMask |= 1<<sm.getStatisticID("Instructions");
-  istatsMask |= 1<<sm.getStatisticID("InstructionTimes");
-  istatsMask |= 1<<sm.getStatisticID("InstructionRealTimes");
-  istatsMask |= 1<<sm.getStatisticID("Forks");
-  istatsMask |= 1<<sm.getStatisticID("CoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("States");
-  istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+  uint64_t istatsMask = getIStatsMask();
 
   of << "positions: instr line\n";
 
@@ -527,7 +582,7 @@ void StatsTracker::writeIStats() {
             of << "fl=" << ii.file << "\n";
             sourceFile = ii.file;
           }
-          of << ii.assemblyLine << " ";
+          of << ii.getAssemblyLine() << " ";
           of << ii.line << " ";
           for (unsigned i=0; i<nStats; i++)
             if (istatsMask&(1<<i))
@@ -550,10 +605,10 @@ void StatsTracker::writeIStats() {
                   of << "cfl=" << fii.file << "\n";
                 of << "cfn=" << f->getName().str() << "\n";
                 of << "calls=" << csi.count << " ";
-                of << fii.assemblyLine << " ";
+                of << fii.getAssemblyLine() << " ";
                 of << fii.line << "\n";
 
-                of << ii.assemblyLine << " ";
+                of << ii.getAssemblyLine() << " ";
                 of << ii.line << " ";
                 for (unsigned i=0; i<nStats; i++) {
                   if (istatsMask&(1<<i)) {
@@ -873,4 +928,206 @@ void StatsTracker::computeReachableUncovered() {
       currentFrameMinDist = computeMinDistToUncovered(kii, currentFrameMinDist);
     }
   }
+
+  ++statsEpoch;
+}
+
+/* Binary istats.
+
+   run.istats.bin starts with the magic "KISTATS" and a version, followed
+   by tagged records. Integers are big endian, strings are a 32 bit
+   length followed by the characters. The layout of the module is written
+   once:
+
+     'h' pid cmd object numEvents (shortName name)*   header
+     's' sid string                                    source file name
+     'f' fid name fileSid assemblyLine line            function
+     'i' id fid fileSid assemblyLine line              instruction
+
+   after which each write appends a snapshot holding the values that
+   changed since the previous one:
+
+     'v' id event value                                statistic value
+     'c' callerId calleeFid count value*               call site summary
+     'e'                                               end of snapshot
+
+   Values are 64 bit, everything else is 32 bit. A snapshot without its
+   'e' record (e.g. if klee was killed while writing it) is ignored. */
+
+static const char IStatsMagic[] = "KISTATS";
+static const unsigned IStatsVersion = 1;
+
+static void writeUInt32(llvm::raw_ostream &os, uint32_t value) {
+  char data[4];
+  data[0] = value>>24;
+  data[1] = value>>16;
+  data[2] = value>> 8;
+  data[3] = value>> 0;
+  os.write(data, 4);
+}
+
+static void writeUInt64(llvm::raw_ostream &os, uint64_t value) {
+  writeUInt32(os, value>>32);
+  writeUInt32(os, value);
+}
+
+static void writeString(llvm::raw_ostream &os, const std::string &value) {
+  writeUInt32(os, value.size());
+  os << value;
+}
+
+static unsigned getIStatsFileID(llvm::raw_ostream &os,
+                                std::map<std::string, unsigned> &fileIDs,
+                                const std::string &file) {
+  std::map<std::string, unsigned>::iterator it = fileIDs.find(file);
+  if (it != fileIDs.end())
+    return it->second;
+
+  unsigned sid = fileIDs.size();
+  fileIDs.insert(std::make_pair(file, sid));
+  os << 's';
+  writeUInt32(os, sid);
+  writeString(os, file);
+  return sid;
+}
+
+void StatsTracker::writeIStatsLayout() {
+  Module *m = executor.kmodule->module;
+  const InstructionInfoTable &infos = *executor.kmodule->infos;
+  llvm::raw_fd_ostream &of = *istatsFile;
+  StatisticManager &sm = *theStatisticManager;
+  unsigned nStats = sm.getNumStatistics();
+  uint64_t istatsMask = getIStatsMask();
+
+  of << IStatsMagic;
+  writeUInt32(of, IStatsVersion);
+
+  unsigned numEvents = 0;
+  for (unsigned i=0; i<nStats; i++)
+    if (istatsMask & (1<<i))
+      ++numEvents;
+
+  of << 'h';
+  writeUInt32(of, getpid());
+  writeString(of, m->getModuleIdentifier());
+  writeString(of, objectFilename);
+  writeUInt32(of, numEvents);
+  for (unsigned i=0; i<nStats; i++) {
+    if (istatsMask & (1<<i)) {
+      Statistic &s = sm.getStatistic(i);
+      writeString(of, s.getShortName());
+      writeString(of, s.getName());
+    }
+  }
+
+  std::map<std::string, unsigned> fileIDs;
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
+       fnIt != fn_ie; ++fnIt) {
+    const InstructionInfo &fii = infos.getFunctionInfo(fnIt);
+    unsigned fileID = getIStatsFileID(of, fileIDs, fii.file);
+    unsigned fid = istatsFunctionIDs.size();
+    istatsFunctionIDs.insert(std::make_pair(fnIt, fid));
+
+    of << 'f';
+    writeUInt32(of, fid);
+    writeString(of, fnIt->getName().str());
+    writeUInt32(of, fileID);
+    writeUInt32(of, fii.getAssemblyLine());
+    writeUInt32(of, fii.line);
+
+    for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
+         ++it) {
+      const InstructionInfo &ii = infos.getInfo(&*it);
+      unsigned instFileID = getIStatsFileID(of, fileIDs, ii.file);
+      of << 'i';
+      writeUInt32(of, ii.id);
+      writeUInt32(of, fid);
+      writeUInt32(of, instFileID);
+      writeUInt32(of, ii.getAssemblyLine());
+      writeUInt32(of, ii.line);
+    }
+  }
+
+  // Statistics start at zero, so only non-zero values are in the first
+  // snapshot.
+  istatsValues.assign(infos.getMaxID() * numEvents, 0);
+
+  of.flush();
+}
+
+void StatsTracker::writeIStatsDelta() {
+  llvm::raw_fd_ostream &of = *istatsFile;
+  StatisticManager &sm = *theStatisticManager;
+  unsigned nStats = sm.getNumStatistics();
+  uint64_t istatsMask = getIStatsMask();
+
+  std::vector<Statistic*> events;
+  for (unsigned i=0; i<nStats; i++)
+    if (istatsMask & (1<<i))
+      events.push_back(&sm.getStatistic(i));
+  unsigned numEvents = events.size();
+
+  // set state counts, decremented after we process so that we don't
+  // have to zero all records each time.
+  if (istatsMask & (1<<stats::states.getID()))
+    updateStateStatistics(1);
+
+  for (unsigned id=0, e=istatsValues.size() / numEvents; id != e; ++id) {
+    for (unsigned i=0; i<numEvents; ++i) {
+      uint64_t value = sm.getIndexedValue(*events[i], id);
+      uint64_t &last = istatsValues[id * numEvents + i];
+      if (value != last) {
+        of << 'v';
+        writeUInt32(of, id);
+        writeUInt32(of, i);
+        writeUInt64(of, value);
+        last = value;
+      }
+    }
+  }
+
+  if (istatsMask & (1<<stats::states.getID()))
+    updateStateStatistics((uint64_t)-1);
+
+  if (UseCallPaths) {
+    CallSiteSummaryTable callSiteStats;
+    callPathManager.getSummaryStatistics(callSiteStats);
+
+    std::vector<uint64_t> values(numEvents + 1);
+    for (CallSiteSummaryTable::iterator it = callSiteStats.begin(),
+           ie = callSiteStats.end(); it != ie; ++it) {
+      Instruction *instr = it->first;
+      for (std::map<llvm::Function*, CallSiteInfo>::iterator
+             fit = it->second.begin(), fie = it->second.end(); 
+           fit != fie; ++fit) {
+        Function *f = fit->first;
+        CallSiteInfo &csi = fit->second;
+
+        values[0] = csi.count;
+        for (unsigned i=0; i<numEvents; ++i) {
+          // Hack, ignore things that don't make sense on call paths.
+          if (events[i] == &stats::uncoveredInstructions) {
+            values[i + 1] = 0;
+          } else {
+            values[i + 1] = csi.statistics.getValue(*events[i]);
+          }
+        }
+
+        std::vector<uint64_t> &last =
+          istatsCallSites[std::make_pair(instr, f)];
+        if (last == values)
+          continue;
+        last = values;
+
+        of << 'c';
+        writeUInt32(of, executor.kmodule->infos->getInfo(instr).id);
+        writeUInt32(of, istatsFunctionIDs[f]);
+        for (unsigned i=0; i<=numEvents; ++i)
+          writeUInt64(of, values[i]);
+      }
+    }
+  }
+
+  of << 'e';
+  of.flush();
 }
@@ -12,7 +12,11 @@
 
 #include "CallPathManager.h"
 
+#include "klee/Internal/ADT/CoverageBitmap.h"
+
+#include <map>
 #include <set>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -37,6 +41,14 @@ namespace klee {
     std::string objectFilename;
 
     llvm::raw_fd_ostream *statsFile, *istatsFile;
+
+    /// With --binary-istats, the statistic values and call site
+    /// summaries as last written to istatsFile, so that only changes
+    /// need to be logged.
+    std::vector<uint64_t> istatsValues;
+    std::map<std::pair<llvm::Instruction*, llvm::Function*>,
+             std::vector<uint64_t> > istatsCallSites;
+    std::map<const llvm::Function*, unsigned> istatsFunctionIDs;
     double startWallTime;
     
     unsigned numBranches;
@@ -44,6 +56,10 @@ namespace klee {
 
     CallPathManager callPathManager;    
 
+    /// Union of the coverage of all states, only contains coverable
+    /// instructions in functions which track coverage.
+    CoverageBitmap globalCoverage;
+
     bool updateMinDistToUncovered;
 
   public:
@@ -54,6 +70,8 @@ namespace klee {
     void writeStatsHeader();
     void writeStatsLine();
     void writeIStats();
+    void writeIStatsLayout();
+    void writeIStatsDelta();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -79,6 +97,12 @@ namespace klee {
     // about to be stepped
     void stepInstruction(ExecutionState &es);
 
+    const CoverageBitmap &getGlobalCoverage() const { return globalCoverage; }
+
+    /// Mark the instructions with the given ids, which were covered in
+    /// another process (see Executor::runSeedWorkers()), as covered.
+    void markCovered(const std::vector<unsigned> &ids);
+
     /// Return time in seconds since execution start.
     double elapsed();
 
@@ -88,6 +112,12 @@ namespace klee {
   uint64_t computeMinDistToUncovered(const KInstruction *ki,
                                      uint64_t minDistAtRA);
 
+  /// Return the current statistics epoch. The epoch starts at 1 and is
+  /// advanced whenever the tracker refreshes the statistics searchers
+  /// derive their weights from, so values cached from them can be
+  /// tagged with the epoch and recomputed once it changes.
+  uint64_t getStatsEpoch();
+
 }
 
 #endif
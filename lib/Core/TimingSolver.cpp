@@ -17,11 +17,67 @@
 
 #include "CoreStats.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/TimeValue.h"
 
+#include <algorithm>
+
 using namespace klee;
 using namespace llvm;
 
+namespace {
+  cl::opt<bool>
+  UseRangeFastPath("use-range-fast-path",
+                   cl::desc("Decide branch conditions over symbolic bytes with "
+                            "known ranges without calling the solver "
+                            "(default=on)"),
+                   cl::init(true));
+
+  cl::opt<unsigned>
+  RecentQueriesSize("recent-queries-size",
+                    cl::desc("Number of recent queries whose answers are "
+                             "reused by states asking them again, 0 to "
+                             "disable (default=256)"),
+                    cl::init(256));
+}
+
+/***/
+
+unsigned TimingSolver::hashQuery(const ExecutionState &state, ref<Expr> expr) {
+  return (state.constraints.hash() * Expr::MAGIC_HASH_CONSTANT) ^ expr->hash();
+}
+
+TimingSolver::RecentQuery *
+TimingSolver::lookupRecent(const ExecutionState &state, ref<Expr> expr,
+                           unsigned hash) {
+  std::map<unsigned, std::vector<RecentQuery> >::iterator it =
+    recentQueries.find(hash);
+  if (it == recentQueries.end())
+    return 0;
+  for (std::vector<RecentQuery>::iterator qi = it->second.begin(),
+         qe = it->second.end(); qi != qe; ++qi)
+    if (qi->expr == expr && qi->generation == state.constraints.generation())
+      return &*qi;
+  return 0;
+}
+
+TimingSolver::RecentQuery &
+TimingSolver::insertRecent(const ExecutionState &state, ref<Expr> expr,
+                           unsigned hash) {
+  if (RecentQuery *rq = lookupRecent(state, expr, hash))
+    return *rq;
+  // Start over rather than track the age of entries, the queries worth
+  // remembering are issued close together.
+  if (numRecentQueries >= RecentQueriesSize) {
+    recentQueries.clear();
+    numRecentQueries = 0;
+  }
+  ++numRecentQueries;
+  std::vector<RecentQuery> &bucket = recentQueries[hash];
+  bucket.push_back(RecentQuery(state.constraints.generation(), expr));
+  return bucket.back();
+}
+
 /***/
 
 bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
@@ -32,18 +88,49 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
     return true;
   }
 
+  bool value;
+  if (UseRangeFastPath && state.byteRanges.evaluate(expr, value)) {
+    ++stats::rangeFastPathHits;
+    result = value ? Solver::True : Solver::False;
+    return true;
+  }
+
+  unsigned hash = 0;
+  if (RecentQueriesSize) {
+    hash = hashQuery(state, expr);
+    if (RecentQuery *rq = lookupRecent(state, expr, hash)) {
+      if (rq->hasValidity) {
+        ++stats::recentQueryHits;
+        result = rq->validity;
+        return true;
+      }
+      if (rq->hasTruth && rq->truth) {
+        ++stats::recentQueryHits;
+        result = Solver::True;
+        return true;
+      }
+    }
+  }
+
   sys::TimeValue now = util::getWallTimeVal();
 
+  ref<Expr> query = expr;
   if (simplifyExprs)
-    expr = state.constraints.simplifyExpr(expr);
+    query = state.constraints.simplifyExpr(query);
 
-  bool success = solver->evaluate(Query(state.constraints, expr), result);
+  bool success = solver->evaluate(Query(state.constraints, query), result);
 
   sys::TimeValue delta = util::getWallTimeVal();
   delta -= now;
   stats::solverTime += delta.usec();
   state.queryCost += delta.usec()/1000000.;
 
+  if (success && RecentQueriesSize) {
+    RecentQuery &rq = insertRecent(state, expr, hash);
+    rq.hasValidity = true;
+    rq.validity = result;
+  }
+
   return success;
 }
 
@@ -55,18 +142,44 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
     return true;
   }
 
+  bool value;
+  if (UseRangeFastPath && state.byteRanges.evaluate(expr, value)) {
+    ++stats::rangeFastPathHits;
+    result = value;
+    return true;
+  }
+
+  unsigned hash = 0;
+  if (RecentQueriesSize) {
+    hash = hashQuery(state, expr);
+    if (RecentQuery *rq = lookupRecent(state, expr, hash)) {
+      if (rq->hasValidity || rq->hasTruth) {
+        ++stats::recentQueryHits;
+        result = rq->hasValidity ? rq->validity == Solver::True : rq->truth;
+        return true;
+      }
+    }
+  }
+
   sys::TimeValue now = util::getWallTimeVal();
 
+  ref<Expr> query = expr;
   if (simplifyExprs)
-    expr = state.constraints.simplifyExpr(expr);
+    query = state.constraints.simplifyExpr(query);
 
-  bool success = solver->mustBeTrue(Query(state.constraints, expr), result);
+  bool success = solver->mustBeTrue(Query(state.constraints, query), result);
 
   sys::TimeValue delta = util::getWallTimeVal();
   delta -= now;
   stats::solverTime += delta.usec();
   state.queryCost += delta.usec()/1000000.;
 
+  if (success && RecentQueriesSize) {
+    RecentQuery &rq = insertRecent(state, expr, hash);
+    rq.hasTruth = true;
+    rq.truth = result;
+  }
+
   return success;
 }
 
@@ -93,6 +206,77 @@ bool TimingSolver::mayBeFalse(const ExecutionState& state, ref<Expr> expr,
   return true;
 }
 
+namespace {
+  /// Orders batched queries by the constraints of their states, then by
+  /// their expressions, so that identical queries end up next to each
+  /// other and queries sharing a prefix of constraints close together.
+  struct BatchOrder {
+    const std::vector<const ExecutionState*> &states;
+    const std::vector< ref<Expr> > &exprs;
+
+    BatchOrder(const std::vector<const ExecutionState*> &_states,
+               const std::vector< ref<Expr> > &_exprs)
+      : states(_states), exprs(_exprs) {}
+
+    static bool lessPtr(const ref<Expr> &a, const ref<Expr> &b) {
+      return a.get() < b.get();
+    }
+
+    bool operator()(unsigned a, unsigned b) const {
+      const ConstraintManager &ca = states[a]->constraints;
+      const ConstraintManager &cb = states[b]->constraints;
+      // Constraints are shared between states forked from each other, so
+      // comparing them by address is enough to group common prefixes.
+      if (std::lexicographical_compare(ca.begin(), ca.end(),
+                                       cb.begin(), cb.end(), lessPtr))
+        return true;
+      if (std::lexicographical_compare(cb.begin(), cb.end(),
+                                       ca.begin(), ca.end(), lessPtr))
+        return false;
+      return exprs[a].get() < exprs[b].get();
+    }
+  };
+}
+
+bool TimingSolver::mayBeTrue(const std::vector<const ExecutionState*> &states,
+                             const std::vector< ref<Expr> > &exprs,
+                             std::vector<bool> &results) {
+  assert(states.size() == exprs.size() && "invalid batch");
+  unsigned N = exprs.size();
+  results.assign(N, false);
+
+  std::vector<unsigned> order(N);
+  bool oneState = true;
+  for (unsigned i = 0; i != N; ++i) {
+    order[i] = i;
+    oneState &= states[i] == states[0];
+  }
+  // The queries of a single state (e.g. the cases of a switch) share all
+  // their constraints already, repeated ones are caught by the table of
+  // recent queries.
+  if (!oneState)
+    std::sort(order.begin(), order.end(), BatchOrder(states, exprs));
+
+  for (unsigned i = 0; i != N; ++i) {
+    unsigned index = order[i];
+    if (i) {
+      unsigned prev = order[i - 1];
+      if (exprs[prev] == exprs[index] &&
+          states[prev]->constraints == states[index]->constraints) {
+        ++stats::recentQueryHits;
+        results[index] = results[prev];
+        continue;
+      }
+    }
+
+    bool res;
+    if (!mayBeTrue(*states[index], exprs[index], res))
+      return false;
+    results[index] = res;
+  }
+  return true;
+}
+
 bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr, 
                             ref<ConstantExpr> &result) {
   // Fast path, to avoid timer and OS overhead.
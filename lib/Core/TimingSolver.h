@@ -10,9 +10,11 @@
 #ifndef KLEE_TIMINGSOLVER_H
 #define KLEE_TIMINGSOLVER_H
 
+#include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 
+#include <map>
 #include <vector>
 
 namespace klee {
@@ -21,11 +23,44 @@ namespace klee {
 
   /// TimingSolver - A simple class which wraps a solver and handles
   /// tracking the statistics that we care about.
+  ///
+  /// The answers to recent validity queries are remembered, so that states
+  /// with the same constraints asking the same question in quick succession
+  /// (e.g. siblings stepped in turn by the searcher) reach the solver once.
   class TimingSolver {
   public:
     Solver *solver;
     bool simplifyExprs;
 
+  private:
+    /// RecentQuery - What is known about a recently issued query. Only the
+    /// generation of the constraints is kept: holding on to the constraints
+    /// would make both children of a fork copy them when they next add one.
+    struct RecentQuery {
+      uint64_t generation;
+      ref<Expr> expr;
+      bool hasValidity;
+      Solver::Validity validity;
+      /// Whether the expression is known to be (or not to be) valid, when
+      /// only mustBeTrue was asked.
+      bool hasTruth;
+      bool truth;
+
+      RecentQuery(uint64_t _generation, ref<Expr> _expr)
+        : generation(_generation), expr(_expr),
+          hasValidity(false), validity(Solver::Unknown),
+          hasTruth(false), truth(false) {}
+    };
+
+    /// Recent queries, bucketed by the hash of their constraints and
+    /// expression.
+    std::map<unsigned, std::vector<RecentQuery> > recentQueries;
+    unsigned numRecentQueries;
+
+    static unsigned hashQuery(const ExecutionState&, ref<Expr>);
+    RecentQuery *lookupRecent(const ExecutionState&, ref<Expr>, unsigned hash);
+    RecentQuery &insertRecent(const ExecutionState&, ref<Expr>, unsigned hash);
+
   public:
     /// TimingSolver - Construct a new timing solver.
     ///
@@ -33,7 +68,7 @@ namespace klee {
     /// simplified (via the constraint manager interface) prior to
     /// querying.
     TimingSolver(Solver *_solver, bool _simplifyExprs = true) 
-      : solver(_solver), simplifyExprs(_simplifyExprs) {}
+      : solver(_solver), simplifyExprs(_simplifyExprs), numRecentQueries(0) {}
     ~TimingSolver() {
       delete solver;
     }
@@ -56,6 +91,15 @@ namespace klee {
 
     bool mayBeFalse(const ExecutionState&, ref<Expr>, bool &result);
 
+    /// mayBeTrue - Answer a batch of mayBeTrue queries, the i-th issued in
+    /// the i-th state. Identical queries are issued once. Queries from
+    /// several states are ordered by their constraints, so that queries
+    /// sharing a prefix of constraints reach an incremental solver one after
+    /// another.
+    bool mayBeTrue(const std::vector<const ExecutionState*> &states,
+                   const std::vector< ref<Expr> > &exprs,
+                   std::vector<bool> &results);
+
     bool getValue(const ExecutionState &, ref<Expr> expr, 
                   ref<ConstantExpr> &result);
 
@@ -63,6 +63,21 @@ namespace {
   UseBumpMerge("use-bump-merge", 
            cl::desc("Enable support for klee_merge() (extra experimental)"));
 
+  cl::opt<bool>
+  UseDynamicMerge("use-dynamic-merge",
+                  cl::desc("Merge states where the paths of a branch join again, when it is not expected to make later queries harder (default=off)"),
+                  cl::init(false));
+
+  cl::opt<unsigned>
+  DynamicMergeWindow("dynamic-merge-window",
+                     cl::desc("Number of state selections a state waits at a join for others to merge with when using --use-dynamic-merge (default=1000)"),
+                     cl::init(1000));
+
+  cl::opt<double>
+  DynamicMergeRatio("dynamic-merge-ratio",
+                    cl::desc("States are not merged if they differ in a register that more than this fraction of the later queries depend on, when using --use-dynamic-merge (default=0.1)"),
+                    cl::init(0.1));
+
 }
 
 
@@ -74,6 +89,9 @@ bool klee::userSearcherRequiresMD2U() {
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end());
 }
 
+bool klee::userSearcherRequiresMergePoints() {
+  return UseDynamicMerge;
+}
 
 Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   Searcher *searcher = NULL;
@@ -125,6 +143,16 @@ Searcher *klee::constructUserSearcher(Executor &executor) {
     searcher = new MergingSearcher(executor, searcher);
   } else if (UseBumpMerge) {
     searcher = new BumpMergingSearcher(executor, searcher);
+  } else if (UseDynamicMerge) {
+    // Random path selection walks the process tree, so it would keep
+    // picking the states held at joins.
+    if (std::find(CoreSearch.begin(), CoreSearch.end(),
+                  Searcher::RandomPath) != CoreSearch.end())
+      klee_error("--use-dynamic-merge cannot be used with random-path search, "
+                 "pass --search");
+    searcher = new DynamicMergingSearcher(executor, searcher,
+                                          DynamicMergeWindow,
+                                          DynamicMergeRatio);
   }
   
   if (UseIterativeDeepeningTimeSearch) {
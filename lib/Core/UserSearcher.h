@@ -17,6 +17,9 @@ namespace klee {
   // XXX gross, should be on demand?
   bool userSearcherRequiresMD2U();
 
+  /// The searcher merges states at the merge points of the module.
+  bool userSearcherRequiresMergePoints();
+
   Searcher *constructUserSearcher(Executor &executor);
 }
 
@@ -0,0 +1,640 @@
+//===-- ByteRanges.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ByteRanges.h"
+
+#include "klee/util/Bits.h"
+#include "klee/Internal/Support/IntEvaluation.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+namespace {
+
+/// Bounds and known bits of a value of at most 64 bits.
+struct ValueBits {
+  unsigned width;
+  uint64_t min, max, zeros, ones;
+
+  ValueBits(unsigned _width, uint64_t _min, uint64_t _max,
+            uint64_t _zeros = 0, uint64_t _ones = 0)
+    : width(_width), min(_min), max(_max), zeros(_zeros), ones(_ones) {
+    normalize();
+  }
+
+  static ValueBits top(unsigned width) {
+    return ValueBits(width, 0, bits64::maxValueOfNBits(width));
+  }
+  static ValueBits exact(unsigned width, uint64_t value) {
+    return ValueBits(width, value, value);
+  }
+  static ValueBits fromBits(unsigned width, uint64_t zeros, uint64_t ones) {
+    return ValueBits(width, 0, bits64::maxValueOfNBits(width), zeros, ones);
+  }
+
+  uint64_t mask() const { return bits64::maxValueOfNBits(width); }
+  bool isFixed() const { return min == max; }
+  bool isEmpty() const { return min > max || (zeros & ones); }
+
+  /// Make the bounds and the known bits agree with each other as far as is
+  /// cheap: bits above the highest bit in which the bounds differ are
+  /// known, and known bits bound the value.
+  void normalize() {
+    uint64_t m = mask();
+    zeros &= m;
+    ones &= m;
+    max = std::min(max, m);
+    if (min > max)
+      return;
+
+    uint64_t diff = min ^ max;
+    for (unsigned shift = 1; shift < 64; shift <<= 1)
+      diff |= diff >> shift;
+    ones |= min & ~diff & m;
+    zeros |= ~min & ~diff & m;
+
+    min = std::max(min, ones);
+    max = std::min(max, m & ~zeros);
+  }
+
+  ValueBits join(const ValueBits &b) const {
+    return ValueBits(width, std::min(min, b.min), std::max(max, b.max),
+                     zeros & b.zeros, ones & b.ones);
+  }
+
+  int64_t signedMin() const {
+    uint64_t sign = 1ULL << (width - 1);
+    if (zeros & sign)
+      return min;
+    if (ones & sign)
+      return ints::sext(min, 64, width);
+    return ints::sext(sign, 64, width);
+  }
+  int64_t signedMax() const {
+    uint64_t sign = 1ULL << (width - 1);
+    if (zeros & sign)
+      return max;
+    if (ones & sign)
+      return ints::sext(max, 64, width);
+    return sign - 1;
+  }
+};
+
+/// Evaluates expressions to ValueBits under the byte ranges, giving up on
+/// expressions which are too large to be worth it.
+class RangeEvaluator {
+  const ByteRanges &ranges;
+  unsigned budget;
+
+  ValueBits evalRead(const ReadExpr *re);
+  ValueBits evalActual(const ref<Expr> &e);
+
+public:
+  RangeEvaluator(const ByteRanges &_ranges)
+    : ranges(_ranges), budget(256) {}
+
+  ValueBits eval(const ref<Expr> &e) {
+    if (e->getWidth() > 64 || !budget)
+      return ValueBits::top(std::min(e->getWidth(), 64U));
+    --budget;
+    ValueBits res = evalActual(e);
+    if (res.isEmpty())
+      return ValueBits::top(res.width);
+    return res;
+  }
+};
+
+}
+
+static ValueBits boolValue(bool b) {
+  return ValueBits::exact(Expr::Bool, b);
+}
+
+/// Return the value of the byte which a read at a constant index sees, or
+/// the initial byte of the array, looking through writes to other constant
+/// indices.
+static bool findInitialByte(const ReadExpr *re, const Array *&array,
+                            unsigned &index, ref<Expr> &written) {
+  const ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index);
+  if (!CE || re->getWidth() != Expr::Int8)
+    return false;
+  uint64_t idx = CE->getZExtValue();
+
+  for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+    const ConstantExpr *UI = dyn_cast<ConstantExpr>(un->index);
+    if (!UI)
+      return false;
+    if (UI->getZExtValue() == idx) {
+      written = un->value;
+      return true;
+    }
+  }
+
+  if (idx >= re->updates.root->size)
+    return false;
+  array = re->updates.root;
+  index = idx;
+  return true;
+}
+
+ValueBits RangeEvaluator::evalRead(const ReadExpr *re) {
+  const Array *array = 0;
+  unsigned index = 0;
+  ref<Expr> written;
+  if (!findInitialByte(re, array, index, written))
+    return ValueBits::top(re->getWidth());
+  if (!written.isNull())
+    return eval(written);
+  if (array->isConstantArray())
+    return ValueBits::exact(8, array->constantValues[index]->getZExtValue(8));
+
+  ByteRanges::Byte b = ranges.getByte(array, index);
+  return ValueBits(8, b.min, b.max, b.zeros, b.ones);
+}
+
+ValueBits RangeEvaluator::evalActual(const ref<Expr> &e) {
+  unsigned width = e->getWidth();
+
+  switch (e->getKind()) {
+  case Expr::Constant:
+    return ValueBits::exact(width, cast<ConstantExpr>(e)->getZExtValue());
+
+  case Expr::NotOptimized:
+    return eval(cast<NotOptimizedExpr>(e)->src);
+
+  case Expr::Read:
+    return evalRead(cast<ReadExpr>(e));
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    ValueBits cond = eval(se->cond);
+    if (cond.isFixed())
+      return eval(cond.min ? se->trueExpr : se->falseExpr);
+    return eval(se->trueExpr).join(eval(se->falseExpr));
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    ValueBits l = eval(ce->getLeft()), r = eval(ce->getRight());
+    unsigned shift = r.width;
+    return ValueBits(width, (l.min << shift) | r.min, (l.max << shift) | r.max,
+                     (l.zeros << shift) | r.zeros, (l.ones << shift) | r.ones);
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->expr->getWidth() > 64)
+      return ValueBits::top(width);
+    ValueBits src = eval(ee->expr);
+    unsigned offset = ee->offset;
+    uint64_t m = bits64::maxValueOfNBits(width);
+    uint64_t zeros = (src.zeros >> offset) & m, ones = (src.ones >> offset) & m;
+    // Taking the top bits is monotone.
+    if ((src.max >> offset) <= m)
+      return ValueBits(width, src.min >> offset, src.max >> offset,
+                       zeros, ones);
+    return ValueBits::fromBits(width, zeros, ones);
+  }
+
+  case Expr::ZExt: {
+    ValueBits src = eval(cast<CastExpr>(e)->src);
+    uint64_t high = bits64::maxValueOfNBits(width) & ~src.mask();
+    return ValueBits(width, src.min, src.max, src.zeros | high, src.ones);
+  }
+
+  case Expr::SExt: {
+    ValueBits src = eval(cast<CastExpr>(e)->src);
+    uint64_t sign = 1ULL << (src.width - 1);
+    uint64_t high = bits64::maxValueOfNBits(width) & ~src.mask();
+    if (src.zeros & sign)
+      return ValueBits(width, src.min, src.max, src.zeros | high, src.ones);
+    if (src.ones & sign)
+      return ValueBits(width, src.min | high, src.max | high, src.zeros,
+                       src.ones | high);
+    return ValueBits::top(width);
+  }
+
+  case Expr::Add: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    uint64_t m = l.mask();
+    if (l.max <= m - r.max)
+      return ValueBits(width, l.min + r.min, l.max + r.max);
+    // Otherwise both sums wrap, or the result may be anything.
+    if (width < 64 && l.min + r.min > m)
+      return ValueBits(width, l.min + r.min - m - 1, l.max + r.max - m - 1);
+    return ValueBits::top(width);
+  }
+
+  case Expr::Sub: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    if (l.min >= r.max)
+      return ValueBits(width, l.min - r.max, l.max - r.min);
+    if (l.max < r.min) {
+      uint64_t m = l.mask();
+      return ValueBits(width, m - (r.max - l.min) + 1, m - (r.min - l.max) + 1);
+    }
+    return ValueBits::top(width);
+  }
+
+  case Expr::And: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    return ValueBits(width, 0, std::min(l.max, r.max),
+                     l.zeros | r.zeros, l.ones & r.ones);
+  }
+
+  case Expr::Or: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    return ValueBits(width, std::max(l.min, r.min), l.mask(),
+                     l.zeros & r.zeros, l.ones | r.ones);
+  }
+
+  case Expr::Xor: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    return ValueBits::fromBits(width,
+                               (l.zeros & r.zeros) | (l.ones & r.ones),
+                               (l.zeros & r.ones) | (l.ones & r.zeros));
+  }
+
+  case Expr::Not: {
+    ValueBits src = eval(cast<NotExpr>(e)->expr);
+    uint64_t m = src.mask();
+    return ValueBits(width, m - src.max, m - src.min, src.ones, src.zeros);
+  }
+
+  case Expr::Shl:
+  case Expr::LShr: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->right);
+    if (!CE || CE->getZExtValue() >= width)
+      return ValueBits::top(width);
+    unsigned shift = CE->getZExtValue();
+    ValueBits l = eval(be->left);
+    uint64_t m = l.mask();
+    if (e->getKind() == Expr::LShr)
+      return ValueBits(width, l.min >> shift, l.max >> shift,
+                       (l.zeros >> shift) | (m & ~(m >> shift)),
+                       l.ones >> shift);
+    uint64_t low = bits64::maxValueOfNBits(shift);
+    if (l.max <= (m >> shift))
+      return ValueBits(width, l.min << shift, l.max << shift,
+                       (l.zeros << shift) | low, l.ones << shift);
+    return ValueBits::fromBits(width, (l.zeros << shift) | low,
+                               l.ones << shift);
+  }
+
+  case Expr::Eq: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    if (l.isFixed() && r.isFixed() && l.min == r.min)
+      return boolValue(true);
+    if (l.max < r.min || r.max < l.min ||
+        (l.ones & r.zeros) || (l.zeros & r.ones))
+      return boolValue(false);
+    return ValueBits::top(Expr::Bool);
+  }
+
+  case Expr::Ult:
+  case Expr::Ule: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    bool strict = e->getKind() == Expr::Ult;
+    if (strict ? l.max < r.min : l.max <= r.min)
+      return boolValue(true);
+    if (strict ? l.min >= r.max : l.min > r.max)
+      return boolValue(false);
+    return ValueBits::top(Expr::Bool);
+  }
+
+  case Expr::Slt:
+  case Expr::Sle: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ValueBits l = eval(be->left), r = eval(be->right);
+    bool strict = e->getKind() == Expr::Slt;
+    int64_t lmin = l.signedMin(), lmax = l.signedMax();
+    int64_t rmin = r.signedMin(), rmax = r.signedMax();
+    if (strict ? lmax < rmin : lmax <= rmin)
+      return boolValue(true);
+    if (strict ? lmin >= rmax : lmin > rmax)
+      return boolValue(false);
+    return ValueBits::top(Expr::Bool);
+  }
+
+  default:
+    return ValueBits::top(width);
+  }
+}
+
+/***/
+
+ByteRanges::Byte ByteRanges::getByte(const Array *array,
+                                     unsigned index) const {
+  const bytes_ty::value_type *entry = bytes.lookup(key_ty(array, index));
+  return entry ? entry->second : Byte();
+}
+
+void ByteRanges::setByte(const Array *array, unsigned index, Byte b) {
+  Byte old = getByte(array, index);
+  ValueBits v(8, std::max(b.min, old.min), std::min(b.max, old.max),
+              b.zeros | old.zeros, b.ones | old.ones);
+  if (v.isEmpty())
+    return;
+
+  // Move the bounds to values which agree with the known bits.
+  while (v.min < v.max && ((v.min & v.zeros) || (~v.min & v.ones)))
+    ++v.min;
+  while (v.max > v.min && ((v.max & v.zeros) || (~v.max & v.ones)))
+    --v.max;
+  v.normalize();
+  if (v.isEmpty())
+    return;
+
+  Byte res;
+  res.min = v.min;
+  res.max = v.max;
+  res.zeros = v.zeros;
+  res.ones = v.ones;
+  if (res.min == old.min && res.max == old.max &&
+      res.zeros == old.zeros && res.ones == old.ones)
+    return;
+  bytes = bytes.replace(std::make_pair(key_ty(array, index), res));
+}
+
+/// Narrow the bytes an expression is built from so that it lies in
+/// [min, max], following only operations which can be inverted exactly.
+void ByteRanges::restrict(const ref<Expr> &e, uint64_t min, uint64_t max) {
+  unsigned width = e->getWidth();
+  if (width > 64)
+    return;
+  uint64_t m = bits64::maxValueOfNBits(width);
+  max = std::min(max, m);
+  if (min > max)
+    return;
+
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    restrict(cast<NotOptimizedExpr>(e)->src, min, max);
+    break;
+
+  case Expr::Read: {
+    const Array *array = 0;
+    unsigned index = 0;
+    ref<Expr> written;
+    if (!findInitialByte(cast<ReadExpr>(e), array, index, written))
+      break;
+    if (!written.isNull()) {
+      restrict(written, min, max);
+    } else if (array->isSymbolicArray()) {
+      Byte b;
+      b.min = min;
+      b.max = max;
+      setByte(array, index, b);
+    }
+    break;
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    unsigned shift = ce->getRight()->getWidth();
+    restrict(ce->getLeft(), min >> shift, max >> shift);
+    if ((min >> shift) == (max >> shift)) {
+      uint64_t low = bits64::maxValueOfNBits(shift);
+      restrict(ce->getRight(), min & low, max & low);
+    }
+    break;
+  }
+
+  case Expr::ZExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    restrict(ce->src, min, max);
+    break;
+  }
+
+  case Expr::SExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    unsigned srcWidth = ce->src->getWidth();
+    uint64_t positive = bits64::maxValueOfNBits(srcWidth - 1);
+    if (max <= positive)
+      restrict(ce->src, min, max);
+    else if (min >= m - positive)
+      restrict(ce->src, min & bits64::maxValueOfNBits(srcWidth),
+               max & bits64::maxValueOfNBits(srcWidth));
+    break;
+  }
+
+  case Expr::Add:
+  case Expr::Sub: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    ref<Expr> other;
+    uint64_t lo, hi;
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left)) {
+      uint64_t c = CE->getZExtValue();
+      other = be->right;
+      if (e->getKind() == Expr::Add) {
+        lo = (min - c) & m;
+        hi = (max - c) & m;
+      } else {
+        lo = (c - max) & m;
+        hi = (c - min) & m;
+      }
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->right)) {
+      uint64_t c = CE->getZExtValue();
+      other = be->left;
+      if (e->getKind() == Expr::Add) {
+        lo = (min - c) & m;
+        hi = (max - c) & m;
+      } else {
+        lo = (min + c) & m;
+        hi = (max + c) & m;
+      }
+    } else {
+      break;
+    }
+    // Only narrow if the interval does not wrap around.
+    if (lo <= hi && hi - lo == max - min)
+      restrict(other, lo, hi);
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+/// Narrow the bytes an expression is built from so that it is not equal to
+/// value, which only helps when value is at the edge of a range.
+void ByteRanges::exclude(const ref<Expr> &e, uint64_t value) {
+  unsigned width = e->getWidth();
+  if (width > 64)
+    return;
+  if (width == Expr::Bool) {
+    learn(e, !value);
+    return;
+  }
+  uint64_t m = bits64::maxValueOfNBits(width);
+
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    exclude(cast<NotOptimizedExpr>(e)->src, value);
+    break;
+
+  case Expr::Read: {
+    const Array *array = 0;
+    unsigned index = 0;
+    ref<Expr> written;
+    if (!findInitialByte(cast<ReadExpr>(e), array, index, written))
+      break;
+    if (!written.isNull()) {
+      exclude(written, value);
+    } else if (array->isSymbolicArray()) {
+      Byte b = getByte(array, index);
+      if (b.min == value && b.min < b.max)
+        ++b.min;
+      else if (b.max == value && b.min < b.max)
+        --b.max;
+      else
+        break;
+      setByte(array, index, b);
+    }
+    break;
+  }
+
+  case Expr::Concat: {
+    // One side has to differ, so if the other one cannot the first must.
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    unsigned shift = ce->getRight()->getWidth();
+    uint64_t low = bits64::maxValueOfNBits(shift);
+    RangeEvaluator re(*this);
+    ValueBits l = re.eval(ce->getLeft()), r = re.eval(ce->getRight());
+    if (l.isFixed() && l.min == (value >> shift))
+      exclude(ce->getRight(), value & low);
+    else if (r.isFixed() && r.min == (value & low))
+      exclude(ce->getLeft(), value >> shift);
+    break;
+  }
+
+  case Expr::ZExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    if (value <= bits64::maxValueOfNBits(ce->src->getWidth()))
+      exclude(ce->src, value);
+    break;
+  }
+
+  case Expr::Add:
+  case Expr::Sub: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left)) {
+      uint64_t c = CE->getZExtValue();
+      exclude(be->right, e->getKind() == Expr::Add ? (value - c) & m
+                                                   : (c - value) & m);
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->right)) {
+      uint64_t c = CE->getZExtValue();
+      exclude(be->left, e->getKind() == Expr::Add ? (value - c) & m
+                                                  : (value + c) & m);
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+/// Learn from a boolean expression which is known to have the given value.
+void ByteRanges::learn(const ref<Expr> &e, bool value) {
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    learn(cast<NotOptimizedExpr>(e)->src, value);
+    break;
+
+  case Expr::And:
+  case Expr::Or: {
+    // Both sides are known only for a true And or a false Or.
+    if (e->getWidth() != Expr::Bool ||
+        value != (e->getKind() == Expr::And))
+      break;
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    learn(be->left, value);
+    learn(be->right, value);
+    break;
+  }
+
+  case Expr::Eq: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left);
+    if (!CE || be->right->getWidth() > 64)
+      break;
+    uint64_t c = CE->getZExtValue();
+    if (be->right->getWidth() == Expr::Bool)
+      learn(be->right, value ? c : !c);
+    else if (value)
+      restrict(be->right, c, c);
+    else
+      exclude(be->right, c);
+    break;
+  }
+
+  case Expr::Ult:
+  case Expr::Ule: {
+    const BinaryExpr *be = cast<BinaryExpr>(e);
+    if (be->left->getWidth() > 64)
+      break;
+    uint64_t m = bits64::maxValueOfNBits(be->left->getWidth());
+    // Turn the comparison into left <= right or left >= right, with the
+    // bound adjusted for strictness.
+    bool strict = (e->getKind() == Expr::Ult) == value;
+    bool less = value;
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->right)) {
+      uint64_t c = CE->getZExtValue();
+      if (less && strict) {
+        if (c)
+          restrict(be->left, 0, c - 1);
+      } else if (less) {
+        restrict(be->left, 0, c);
+      } else if (strict) {
+        if (c < m)
+          restrict(be->left, c + 1, m);
+      } else {
+        restrict(be->left, c, m);
+      }
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left)) {
+      uint64_t c = CE->getZExtValue();
+      if (less && strict) {
+        if (c < m)
+          restrict(be->right, c + 1, m);
+      } else if (less) {
+        restrict(be->right, c, m);
+      } else if (strict) {
+        if (c)
+          restrict(be->right, 0, c - 1);
+      } else {
+        restrict(be->right, 0, c);
+      }
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+bool ByteRanges::evaluate(const ref<Expr> &e, bool &value) const {
+  RangeEvaluator re(*this);
+  ValueBits res = re.eval(e);
+  if (!res.isFixed())
+    return false;
+  value = res.min;
+  return true;
+}
@@ -75,11 +75,52 @@ public:
   }
 };
 
+ConstraintManager::ConstraintManager(const std::vector< ref<Expr> >
+                                       &_constraints) : storage(0) {
+  for (std::vector< ref<Expr> >::const_iterator it = _constraints.begin(),
+         ie = _constraints.end(); it != ie; ++it)
+    push(*it);
+}
+
+const ConstraintManager::constraints_ty &
+ConstraintManager::getConstraints() const {
+  static const constraints_ty empty;
+  return storage ? storage->constraints : empty;
+}
+
+uint64_t ConstraintManager::lastGeneration = 0;
+
+void ConstraintManager::makeUnique() {
+  if (!storage) {
+    storage = new Storage();
+  } else if (storage->refCount > 1) {
+    Storage *s = new Storage();
+    s->constraints = storage->constraints;
+    s->hashValue = storage->hashValue;
+    --storage->refCount;
+    storage = s;
+  }
+  // The constraints are about to change.
+  storage->generation = ++lastGeneration;
+}
+
+void ConstraintManager::push(ref<Expr> e) {
+  makeUnique();
+  storage->constraints.push_back(e);
+  storage->hashValue =
+    (storage->hashValue * Expr::MAGIC_HASH_CONSTANT) ^ e->hash();
+}
+
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
+  if (empty())
+    return false;
+
   ConstraintManager::constraints_ty old;
   bool changed = false;
 
-  constraints.swap(old);
+  makeUnique();
+  storage->constraints.swap(old);
+  storage->hashValue = 0;
   for (ConstraintManager::constraints_ty::iterator 
          it = old.begin(), ie = old.end(); it != ie; ++it) {
     ref<Expr> &ce = *it;
@@ -89,7 +130,7 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
       addConstraintInternal(e); // enable further reductions
       changed = true;
     } else {
-      constraints.push_back(ce);
+      push(ce);
     }
   }
 
@@ -107,7 +148,7 @@ ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
   std::map< ref<Expr>, ref<Expr> > equalities;
   
   for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
+         it = begin(), ie = end(); it != ie; ++it) {
     if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
       if (isa<ConstantExpr>(ee->left)) {
         equalities.insert(std::make_pair(ee->right,
@@ -155,12 +196,12 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
 	rewriteConstraints(visitor);
       }
     }
-    constraints.push_back(e);
+    push(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    push(e);
     break;
   }
 }
@@ -0,0 +1,316 @@
+//===-- ExprProgram.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprProgram.h"
+
+#include "klee/util/Assignment.h"
+
+using namespace klee;
+
+static inline uint64_t getMask(Expr::Width w) {
+  return w == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << w) - 1;
+}
+
+static inline int64_t signExtend(uint64_t value, Expr::Width w) {
+  if (w == 64)
+    return (int64_t) value;
+  return (int64_t) (value << (64 - w)) >> (64 - w);
+}
+
+static inline bool isNegative(uint64_t value, Expr::Width w) {
+  return (value >> (w - 1)) & 1;
+}
+
+// Signed division and remainder, computed on the magnitudes like APInt.
+
+static uint64_t signedDiv(uint64_t l, uint64_t r, Expr::Width w) {
+  uint64_t mask = getMask(w);
+  bool ln = isNegative(l, w), rn = isNegative(r, w);
+  uint64_t q = ((ln ? -l : l) & mask) / ((rn ? -r : r) & mask);
+  return ln != rn ? -q : q;
+}
+
+static uint64_t signedRem(uint64_t l, uint64_t r, Expr::Width w) {
+  uint64_t mask = getMask(w);
+  bool ln = isNegative(l, w), rn = isNegative(r, w);
+  uint64_t rem = ((ln ? -l : l) & mask) % ((rn ? -r : r) & mask);
+  return ln ? -rem : rem;
+}
+
+unsigned ExprProgram::emit(Expr::Kind kind, Expr::Width width,
+                           unsigned a, unsigned b, unsigned c, uint64_t imm) {
+  Instruction inst;
+  inst.kind = kind;
+  inst.width = width;
+  inst.a = a;
+  inst.b = b;
+  inst.c = c;
+  inst.imm = imm;
+  instructions.push_back(inst);
+  values.push_back(0);
+  return instructions.size() - 1;
+}
+
+unsigned ExprProgram::getArrayIndex(const Array *array) {
+  std::map<const Array*, unsigned>::iterator it = arrayIndices.find(array);
+  if (it != arrayIndices.end())
+    return it->second;
+
+  unsigned index = arrays.size();
+  arrays.push_back(array);
+  arrayData.push_back(0);
+  arraySizes.push_back(0);
+  constantOffsets.push_back(constants.size());
+  if (array->isConstantArray())
+    for (unsigned i = 0; i < array->size; ++i)
+      constants.push_back(array->constantValues[i]->getZExtValue(8));
+  arrayIndices.insert(std::make_pair(array, index));
+  return index;
+}
+
+unsigned ExprProgram::compileUpdates(const UpdateNode *head) {
+  // Update lists can be long, compile the nodes not seen yet from the
+  // tail without recursing.
+  std::vector<const UpdateNode*> pending;
+  unsigned next = ~0U;
+  for (const UpdateNode *un = head; un; un = un->next) {
+    std::map<const UpdateNode*, unsigned>::iterator it =
+      updateIndices.find(un);
+    if (it != updateIndices.end()) {
+      next = it->second;
+      break;
+    }
+    pending.push_back(un);
+  }
+
+  while (!pending.empty()) {
+    const UpdateNode *un = pending.back();
+    pending.pop_back();
+    Update u;
+    u.index = compile(un->index);
+    u.value = compile(un->value);
+    u.next = next;
+    next = updates.size();
+    updates.push_back(u);
+    updateIndices.insert(std::make_pair(un, next));
+  }
+
+  return next;
+}
+
+unsigned ExprProgram::compile(const ref<Expr> &e) {
+  std::map<const Expr*, unsigned>::iterator it = exprSlots.find(e.get());
+  if (it != exprSlots.end())
+    return it->second;
+
+  Expr::Width width = e->getWidth();
+  if (width > 64) {
+    valid = false;
+    return 0;
+  }
+
+  unsigned res;
+  switch (e->getKind()) {
+  case Expr::Constant:
+    res = emit(Expr::Constant, width, 0, 0, 0,
+               cast<ConstantExpr>(e)->getZExtValue());
+    break;
+
+  case Expr::NotOptimized:
+    res = compile(e->getKid(0));
+    break;
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    if (re->updates.root->range != Expr::Int8) {
+      valid = false;
+      return 0;
+    }
+    unsigned index = compile(re->index);
+    unsigned updates = compileUpdates(re->updates.head);
+    res = emit(Expr::Read, width, index,
+               getArrayIndex(re->updates.root), updates);
+    break;
+  }
+
+  case Expr::Select:
+    res = emit(Expr::Select, width, compile(e->getKid(0)),
+               compile(e->getKid(1)), compile(e->getKid(2)));
+    break;
+
+  case Expr::Extract:
+    res = emit(Expr::Extract, width, compile(e->getKid(0)), 0, 0,
+               cast<ExtractExpr>(e)->offset);
+    break;
+
+  case Expr::Concat:
+    res = emit(Expr::Concat, width, compile(e->getKid(0)),
+               compile(e->getKid(1)), 0, e->getKid(1)->getWidth());
+    break;
+
+  case Expr::ZExt:
+  case Expr::SExt:
+  case Expr::Not:
+    res = emit(e->getKind(), width, compile(e->getKid(0)), 0, 0,
+               e->getKid(0)->getWidth());
+    break;
+
+  default:
+    // Binary operations, signed comparisons need the operand width.
+    assert(e->getNumKids() == 2 && "unexpected expression kind");
+    res = emit(e->getKind(), width, compile(e->getKid(0)),
+               compile(e->getKid(1)), 0, e->getKid(0)->getWidth());
+    break;
+  }
+
+  if (!valid)
+    return 0;
+  exprSlots.insert(std::make_pair(e.get(), res));
+  return res;
+}
+
+void ExprProgram::add(const ref<Expr> &e) {
+  unsigned slot = compile(e);
+  if (valid)
+    emit(CheckKind, Expr::Bool, slot);
+}
+
+void ExprProgram::loadArrays(const Assignment &a) {
+  for (unsigned i = 0, e = arrays.size(); i != e; ++i) {
+    Assignment::bindings_ty::const_iterator it = a.bindings.find(arrays[i]);
+    if (it == a.bindings.end() || it->second.empty()) {
+      arrayData[i] = 0;
+      arraySizes[i] = 0;
+    } else {
+      arrayData[i] = &it->second[0];
+      arraySizes[i] = it->second.size();
+    }
+  }
+  allowFreeValues = a.allowFreeValues;
+}
+
+/// Read a byte of an array the way ExprEvaluator does, returning false if
+/// the result is not a constant.
+bool ExprProgram::readArray(unsigned array, unsigned index,
+                            uint64_t &result) const {
+  const Array *root = arrays[array];
+  if (root->isConstantArray() && index < root->size) {
+    result = constants[constantOffsets[array] + index];
+  } else if (index < arraySizes[array]) {
+    result = arrayData[array][index];
+  } else if (allowFreeValues) {
+    return false;
+  } else {
+    result = 0;
+  }
+  return true;
+}
+
+ExprProgram::Result ExprProgram::evaluate(const Assignment &a) {
+  if (!valid)
+    return Unknown;
+  if (instructions.empty())
+    return True;
+  loadArrays(a);
+
+  uint64_t *v = &values[0];
+  for (unsigned i = 0, e = instructions.size(); i != e; ++i) {
+    const Instruction &inst = instructions[i];
+    uint64_t l = v[inst.a], r = v[inst.b], res;
+    switch (inst.kind) {
+    case CheckKind:
+      if (!l)
+        return False;
+      continue;
+
+    case Expr::Constant: res = inst.imm; break;
+
+    case Expr::Read: {
+      // The index is truncated as in ExprEvaluator::evalRead.
+      unsigned index = l;
+      unsigned u = inst.c;
+      while (u != ~0U && v[updates[u].index] != index)
+        u = updates[u].next;
+      if (u != ~0U) {
+        res = v[updates[u].value];
+      } else if (!readArray(inst.b, index, res)) {
+        return Unknown;
+      }
+      break;
+    }
+
+    case Expr::Select: res = l ? r : v[inst.c]; break;
+    case Expr::Concat: res = (l << inst.imm) | r; break;
+    case Expr::Extract: res = l >> inst.imm; break;
+    case Expr::ZExt: res = l; break;
+    case Expr::SExt: res = signExtend(l, inst.imm); break;
+
+    case Expr::Add: res = l + r; break;
+    case Expr::Sub: res = l - r; break;
+    case Expr::Mul: res = l * r; break;
+
+    // Division by zero is left symbolic by ExprEvaluator.
+    case Expr::UDiv:
+      if (!r) return Unknown;
+      res = l / r;
+      break;
+    case Expr::SDiv:
+      if (!r) return Unknown;
+      res = signedDiv(l, r, inst.width);
+      break;
+    case Expr::URem:
+      if (!r) return Unknown;
+      res = l % r;
+      break;
+    case Expr::SRem:
+      if (!r) return Unknown;
+      res = signedRem(l, r, inst.width);
+      break;
+
+    case Expr::Not: res = ~l; break;
+    case Expr::And: res = l & r; break;
+    case Expr::Or: res = l | r; break;
+    case Expr::Xor: res = l ^ r; break;
+
+    case Expr::Shl: res = r >= inst.width ? 0 : l << r; break;
+    case Expr::LShr: res = r >= inst.width ? 0 : l >> r; break;
+    case Expr::AShr: {
+      int64_t s = signExtend(l, inst.width);
+      res = s >> (r >= inst.width ? inst.width - 1 : r);
+      break;
+    }
+
+    case Expr::Eq: res = l == r; break;
+    case Expr::Ne: res = l != r; break;
+    case Expr::Ult: res = l < r; break;
+    case Expr::Ule: res = l <= r; break;
+    case Expr::Ugt: res = l > r; break;
+    case Expr::Uge: res = l >= r; break;
+    case Expr::Slt:
+      res = signExtend(l, inst.imm) < signExtend(r, inst.imm);
+      break;
+    case Expr::Sle:
+      res = signExtend(l, inst.imm) <= signExtend(r, inst.imm);
+      break;
+    case Expr::Sgt:
+      res = signExtend(l, inst.imm) > signExtend(r, inst.imm);
+      break;
+    case Expr::Sge:
+      res = signExtend(l, inst.imm) >= signExtend(r, inst.imm);
+      break;
+
+    default:
+      assert(0 && "invalid instruction");
+      return Unknown;
+    }
+    v[i] = res & getMask(inst.width);
+  }
+
+  return True;
+}
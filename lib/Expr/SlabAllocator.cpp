@@ -0,0 +1,134 @@
+//===-- SlabAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/SlabAllocator.h"
+
+#include "klee/Statistics.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <new>
+#include <map>
+
+#include <pthread.h>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  cl::opt<bool>
+  UseSystemAllocator("use-system-allocator",
+                     cl::desc("Allocate expressions and object states with the system allocator, e.g. for memory debuggers (default=off)"),
+                     cl::init(false));
+}
+
+Statistic stats::slabAllocations("SlabAllocations", "SAllocs");
+Statistic stats::slabBytes("SlabBytes", "SBytes");
+
+// Objects can be allocated by static constructors that run before the
+// statistics above are registered.
+static bool statisticsReady = false;
+
+namespace {
+  struct StatisticsReady {
+    StatisticsReady() { statisticsReady = true; }
+  } statisticsReadyInit;
+}
+
+static const size_t Granularity = 16;
+static const size_t MaxSize = 512;
+static const size_t NumClasses = MaxSize / Granularity;
+static const size_t SlabSize = 64 * 1024;
+
+namespace {
+  struct FreeObject {
+    FreeObject *next;
+  };
+}
+
+static __thread FreeObject *freeLists[NumClasses];
+static __thread size_t freeBytes;
+
+/// The start and end of every slab, to tell objects from slabs apart from
+/// those of the system allocator once --use-system-allocator is parsed.
+static std::map<char*, char*> *slabs;
+static pthread_mutex_t slabLock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool isSlabObject(void *p) {
+  char *c = static_cast<char*>(p);
+  pthread_mutex_lock(&slabLock);
+  bool result = false;
+  if (slabs) {
+    std::map<char*, char*>::iterator it = slabs->upper_bound(c);
+    if (it != slabs->begin()) {
+      --it;
+      result = c < it->second;
+    }
+  }
+  pthread_mutex_unlock(&slabLock);
+  return result;
+}
+
+/// Carve a new slab into objects of the given size class.
+static FreeObject *refill(size_t index) {
+  size_t size = (index + 1) * Granularity;
+  char *slab = static_cast<char*>(::operator new(SlabSize));
+
+  pthread_mutex_lock(&slabLock);
+  if (!slabs)
+    slabs = new std::map<char*, char*>();
+  (*slabs)[slab] = slab + SlabSize;
+  pthread_mutex_unlock(&slabLock);
+
+  FreeObject *head = 0;
+  for (size_t offset = SlabSize - SlabSize % size; offset; ) {
+    offset -= size;
+    FreeObject *o = reinterpret_cast<FreeObject*>(slab + offset);
+    o->next = head;
+    head = o;
+  }
+  freeBytes += SlabSize - SlabSize % size;
+  if (statisticsReady)
+    stats::slabBytes += SlabSize;
+  return head;
+}
+
+void *SlabAllocator::allocate(size_t size) {
+  if (size > MaxSize || UseSystemAllocator)
+    return ::operator new(size);
+
+  size_t index = size ? (size - 1) / Granularity : 0;
+  FreeObject *o = freeLists[index];
+  if (!o)
+    o = refill(index);
+  freeLists[index] = o->next;
+  freeBytes -= (index + 1) * Granularity;
+  if (statisticsReady)
+    ++stats::slabAllocations;
+  return o;
+}
+
+void SlabAllocator::deallocate(void *p, size_t size) {
+  if (!p)
+    return;
+  if (size > MaxSize || (UseSystemAllocator && !isSlabObject(p))) {
+    ::operator delete(p);
+    return;
+  }
+
+  size_t index = size ? (size - 1) / Granularity : 0;
+  FreeObject *o = static_cast<FreeObject*>(p);
+  o->next = freeLists[index];
+  freeLists[index] = o;
+  freeBytes += (index + 1) * Granularity;
+}
+
+size_t SlabAllocator::getFreeBytes() {
+  return freeBytes;
+}
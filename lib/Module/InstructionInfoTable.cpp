@@ -46,46 +46,66 @@
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Support/ErrorHandling.h"
 
+#include <algorithm>
+#include <istream>
 #include <map>
+#include <ostream>
 #include <string>
+#include <vector>
 
 using namespace llvm;
 using namespace klee;
 
+/// A stream which counts the lines written to it, and passes them on to
+/// another stream if there is one.
+class LineCountingStream : public llvm::raw_ostream {
+  llvm::raw_ostream *os;
+  unsigned lines;
+  uint64_t pos;
+
+  void write_impl(const char *ptr, size_t size) {
+    if (os)
+      os->write(ptr, size);
+    lines += std::count(ptr, ptr + size, '\n');
+    pos += size;
+  }
+
+  uint64_t current_pos() const { return pos; }
+
+public:
+  explicit LineCountingStream(llvm::raw_ostream *_os)
+    : os(_os), lines(0), pos(0) {}
+  ~LineCountingStream() { flush(); }
+
+  /// The line the next character written goes on, counting from 1.
+  unsigned getLine() {
+    flush();
+    return lines + 1;
+  }
+};
+
+/// Record the line of the module assembly each instruction is printed on.
 class InstructionToLineAnnotator : public llvm::AssemblyAnnotationWriter {
+  LineCountingStream &counter;
+  const llvm::DenseMap<const Instruction*, unsigned> &ids;
+  std::vector<unsigned> &lines;
+
 public:
+  InstructionToLineAnnotator(LineCountingStream &_counter,
+                             const llvm::DenseMap<const Instruction*,
+                                                  unsigned> &_ids,
+                             std::vector<unsigned> &_lines)
+    : counter(_counter), ids(_ids), lines(_lines) {}
+
   void emitInstructionAnnot(const Instruction *i,
                             llvm::formatted_raw_ostream &os) {
-    os << "%%%";
-    os << (uintptr_t) i;
+    os.flush();
+    llvm::DenseMap<const Instruction*, unsigned>::const_iterator it =
+      ids.find(i);
+    if (it != ids.end())
+      lines[it->second] = counter.getLine();
   }
 };
-        
-static void buildInstructionToLineMap(Module *m,
-                                      std::map<const Instruction*, unsigned> &out) {  
-  InstructionToLineAnnotator a;
-  std::string str;
-  llvm::raw_string_ostream os(str);
-  m->print(os, &a);
-  os.flush();
-  const char *s;
-
-  unsigned line = 1;
-  for (s=str.c_str(); *s; s++) {
-    if (*s=='\n') {
-      line++;
-      if (s[1]=='%' && s[2]=='%' && s[3]=='%') {
-        s += 4;
-        char *end;
-        unsigned long long value = strtoull(s, &end, 10);
-        if (end!=s) {
-          out.insert(std::make_pair((const Instruction*) value, line));
-        }
-        s = end;
-      }
-    }
-  }
-}
 
 static std::string getDSPIPath(DILocation Loc) {
   std::string dir = Loc.getDirectory();
@@ -113,10 +133,16 @@ bool InstructionInfoTable::getInstructionDebugInfo(const llvm::Instruction *I,
 }
 
 InstructionInfoTable::InstructionInfoTable(Module *m) 
-  : dummyString(""), dummyInfo(0, dummyString, 0, 0) {
-  unsigned id = 0;
-  std::map<const Instruction*, unsigned> lineTable;
-  buildInstructionToLineMap(m, lineTable);
+  : dummyString(""), dummyInfo(0, dummyString, 0, 0), module(m) {
+  // The ids are the positions in infos, which must not move once they
+  // are handed out.
+  unsigned numInstructions = 0;
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end();
+       fnIt != fn_ie; ++fnIt)
+    for (Function::iterator bbIt = fnIt->begin(), bb_ie = fnIt->end();
+         bbIt != bb_ie; ++bbIt)
+      numInstructions += bbIt->size();
+  infos.reserve(numInstructions);
 
   for (Module::iterator fnIt = m->begin(), fn_ie = m->end(); 
        fnIt != fn_ie; ++fnIt) {
@@ -139,18 +165,20 @@ InstructionInfoTable::InstructionInfoTable(Module *m)
     for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
         ++it) {
       Instruction *instr = &*it;
-      unsigned assemblyLine = lineTable[instr];
 
       // Update our source level debug information.
       getInstructionDebugInfo(instr, file, line);
 
-      infos.insert(std::make_pair(instr,
-                                  InstructionInfo(id++, *file, line,
-                                                  assemblyLine)));
+      ids[instr] = infos.size();
+      infos.push_back(InstructionInfo(infos.size(), *file, line, this));
     }
   }
 }
 
+InstructionInfoTable::InstructionInfoTable()
+  : dummyString(""), dummyInfo(0, dummyString, 0, 0), module(0) {
+}
+
 InstructionInfoTable::~InstructionInfoTable() {
   for (std::set<const std::string *, ltstr>::iterator
          it = internedStrings.begin(), ie = internedStrings.end();
@@ -175,12 +203,12 @@ unsigned InstructionInfoTable::getMaxID() const {
 
 const InstructionInfo &
 InstructionInfoTable::getInfo(const Instruction *inst) const {
-  std::map<const llvm::Instruction*, InstructionInfo>::const_iterator it = 
-    infos.find(inst);
-  if (it == infos.end())
+  llvm::DenseMap<const llvm::Instruction*, unsigned>::const_iterator it =
+    ids.find(inst);
+  if (it == ids.end())
     llvm::report_fatal_error("invalid instruction, not present in "
                              "initial module!");
-  return it->second;
+  return infos[it->second];
 }
 
 const InstructionInfo &
@@ -196,3 +224,103 @@ InstructionInfoTable::getFunctionInfo(const Function *f) const {
     return getInfo(f->begin()->begin());
   }
 }
+
+unsigned InstructionInfo::getAssemblyLine() const {
+  return table ? table->getAssemblyLine(id) : 0;
+}
+
+unsigned InstructionInfoTable::getAssemblyLine(unsigned id) const {
+  assert(id < infos.size() && "invalid instruction id");
+  if (assemblyLines.empty()) {
+    // Nothing printed assembly.ll yet; print the module into a stream which
+    // only counts lines, rather than keeping the text.
+    LineCountingStream counter(0);
+    assemblyLines.resize(infos.size());
+    InstructionToLineAnnotator a(counter, ids, assemblyLines);
+    module->print(counter, &a);
+  }
+  return assemblyLines[id];
+}
+
+void InstructionInfoTable::printModule(llvm::raw_ostream &os) const {
+  LineCountingStream counter(&os);
+  std::vector<unsigned> lines(infos.size());
+  InstructionToLineAnnotator a(counter, ids, lines);
+  module->print(counter, &a);
+  counter.flush();
+  assemblyLines.swap(lines);
+}
+
+// The file format, all in text: a header line, the number of files and
+// one file name per line, then the number of instructions and a line with
+// the file index and source line of each instruction, in the order of the
+// module. The assembly lines are not stored; they are counted again from
+// the module when needed.
+static const char *InstructionInfoHeader = "klee-instruction-info 2";
+
+void InstructionInfoTable::write(std::ostream &os) const {
+  std::map<const std::string*, unsigned> fileIndex;
+  std::vector<const std::string*> files;
+
+  for (unsigned i = 0; i != infos.size(); ++i)
+    if (fileIndex.insert(std::make_pair(&infos[i].file, files.size())).second)
+      files.push_back(&infos[i].file);
+
+  os << InstructionInfoHeader << "\n" << files.size() << "\n";
+  for (unsigned i = 0; i != files.size(); ++i)
+    os << *files[i] << "\n";
+  os << infos.size() << "\n";
+  for (unsigned i = 0; i != infos.size(); ++i) {
+    const InstructionInfo &info = infos[i];
+    os << fileIndex[&info.file] << " " << info.line << "\n";
+  }
+}
+
+InstructionInfoTable *InstructionInfoTable::read(Module *m,
+                                                 std::istream &is) {
+  std::string header;
+  std::getline(is, header);
+  if (header != InstructionInfoHeader)
+    return 0;
+
+  InstructionInfoTable *table = new InstructionInfoTable();
+  table->module = m;
+  std::vector<const std::string*> files;
+  unsigned numFiles = 0, numInstructions = 0;
+  is >> numFiles;
+  is.ignore(1);
+  for (unsigned i = 0; i != numFiles && is.good(); ++i) {
+    std::string file;
+    std::getline(is, file);
+    files.push_back(file.empty() ? &table->dummyString :
+                    table->internString(file));
+  }
+  is >> numInstructions;
+  table->infos.reserve(numInstructions);
+
+  for (Module::iterator fnIt = m->begin(), fn_ie = m->end();
+       fnIt != fn_ie && is.good(); ++fnIt) {
+    for (inst_iterator it = inst_begin(fnIt), ie = inst_end(fnIt); it != ie;
+         ++it) {
+      unsigned file = 0, line = 0;
+      if (!(is >> file >> line) || file >= files.size()) {
+        is.setstate(std::ios::failbit);
+        break;
+      }
+      if (table->infos.size() == numInstructions) {
+        is.setstate(std::ios::failbit);
+        break;
+      }
+      table->ids[&*it] = table->infos.size();
+      table->infos.push_back(InstructionInfo(table->infos.size(),
+                                             *files[file], line, table));
+    }
+  }
+
+  if (!is.good() || files.size() != numFiles ||
+      table->infos.size() != numInstructions) {
+    delete table;
+    return 0;
+  }
+  return table;
+}
@@ -25,12 +25,14 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/IR/DataLayout.h"
 #else
+#include "llvm/Constants.h"
 #include "llvm/Instructions.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
@@ -45,10 +47,16 @@
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
 #else
 #include "llvm/IR/CallSite.h"
+#include "llvm/IR/CFG.h"
 #endif
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/PostDominators.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
@@ -58,8 +66,13 @@
 
 #include <llvm/Transforms/Utils/Cloning.h>
 
+#include <algorithm>
+#include <fstream>
 #include <sstream>
 
+#include <stdio.h>
+#include <unistd.h>
+
 using namespace llvm;
 using namespace klee;
 
@@ -101,6 +114,11 @@ namespace {
   cl::opt<bool>
   DebugPrintEscapingFunctions("debug-print-escaping-functions", 
                               cl::desc("Print functions whose address is taken."));
+
+  cl::opt<bool>
+  ReuseRegisters("reuse-registers",
+                 cl::desc("Let values of a function that are never live at the same time share a register (default=on)"),
+                 cl::init(true));
 }
 
 KModule::KModule(Module *_module) 
@@ -230,6 +248,43 @@ static void forceImport(Module *m, const char *name, LLVM_TYPE_Q Type *retType,
 #endif
 
 
+static std::string
+getIntrinsicLibraryPath(const Interpreter::ModuleOptions &opts) {
+  SmallString<128> LibPath(opts.LibraryDir);
+  llvm::sys::path::append(LibPath,
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
+      "kleeRuntimeIntrinsic.bc"
+#else
+      "libkleeRuntimeIntrinsic.bca"
+#endif
+    );
+  return LibPath.str();
+}
+
+/// Append the contents of a file to a stream, or return false if it
+/// cannot be read.
+static bool copyFile(const std::string &path, llvm::raw_ostream &os) {
+  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  if (!in.good() || contents.fail())
+    return false;
+  os << contents.str();
+  return true;
+}
+
+/// Close a file written under a temporary name and move it to its place
+/// in the module cache.
+static bool commitCacheFile(std::ofstream &out, const std::string &tmpPath,
+                            const std::string &path) {
+  out.close();
+  if (out.fail() || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
 void KModule::addInternalFunction(const char* functionName){
   Function* internalFunction = module->getFunction(functionName);
   if (!internalFunction) {
@@ -241,8 +296,7 @@ void KModule::addInternalFunction(const char* functionName){
   internalFunctions.insert(internalFunction);
 }
 
-void KModule::prepare(const Interpreter::ModuleOptions &opts,
-                      InterpreterHandler *ih) {
+void KModule::transform(const Interpreter::ModuleOptions &opts) {
   if (!MergeAtExit.empty()) {
     Function *mergeFn = module->getFunction("klee_merge");
     if (!mergeFn) {
@@ -339,23 +393,7 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   // this to be linked in, it makes low level debugging much more
   // annoying.
 
-  SmallString<128> LibPath(opts.LibraryDir);
-  llvm::sys::path::append(LibPath,
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
-      "kleeRuntimeIntrinsic.bc"
-#else
-      "libkleeRuntimeIntrinsic.bca"
-#endif
-    );
-  module = linkWithLibrary(module, LibPath.str());
-
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
-
+  module = linkWithLibrary(module, getIntrinsicLibraryPath(opts));
 
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
@@ -388,6 +426,30 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   f = module->getFunction("memset");
   if (f && f->use_empty()) f->eraseFromParent();
 #endif
+}
+
+void KModule::prepare(const Interpreter::ModuleOptions &opts,
+                      InterpreterHandler *ih) {
+  // A module from the cache has been through all of this already.
+  if (!opts.Cached)
+    transform(opts);
+
+  // Add internal functions which are not used to check if instructions
+  // have been already visited
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
+
+  if (opts.Cached) {
+    std::ifstream is((opts.CachePath + ".info").c_str());
+    infos = InstructionInfoTable::read(module, is);
+    if (!infos)
+      klee_warning("unable to read cached instruction info: %s.info",
+                   opts.CachePath.c_str());
+  }
+  if (!infos)
+    infos = new InstructionInfoTable(module);
 
   // Write out the .ll assembly file. We truncate long lines to work
   // around a kcachegrind parsing bug (it puts them on new lines), so
@@ -398,12 +460,14 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
 
     // We have an option for this in case the user wants a .ll they
     // can compile.
-    if (NoTruncateSourceLines) {
-      *os << *module;
+    if (opts.Cached && copyFile(opts.CachePath + ".ll", *os)) {
+      // The assembly the run that filled the cache entry wrote.
+    } else if (NoTruncateSourceLines) {
+      infos->printModule(*os);
     } else {
       std::string string;
       llvm::raw_string_ostream rss(string);
-      rss << *module;
+      infos->printModule(rss);
       rss.flush();
       const char *position = string.c_str();
 
@@ -435,9 +499,11 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
 
   kleeMergeFn = module->getFunction("klee_merge");
 
-  /* Build shadow structures */
+  if (!opts.Cached && !opts.CachePath.empty())
+    writeCache(opts.CachePath,
+               OutputSource ? ih->getOutputFilename("assembly.ll") : "");
 
-  infos = new InstructionInfoTable(module);  
+  /* Build shadow structures */
   
   for (Module::iterator it = module->begin(), ie = module->end();
        it != ie; ++it) {
@@ -474,6 +540,58 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   }
 }
 
+std::string KModule::getCacheKey(const Interpreter::ModuleOptions &opts) {
+  std::ostringstream key;
+  key << "optimize=" << opts.Optimize
+      << " check-div-zero=" << opts.CheckDivZero
+      << " check-overshift=" << opts.CheckOvershift
+      << " switch-type=" << SwitchType
+      << " no-truncate-source-lines=" << NoTruncateSourceLines
+      << " intrinsic=" << std::hex
+      << getFileHash(getIntrinsicLibraryPath(opts)) << std::dec;
+  for (cl::list<std::string>::iterator it = MergeAtExit.begin(),
+         ie = MergeAtExit.end(); it != ie; ++it)
+    key << " merge-at-exit=" << *it;
+  return key.str();
+}
+
+void KModule::writeCache(const std::string &path,
+                         const std::string &assemblyPath) {
+  std::ostringstream tmpPath;
+  tmpPath << path << ".tmp" << getpid();
+  std::string tmp = tmpPath.str();
+
+  if (!assemblyPath.empty()) {
+    std::ifstream in(assemblyPath.c_str(), std::ios::in | std::ios::binary);
+    std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary);
+    out << in.rdbuf();
+    if (!in.good() || !commitCacheFile(out, tmp, path + ".ll"))
+      klee_warning("unable to write module cache: %s.ll", path.c_str());
+  }
+
+  std::ofstream info(tmp.c_str(), std::ios::out | std::ios::binary);
+  infos->write(info);
+  if (!commitCacheFile(info, tmp, path + ".info")) {
+    klee_warning("unable to write module cache: %s.info", path.c_str());
+    return;
+  }
+
+  // The bitcode goes last: its presence marks a complete entry.
+  std::ofstream bitcode(tmp.c_str(), std::ios::out | std::ios::binary);
+  {
+    llvm::raw_os_ostream os(bitcode);
+    WriteBitcodeToFile(module, os);
+  }
+  if (!commitCacheFile(bitcode, tmp, path + ".bc"))
+    klee_warning("unable to write module cache: %s.bc", path.c_str());
+}
+
+void KModule::computeMergePoints() {
+  for (std::vector<KFunction*>::iterator it = functions.begin(), 
+         ie = functions.end(); it != ie; ++it)
+    (*it)->computeMergePoints();
+}
+
 KConstant* KModule::getKConstant(Constant *c) {
   std::map<llvm::Constant*, KConstant*>::iterator it = constantMap.find(c);
   if (it != constantMap.end())
@@ -521,6 +639,215 @@ static int getOperandNum(Value *v,
   }
 }
 
+/// The function a call calls, through bitcasts and aliases, if there are no
+/// function aliases; as Executor::getTargetFunction() finds it then.
+static Function *getDirectCallee(Value *calledVal) {
+  SmallPtrSet<const GlobalValue*, 3> Visited;
+
+  Constant *c = dyn_cast<Constant>(calledVal);
+  if (!c)
+    return 0;
+
+  while (true) {
+    if (GlobalValue *gv = dyn_cast<GlobalValue>(c)) {
+      if (!Visited.insert(gv))
+        return 0;
+
+      if (Function *f = dyn_cast<Function>(gv))
+        return f;
+      else if (GlobalAlias *ga = dyn_cast<GlobalAlias>(gv))
+        c = ga->getAliasee();
+      else
+        return 0;
+    } else if (llvm::ConstantExpr *ce = dyn_cast<llvm::ConstantExpr>(c)) {
+      if (ce->getOpcode()==Instruction::BitCast)
+        c = ce->getOperand(0);
+      else
+        return 0;
+    } else
+      return 0;
+  }
+}
+
+/// Number the basic blocks of \a f and its instructions other than PHI
+/// nodes, and compute which of those values are live into and out of each
+/// block. A value read by a PHI node is live at the end of the incoming
+/// block.
+static void computeLiveness(Function *f, std::vector<Instruction*> &values,
+                            std::map<Value*, unsigned> &valueIndex,
+                            std::map<BasicBlock*, unsigned> &blockIndex,
+                            std::vector<BitVector> &liveIn,
+                            std::vector<BitVector> &liveOut) {
+  for (Function::iterator bbit = f->begin(), bbie = f->end();
+       bbit != bbie; ++bbit) {
+    unsigned index = blockIndex.size();
+    blockIndex[bbit] = index;
+    for (BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
+         it != ie; ++it) {
+      if (!isa<PHINode>(it)) {
+        valueIndex[it] = values.size();
+        values.push_back(it);
+      }
+    }
+  }
+
+  unsigned numValues = values.size(), numBlocks = blockIndex.size();
+  std::vector<BitVector> uses(numBlocks, BitVector(numValues)),
+    notDefs(numBlocks, BitVector(numValues, true)),
+    phiUses(numBlocks, BitVector(numValues));
+  liveIn.assign(numBlocks, BitVector(numValues));
+  liveOut.assign(numBlocks, BitVector(numValues));
+  std::vector<BasicBlock*> blocks(numBlocks);
+  for (Function::iterator bbit = f->begin(), bbie = f->end();
+       bbit != bbie; ++bbit) {
+    unsigned b = blockIndex[bbit];
+    blocks[b] = bbit;
+    for (BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
+         it != ie; ++it) {
+      if (PHINode *phi = dyn_cast<PHINode>(it)) {
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+          std::map<Value*, unsigned>::iterator vit =
+            valueIndex.find(phi->getIncomingValue(i));
+          std::map<BasicBlock*, unsigned>::iterator bit =
+            blockIndex.find(phi->getIncomingBlock(i));
+          if (vit != valueIndex.end() && bit != blockIndex.end())
+            phiUses[bit->second].set(vit->second);
+        }
+        continue;
+      }
+      for (unsigned i = 0; i < it->getNumOperands(); ++i) {
+        std::map<Value*, unsigned>::iterator vit =
+          valueIndex.find(it->getOperand(i));
+        if (vit != valueIndex.end() && notDefs[b].test(vit->second))
+          uses[b].set(vit->second);
+      }
+      notDefs[b].reset(valueIndex[it]);
+    }
+  }
+
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (unsigned b = numBlocks; b--;) {
+      BitVector out = phiUses[b];
+      for (succ_iterator it = succ_begin(blocks[b]), ie = succ_end(blocks[b]);
+           it != ie; ++it)
+        out |= liveIn[blockIndex[*it]];
+      BitVector in = out;
+      in &= notDefs[b];
+      in |= uses[b];
+      if (!(in == liveIn[b])) {
+        liveIn[b] = in;
+        changed = true;
+      }
+      liveOut[b] = out;
+    }
+  }
+}
+
+/// Give the instructions of the function registers after the \a numArgs
+/// formals, so that values that are never live at the same time share
+/// one, and return the number of registers needed.
+///
+/// PHI nodes get registers of their own: the PHI nodes of a block are
+/// executed one after another, but all read their operands as of the
+/// edge they came in from. Every other instruction gets a register that
+/// is free where it executes, even if its value is never used, as it may
+/// still be written. An instruction does not reuse the register of an
+/// operand it reads for the last time, because the value may be read
+/// again after the result is written.
+static unsigned assignRegisters(Function *f, unsigned numArgs,
+                                std::map<Instruction*, unsigned> &registerMap) {
+  unsigned rnum = numArgs;
+  for (Function::iterator bbit = f->begin(), bbie = f->end();
+       bbit != bbie; ++bbit)
+    for (BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
+         it != ie; ++it)
+      if (isa<PHINode>(it))
+        registerMap[it] = rnum++;
+
+  std::vector<Instruction*> values;
+  std::map<Value*, unsigned> valueIndex;
+  std::map<BasicBlock*, unsigned> blockIndex;
+  std::vector<BitVector> liveIn, liveOut;
+  computeLiveness(f, values, valueIndex, blockIndex, liveIn, liveOut);
+  unsigned numValues = values.size();
+
+  // Hand out the registers in reverse post order, so that the values live
+  // into a block have theirs when the block is reached.
+  std::vector<int> slots(numValues, -1);
+  std::vector<bool> occupied;
+  ReversePostOrderTraversal<Function*> rpot(f);
+  for (ReversePostOrderTraversal<Function*>::rpo_iterator
+         bbit = rpot.begin(), bbie = rpot.end(); bbit != bbie; ++bbit) {
+    BasicBlock *bb = *bbit;
+    unsigned b = blockIndex[bb];
+
+    // Find the values each instruction reads for the last time, and
+    // whether its own value is read at all.
+    std::vector<std::vector<unsigned> > dying(bb->size());
+    std::vector<bool> unused(bb->size());
+    BitVector live = liveOut[b];
+    unsigned pos = bb->size();
+    for (BasicBlock::iterator it = bb->end(); it != bb->begin();) {
+      --it;
+      --pos;
+      if (isa<PHINode>(it))
+        continue;
+      unsigned v = valueIndex[it];
+      unused[pos] = !live.test(v);
+      live.reset(v);
+      for (unsigned i = 0; i < it->getNumOperands(); ++i) {
+        std::map<Value*, unsigned>::iterator vit =
+          valueIndex.find(it->getOperand(i));
+        if (vit != valueIndex.end() && !live.test(vit->second)) {
+          live.set(vit->second);
+          dying[pos].push_back(vit->second);
+        }
+      }
+    }
+
+    std::fill(occupied.begin(), occupied.end(), false);
+    for (int v = liveIn[b].find_first(); v != -1;
+         v = liveIn[b].find_next(v)) {
+      if (slots[v] < 0) {
+        slots[v] = occupied.size();
+        occupied.push_back(false);
+      }
+      occupied[slots[v]] = true;
+    }
+
+    pos = 0;
+    for (BasicBlock::iterator it = bb->begin(), ie = bb->end(); it != ie;
+         ++it, ++pos) {
+      if (isa<PHINode>(it))
+        continue;
+      unsigned v = valueIndex[it];
+      if (slots[v] < 0) {
+        slots[v] = std::find(occupied.begin(), occupied.end(), false) -
+          occupied.begin();
+        if ((unsigned) slots[v] == occupied.size())
+          occupied.push_back(false);
+      }
+      occupied[slots[v]] = true;
+      for (unsigned i = 0; i < dying[pos].size(); ++i)
+        occupied[slots[dying[pos][i]]] = false;
+      if (unused[pos])
+        occupied[slots[v]] = false;
+    }
+  }
+
+  // Blocks that cannot be reached are never executed, give their values
+  // registers of their own.
+  unsigned numSlots = occupied.size();
+  for (unsigned v = 0; v < numValues; ++v) {
+    if (slots[v] < 0)
+      slots[v] = numSlots++;
+    registerMap[values[v]] = rnum + slots[v];
+  }
+
+  return rnum + numSlots;
+}
+
 KFunction::KFunction(llvm::Function *_function,
                      KModule *km) 
   : function(_function),
@@ -539,14 +866,18 @@ KFunction::KFunction(llvm::Function *_function,
   std::map<Instruction*, unsigned> registerMap;
 
   // The first arg_size() registers are reserved for formals.
-  unsigned rnum = numArgs;
-  for (llvm::Function::iterator bbit = function->begin(), 
-         bbie = function->end(); bbit != bbie; ++bbit) {
-    for (llvm::BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
-         it != ie; ++it)
-      registerMap[it] = rnum++;
+  if (ReuseRegisters) {
+    numRegisters = assignRegisters(function, numArgs, registerMap);
+  } else {
+    unsigned rnum = numArgs;
+    for (llvm::Function::iterator bbit = function->begin(), 
+           bbie = function->end(); bbit != bbie; ++bbit) {
+      for (llvm::BasicBlock::iterator it = bbit->begin(), ie = bbit->end();
+           it != ie; ++it)
+        registerMap[it] = rnum++;
+    }
+    numRegisters = rnum;
   }
-  numRegisters = rnum;
   
   unsigned i = 0;
   for (llvm::Function::iterator bbit = function->begin(), 
@@ -566,6 +897,15 @@ KFunction::KFunction(llvm::Function *_function,
 
       ki->inst = it;      
       ki->dest = registerMap[it];
+      ki->opcode = it->getOpcode();
+      ki->predicate = 0;
+      if (CmpInst *ci = dyn_cast<CmpInst>(it))
+        ki->predicate = ci->getPredicate();
+      ki->width = 0;
+      if (it->getType()->isSized())
+        ki->width = km->targetData->getTypeSizeInBits(it->getType());
+      ki->callee = 0;
+      ki->mergePoint = 0;
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(it);
@@ -573,6 +913,7 @@ KFunction::KFunction(llvm::Function *_function,
         ki->operands = new int[numArgs+1];
         ki->operands[0] = getOperandNum(cs.getCalledValue(), registerMap, km,
                                         ki);
+        ki->callee = getDirectCallee(cs.getCalledValue());
         for (unsigned j=0; j<numArgs; j++) {
           Value *v = cs.getArgument(j);
           ki->operands[j+1] = getOperandNum(v, registerMap, km, ki);
@@ -595,4 +936,132 @@ KFunction::~KFunction() {
   for (unsigned i=0; i<numInstructions; ++i)
     delete instructions[i];
   delete[] instructions;
+  for (unsigned i=0; i<mergePoints.size(); ++i)
+    delete mergePoints[i];
+}
+
+/// The condition of the branch ending the block if it can go more than
+/// one way, which is where the solver gets asked, or null.
+static Value *getBranchCondition(BasicBlock *bb) {
+  TerminatorInst *ti = bb->getTerminator();
+  if (BranchInst *bi = dyn_cast<BranchInst>(ti))
+    return bi->isConditional() ? bi->getCondition() : 0;
+  if (SwitchInst *si = dyn_cast<SwitchInst>(ti))
+    return si->getNumSuccessors() > 1 ? si->getCondition() : 0;
+  return 0;
+}
+
+void KFunction::computeMergePoints() {
+  if (!mergePoints.empty())
+    return;
+
+  std::map<Value*, unsigned> registers;
+  unsigned index = 0;
+  for (Function::arg_iterator ai = function->arg_begin(),
+         ae = function->arg_end(); ai != ae; ++ai)
+    registers[ai] = index++;
+  for (unsigned i = 0; i < numInstructions; ++i)
+    registers[instructions[i]->inst] = instructions[i]->dest;
+
+  // The values each branch condition depends on within the function.
+  std::map<BasicBlock*, std::vector<Value*> > conditionValues;
+  for (Function::iterator bbit = function->begin(), bbie = function->end();
+       bbit != bbie; ++bbit) {
+    BasicBlock *bb = bbit;
+    Value *condition = getBranchCondition(bb);
+    if (!condition)
+      continue;
+    std::set<Value*> visited;
+    std::vector<Value*> stack(1, condition);
+    std::vector<Value*> &deps = conditionValues[bb];
+    while (!stack.empty()) {
+      Value *v = stack.back();
+      stack.pop_back();
+      if (!visited.insert(v).second)
+        continue;
+      if (!registers.count(v))
+        continue;
+      deps.push_back(v);
+      if (Instruction *i = dyn_cast<Instruction>(v))
+        for (unsigned j = 0; j < i->getNumOperands(); ++j)
+          stack.push_back(i->getOperand(j));
+    }
+  }
+
+  // Registers are shared by values that are never live at the same time,
+  // so at a merge point only the formals, the PHI nodes and the values live
+  // there are worth weighing, each in a register of its own. The other
+  // registers are written before they are read again.
+  std::vector<Instruction*> values;
+  std::map<Value*, unsigned> valueIndex;
+  std::map<BasicBlock*, unsigned> blockIndex;
+  std::vector<BitVector> liveIn, liveOut;
+  computeLiveness(function, values, valueIndex, blockIndex, liveIn, liveOut);
+  std::vector<bool> alwaysLive(numRegisters);
+  for (unsigned i = 0; i < numArgs; ++i)
+    alwaysLive[i] = true;
+  for (unsigned i = 0; i < numInstructions; ++i)
+    if (isa<PHINode>(instructions[i]->inst))
+      alwaysLive[instructions[i]->dest] = true;
+
+  PostDominatorTree pdt;
+  pdt.runOnFunction(*function);
+
+  std::map<BasicBlock*, MergePoint*> joins;
+  std::vector<unsigned> counts(numRegisters);
+  for (std::map<BasicBlock*, std::vector<Value*> >::iterator
+         it = conditionValues.begin(), ie = conditionValues.end();
+       it != ie; ++it) {
+    DomTreeNode *node = pdt.getNode(it->first);
+    DomTreeNode *idom = node ? node->getIDom() : 0;
+    BasicBlock *join = idom ? idom->getBlock() : 0;
+    // The paths only join again on return if there is no such block.
+    if (!join || joins.count(join))
+      continue;
+
+    MergePoint *mp = new MergePoint();
+    joins[join] = mp;
+    mergePoints.push_back(mp);
+
+    unsigned entry = basicBlockEntry[join];
+    for (BasicBlock::iterator bit = join->begin(); isa<PHINode>(bit); ++bit)
+      ++entry;
+    instructions[entry]->mergePoint = mp;
+
+    std::vector<bool> live = alwaysLive;
+    const BitVector &in = liveIn[blockIndex[join]];
+    for (int v = in.find_first(); v != -1; v = in.find_next(v))
+      live[registers[values[v]]] = true;
+
+    // Count the branches that can follow the merge point.
+    std::fill(counts.begin(), counts.end(), 0);
+    std::set<BasicBlock*> reached;
+    std::vector<BasicBlock*> worklist(1, join);
+    reached.insert(join);
+    while (!worklist.empty()) {
+      BasicBlock *bb = worklist.back();
+      worklist.pop_back();
+      std::map<BasicBlock*, std::vector<Value*> >::iterator cit =
+        conditionValues.find(bb);
+      if (cit != conditionValues.end()) {
+        ++mp->totalQueries;
+        for (unsigned i = 0; i < cit->second.size(); ++i) {
+          Value *v = cit->second[i];
+          std::map<Value*, unsigned>::iterator vit = valueIndex.find(v);
+          if (vit == valueIndex.end() || in.test(vit->second))
+            ++counts[registers[v]];
+        }
+      }
+      TerminatorInst *ti = bb->getTerminator();
+      for (unsigned i = 0; i < ti->getNumSuccessors(); ++i)
+        if (reached.insert(ti->getSuccessor(i)).second)
+          worklist.push_back(ti->getSuccessor(i));
+    }
+    for (unsigned i = 0; i < numRegisters; ++i) {
+      if (!live[i])
+        mp->deadRegisters.push_back(i);
+      else if (counts[i])
+        mp->queries[i] = counts[i];
+    }
+  }
 }
@@ -490,3 +490,32 @@ static bool valueIsOnlyCalled(const Value *v) {
 bool klee::functionEscapes(const Function *f) {
   return !valueIsOnlyCalled(f);
 }
+
+// 64-bit FNV-1a.
+static const uint64_t FNVOffsetBasis = 14695981039346656037ULL;
+
+static uint64_t hashBytes(uint64_t hash, const char *data, size_t size) {
+  for (size_t i = 0; i != size; ++i) {
+    hash ^= (unsigned char) data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t klee::getStringHash(const std::string &s) {
+  return hashBytes(FNVOffsetBasis, s.data(), s.size());
+}
+
+uint64_t klee::getFileHash(const std::string &fileName) {
+  std::ifstream f(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!f.good())
+    return 0;
+
+  uint64_t hash = FNVOffsetBasis;
+  char buffer[65536];
+  while (f.good()) {
+    f.read(buffer, sizeof(buffer));
+    hash = hashBytes(hash, buffer, f.gcount());
+  }
+  return f.bad() ? 0 : hash;
+}
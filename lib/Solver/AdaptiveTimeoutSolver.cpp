@@ -0,0 +1,338 @@
+//===-- AdaptiveTimeoutSolver.cpp -----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/ExprHashMap.h"
+
+#include "SolverStats.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  cl::opt<unsigned>
+  AdaptiveTimeoutGiveUp("adaptive-timeout-give-up",
+                        cl::desc("Fail queries of a shape at once after this "
+                                 "many of them timed out and none was "
+                                 "answered, 0 to never give up (default=3)"),
+                        cl::init(3));
+
+  cl::opt<double>
+  AdaptiveTimeoutFactor("adaptive-timeout-factor",
+                        cl::desc("Limit queries of a shape to this multiple "
+                                 "of the slowest answered one, 0 to always "
+                                 "use the full timeout (default=4)"),
+                        cl::init(4.0));
+}
+
+/// Successes needed before the budget of a shape is lowered.
+static const unsigned MinSamples = 8;
+
+/// Every this many queries of a shape given up on is still tried, so that
+/// a shape which only failed early on is not lost for good.
+static const unsigned ProbeInterval = 16;
+
+/// The budget the core solver actually applies for a timeout of t seconds.
+/// The default one, STP in a forked process, arms alarm() with whole
+/// seconds and at least one.
+static double appliedBudget(double t) {
+  return std::max(1., std::floor(t));
+}
+
+namespace {
+
+/// QueryShape - A fingerprint of the structure of a query: how often each
+/// kind of expression occurs (on a log scale), how many arrays it reads and
+/// how wide its widest expression is. Queries of the same shape tend to
+/// take similar time.
+class QueryShape {
+  std::vector<unsigned char> features;
+
+  static unsigned char bucket(unsigned count) {
+    unsigned char res = 0;
+    for (; count; count >>= 1)
+      ++res;
+    return res;
+  }
+
+public:
+  explicit QueryShape(const Query &query);
+
+  bool operator<(const QueryShape &b) const { return features < b.features; }
+};
+
+/// What is known about the queries of one shape.
+struct ShapeStats {
+  unsigned successes;
+  unsigned timeouts;
+  /// Queries of the shape failed at once since the last one tried.
+  unsigned skipped;
+  /// The time taken by the slowest answered query, in seconds.
+  double slowest;
+  /// Whether a lowered budget may be used, cleared when a query times out
+  /// under one.
+  bool shortenable;
+
+  ShapeStats()
+    : successes(0), timeouts(0), skipped(0), slowest(0), shortenable(true) {}
+};
+
+}
+
+QueryShape::QueryShape(const Query &query)
+  : features(Expr::LastKind + 4, 0) {
+  std::vector<unsigned> counts(Expr::LastKind + 2, 0);
+  std::set<const Array*> arrays;
+  unsigned maxWidth = 0;
+
+  ExprHashSet visited;
+  std::vector< ref<Expr> > stack(query.constraints.begin(),
+                                 query.constraints.end());
+  stack.push_back(query.expr);
+  while (!stack.empty()) {
+    ref<Expr> e = stack.back();
+    stack.pop_back();
+    if (!visited.insert(e).second)
+      continue;
+
+    ++counts[e->getKind()];
+    maxWidth = std::max(maxWidth, e->getWidth());
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      arrays.insert(re->updates.root);
+      // Writes are counted after the kinds of expressions.
+      for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+        ++counts[Expr::LastKind + 1];
+        stack.push_back(un->index);
+        stack.push_back(un->value);
+      }
+    }
+    for (unsigned i = 0, e2 = e->getNumKids(); i != e2; ++i)
+      stack.push_back(e->getKid(i));
+  }
+
+  for (unsigned i = 0; i != counts.size(); ++i)
+    features[i] = bucket(counts[i]);
+  features[Expr::LastKind + 2] = bucket(arrays.size());
+  features[Expr::LastKind + 3] = bucket(maxWidth);
+}
+
+/***/
+
+/// AdaptiveTimeoutSolver - Learns how long queries of each shape take and
+/// picks the timeout of each query accordingly. Shapes which only ever timed
+/// out are failed without calling the solver, and shapes which are always
+/// answered quickly get a budget below the core solver timeout. A query
+/// which times out under a lowered budget is tried once more with the rest
+/// of the full timeout.
+class AdaptiveTimeoutSolver : public SolverImpl {
+private:
+  Solver *solver;
+  /// The timeout set from above, 0 for none.
+  double timeout;
+  /// The timeout the core solver currently has.
+  double coreTimeout;
+  std::map<QueryShape, ShapeStats> shapes;
+  /// Whether the last query was failed without calling the solver.
+  bool gaveUp;
+
+  void setCoreTimeout(double t);
+  ShapeStats *begin(const Query &query, double &budget);
+  bool end(ShapeStats *stats, double &budget, double start, bool success);
+
+public:
+  AdaptiveTimeoutSolver(Solver *_solver)
+    : solver(_solver), timeout(0), coreTimeout(0), gaveUp(false) {}
+  ~AdaptiveTimeoutSolver() { delete solver; }
+
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result, const Query& full_query);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+void AdaptiveTimeoutSolver::setCoreTimeout(double t) {
+  if (t != coreTimeout) {
+    coreTimeout = t;
+    solver->impl->setCoreSolverTimeout(t);
+  }
+}
+
+/// Decide the budget of a query. Returns null if the query should be
+/// failed without calling the solver.
+ShapeStats *AdaptiveTimeoutSolver::begin(const Query &query, double &budget) {
+  gaveUp = false;
+  budget = timeout;
+  // Without a timeout nothing fails, so there is nothing to learn.
+  if (!timeout)
+    return 0;
+
+  ShapeStats &stats = shapes[QueryShape(query)];
+  if (AdaptiveTimeoutGiveUp && !stats.successes &&
+      stats.timeouts >= AdaptiveTimeoutGiveUp &&
+      ++stats.skipped < ProbeInterval) {
+    gaveUp = true;
+    ++stats::adaptiveTimeoutGiveUps;
+    stats::adaptiveTimeoutSavedTime += appliedBudget(timeout) * 1000000.;
+    return 0;
+  }
+  stats.skipped = 0;
+
+  if (AdaptiveTimeoutFactor > 0 && stats.shortenable &&
+      stats.successes >= MinSamples) {
+    double shortened = appliedBudget(stats.slowest * AdaptiveTimeoutFactor);
+    if (shortened < appliedBudget(timeout)) {
+      ++stats::adaptiveTimeoutShortened;
+      budget = shortened;
+      setCoreTimeout(budget);
+    }
+  }
+  return &stats;
+}
+
+/// Learn from the outcome of a query started at start. Returns true if it
+/// timed out under a lowered budget and should be tried again, with the
+/// rest of the full timeout.
+bool AdaptiveTimeoutSolver::end(ShapeStats *stats, double &budget,
+                                double start, bool success) {
+  if (success) {
+    ++stats->successes;
+    stats->slowest = std::max(stats->slowest, util::getWallTime() - start);
+  } else if (solver->impl->getOperationStatusCode() ==
+             SolverImpl::SOLVER_RUN_STATUS_TIMEOUT) {
+    if (budget != timeout) {
+      // The budget was too low for this shape, go back to the full one.
+      stats->shortenable = false;
+      budget = timeout;
+      double left = timeout - (util::getWallTime() - start);
+      if (left > 0) {
+        setCoreTimeout(appliedBudget(left));
+        return true;
+      }
+    } else {
+      ++stats->timeouts;
+    }
+  }
+  setCoreTimeout(timeout);
+  return false;
+}
+
+bool AdaptiveTimeoutSolver::computeValidity(const Query& query,
+                                            Solver::Validity &result) {
+  double budget;
+  ShapeStats *stats = begin(query, budget);
+  if (gaveUp)
+    return false;
+  if (!stats)
+    return solver->impl->computeValidity(query, result);
+
+  double start = util::getWallTime();
+  bool success;
+  do {
+    success = solver->impl->computeValidity(query, result);
+  } while (end(stats, budget, start, success));
+  return success;
+}
+
+bool AdaptiveTimeoutSolver::computeTruth(const Query& query, bool &isValid) {
+  double budget;
+  ShapeStats *stats = begin(query, budget);
+  if (gaveUp)
+    return false;
+  if (!stats)
+    return solver->impl->computeTruth(query, isValid);
+
+  double start = util::getWallTime();
+  bool success;
+  do {
+    success = solver->impl->computeTruth(query, isValid);
+  } while (end(stats, budget, start, success));
+  return success;
+}
+
+bool AdaptiveTimeoutSolver::computeValue(const Query& query,
+                                         ref<Expr> &result,
+                                         const Query& full_query) {
+  double budget;
+  ShapeStats *stats = begin(query, budget);
+  if (gaveUp)
+    return false;
+  if (!stats)
+    return solver->impl->computeValue(query, result, full_query);
+
+  double start = util::getWallTime();
+  bool success;
+  do {
+    success = solver->impl->computeValue(query, result, full_query);
+  } while (end(stats, budget, start, success));
+  return success;
+}
+
+bool
+AdaptiveTimeoutSolver::computeInitialValues(const Query& query,
+                                            const std::vector<const Array*>
+                                              &objects,
+                                            std::vector< std::vector<unsigned char> >
+                                              &values,
+                                            bool &hasSolution) {
+  double budget;
+  ShapeStats *stats = begin(query, budget);
+  if (gaveUp)
+    return false;
+  if (!stats)
+    return solver->impl->computeInitialValues(query, objects, values,
+                                              hasSolution);
+
+  double start = util::getWallTime();
+  bool success;
+  do {
+    success = solver->impl->computeInitialValues(query, objects, values,
+                                                 hasSolution);
+  } while (end(stats, budget, start, success));
+  return success;
+}
+
+SolverImpl::SolverRunStatus AdaptiveTimeoutSolver::getOperationStatusCode() {
+  if (gaveUp)
+    return SOLVER_RUN_STATUS_TIMEOUT;
+  return solver->impl->getOperationStatusCode();
+}
+
+char *AdaptiveTimeoutSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void AdaptiveTimeoutSolver::setCoreSolverTimeout(double _timeout) {
+  timeout = coreTimeout = _timeout;
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createAdaptiveTimeoutSolver(Solver *_solver) {
+  return new Solver(new AdaptiveTimeoutSolver(_solver));
+}
@@ -0,0 +1,298 @@
+//===-- BitBlastSolver.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+
+#include "BitBlaster.h"
+#include "SATSolver.h"
+#include "SolverStats.h"
+
+#include "llvm/Support/CommandLine.h"
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  cl::opt<unsigned>
+  BitBlastMaxClauses("bit-blast-max-clauses",
+                     cl::desc("Start the bit-blasting solver afresh once it "
+                              "holds this many clauses (default=2000000)"),
+                     cl::init(2000000));
+
+  cl::opt<unsigned>
+  BitBlastMaxConflicts("bit-blast-max-conflicts",
+                       cl::desc("Pass a query on to the core solver once "
+                                "bit-blasting it hits this many conflicts, "
+                                "0 for no limit (default=5000)"),
+                       cl::init(5000));
+}
+
+/// Below this many variables the clause database is kept whatever the query.
+static const unsigned MinResetVariables = 100000;
+
+/// The clause database is started afresh when a query depends on fewer than
+/// one in this many of its variables.
+static const unsigned UnrelatedFactor = 8;
+
+/// BitBlastSolver - Answers queries which read arrays only at constant
+/// indices by bit-blasting them into an embedded SAT solver, and passes the
+/// others on to the underlying solver.
+///
+/// The circuits and learned clauses are kept across queries: the facts of
+/// a query are only assumed, so everything in the clause database stays
+/// true and the next query, typically from the same path, starts from it.
+class BitBlastSolver : public SolverImpl {
+private:
+  Solver *solver;
+  SATSolver *sat;
+  BitBlaster *blaster;
+  double timeout;
+  SolverRunStatus runStatusCode;
+  /// Whether the last query was passed on.
+  bool forwarded;
+
+  bool isSupported(const Query &query);
+  void reset();
+  void construct(const Query &query,
+                 std::vector<SATSolver::Lit> &assumptions,
+                 std::vector<unsigned> &cone);
+  SATSolver::Result solve(const Query &query,
+                          const std::vector<const Array*> &objects,
+                          std::vector< std::vector<unsigned char> > &values,
+                          bool &hasSolution);
+
+public:
+  BitBlastSolver(Solver *_solver);
+  ~BitBlastSolver();
+
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result, const Query& full_query);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+BitBlastSolver::BitBlastSolver(Solver *_solver)
+  : solver(_solver), sat(0), blaster(0), timeout(0),
+    runStatusCode(SOLVER_RUN_STATUS_FAILURE), forwarded(false) {
+  reset();
+}
+
+BitBlastSolver::~BitBlastSolver() {
+  delete blaster;
+  delete sat;
+  delete solver;
+}
+
+void BitBlastSolver::reset() {
+  delete blaster;
+  delete sat;
+  sat = new SATSolver();
+  blaster = new BitBlaster(*sat);
+}
+
+bool BitBlastSolver::isSupported(const Query &query) {
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it)
+    if (!BitBlaster::isSupported(*it))
+      return false;
+  return BitBlaster::isSupported(query.expr);
+}
+
+bool BitBlastSolver::computeTruth(const Query& query, bool &isValid) {
+  std::vector<const Array*> objects;
+  std::vector< std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (isSupported(query)) {
+    switch (solve(query, objects, values, hasSolution)) {
+    case SATSolver::Satisfiable:
+    case SATSolver::Unsatisfiable:
+      isValid = !hasSolution;
+      return true;
+    default:
+      if (runStatusCode == SOLVER_RUN_STATUS_TIMEOUT)
+        return false;
+    }
+  }
+
+  forwarded = true;
+  return solver->impl->computeTruth(query, isValid);
+}
+
+bool BitBlastSolver::computeValue(const Query& query,
+                                  ref<Expr> &result,
+                                  const Query& full_query) {
+  std::vector<const Array*> objects;
+  std::vector< std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (isSupported(full_query.withFalse()) && isSupported(query)) {
+    findSymbolicObjects(query.expr, objects);
+    switch (solve(full_query.withFalse(), objects, values, hasSolution)) {
+    case SATSolver::Satisfiable:
+    case SATSolver::Unsatisfiable: {
+      assert(hasSolution && "state has invalid constraint set");
+      Assignment a(objects, values);
+      result = a.evaluate(query.expr);
+      return true;
+    }
+    default:
+      if (runStatusCode == SOLVER_RUN_STATUS_TIMEOUT)
+        return false;
+    }
+  }
+
+  forwarded = true;
+  return solver->impl->computeValue(query, result, full_query);
+}
+
+bool
+BitBlastSolver::computeInitialValues(const Query& query,
+                                     const std::vector<const Array*>
+                                       &objects,
+                                     std::vector< std::vector<unsigned char> >
+                                       &values,
+                                     bool &hasSolution) {
+  if (isSupported(query)) {
+    switch (solve(query, objects, values, hasSolution)) {
+    case SATSolver::Satisfiable:
+    case SATSolver::Unsatisfiable:
+      return true;
+    default:
+      if (runStatusCode == SOLVER_RUN_STATUS_TIMEOUT)
+        return false;
+    }
+  }
+
+  forwarded = true;
+  return solver->impl->computeInitialValues(query, objects, values,
+                                            hasSolution);
+}
+
+/// construct - Bit-blast a query, giving the literals to assume (the
+/// query is valid iff the constraints and its negation are unsatisfiable)
+/// and the variables they depend on.
+void BitBlastSolver::construct(const Query &query,
+                               std::vector<SATSolver::Lit> &assumptions,
+                               std::vector<unsigned> &cone) {
+  TimerStatIncrementer t(stats::queryConstructTime);
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it)
+    assumptions.push_back(blaster->constructBool(*it));
+  assumptions.push_back(SATSolver::negate(blaster->constructBool(query.expr)));
+  blaster->getCone(assumptions, cone);
+}
+
+/// solve - Bit-blast a query and solve it. Unknown means the time is up
+/// (the status code is then a timeout) or the query was too hard for the
+/// conflict budget and should be passed on.
+SATSolver::Result
+BitBlastSolver::solve(const Query& query,
+                      const std::vector<const Array*> &objects,
+                      std::vector< std::vector<unsigned char> > &values,
+                      bool &hasSolution) {
+  forwarded = false;
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  TimerStatIncrementer t(stats::queryTime);
+  if (sat->numClauses() > BitBlastMaxClauses)
+    reset();
+
+  std::vector<SATSolver::Lit> assumptions;
+  std::vector<unsigned> cone;
+  construct(query, assumptions, cone);
+
+  // Assigning the inputs still propagates through the circuits of earlier
+  // queries, so start afresh once they are mostly unrelated to this one.
+  if (sat->numVariables() > MinResetVariables &&
+      sat->numVariables() / UnrelatedFactor > cone.size()) {
+    reset();
+    assumptions.clear();
+    cone.clear();
+    construct(query, assumptions, cone);
+  }
+
+  // Nor should the search waste decisions on them.
+  sat->setDecisionVariables(cone);
+
+  double deadline = timeout ? util::getWallTime() + timeout : 0;
+  SATSolver::Result res = sat->solve(assumptions, deadline,
+                                     BitBlastMaxConflicts);
+  switch (res) {
+  case SATSolver::Satisfiable:
+    ++stats::queries;
+    ++stats::queryCounterexamples;
+    ++stats::bitBlastQueries;
+    hasSolution = true;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+    values.reserve(objects.size());
+    for (std::vector<const Array*>::const_iterator
+           it = objects.begin(), ie = objects.end(); it != ie; ++it) {
+      const Array *array = *it;
+      std::vector<unsigned char> data;
+      data.reserve(array->size);
+      for (unsigned offset = 0; offset < array->size; offset++)
+        data.push_back(blaster->getInitialValue(array, offset));
+      values.push_back(data);
+    }
+    ++stats::queriesInvalid;
+    break;
+
+  case SATSolver::Unsatisfiable:
+    ++stats::queries;
+    ++stats::queryCounterexamples;
+    ++stats::bitBlastQueries;
+    hasSolution = false;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+    ++stats::queriesValid;
+    break;
+
+  default:
+    if (deadline && util::getWallTime() > deadline) {
+      ++stats::queries;
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+    }
+    break;
+  }
+  return res;
+}
+
+SolverImpl::SolverRunStatus BitBlastSolver::getOperationStatusCode() {
+  if (forwarded)
+    return solver->impl->getOperationStatusCode();
+  return runStatusCode;
+}
+
+char *BitBlastSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void BitBlastSolver::setCoreSolverTimeout(double _timeout) {
+  timeout = _timeout;
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createBitBlastSolver(Solver *_solver) {
+  return new Solver(new BitBlastSolver(_solver));
+}
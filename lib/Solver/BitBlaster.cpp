@@ -0,0 +1,556 @@
+//===-- BitBlaster.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BitBlaster.h"
+
+#include "klee/Expr.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace klee;
+
+/// The largest number of gates (roughly) a query may need for its
+/// multiplications, divisions and shifts by symbolic amounts, beyond which
+/// the circuit would not be worth it.
+static const unsigned MaxNonLinearCost = 1 << 16;
+
+BitBlaster::BitBlaster(SATSolver &_solver)
+  : solver(_solver), visitStamp(0) {
+  trueLit = newLit();
+  assert(trueLit == 0 && "newGate() uses 0 for no input");
+  std::vector<Lit> unit(1, trueLit);
+  solver.addClause(unit);
+}
+
+BitBlaster::Lit BitBlaster::newLit() {
+  return SATSolver::mkLit(solver.newVariable());
+}
+
+BitBlaster::Lit BitBlaster::newGate(Lit a, Lit b, Lit c) {
+  Lit g = newLit();
+  unsigned v = SATSolver::var(g);
+  if (fanin.size() < 3 * (v + 1))
+    fanin.resize(3 * (v + 1));
+  fanin[3 * v] = SATSolver::var(a);
+  fanin[3 * v + 1] = SATSolver::var(b);
+  fanin[3 * v + 2] = SATSolver::var(c);
+  return g;
+}
+
+void BitBlaster::addClause(Lit a, Lit b) {
+  std::vector<Lit> c(2);
+  c[0] = a;
+  c[1] = b;
+  solver.addClause(c);
+}
+
+void BitBlaster::addClause(Lit a, Lit b, Lit c) {
+  std::vector<Lit> cl(3);
+  cl[0] = a;
+  cl[1] = b;
+  cl[2] = c;
+  solver.addClause(cl);
+}
+
+/***/
+
+BitBlaster::Lit BitBlaster::mkAnd(Lit a, Lit b) {
+  if (isFalse(a) || isFalse(b) || a == SATSolver::negate(b))
+    return getFalse();
+  if (isTrue(a) || a == b)
+    return b;
+  if (isTrue(b))
+    return a;
+
+  if (b < a)
+    std::swap(a, b);
+  std::pair<Lit, Lit> key(a, b);
+  std::map<std::pair<Lit, Lit>, Lit>::iterator it = andGates.find(key);
+  if (it != andGates.end())
+    return it->second;
+
+  Lit g = newGate(a, b);
+  addClause(SATSolver::negate(g), a);
+  addClause(SATSolver::negate(g), b);
+  addClause(g, SATSolver::negate(a), SATSolver::negate(b));
+  andGates.insert(std::make_pair(key, g));
+  return g;
+}
+
+BitBlaster::Lit BitBlaster::mkXor(Lit a, Lit b) {
+  if (isFalse(a))
+    return b;
+  if (isTrue(a))
+    return SATSolver::negate(b);
+  if (isFalse(b))
+    return a;
+  if (isTrue(b))
+    return SATSolver::negate(a);
+  if (a == b)
+    return getFalse();
+  if (a == SATSolver::negate(b))
+    return trueLit;
+
+  // Negations are pulled out, so a gate serves all four polarities.
+  bool flip = SATSolver::isNegated(a) != SATSolver::isNegated(b);
+  a = SATSolver::mkLit(SATSolver::var(a));
+  b = SATSolver::mkLit(SATSolver::var(b));
+  if (b < a)
+    std::swap(a, b);
+  std::pair<Lit, Lit> key(a, b);
+  Lit g;
+  std::map<std::pair<Lit, Lit>, Lit>::iterator it = xorGates.find(key);
+  if (it != xorGates.end()) {
+    g = it->second;
+  } else {
+    g = newGate(a, b);
+    Lit na = SATSolver::negate(a), nb = SATSolver::negate(b);
+    Lit ng = SATSolver::negate(g);
+    addClause(ng, a, b);
+    addClause(ng, na, nb);
+    addClause(g, na, b);
+    addClause(g, a, nb);
+    xorGates.insert(std::make_pair(key, g));
+  }
+  return flip ? SATSolver::negate(g) : g;
+}
+
+BitBlaster::Lit BitBlaster::mkIte(Lit c, Lit t, Lit e) {
+  if (isTrue(c) || t == e)
+    return t;
+  if (isFalse(c))
+    return e;
+  if (isTrue(t))
+    return mkOr(c, e);
+  if (isFalse(t))
+    return mkAnd(SATSolver::negate(c), e);
+  if (isTrue(e))
+    return mkOr(SATSolver::negate(c), t);
+  if (isFalse(e))
+    return mkAnd(c, t);
+
+  std::pair<Lit, std::pair<Lit, Lit> > key(c, std::make_pair(t, e));
+  std::map<std::pair<Lit, std::pair<Lit, Lit> >, Lit>::iterator it =
+    iteGates.find(key);
+  if (it != iteGates.end())
+    return it->second;
+
+  Lit g = newGate(c, t, e);
+  Lit nc = SATSolver::negate(c), ng = SATSolver::negate(g);
+  addClause(nc, SATSolver::negate(t), g);
+  addClause(nc, t, ng);
+  addClause(c, SATSolver::negate(e), g);
+  addClause(c, e, ng);
+  // Redundant, but they let unit propagation see through the condition.
+  addClause(SATSolver::negate(t), SATSolver::negate(e), g);
+  addClause(t, e, ng);
+  iteGates.insert(std::make_pair(key, g));
+  return g;
+}
+
+/***/
+
+BitBlaster::Bits BitBlaster::constantBits(const llvm::APInt &value) {
+  Bits res;
+  res.reserve(value.getBitWidth());
+  for (unsigned i = 0, e = value.getBitWidth(); i != e; ++i)
+    res.push_back(value[i] ? trueLit : getFalse());
+  return res;
+}
+
+bool BitBlaster::isConstant(const Bits &a, llvm::APInt &value) const {
+  value = llvm::APInt(a.size(), 0);
+  for (unsigned i = 0, e = a.size(); i != e; ++i) {
+    if (isTrue(a[i]))
+      value.setBit(i);
+    else if (!isFalse(a[i]))
+      return false;
+  }
+  return true;
+}
+
+BitBlaster::Bits BitBlaster::add(const Bits &a, const Bits &b, Lit carry,
+                                 Lit *carryOut) {
+  Bits res;
+  res.reserve(a.size());
+  for (unsigned i = 0, e = a.size(); i != e; ++i) {
+    Lit x = mkXor(a[i], b[i]);
+    res.push_back(mkXor(x, carry));
+    carry = mkOr(mkAnd(a[i], b[i]), mkAnd(carry, x));
+  }
+  if (carryOut)
+    *carryOut = carry;
+  return res;
+}
+
+BitBlaster::Bits BitBlaster::negateBits(const Bits &a) {
+  Bits inverted, zero(a.size(), getFalse());
+  for (unsigned i = 0, e = a.size(); i != e; ++i)
+    inverted.push_back(SATSolver::negate(a[i]));
+  return add(inverted, zero, trueLit);
+}
+
+BitBlaster::Bits BitBlaster::mul(const Bits &a, const Bits &b) {
+  // Operands can be constant without being ConstantExprs, e.g. x & ~x.
+  llvm::APInt valueA, valueB;
+  bool constantA = isConstant(a, valueA), constantB = isConstant(b, valueB);
+  if (constantA && constantB)
+    return constantBits(valueA * valueB);
+  // Rows for the zero bits of a constant multiplier are skipped, so put a
+  // constant operand second.
+  if (constantA)
+    return mul(b, a);
+
+  unsigned width = a.size();
+  Bits res(width, getFalse());
+  for (unsigned i = 0; i != width; ++i) {
+    if (isFalse(b[i]))
+      continue;
+    // Add a shifted by i, where b has bit i set.
+    Bits partial(width, getFalse());
+    for (unsigned j = 0; j + i < width; ++j)
+      partial[j + i] = mkAnd(a[j], b[i]);
+    res = add(res, partial, getFalse());
+  }
+  return res;
+}
+
+void BitBlaster::udivrem(const Bits &a, const Bits &b, Bits &q, Bits &r) {
+  // Restoring division. Dividing by zero gives all ones and the dividend,
+  // as in SMT-LIB.
+  unsigned width = a.size();
+  Bits divisor(b), invDivisor;
+  divisor.push_back(getFalse());
+  for (unsigned i = 0; i != width + 1; ++i)
+    invDivisor.push_back(SATSolver::negate(divisor[i]));
+
+  q.assign(width, getFalse());
+  r.assign(width, getFalse());
+  for (unsigned i = width; i-- > 0;) {
+    Bits shifted(1, a[i]);
+    shifted.insert(shifted.end(), r.begin(), r.end());
+    // No borrow out of shifted - divisor means shifted >= divisor.
+    Lit ge;
+    Bits diff = add(shifted, invDivisor, trueLit, &ge);
+    q[i] = ge;
+    for (unsigned j = 0; j != width; ++j)
+      r[j] = mkIte(ge, diff[j], shifted[j]);
+  }
+}
+
+void BitBlaster::sdivrem(const Bits &a, const Bits &b, Bits &q, Bits &r) {
+  Lit signA = a.back(), signB = b.back();
+  Bits absA = ite(signA, negateBits(a), a);
+  Bits absB = ite(signB, negateBits(b), b);
+  Bits uq, ur;
+  udivrem(absA, absB, uq, ur);
+  q = ite(mkXor(signA, signB), negateBits(uq), uq);
+  r = ite(signA, negateBits(ur), ur);
+}
+
+BitBlaster::Bits BitBlaster::shift(const Bits &a, const Bits &amount,
+                                   Expr::Kind kind) {
+  unsigned width = a.size();
+  Lit fill = kind == Expr::AShr ? a.back() : getFalse();
+
+  // Shifting by the width or more gives zero, as in STPBuilder. The
+  // width need not be a power of two, so compare the whole amount.
+  Lit overflow =
+    SATSolver::negate(ult(amount, constantBits(llvm::APInt(width, width))));
+
+  Bits res(a);
+  for (unsigned k = 0; k != amount.size(); ++k) {
+    // Larger amounts overflow.
+    if (k >= 32 || (1U << k) >= width)
+      continue;
+    unsigned by = 1U << k;
+    Bits shifted(width, fill);
+    for (unsigned i = 0; i != width; ++i) {
+      if (kind == Expr::Shl) {
+        if (i >= by)
+          shifted[i] = res[i - by];
+      } else if (i + by < width) {
+        shifted[i] = res[i + by];
+      }
+    }
+    res = ite(amount[k], shifted, res);
+  }
+  return ite(overflow, Bits(width, getFalse()), res);
+}
+
+BitBlaster::Lit BitBlaster::eq(const Bits &a, const Bits &b) {
+  Lit res = trueLit;
+  for (unsigned i = 0, e = a.size(); i != e; ++i)
+    res = mkAnd(res, SATSolver::negate(mkXor(a[i], b[i])));
+  return res;
+}
+
+BitBlaster::Lit BitBlaster::ult(const Bits &a, const Bits &b) {
+  // From the low bits up, the highest differing bit decides.
+  Lit res = getFalse();
+  for (unsigned i = 0, e = a.size(); i != e; ++i)
+    res = mkIte(mkXor(a[i], b[i]), b[i], res);
+  return res;
+}
+
+BitBlaster::Lit BitBlaster::slt(const Bits &a, const Bits &b) {
+  Bits fa(a), fb(b);
+  fa.back() = SATSolver::negate(fa.back());
+  fb.back() = SATSolver::negate(fb.back());
+  return ult(fa, fb);
+}
+
+BitBlaster::Bits BitBlaster::ite(Lit c, const Bits &t, const Bits &e) {
+  Bits res;
+  res.reserve(t.size());
+  for (unsigned i = 0, n = t.size(); i != n; ++i)
+    res.push_back(mkIte(c, t[i], e[i]));
+  return res;
+}
+
+/***/
+
+BitBlaster::Bits BitBlaster::constructRead(const ReadExpr *re) {
+  uint64_t index = cast<ConstantExpr>(re->index)->getZExtValue();
+  for (const UpdateNode *un = re->updates.head; un; un = un->next)
+    if (cast<ConstantExpr>(un->index)->getZExtValue() == index)
+      return construct(un->value);
+
+  const Array *array = re->updates.root;
+  if (array->isConstantArray())
+    return constantBits(array->constantValues[index]->getAPValue());
+
+  Bits &bits = initialReads[std::make_pair(array, (unsigned) index)];
+  if (bits.empty())
+    for (unsigned i = 0, e = array->getRange(); i != e; ++i)
+      bits.push_back(newLit());
+  return bits;
+}
+
+BitBlaster::Bits BitBlaster::construct(const ref<Expr> &e) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
+    return constantBits(CE->getAPValue());
+
+  ExprHashMap<Bits>::iterator it = constructed.find(e);
+  if (it != constructed.end())
+    return it->second;
+
+  Bits res = constructActual(e);
+  assert(res.size() == e->getWidth() && "width mismatch");
+  constructed.insert(std::make_pair(e, res));
+  return res;
+}
+
+BitBlaster::Bits BitBlaster::constructActual(const ref<Expr> &e) {
+  switch (e->getKind()) {
+  case Expr::NotOptimized:
+    return construct(cast<NotOptimizedExpr>(e)->src);
+
+  case Expr::Read:
+    return constructRead(cast<ReadExpr>(e));
+
+  case Expr::Select: {
+    SelectExpr *se = cast<SelectExpr>(e);
+    return ite(constructBool(se->cond), construct(se->trueExpr),
+               construct(se->falseExpr));
+  }
+
+  case Expr::Concat: {
+    ConcatExpr *ce = cast<ConcatExpr>(e);
+    Bits res = construct(ce->getRight()), left = construct(ce->getLeft());
+    res.insert(res.end(), left.begin(), left.end());
+    return res;
+  }
+
+  case Expr::Extract: {
+    ExtractExpr *ee = cast<ExtractExpr>(e);
+    Bits src = construct(ee->expr);
+    return Bits(src.begin() + ee->offset,
+                src.begin() + ee->offset + ee->width);
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    CastExpr *ce = cast<CastExpr>(e);
+    Bits res = construct(ce->src);
+    Lit fill = e->getKind() == Expr::SExt ? res.back() : getFalse();
+    res.resize(ce->width, fill);
+    return res;
+  }
+
+  case Expr::Not: {
+    Bits res = construct(cast<NotExpr>(e)->expr);
+    for (unsigned i = 0, n = res.size(); i != n; ++i)
+      res[i] = SATSolver::negate(res[i]);
+    return res;
+  }
+
+  default:
+    break;
+  }
+
+  BinaryExpr *be = cast<BinaryExpr>(e);
+  Bits l = construct(be->left), r = construct(be->right);
+  Bits res;
+  switch (e->getKind()) {
+  case Expr::Add:
+    return add(l, r, getFalse());
+  case Expr::Sub: {
+    for (unsigned i = 0, n = r.size(); i != n; ++i)
+      r[i] = SATSolver::negate(r[i]);
+    return add(l, r, trueLit);
+  }
+  case Expr::Mul:
+    return mul(l, r);
+  case Expr::UDiv:
+  case Expr::URem:
+  case Expr::SDiv:
+  case Expr::SRem: {
+    Bits q;
+    if (e->getKind() == Expr::UDiv || e->getKind() == Expr::URem)
+      udivrem(l, r, q, res);
+    else
+      sdivrem(l, r, q, res);
+    return (e->getKind() == Expr::UDiv || e->getKind() == Expr::SDiv) ? q : res;
+  }
+
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor:
+    for (unsigned i = 0, n = l.size(); i != n; ++i)
+      res.push_back(e->getKind() == Expr::And ? mkAnd(l[i], r[i]) :
+                    e->getKind() == Expr::Or ? mkOr(l[i], r[i]) :
+                    mkXor(l[i], r[i]));
+    return res;
+
+  case Expr::Shl:
+  case Expr::LShr:
+  case Expr::AShr:
+    return shift(l, r, e->getKind());
+
+  case Expr::Eq:
+    return Bits(1, eq(l, r));
+  case Expr::Ne:
+    return Bits(1, SATSolver::negate(eq(l, r)));
+  case Expr::Ult:
+    return Bits(1, ult(l, r));
+  case Expr::Ule:
+    return Bits(1, SATSolver::negate(ult(r, l)));
+  case Expr::Ugt:
+    return Bits(1, ult(r, l));
+  case Expr::Uge:
+    return Bits(1, SATSolver::negate(ult(l, r)));
+  case Expr::Slt:
+    return Bits(1, slt(l, r));
+  case Expr::Sle:
+    return Bits(1, SATSolver::negate(slt(r, l)));
+  case Expr::Sgt:
+    return Bits(1, slt(r, l));
+  case Expr::Sge:
+    return Bits(1, SATSolver::negate(slt(l, r)));
+
+  default:
+    assert(0 && "unhandled Expr type");
+    return Bits(e->getWidth(), getFalse());
+  }
+}
+
+/***/
+
+bool BitBlaster::isSupported(const ref<Expr> &root) {
+  ExprHashSet visited;
+  std::vector< ref<Expr> > stack(1, root);
+  unsigned cost = 0;
+  while (!stack.empty()) {
+    ref<Expr> e = stack.back();
+    stack.pop_back();
+    if (isa<ConstantExpr>(e) || !visited.insert(e).second)
+      continue;
+
+    switch (e->getKind()) {
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      const ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index);
+      if (!CE || CE->getZExtValue() >= re->updates.root->size)
+        return false;
+      for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+        if (!isa<ConstantExpr>(un->index))
+          return false;
+        stack.push_back(un->value);
+      }
+      continue;
+    }
+
+    case Expr::Mul:
+    case Expr::UDiv:
+    case Expr::SDiv:
+    case Expr::URem:
+    case Expr::SRem:
+    case Expr::Shl:
+    case Expr::LShr:
+    case Expr::AShr: {
+      // Operations by constants mostly fold away.
+      const BinaryExpr *be = cast<BinaryExpr>(e);
+      if (!isa<ConstantExpr>(be->left) && !isa<ConstantExpr>(be->right)) {
+        unsigned width = e->getWidth();
+        bool isShift = e->getKind() == Expr::Shl ||
+          e->getKind() == Expr::LShr || e->getKind() == Expr::AShr;
+        cost += isShift ? width * 8 : width * width;
+        if (cost > MaxNonLinearCost)
+          return false;
+      }
+      break;
+    }
+
+    default:
+      break;
+    }
+
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      stack.push_back(e->getKid(i));
+  }
+  return true;
+}
+
+void BitBlaster::getCone(const std::vector<Lit> &roots,
+                         std::vector<unsigned> &vars) {
+  fanin.resize(3 * solver.numVariables());
+  visited.resize(solver.numVariables());
+  ++visitStamp;
+
+  std::vector<unsigned> stack;
+  for (std::vector<Lit>::const_iterator it = roots.begin(),
+         ie = roots.end(); it != ie; ++it)
+    stack.push_back(SATSolver::var(*it));
+  while (!stack.empty()) {
+    unsigned v = stack.back();
+    stack.pop_back();
+    if (!v || visited[v] == visitStamp)
+      continue;
+    visited[v] = visitStamp;
+    vars.push_back(v);
+    for (unsigned i = 0; i != 3; ++i)
+      stack.push_back(fanin[3 * v + i]);
+  }
+}
+
+unsigned char BitBlaster::getInitialValue(const Array *array, unsigned index) {
+  std::map<std::pair<const Array*, unsigned>, Bits>::iterator it =
+    initialReads.find(std::make_pair(array, index));
+  if (it == initialReads.end())
+    return 0;
+
+  unsigned char res = 0;
+  for (unsigned i = 0, e = std::min(8U, (unsigned) it->second.size());
+       i != e; ++i)
+    if (solver.modelValue(it->second[i]))
+      res |= 1 << i;
+  return res;
+}
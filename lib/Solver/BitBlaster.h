@@ -0,0 +1,107 @@
+//===-- BitBlaster.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __UTIL_BITBLASTER_H__
+#define __UTIL_BITBLASTER_H__
+
+#include "SATSolver.h"
+
+#include "klee/util/ExprHashMap.h"
+
+#include <map>
+#include <vector>
+
+namespace klee {
+
+  /// BitBlaster - Translates bitvector expressions into circuits of SAT
+  /// clauses, one literal per bit (least significant first).
+  ///
+  /// Arrays may only be read at constant indices, each initial byte of a
+  /// symbolic array becoming its own variables. The circuit of every
+  /// expression is kept, so that later queries over the same expressions
+  /// reuse it (and the clauses learned on it).
+  class BitBlaster {
+  public:
+    typedef SATSolver::Lit Lit;
+    typedef std::vector<Lit> Bits;
+
+  private:
+    SATSolver &solver;
+    Lit trueLit;
+
+    /// The variables each gate is computed from, three per variable (the
+    /// variable of trueLit where unused, and for inputs).
+    std::vector<unsigned> fanin;
+    /// Marks the variables visited by getCone().
+    std::vector<unsigned> visited;
+    unsigned visitStamp;
+
+    ExprHashMap<Bits> constructed;
+    std::map<std::pair<const Array*, unsigned>, Bits> initialReads;
+
+    /// Structural hashing of the gates, keyed by their inputs.
+    std::map<std::pair<Lit, Lit>, Lit> andGates, xorGates;
+    std::map<std::pair<Lit, std::pair<Lit, Lit> >, Lit> iteGates;
+
+    bool isTrue(Lit l) const { return l == trueLit; }
+    bool isFalse(Lit l) const { return l == SATSolver::negate(trueLit); }
+    Lit getFalse() const { return SATSolver::negate(trueLit); }
+    Lit newLit();
+    Lit newGate(Lit a, Lit b, Lit c = 0);
+    void addClause(Lit a, Lit b);
+    void addClause(Lit a, Lit b, Lit c);
+
+    Lit mkAnd(Lit a, Lit b);
+    Lit mkOr(Lit a, Lit b) {
+      return SATSolver::negate(mkAnd(SATSolver::negate(a),
+                                     SATSolver::negate(b)));
+    }
+    Lit mkXor(Lit a, Lit b);
+    Lit mkIte(Lit c, Lit t, Lit e);
+
+    Bits constantBits(const llvm::APInt &value);
+    /// Whether all bits are constant, and if so their value.
+    bool isConstant(const Bits &a, llvm::APInt &value) const;
+    Bits add(const Bits &a, const Bits &b, Lit carry, Lit *carryOut = 0);
+    Bits negateBits(const Bits &a);
+    Bits mul(const Bits &a, const Bits &b);
+    void udivrem(const Bits &a, const Bits &b, Bits &q, Bits &r);
+    void sdivrem(const Bits &a, const Bits &b, Bits &q, Bits &r);
+    Bits shift(const Bits &a, const Bits &amount, Expr::Kind kind);
+    Lit eq(const Bits &a, const Bits &b);
+    Lit ult(const Bits &a, const Bits &b);
+    Lit slt(const Bits &a, const Bits &b);
+    Bits ite(Lit c, const Bits &t, const Bits &e);
+
+    Bits constructRead(const ReadExpr *re);
+    Bits constructActual(const ref<Expr> &e);
+
+  public:
+    BitBlaster(SATSolver &_solver);
+
+    /// isSupported - Whether an expression can be translated: it reads
+    /// arrays at constant indices only.
+    static bool isSupported(const ref<Expr> &e);
+
+    Bits construct(const ref<Expr> &e);
+    Lit constructBool(const ref<Expr> &e) { return construct(e)[0]; }
+
+    /// getCone - Collect the variables the given literals are computed from,
+    /// themselves included. Deciding only on these is enough to solve
+    /// for the literals.
+    void getCone(const std::vector<Lit> &roots, std::vector<unsigned> &vars);
+
+    /// getInitialValue - The value of an initial array byte in the last
+    /// model, or 0 if no query read it.
+    unsigned char getInitialValue(const Array *array, unsigned index);
+  };
+
+}
+
+#endif
@@ -0,0 +1,243 @@
+//===-- CanonicalSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// QueryCanonicalizer - Rewrites the expressions of one query over canonical
+/// arrays, numbered in the order in which the symbolic arrays are first
+/// reached, and puts the operands of commutative expressions in a fixed
+/// order. Alpha-equivalent queries are rewritten to the same expressions.
+class QueryCanonicalizer {
+  std::map<const Array*, const Array*> arrays;
+  std::map<const UpdateNode*, UpdateList> updates;
+  ExprHashMap< ref<Expr> > rewritten;
+
+  UpdateList canonicalize(const UpdateList &ul);
+
+public:
+  const Array *canonicalize(const Array *array);
+  ref<Expr> canonicalize(const ref<Expr> &e);
+  void canonicalize(const ConstraintManager &constraints,
+                    std::vector< ref<Expr> > &result);
+};
+
+}
+
+const Array *QueryCanonicalizer::canonicalize(const Array *array) {
+  // Constant arrays are compared by their contents already.
+  if (array->isConstantArray())
+    return array;
+
+  std::map<const Array*, const Array*>::iterator it = arrays.find(array);
+  if (it != arrays.end())
+    return it->second;
+
+  // The size is part of the name so that logged queries using a canonical
+  // array of another size still parse.
+  std::ostringstream name;
+  name << "canon" << arrays.size() << "_" << array->size;
+  if (array->domain != Expr::Int32 || array->range != Expr::Int8)
+    name << "_" << array->domain << "_" << array->range;
+  const Array *res = Array::CreateArray(name.str(), array->size, 0, 0,
+                                        array->domain, array->range);
+  arrays.insert(std::make_pair(array, res));
+  return res;
+}
+
+UpdateList QueryCanonicalizer::canonicalize(const UpdateList &ul) {
+  const Array *root = canonicalize(ul.root);
+  if (!ul.head)
+    return UpdateList(root, 0);
+
+  // Only the writes newer than the newest node already renamed are
+  // replayed, oldest first, on top of its result.
+  UpdateList res(root, 0);
+  std::vector<const UpdateNode*> writes;
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    std::map<const UpdateNode*, UpdateList>::iterator it = updates.find(un);
+    if (it != updates.end()) {
+      res = it->second;
+      break;
+    }
+    writes.push_back(un);
+  }
+
+  for (std::vector<const UpdateNode*>::reverse_iterator
+         wi = writes.rbegin(), we = writes.rend(); wi != we; ++wi) {
+    ref<Expr> index = canonicalize((*wi)->index);
+    res.extend(index, canonicalize((*wi)->value));
+    updates.insert(std::make_pair(*wi, res));
+  }
+  return res;
+}
+
+static bool isCommutative(Expr::Kind k) {
+  switch (k) {
+  case Expr::Add:
+  case Expr::Mul:
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor:
+  case Expr::Eq:
+    return true;
+  default:
+    return false;
+  }
+}
+
+ref<Expr> QueryCanonicalizer::canonicalize(const ref<Expr> &e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+
+  ExprHashMap< ref<Expr> >::iterator it = rewritten.find(e);
+  if (it != rewritten.end())
+    return it->second;
+
+  ref<Expr> res;
+  if (ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    UpdateList ul = canonicalize(re->updates);
+    res = ReadExpr::create(ul, canonicalize(re->index));
+  } else {
+    ref<Expr> kids[8];
+    unsigned count = e->getNumKids();
+    for (unsigned i = 0; i != count; ++i)
+      kids[i] = canonicalize(e->getKid(i));
+    // Constants have the lowest kind, so they stay on the left where the
+    // builders expect them.
+    if (isCommutative(e->getKind()) && kids[1].compare(kids[0]) < 0)
+      std::swap(kids[0], kids[1]);
+    res = e->rebuild(kids);
+  }
+
+  rewritten.insert(std::make_pair(e, res));
+  return res;
+}
+
+void QueryCanonicalizer::canonicalize(const ConstraintManager &constraints,
+                                      std::vector< ref<Expr> > &result) {
+  result.reserve(constraints.size());
+  for (ConstraintManager::const_iterator it = constraints.begin(),
+         ie = constraints.end(); it != ie; ++it)
+    result.push_back(canonicalize(*it));
+}
+
+/***/
+
+/// CanonicalSolver - Rewrites each query over canonical arrays before
+/// passing it on, so that the caches below share the entries of queries
+/// which only differ in the names of their arrays.
+class CanonicalSolver : public SolverImpl {
+private:
+  Solver *solver;
+
+public:
+  CanonicalSolver(Solver *_solver) : solver(_solver) {}
+  ~CanonicalSolver() { delete solver; }
+
+  bool computeValidity(const Query&, Solver::Validity &result);
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result, const Query& full_query);
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double timeout);
+};
+
+bool CanonicalSolver::computeValidity(const Query& query,
+                                      Solver::Validity &result) {
+  QueryCanonicalizer qc;
+  std::vector< ref<Expr> > constraints;
+  qc.canonicalize(query.constraints, constraints);
+  ConstraintManager cm(constraints);
+  return solver->impl->computeValidity(Query(cm, qc.canonicalize(query.expr)),
+                                       result);
+}
+
+bool CanonicalSolver::computeTruth(const Query& query, bool &isValid) {
+  QueryCanonicalizer qc;
+  std::vector< ref<Expr> > constraints;
+  qc.canonicalize(query.constraints, constraints);
+  ConstraintManager cm(constraints);
+  return solver->impl->computeTruth(Query(cm, qc.canonicalize(query.expr)),
+                                    isValid);
+}
+
+bool CanonicalSolver::computeValue(const Query& query, ref<Expr> &result,
+                                   const Query& full_query) {
+  // Both queries are rewritten with the same renaming, so that the full
+  // query still constrains the arrays read by the expression.
+  QueryCanonicalizer qc;
+  std::vector< ref<Expr> > constraints, fullConstraints;
+  qc.canonicalize(query.constraints, constraints);
+  qc.canonicalize(full_query.constraints, fullConstraints);
+  ConstraintManager cm(constraints), fullCm(fullConstraints);
+  return solver->impl->computeValue(Query(cm, qc.canonicalize(query.expr)),
+                                    result,
+                                    Query(fullCm,
+                                          qc.canonicalize(full_query.expr)));
+}
+
+bool
+CanonicalSolver::computeInitialValues(const Query& query,
+                                      const std::vector<const Array*>
+                                        &objects,
+                                      std::vector< std::vector<unsigned char> >
+                                        &values,
+                                      bool &hasSolution) {
+  QueryCanonicalizer qc;
+  std::vector< ref<Expr> > constraints;
+  qc.canonicalize(query.constraints, constraints);
+  ConstraintManager cm(constraints);
+  ref<Expr> expr = qc.canonicalize(query.expr);
+
+  // The values come back in the order of the objects, so they need no
+  // mapping back to the original arrays.
+  std::vector<const Array*> canonicalObjects;
+  canonicalObjects.reserve(objects.size());
+  for (std::vector<const Array*>::const_iterator it = objects.begin(),
+         ie = objects.end(); it != ie; ++it)
+    canonicalObjects.push_back(qc.canonicalize(*it));
+
+  return solver->impl->computeInitialValues(Query(cm, expr), canonicalObjects,
+                                            values, hasSolution);
+}
+
+SolverImpl::SolverRunStatus CanonicalSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *CanonicalSolver::getConstraintLog(const Query& query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void CanonicalSolver::setCoreSolverTimeout(double timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+///
+
+Solver *klee::createCanonicalSolver(Solver *_solver) {
+  return new Solver(new CanonicalSolver(_solver));
+}
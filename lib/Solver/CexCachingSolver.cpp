@@ -14,9 +14,10 @@
 #include "klee/SolverImpl.h"
 #include "klee/TimerStatIncrementer.h"
 #include "klee/util/Assignment.h"
+#include "klee/util/ExprProgram.h"
 #include "klee/util/ExprUtil.h"
 #include "klee/util/ExprVisitor.h"
-#include "klee/Internal/ADT/MapOfSets.h"
+#include "klee/Internal/ADT/SetIndex.h"
 
 #include "SolverStats.h"
 
@@ -43,6 +44,16 @@ namespace {
   cl::opt<bool>
   CexCacheExperimental("cex-cache-exp", cl::init(false));
 
+  cl::opt<unsigned>
+  CexCacheMaxSize("cex-cache-max-size",
+                  cl::desc("Maximum number of queries kept in the counterexample cache, the least recently used are evicted with the counterexamples only they refer to (default=1000000, 0=unlimited)"),
+                  cl::init(1000000));
+
+  cl::opt<bool>
+  CexCacheCompiledEval("cex-cache-compiled-eval",
+                       cl::desc("Check cached counterexamples against a query compiled to a flat program instead of walking its expressions (default=on)"),
+                       cl::init(true));
+
 }
 
 ///
@@ -61,7 +72,7 @@ class CexCachingSolver : public SolverImpl {
 
   Solver *solver;
   
-  MapOfSets<ref<Expr>, Assignment*> cache;
+  SetIndex<ref<Expr>, Assignment*> cache;
   // memo table
   assignmentsTable_ty assignmentsTable;
 
@@ -76,9 +87,12 @@ class CexCachingSolver : public SolverImpl {
   }
 
   bool getAssignment(const Query& query, Assignment *&result);
+
+  void sweepAssignments();
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver) 
+    : solver(_solver), cache(CexCacheMaxSize) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -103,13 +117,38 @@ struct NonNullAssignment {
   bool operator()(Assignment *a) const { return a!=0; }
 };
 
-struct NullOrSatisfyingAssignment {
+/// AssignmentChecker - Checks assignments against a query, which is
+/// compiled the first time an assignment is checked.
+class AssignmentChecker {
   KeyType &key;
+  ExprProgram *program;
+
+public:
+  AssignmentChecker(KeyType &_key) : key(_key), program(0) {}
+  ~AssignmentChecker() { delete program; }
+
+  bool satisfies(Assignment *a) {
+    if (CexCacheCompiledEval) {
+      if (!program)
+        program = new ExprProgram(key.begin(), key.end());
+      switch (program->evaluate(*a)) {
+      case ExprProgram::True: return true;
+      case ExprProgram::False: return false;
+      case ExprProgram::Unknown: break;
+      }
+    }
+    return a->satisfies(key.begin(), key.end());
+  }
+};
+
+struct NullOrSatisfyingAssignment {
+  AssignmentChecker &checker;
   
-  NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
+  NullOrSatisfyingAssignment(AssignmentChecker &_checker) 
+    : checker(_checker) {}
 
   bool operator()(Assignment *a) const { 
-    return !a || a->satisfies(key.begin(), key.end()); 
+    return !a || checker.satisfies(a); 
   }
 };
 
@@ -127,6 +166,8 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
     return true;
   }
 
+  AssignmentChecker checker(key);
+
   if (CexCacheTryAll) {
     // Look for a satisfying assignment for a superset, which is trivially an
     // assignment for any subset.
@@ -149,7 +190,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
     for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
            ie = assignmentsTable.end(); it != ie; ++it) {
       Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
+      if (checker.satisfies(a)) {
         result = a;
         return true;
       }
@@ -169,7 +210,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
     // satisfiable subsets to see if they solve the current query and return
     // them if so. This is cheap and frequently succeeds.
     if (!lookup) 
-      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key));
+      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(checker));
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
@@ -247,9 +288,31 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   result = binding;
   cache.insert(key, binding);
 
+  // Evicted or replaced cache entries leave assignments behind, free
+  // them once they outnumber the entries.
+  if (assignmentsTable.size() > 2 * cache.size())
+    sweepAssignments();
+
   return true;
 }
 
+/// sweepAssignments - Free the assignments no cache entry refers to.
+void CexCachingSolver::sweepAssignments() {
+  std::vector<Assignment*> values;
+  cache.getValues(values);
+  std::set<Assignment*> live(values.begin(), values.end());
+  for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
+         ie = assignmentsTable.end(); it != ie;) {
+    Assignment *a = *it;
+    if (live.count(a)) {
+      ++it;
+    } else {
+      assignmentsTable.erase(it++);
+      delete a;
+    }
+  }
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
@@ -0,0 +1,443 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/SolverImpl.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+#include "klee/Internal/System/Time.h"
+
+#include "SolverStats.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+/// The wins of each member, by its position in the portfolio. The last one
+/// also counts the wins of any later members.
+static Statistic *const portfolioWins[] = {
+  &stats::portfolioWins1, &stats::portfolioWins2,
+  &stats::portfolioWins3, &stats::portfolioWins4
+};
+static const unsigned MaxPortfolioWinStats =
+  sizeof(portfolioWins) / sizeof(portfolioWins[0]);
+
+namespace {
+  llvm::cl::opt<unsigned>
+  PortfolioLearnStreak("portfolio-learn-streak",
+                       llvm::cl::desc("Run only the backend which won the last "
+                                      "N races on queries of the same shape, "
+                                      "0 always races (default=8)"),
+                       llvm::cl::init(8));
+
+  llvm::cl::opt<unsigned>
+  PortfolioRaceInterval("portfolio-race-interval",
+                        llvm::cl::desc("Race all backends again on every Nth "
+                                       "query of a learned shape "
+                                       "(default=16)"),
+                        llvm::cl::init(16));
+}
+
+/// PortfolioSolver - Runs each query on several core solvers at once, each
+/// in a forked worker process, takes the first answer and kills the other
+/// workers.
+///
+/// Queries are grouped by a coarse shape (number of constraints and bytes
+/// of the objects asked for). Once a backend wins every race of a shape
+/// for a while, that backend alone is run on the shape, still in a worker
+/// and under the timeout, with an occasional race to notice when another
+/// backend becomes faster.
+class PortfolioSolver : public SolverImpl {
+private:
+  struct Member {
+    CoreSolverType type;
+    Solver *solver;
+  };
+
+  struct Worker {
+    pid_t pid;
+    int fd;
+    unsigned member;
+  };
+
+  struct ShapeInfo {
+    unsigned winner;
+    unsigned streak;
+    unsigned soloRuns;
+    ShapeInfo() : winner(0), streak(0), soloRuns(0) {}
+  };
+
+  std::vector<Member> members;
+  std::map<std::pair<unsigned, unsigned>, ShapeInfo> shapes;
+  double timeout;
+  SolverRunStatus runStatusCode;
+
+  std::pair<unsigned, unsigned>
+  getShape(const Query &query, const std::vector<const Array*> &objects);
+
+  bool startWorker(unsigned member, const Query &query,
+                   const std::vector<const Array*> &objects, Worker &w);
+  bool readResult(Worker &w, const std::vector<const Array*> &objects,
+                  std::vector< std::vector<unsigned char> > &values,
+                  bool &hasSolution);
+  void stopWorkers(std::vector<Worker> &workers);
+  SolverRunStatus race(const std::vector<unsigned> &racers,
+                       const Query &query,
+                       const std::vector<const Array*> &objects,
+                       std::vector< std::vector<unsigned char> > &values,
+                       bool &hasSolution, unsigned &winner);
+
+public:
+  PortfolioSolver(const std::vector<Solver*> &solvers,
+                  const std::vector<CoreSolverType> &types);
+  ~PortfolioSolver();
+
+  void setCoreSolverTimeout(double _timeout);
+  char *getConstraintLog(const Query &query) {
+    return members[0].solver->getConstraintLog(query);
+  }
+
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result, const Query& full_query);
+  bool computeInitialValues(const Query&,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+};
+
+PortfolioSolver::PortfolioSolver(const std::vector<Solver*> &solvers,
+                                 const std::vector<CoreSolverType> &types)
+  : timeout(0.0), runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+  for (unsigned i = 0, e = solvers.size(); i != e; ++i) {
+    Member m;
+    m.type = types[i];
+    m.solver = solvers[i];
+    members.push_back(m);
+  }
+}
+
+PortfolioSolver::~PortfolioSolver() {
+  for (unsigned i = 0, e = members.size(); i != e; ++i)
+    delete members[i].solver;
+}
+
+void PortfolioSolver::setCoreSolverTimeout(double _timeout) {
+  // The workers are killed at the timeout, the members get it too so that
+  // those which honour it give up cleanly before.
+  timeout = _timeout;
+  for (unsigned i = 0, e = members.size(); i != e; ++i)
+    members[i].solver->setCoreSolverTimeout(_timeout);
+}
+
+static unsigned log2Bucket(uint64_t n) {
+  unsigned res = 0;
+  for (; n; n >>= 1)
+    ++res;
+  return res;
+}
+
+std::pair<unsigned, unsigned>
+PortfolioSolver::getShape(const Query &query,
+                          const std::vector<const Array*> &objects) {
+  uint64_t bytes = 0;
+  for (unsigned i = 0, e = objects.size(); i != e; ++i)
+    bytes += objects[i]->size;
+  return std::make_pair(log2Bucket(query.constraints.size()),
+                        log2Bucket(bytes));
+}
+
+static bool writeAll(int fd, const void *data, size_t size) {
+  const char *p = (const char*) data;
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool PortfolioSolver::startWorker(unsigned member, const Query &query,
+                                  const std::vector<const Array*> &objects,
+                                  Worker &w) {
+  int fds[2];
+  if (pipe(fds) < 0)
+    return false;
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    SolverImpl *impl = members[member].solver->impl;
+    std::vector< std::vector<unsigned char> > values;
+    bool hasSolution = false;
+    unsigned char header[2];
+    header[0] = impl->computeInitialValues(query, objects, values,
+                                           hasSolution);
+    header[1] = hasSolution;
+    bool ok = writeAll(fds[1], header, sizeof(header));
+    if (header[0] && hasSolution)
+      for (unsigned i = 0, e = values.size(); ok && i != e; ++i)
+        if (!values[i].empty())
+          ok = writeAll(fds[1], &values[i][0], values[i].size());
+    _exit(ok ? 0 : 1);
+  }
+
+  close(fds[1]);
+  w.pid = pid;
+  w.fd = fds[0];
+  w.member = member;
+  return true;
+}
+
+/// Read the answer of a worker which has become readable, returning false
+/// if it failed or died.
+bool PortfolioSolver::readResult(Worker &w,
+                                 const std::vector<const Array*> &objects,
+                                 std::vector< std::vector<unsigned char> >
+                                   &values,
+                                 bool &hasSolution) {
+  std::vector<unsigned char> data;
+  unsigned char buf[4096];
+  for (;;) {
+    ssize_t n = read(w.fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    data.insert(data.end(), buf, buf + n);
+  }
+
+  if (data.size() < 2 || !data[0])
+    return false;
+  hasSolution = data[1];
+  if (!hasSolution)
+    return data.size() == 2;
+
+  size_t pos = 2;
+  values.clear();
+  for (unsigned i = 0, e = objects.size(); i != e; ++i) {
+    if (pos + objects[i]->size > data.size())
+      return false;
+    values.push_back(std::vector<unsigned char>(data.begin() + pos,
+                                                data.begin() + pos +
+                                                objects[i]->size));
+    pos += objects[i]->size;
+  }
+  return pos == data.size();
+}
+
+void PortfolioSolver::stopWorkers(std::vector<Worker> &workers) {
+  for (unsigned i = 0, e = workers.size(); i != e; ++i)
+    kill(workers[i].pid, SIGKILL);
+  for (unsigned i = 0, e = workers.size(); i != e; ++i) {
+    close(workers[i].fd);
+    while (waitpid(workers[i].pid, 0, 0) < 0 && errno == EINTR)
+      ;
+  }
+  workers.clear();
+}
+
+SolverImpl::SolverRunStatus
+PortfolioSolver::race(const std::vector<unsigned> &racers,
+                      const Query &query,
+                      const std::vector<const Array*> &objects,
+                      std::vector< std::vector<unsigned char> > &values,
+                      bool &hasSolution, unsigned &winner) {
+  std::vector<Worker> workers;
+  for (unsigned i = 0, e = racers.size(); i != e; ++i) {
+    Worker w;
+    if (startWorker(racers[i], query, objects, w))
+      workers.push_back(w);
+  }
+  if (workers.empty()) {
+    fprintf(stderr, "ERROR: fork failed (for portfolio solver)\n");
+    return SOLVER_RUN_STATUS_FORK_FAILED;
+  }
+
+  double deadline = timeout ? util::getWallTime() + timeout : 0;
+  while (!workers.empty()) {
+    int wait = -1;
+    if (timeout) {
+      double left = deadline - util::getWallTime();
+      if (left <= 0)
+        break;
+      wait = (int) (left * 1000) + 1;
+    }
+
+    std::vector<struct pollfd> fds(workers.size());
+    for (unsigned i = 0, e = workers.size(); i != e; ++i) {
+      fds[i].fd = workers[i].fd;
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+    }
+    int res = poll(&fds[0], fds.size(), wait);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res < 0)
+      break;
+
+    for (unsigned i = fds.size(); i != 0; --i) {
+      if (!fds[i - 1].revents)
+        continue;
+      Worker w = workers[i - 1];
+      workers.erase(workers.begin() + (i - 1));
+      bool answered = readResult(w, objects, values, hasSolution);
+      close(w.fd);
+      while (waitpid(w.pid, 0, 0) < 0 && errno == EINTR)
+        ;
+      if (answered) {
+        winner = w.member;
+        stopWorkers(workers);
+        return hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                           : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+      }
+    }
+  }
+
+  bool timedOut = !workers.empty();
+  stopWorkers(workers);
+  if (timedOut) {
+    fprintf(stderr, "error: portfolio solver timed out\n");
+    return SOLVER_RUN_STATUS_TIMEOUT;
+  }
+  return SOLVER_RUN_STATUS_FAILURE;
+}
+
+bool PortfolioSolver::computeTruth(const Query& query, bool &isValid) {
+  std::vector<const Array*> objects;
+  std::vector< std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (!computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  isValid = !hasSolution;
+  return true;
+}
+
+bool PortfolioSolver::computeValue(const Query& query,
+                                   ref<Expr> &result,
+                                   const Query& full_query) {
+  std::vector<const Array*> objects;
+  std::vector< std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  // Find the object used in the expression, and compute an assignment
+  // for them.
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(full_query.withFalse(), objects, values,
+                            hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  // Evaluate the expression with the computed assignment.
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+
+  return true;
+}
+
+bool
+PortfolioSolver::computeInitialValues(const Query &query,
+                                      const std::vector<const Array*>
+                                        &objects,
+                                      std::vector< std::vector<unsigned char> >
+                                        &values,
+                                      bool &hasSolution) {
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  ++stats::queryCounterexamples;
+
+  // The learned backend runs alone, but still in a worker: the members are
+  // not forked themselves, and may neither honour the timeout nor survive
+  // the query.
+  ShapeInfo &shape = shapes[getShape(query, objects)];
+  bool solo = PortfolioLearnStreak && shape.streak >= PortfolioLearnStreak &&
+    (!PortfolioRaceInterval || ++shape.soloRuns % PortfolioRaceInterval);
+  std::vector<unsigned> racers;
+  if (solo) {
+    ++stats::portfolioSoloRuns;
+    racers.push_back(shape.winner);
+  } else {
+    ++stats::portfolioRaces;
+    for (unsigned i = 0, e = members.size(); i != e; ++i)
+      racers.push_back(i);
+  }
+
+  unsigned winner;
+  runStatusCode = race(racers, query, objects, values, hasSolution, winner);
+  if (runStatusCode != SOLVER_RUN_STATUS_SUCCESS_SOLVABLE &&
+      runStatusCode != SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+    // Race again next time, another backend may have succeeded.
+    shape.streak = 0;
+    return false;
+  }
+
+  if (!solo) {
+    if (winner == shape.winner) {
+      ++shape.streak;
+    } else {
+      shape.winner = winner;
+      shape.streak = 1;
+    }
+  }
+  ++*portfolioWins[std::min(winner, MaxPortfolioWinStats - 1)];
+
+  if (hasSolution)
+    ++stats::queriesInvalid;
+  else
+    ++stats::queriesValid;
+  return true;
+}
+
+/***/
+
+Solver *klee::createPortfolioSolver(const std::vector<CoreSolverType> &types,
+                                    bool optimizeDivides) {
+  // The workers already run in their own process, so the members are never
+  // forked themselves.
+  std::vector<Solver*> solvers;
+  for (unsigned i = 0, e = types.size(); i != e; ++i) {
+    Solver *s = createCoreSolver(types[i], false, optimizeDivides);
+    if (!s) {
+      for (unsigned j = 0; j != i; ++j)
+        delete solvers[j];
+      return 0;
+    }
+    solvers.push_back(s);
+  }
+  return new Solver(new PortfolioSolver(solvers, types));
+}
@@ -0,0 +1,469 @@
+//===-- SATSolver.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SATSolver.h"
+
+#include "klee/Internal/System/Time.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace klee;
+
+/// The number of conflicts between restarts, scaled by the Luby sequence.
+static const unsigned RestartBase = 100;
+
+/// How often the deadline is checked, in conflicts and in decisions.
+static const unsigned DeadlineInterval = 256;
+
+SATSolver::SATSolver()
+  : ok(true), propagated(0), varIncrement(1), clauseIncrement(1),
+    stamp(0), maxLearnts(2000) {}
+
+SATSolver::~SATSolver() {
+  for (std::vector<Clause*>::iterator it = clauses.begin(),
+         ie = clauses.end(); it != ie; ++it)
+    delete *it;
+  for (std::vector<Clause*>::iterator it = learnts.begin(),
+         ie = learnts.end(); it != ie; ++it)
+    delete *it;
+}
+
+unsigned SATSolver::newVariable() {
+  unsigned v = assigns.size();
+  assigns.push_back(Undef);
+  levels.push_back(0);
+  reasons.push_back(0);
+  activity.push_back(0);
+  polarity.push_back(1);
+  seen.push_back(0);
+  heapIndex.push_back(-1);
+  decisionStamp.push_back(stamp);
+  watches.resize(2 * (v + 1));
+  heapInsert(v);
+  return v;
+}
+
+void SATSolver::setDecisionVariables(const std::vector<unsigned> &vars) {
+  assert(!decisionLevel() && "decision variables changed while solving");
+  ++stamp;
+  for (std::vector<unsigned>::iterator it = heap.begin(), ie = heap.end();
+       it != ie; ++it)
+    heapIndex[*it] = -1;
+  heap.clear();
+  for (std::vector<unsigned>::const_iterator it = vars.begin(),
+         ie = vars.end(); it != ie; ++it) {
+    decisionStamp[*it] = stamp;
+    if (assigns[*it] == Undef && heapIndex[*it] < 0)
+      heapInsert(*it);
+  }
+}
+
+/***/
+
+void SATSolver::heapUp(unsigned i) {
+  unsigned v = heap[i];
+  while (i) {
+    unsigned parent = (i - 1) / 2;
+    if (activity[heap[parent]] >= activity[v])
+      break;
+    heap[i] = heap[parent];
+    heapIndex[heap[i]] = i;
+    i = parent;
+  }
+  heap[i] = v;
+  heapIndex[v] = i;
+}
+
+void SATSolver::heapDown(unsigned i) {
+  unsigned v = heap[i];
+  for (;;) {
+    unsigned child = 2 * i + 1;
+    if (child >= heap.size())
+      break;
+    if (child + 1 < heap.size() &&
+        activity[heap[child + 1]] > activity[heap[child]])
+      ++child;
+    if (activity[heap[child]] <= activity[v])
+      break;
+    heap[i] = heap[child];
+    heapIndex[heap[i]] = i;
+    i = child;
+  }
+  heap[i] = v;
+  heapIndex[v] = i;
+}
+
+void SATSolver::heapInsert(unsigned v) {
+  heapIndex[v] = heap.size();
+  heap.push_back(v);
+  heapUp(heap.size() - 1);
+}
+
+unsigned SATSolver::heapPop() {
+  unsigned v = heap[0];
+  unsigned last = heap.back();
+  heap.pop_back();
+  heapIndex[v] = -1;
+  if (!heap.empty()) {
+    heap[0] = last;
+    heapIndex[last] = 0;
+    heapDown(0);
+  }
+  return v;
+}
+
+void SATSolver::bumpVariable(unsigned v) {
+  if ((activity[v] += varIncrement) > 1e100) {
+    for (unsigned i = 0, e = activity.size(); i != e; ++i)
+      activity[i] *= 1e-100;
+    varIncrement *= 1e-100;
+  }
+  if (heapIndex[v] >= 0)
+    heapUp(heapIndex[v]);
+}
+
+void SATSolver::bumpClause(Clause *c) {
+  if ((c->activity += clauseIncrement) > 1e20) {
+    for (std::vector<Clause*>::iterator it = learnts.begin(),
+           ie = learnts.end(); it != ie; ++it)
+      (*it)->activity *= 1e-20;
+    clauseIncrement *= 1e-20;
+  }
+}
+
+/***/
+
+void SATSolver::enqueue(Lit l, Clause *reason) {
+  unsigned v = var(l);
+  assigns[v] = isNegated(l) ? False : True;
+  levels[v] = decisionLevel();
+  reasons[v] = reason;
+  trail.push_back(l);
+}
+
+void SATSolver::attach(Clause *c) {
+  watches[c->lits[0]].push_back(Watcher(c, c->lits[1]));
+  watches[c->lits[1]].push_back(Watcher(c, c->lits[0]));
+}
+
+SATSolver::Clause *SATSolver::propagate() {
+  Clause *conflict = 0;
+  while (propagated < trail.size()) {
+    Lit falseLit = negate(trail[propagated++]);
+    std::vector<Watcher> &ws = watches[falseLit];
+
+    unsigned i = 0, j = 0, n = ws.size();
+    while (i != n) {
+      if (value(ws[i].blocker) == True) {
+        ws[j++] = ws[i++];
+        continue;
+      }
+
+      Clause *c = ws[i++].clause;
+      std::vector<Lit> &lits = c->lits;
+      // Keep the false literal second.
+      if (lits[0] == falseLit)
+        std::swap(lits[0], lits[1]);
+      if (value(lits[0]) == True) {
+        ws[j++] = Watcher(c, lits[0]);
+        continue;
+      }
+
+      // Look for another literal to watch.
+      bool moved = false;
+      for (unsigned k = 2, e = lits.size(); k != e; ++k) {
+        if (value(lits[k]) != False) {
+          std::swap(lits[1], lits[k]);
+          watches[lits[1]].push_back(Watcher(c, lits[0]));
+          moved = true;
+          break;
+        }
+      }
+      if (moved)
+        continue;
+
+      ws[j++] = Watcher(c, lits[0]);
+      if (value(lits[0]) == False) {
+        conflict = c;
+        propagated = trail.size();
+        while (i != n)
+          ws[j++] = ws[i++];
+      } else if (decisionLevel() && decisionStamp[var(lits[0])] != stamp) {
+        // Outside of the decision variables, which nothing depends on. At
+        // level 0 the fact is kept though, since it outlives this call.
+      } else {
+        enqueue(lits[0], c);
+      }
+    }
+    ws.resize(j, Watcher(0, 0));
+    if (conflict)
+      break;
+  }
+  return conflict;
+}
+
+void SATSolver::analyze(Clause *conflict, std::vector<Lit> &learnt,
+                        unsigned &backtrackLevel) {
+  learnt.clear();
+  learnt.push_back(0);
+
+  unsigned pending = 0, index = trail.size();
+  Lit p = 0;
+  bool first = true;
+  Clause *c = conflict;
+  do {
+    assert(c && "conflict without a reason");
+    if (c->learnt)
+      bumpClause(c);
+    for (unsigned j = first ? 0 : 1, e = c->lits.size(); j != e; ++j) {
+      Lit q = c->lits[j];
+      unsigned v = var(q);
+      if (!seen[v] && levels[v] > 0) {
+        bumpVariable(v);
+        seen[v] = 1;
+        if ((unsigned) levels[v] >= decisionLevel())
+          ++pending;
+        else
+          learnt.push_back(q);
+      }
+    }
+    first = false;
+
+    // The next literal of the current level to resolve on.
+    while (!seen[var(trail[--index])])
+      ;
+    p = trail[index];
+    c = reasons[var(p)];
+    seen[var(p)] = 0;
+    --pending;
+  } while (pending);
+  learnt[0] = negate(p);
+
+  backtrackLevel = 0;
+  if (learnt.size() > 1) {
+    unsigned max = 1;
+    for (unsigned i = 2, e = learnt.size(); i != e; ++i)
+      if (levels[var(learnt[i])] > levels[var(learnt[max])])
+        max = i;
+    std::swap(learnt[1], learnt[max]);
+    backtrackLevel = levels[var(learnt[1])];
+  }
+
+  for (unsigned i = 1, e = learnt.size(); i != e; ++i)
+    seen[var(learnt[i])] = 0;
+}
+
+void SATSolver::cancelUntil(unsigned level) {
+  if (decisionLevel() <= level)
+    return;
+  for (unsigned i = trail.size(); i-- > trailLimits[level];) {
+    unsigned v = var(trail[i]);
+    polarity[v] = isNegated(trail[i]);
+    assigns[v] = Undef;
+    reasons[v] = 0;
+    if (heapIndex[v] < 0 && decisionStamp[v] == stamp)
+      heapInsert(v);
+  }
+  trail.resize(trailLimits[level]);
+  trailLimits.resize(level);
+  propagated = trail.size();
+}
+
+static bool lessActive(const std::pair<double, unsigned> &a,
+                       const std::pair<double, unsigned> &b) {
+  return a.first < b.first;
+}
+
+void SATSolver::reduceLearnts() {
+  std::vector< std::pair<double, unsigned> > order;
+  order.reserve(learnts.size());
+  for (unsigned i = 0, e = learnts.size(); i != e; ++i)
+    order.push_back(std::make_pair(learnts[i]->activity, i));
+  std::sort(order.begin(), order.end(), lessActive);
+
+  // Drop the less active half, keeping binary clauses and the reasons of
+  // current assignments.
+  std::vector<unsigned char> drop(learnts.size(), 0);
+  for (unsigned i = 0, e = order.size() / 2; i != e; ++i) {
+    Clause *c = learnts[order[i].second];
+    Lit l = c->lits[0];
+    if (c->lits.size() > 2 && !(reasons[var(l)] == c && value(l) == True))
+      drop[order[i].second] = 1;
+  }
+
+  unsigned j = 0;
+  for (unsigned i = 0, e = learnts.size(); i != e; ++i) {
+    if (drop[i])
+      delete learnts[i];
+    else
+      learnts[j++] = learnts[i];
+  }
+  learnts.resize(j);
+
+  // The clauses keep their watched literals first, so the watch lists can
+  // be rebuilt at any decision level.
+  for (unsigned i = 0, e = watches.size(); i != e; ++i)
+    watches[i].clear();
+  for (std::vector<Clause*>::iterator it = clauses.begin(),
+         ie = clauses.end(); it != ie; ++it)
+    attach(*it);
+  for (std::vector<Clause*>::iterator it = learnts.begin(),
+         ie = learnts.end(); it != ie; ++it)
+    attach(*it);
+
+  maxLearnts += maxLearnts / 10;
+}
+
+/***/
+
+bool SATSolver::addClause(const std::vector<Lit> &lits) {
+  assert(!decisionLevel() && "clause added during search");
+  if (!ok)
+    return false;
+
+  std::vector<Lit> c(lits);
+  std::sort(c.begin(), c.end());
+  unsigned j = 0;
+  for (unsigned i = 0, e = c.size(); i != e; ++i) {
+    // Literals of a variable are adjacent, so tautologies are too.
+    if (value(c[i]) == True || (j && c[j - 1] == negate(c[i])))
+      return true;
+    if (value(c[i]) != False && (!j || c[j - 1] != c[i]))
+      c[j++] = c[i];
+  }
+  c.resize(j);
+
+  if (c.empty()) {
+    ok = false;
+  } else if (c.size() == 1) {
+    enqueue(c[0], 0);
+    if (propagate())
+      ok = false;
+  } else {
+    Clause *clause = new Clause(c, false);
+    clauses.push_back(clause);
+    attach(clause);
+  }
+  return ok;
+}
+
+/// The i-th element of the Luby sequence 1 1 2 1 1 2 4 1 1 2 ...
+static unsigned luby(unsigned i) {
+  unsigned size = 1, seq = 0;
+  while (size < i + 1) {
+    ++seq;
+    size = 2 * size + 1;
+  }
+  while (size - 1 != i) {
+    size = (size - 1) >> 1;
+    --seq;
+    i = i % size;
+  }
+  return 1U << seq;
+}
+
+SATSolver::Result SATSolver::solve(const std::vector<Lit> &assumptions,
+                                   double deadline, unsigned maxConflicts) {
+  if (!ok)
+    return Unsatisfiable;
+  maxLearnts = std::max(maxLearnts, (unsigned) clauses.size() / 3);
+
+  std::vector<Lit> learnt;
+  unsigned conflicts = 0, decisions = 0;
+  for (unsigned restart = 0;; ++restart) {
+    unsigned limit = RestartBase * luby(restart), restartConflicts = 0;
+
+    for (;;) {
+      if (Clause *conflict = propagate()) {
+        ++conflicts;
+        ++restartConflicts;
+        if (!decisionLevel()) {
+          ok = false;
+          return Unsatisfiable;
+        }
+
+        unsigned backtrackLevel;
+        analyze(conflict, learnt, backtrackLevel);
+        cancelUntil(backtrackLevel);
+        if (learnt.size() == 1) {
+          enqueue(learnt[0], 0);
+        } else {
+          Clause *c = new Clause(learnt, true);
+          learnts.push_back(c);
+          attach(c);
+          bumpClause(c);
+          enqueue(learnt[0], c);
+        }
+        varIncrement /= 0.95;
+        clauseIncrement /= 0.999;
+
+        if (maxConflicts && conflicts >= maxConflicts) {
+          cancelUntil(0);
+          return Unknown;
+        }
+
+        if (deadline && conflicts % DeadlineInterval == 0 &&
+            util::getWallTime() > deadline) {
+          cancelUntil(0);
+          return Unknown;
+        }
+        continue;
+      }
+
+      if (restartConflicts >= limit) {
+        cancelUntil(0);
+        break;
+      }
+      if (learnts.size() >= maxLearnts + trail.size())
+        reduceLearnts();
+
+      // Assumptions are decided first, one level each.
+      bool found = false;
+      Lit next = 0;
+      while (decisionLevel() < assumptions.size()) {
+        Lit p = assumptions[decisionLevel()];
+        if (value(p) == True) {
+          trailLimits.push_back(trail.size());
+        } else if (value(p) == False) {
+          cancelUntil(0);
+          return Unsatisfiable;
+        } else {
+          next = p;
+          found = true;
+          break;
+        }
+      }
+
+      if (!found) {
+        while (!heap.empty()) {
+          unsigned v = heapPop();
+          if (assigns[v] == Undef) {
+            next = mkLit(v, polarity[v]);
+            found = true;
+            break;
+          }
+        }
+        if (!found) {
+          model = assigns;
+          cancelUntil(0);
+          return Satisfiable;
+        }
+        if (deadline && ++decisions % DeadlineInterval == 0 &&
+            util::getWallTime() > deadline) {
+          cancelUntil(0);
+          return Unknown;
+        }
+      }
+
+      trailLimits.push_back(trail.size());
+      enqueue(next, 0);
+    }
+  }
+}
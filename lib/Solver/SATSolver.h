@@ -0,0 +1,142 @@
+//===-- SATSolver.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __UTIL_SATSOLVER_H__
+#define __UTIL_SATSOLVER_H__
+
+#include <vector>
+
+namespace klee {
+
+  /// SATSolver - A small CDCL SAT solver (two watched literals, first UIP
+  /// learning, activity based decisions and Luby restarts).
+  ///
+  /// Clauses are only ever added, and queries pass their facts as
+  /// assumptions, so clauses learned while answering one query stay valid
+  /// for the next.
+  class SATSolver {
+  public:
+    /// A literal is a variable times two, plus one if negated.
+    typedef unsigned Lit;
+
+    static Lit mkLit(unsigned var, bool negated = false) {
+      return var * 2 + negated;
+    }
+    static Lit negate(Lit l) { return l ^ 1; }
+    static unsigned var(Lit l) { return l >> 1; }
+    static bool isNegated(Lit l) { return l & 1; }
+
+    enum Result { Satisfiable, Unsatisfiable, Unknown };
+
+  private:
+    struct Clause {
+      std::vector<Lit> lits;
+      bool learnt;
+      double activity;
+
+      Clause(const std::vector<Lit> &_lits, bool _learnt)
+        : lits(_lits), learnt(_learnt), activity(0) {}
+    };
+
+    enum { Undef = 0, True = 1, False = 2 };
+
+    /// False if the clauses are unsatisfiable without any assumption.
+    bool ok;
+
+    std::vector<Clause*> clauses, learnts;
+    /// A clause watching a literal, with another of its literals: while
+    /// that one is true the clause need not be looked at.
+    struct Watcher {
+      Clause *clause;
+      Lit blocker;
+
+      Watcher(Clause *_clause, Lit _blocker)
+        : clause(_clause), blocker(_blocker) {}
+    };
+
+    /// The clauses watching each literal, visited when it becomes false.
+    std::vector< std::vector<Watcher> > watches;
+
+    std::vector<unsigned char> assigns;
+    std::vector<int> levels;
+    std::vector<Clause*> reasons;
+    std::vector<Lit> trail;
+    std::vector<unsigned> trailLimits;
+    unsigned propagated;
+
+    std::vector<double> activity;
+    double varIncrement, clauseIncrement;
+    std::vector<unsigned char> polarity;
+    /// Binary max-heap of the variables by activity, and each variable's
+    /// position in it (-1 if not in the heap).
+    std::vector<unsigned> heap;
+    std::vector<int> heapIndex;
+    /// Variables are decided upon only if their stamp is the current one.
+    std::vector<unsigned> decisionStamp;
+    unsigned stamp;
+
+    std::vector<unsigned char> seen;
+    std::vector<unsigned char> model;
+    unsigned maxLearnts;
+
+    unsigned value(Lit l) const {
+      unsigned char v = assigns[var(l)];
+      return v == Undef ? Undef : ((v == True) != isNegated(l) ? True : False);
+    }
+    unsigned decisionLevel() const { return trailLimits.size(); }
+
+    void enqueue(Lit l, Clause *reason);
+    Clause *propagate();
+    void analyze(Clause *conflict, std::vector<Lit> &learnt,
+                 unsigned &backtrackLevel);
+    void cancelUntil(unsigned level);
+    void attach(Clause *c);
+    void reduceLearnts();
+
+    void bumpVariable(unsigned v);
+    void bumpClause(Clause *c);
+    void heapUp(unsigned i);
+    void heapDown(unsigned i);
+    void heapInsert(unsigned v);
+    unsigned heapPop();
+
+  public:
+    SATSolver();
+    ~SATSolver();
+
+    unsigned newVariable();
+    unsigned numVariables() const { return assigns.size(); }
+    unsigned numClauses() const { return clauses.size(); }
+
+    /// addClause - Add a clause which holds from now on. Returns false if the
+    /// clauses have become unsatisfiable.
+    bool addClause(const std::vector<Lit> &lits);
+
+    /// setDecisionVariables - Only decide upon, and propagate to, the given
+    /// variables (and the ones created from now on) until the next call.
+    /// Any assignment to these must extend to one satisfying the clauses
+    /// over the other variables, as for the inputs of a circuit.
+    void setDecisionVariables(const std::vector<unsigned> &vars);
+
+    /// solve - Look for an assignment satisfying the clauses and the
+    /// assumptions, giving up after the given wall time or number of
+    /// conflicts (0 for none).
+    Result solve(const std::vector<Lit> &assumptions, double deadline,
+                 unsigned maxConflicts = 0);
+
+    /// modelValue - The value of a literal in the last satisfying
+    /// assignment.
+    bool modelValue(Lit l) const {
+      return (model[var(l)] == True) != isNegated(l);
+    }
+  };
+
+}
+
+#endif
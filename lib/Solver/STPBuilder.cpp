@@ -11,6 +11,7 @@
 
 #include "klee/Expr.h"
 #include "klee/Solver.h"
+#include "klee/TimerStatIncrementer.h"
 #include "klee/util/Bits.h"
 
 #include "ConstantDivision.h"
@@ -45,6 +46,14 @@ namespace {
   UseConstructHash("use-construct-hash", 
                    llvm::cl::desc("Use hash-consing during STP query construction."),
                    llvm::cl::init(true));
+
+  llvm::cl::opt<unsigned>
+  STPConstructCacheSize("stp-construct-cache-size",
+                        llvm::cl::desc("Maximum number of expression "
+                                       "translations kept by the STP backend "
+                                       "across queries, 0 drops them after "
+                                       "each query (default=1000000)"),
+                        llvm::cl::init(1000000));
 }
 
 ///
@@ -70,10 +79,18 @@ STPArrayExprHash::~STPArrayExprHash() {
   }
 }
 
+void STPArrayExprHash::clearUpdateNodes() {
+  for (UpdateNodeHashConstIter it = _update_node_hash.begin();
+      it != _update_node_hash.end(); ++it)
+    if (it->second)
+      ::vc_DeleteExpr(it->second);
+  _update_node_hash.clear();
+}
+
 /***/
 
 STPBuilder::STPBuilder(::VC _vc, bool _optimizeDivides) 
-  : vc(_vc), optimizeDivides(_optimizeDivides)
+  : vc(_vc), queryNumber(0), optimizeDivides(_optimizeDivides)
 {
   tempVars[0] = buildVar("__tmpInt8", 8);
   tempVars[1] = buildVar("__tmpInt16", 16);
@@ -482,23 +499,71 @@ ExprHandle STPBuilder::getInitialRead(const Array *root, unsigned index) {
   }
 }
 
+void STPBuilder::startQuery() {
+  ++queryNumber;
+  if (constructed.size() > STPConstructCacheSize ||
+      _arr_hash._update_node_hash.size() > STPConstructCacheSize)
+    evictConstructed();
+}
+
+/// Drop the translations of expressions which are only referenced by the
+/// cache itself first, as no state can ask for those again, and everything
+/// if that is not enough.
+void STPBuilder::evictConstructed() {
+  // The update node hash is keyed by address, and only the cached read
+  // expressions keep the update nodes alive.
+  _arr_hash.clearUpdateNodes();
+
+  uint64_t before = constructed.size();
+  if (STPConstructCacheSize) {
+    // Dropping an expression releases its kids, so sweep until nothing more
+    // is freed.
+    for (bool changed = true; changed &&
+           constructed.size() > STPConstructCacheSize / 2;) {
+      changed = false;
+      for (ExprHashMap<ConstructedExpr>::iterator it = constructed.begin(),
+             ie = constructed.end(); it != ie;) {
+        if (it->first->refCount == 1) {
+          constructed.erase(it++);
+          changed = true;
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+  if (constructed.size() > STPConstructCacheSize / 2)
+    constructed.clear();
+  stats::queryConstructEvictions += before - constructed.size();
+}
+
+ExprHandle STPBuilder::construct(ref<Expr> e) {
+  TimerStatIncrementer t(stats::queryConstructTime);
+  return construct(e, 0);
+}
+
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
 ExprHandle STPBuilder::construct(ref<Expr> e, int *width_out) {
   if (!UseConstructHash || isa<ConstantExpr>(e)) {
     return constructActual(e, width_out);
   } else {
-    ExprHashMap< std::pair<ExprHandle, unsigned> >::iterator it = 
-      constructed.find(e);
+    ExprHashMap<ConstructedExpr>::iterator it = constructed.find(e);
     if (it!=constructed.end()) {
+      if (it->second.query != queryNumber) {
+        // Count each translation reused from an earlier query once.
+        it->second.query = queryNumber;
+        ++stats::queryConstructCacheHits;
+      }
       if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
+        *width_out = it->second.width;
+      return it->second.expr;
     } else {
       int width;
       if (!width_out) width_out = &width;
       ExprHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
+      constructed.insert(std::make_pair(e, ConstructedExpr(res, *width_out,
+                                                           queryNumber)));
       return res;
     }
   }
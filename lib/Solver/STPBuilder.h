@@ -64,12 +64,29 @@ namespace klee {
   public:
     STPArrayExprHash() {};
     virtual ~STPArrayExprHash();
+
+    void clearUpdateNodes();
   };
 
 class STPBuilder {
+  /// An expression translated by the builder, with its width and the query
+  /// during which it was translated.
+  struct ConstructedExpr {
+    ExprHandle expr;
+    unsigned width;
+    unsigned query;
+
+    ConstructedExpr(const ExprHandle &_expr, unsigned _width, unsigned _query)
+      : expr(_expr), width(_width), query(_query) {}
+  };
+
   ::VC vc;
   ExprHandle tempVars[4];
-  ExprHashMap< std::pair<ExprHandle, unsigned> > constructed;
+
+  /// The translations are kept across queries, up to
+  /// --stp-construct-cache-size entries.
+  ExprHashMap<ConstructedExpr> constructed;
+  unsigned queryNumber;
 
   /// optimizeDivides - Rewrite division and reminders by constants
   /// into multiplies and shifts. STP should probably handle this for
@@ -113,6 +130,8 @@ private:
   
   ::VCExpr buildVar(const char *name, unsigned width);
   ::VCExpr buildArray(const char *name, unsigned indexWidth, unsigned valueWidth);
+
+  void evictConstructed();
  
 public:
   STPBuilder(::VC _vc, bool _optimizeDivides=true);
@@ -123,11 +142,11 @@ public:
   ExprHandle getTempVar(Expr::Width w);
   ExprHandle getInitialRead(const Array *os, unsigned index);
 
-  ExprHandle construct(ref<Expr> e) { 
-    ExprHandle res = construct(e, 0);
-    constructed.clear();
-    return res;
-  }
+  /// startQuery - Called before the expressions of a new query are
+  /// constructed, evicts translations if the cache has grown too large.
+  void startQuery();
+
+  ExprHandle construct(ref<Expr> e);
 };
 
 }
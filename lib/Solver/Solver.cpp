@@ -597,6 +597,7 @@ void STPSolver::setCoreSolverTimeout(double timeout) {
 /***/
 
 char *STPSolverImpl::getConstraintLog(const Query &query) {
+  builder->startQuery();
   vc_push(vc);
   for (std::vector< ref<Expr> >::const_iterator it = query.constraints.begin(), 
          ie = query.constraints.end(); it != ie; ++it)
@@ -803,6 +804,7 @@ STPSolverImpl::computeInitialValues(const Query &query,
     
   TimerStatIncrementer t(stats::queryTime);
 
+  builder->startQuery();
   vc_push(vc);
 
   for (ConstraintManager::const_iterator it = query.constraints.begin(), 
@@ -848,6 +850,23 @@ SolverImpl::SolverRunStatus STPSolverImpl::getOperationStatusCode() {
    return runStatusCode;
 }
 
+/***/
+
+Solver *klee::createCoreSolver(CoreSolverType type, bool useForkedSolver,
+                               bool optimizeDivides) {
+  switch (type) {
+  case STP_SOLVER:
+    return new STPSolver(useForkedSolver, optimizeDivides);
+  case Z3_SOLVER:
+#ifdef SUPPORT_Z3
+    return new Z3Solver();
+#else
+    return 0;
+#endif
+  }
+  return 0;
+}
+
 #ifdef SUPPORT_METASMT
 
 // ------------------------------------- MetaSMTSolverImpl class declaration ------------------------------
@@ -11,7 +11,17 @@
 
 using namespace klee;
 
+Statistic stats::adaptiveTimeoutGiveUps("AdaptiveTimeoutGiveUps", "ATgiveup");
+Statistic stats::adaptiveTimeoutSavedTime("AdaptiveTimeoutSavedTime", "ATsaved");
+Statistic stats::adaptiveTimeoutShortened("AdaptiveTimeoutShortened", "ATshort");
+Statistic stats::bitBlastQueries("BitBlastQueries", "Qbb");
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
+Statistic stats::portfolioRaces("PortfolioRaces", "PRaces");
+Statistic stats::portfolioSoloRuns("PortfolioSoloRuns", "PSolo");
+Statistic stats::portfolioWins1("PortfolioWins1", "PW1");
+Statistic stats::portfolioWins2("PortfolioWins2", "PW2");
+Statistic stats::portfolioWins3("PortfolioWins3", "PW3");
+Statistic stats::portfolioWins4("PortfolioWins4", "PW4");
 Statistic stats::queries("Queries", "Q");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
 Statistic stats::queriesValid("QueriesValid", "Qv");
@@ -19,6 +29,8 @@ Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryConstructCacheHits("QueryConstructCacheHits", "QBhits");
+Statistic stats::queryConstructEvictions("QueryConstructEvictions", "QBevict");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
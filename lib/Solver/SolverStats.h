@@ -15,7 +15,17 @@
 namespace klee {
 namespace stats {
 
+  extern Statistic adaptiveTimeoutGiveUps;
+  extern Statistic adaptiveTimeoutSavedTime;
+  extern Statistic adaptiveTimeoutShortened;
+  extern Statistic bitBlastQueries;
   extern Statistic cexCacheTime;
+  extern Statistic portfolioRaces;
+  extern Statistic portfolioSoloRuns;
+  extern Statistic portfolioWins1;
+  extern Statistic portfolioWins2;
+  extern Statistic portfolioWins3;
+  extern Statistic portfolioWins4;
   extern Statistic queries;
   extern Statistic queriesInvalid;
   extern Statistic queriesValid;
@@ -23,6 +33,8 @@ namespace stats {
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryConstructCacheHits;
+  extern Statistic queryConstructEvictions;
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
@@ -0,0 +1,335 @@
+//===-- Z3Builder.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Z3Builder.h"
+
+#ifdef SUPPORT_Z3
+
+#include "SolverStats.h"
+
+#include "klee/Expr.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+  llvm::cl::opt<unsigned>
+  Z3CacheSize("z3-cache-size",
+              llvm::cl::desc("Maximum number of expression translations "
+                             "kept by the Z3 backend (default=1000000)"),
+              llvm::cl::init(1000000));
+}
+
+Z3SortHandle Z3Builder::getBvSort(unsigned width) {
+  return Z3SortHandle(Z3_mk_bv_sort(ctx, width), ctx);
+}
+
+Z3SortHandle Z3Builder::getArraySort(unsigned domain, unsigned range) {
+  Z3SortHandle domainSort = getBvSort(domain);
+  Z3SortHandle rangeSort = getBvSort(range);
+  return Z3SortHandle(Z3_mk_array_sort(ctx, domainSort, rangeSort), ctx);
+}
+
+Z3ASTHandle Z3Builder::getTrue() {
+  return Z3ASTHandle(Z3_mk_true(ctx), ctx);
+}
+
+Z3ASTHandle Z3Builder::getFalse() {
+  return Z3ASTHandle(Z3_mk_false(ctx), ctx);
+}
+
+Z3ASTHandle Z3Builder::bvConst(unsigned width, uint64_t value) {
+  Z3SortHandle sort = getBvSort(width);
+  return Z3ASTHandle(Z3_mk_unsigned_int64(ctx, value, sort), ctx);
+}
+
+Z3ASTHandle Z3Builder::bvMinusOne(unsigned width) {
+  Z3ASTHandle zero = bvZero(width);
+  return Z3ASTHandle(Z3_mk_bvnot(ctx, zero), ctx);
+}
+
+/// Convert a width 1 expression constructed as a boolean to a bitvector.
+Z3ASTHandle Z3Builder::toBv(Z3ASTHandle e, unsigned width) {
+  if (width != 1)
+    return e;
+  Z3ASTHandle one = bvOne(1), zero = bvZero(1);
+  return Z3ASTHandle(Z3_mk_ite(ctx, e, one, zero), ctx);
+}
+
+Z3ASTHandle Z3Builder::getInitialArray(const Array *root) {
+  std::map<const Array*, Z3ASTHandle>::iterator it = arrays.find(root);
+  if (it != arrays.end())
+    return it->second;
+
+  // Z3 uniques constants by name, so make the name unique by including the
+  // address.
+  char buf[32];
+  snprintf(buf, sizeof(buf), "_%p", (const void*) root);
+  std::string name = root->name + buf;
+
+  Z3SortHandle sort = getArraySort(root->getDomain(), root->getRange());
+  Z3ASTHandle array(Z3_mk_const(ctx, Z3_mk_string_symbol(ctx, name.c_str()),
+                                sort), ctx);
+  if (root->isConstantArray()) {
+    for (unsigned i = 0, e = root->size; i != e; ++i) {
+      Z3ASTHandle index = bvConst(root->getDomain(), i);
+      Z3ASTHandle value = constructCached(root->constantValues[i]);
+      array = Z3ASTHandle(Z3_mk_store(ctx, array, index, value), ctx);
+    }
+  }
+
+  arrays.insert(std::make_pair(root, array));
+  return array;
+}
+
+Z3ASTHandle Z3Builder::getInitialRead(const Array *root, unsigned index) {
+  Z3ASTHandle array = getInitialArray(root);
+  Z3ASTHandle offset = bvConst(root->getDomain(), index);
+  return Z3ASTHandle(Z3_mk_select(ctx, array, offset), ctx);
+}
+
+Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
+                                         const UpdateNode *un) {
+  // Update lists can be long, so find the longest constructed suffix and
+  // build the remaining nodes from the tail without recursing.
+  std::vector<const UpdateNode*> pending;
+  Z3ASTHandle array;
+  for (; un; un = un->next) {
+    std::map<const UpdateNode*, Z3ASTHandle>::iterator it =
+      updateNodes.find(un);
+    if (it != updateNodes.end()) {
+      array = it->second;
+      break;
+    }
+    pending.push_back(un);
+  }
+  if (!un)
+    array = getInitialArray(root);
+
+  while (!pending.empty()) {
+    un = pending.back();
+    pending.pop_back();
+    Z3ASTHandle index = constructCached(un->index);
+    Z3ASTHandle value = constructCached(un->value);
+    array = Z3ASTHandle(Z3_mk_store(ctx, array, index, value), ctx);
+    updateNodes.insert(std::make_pair(un, array));
+  }
+
+  return array;
+}
+
+Z3ASTHandle Z3Builder::construct(ref<Expr> e) {
+  // The cache holds on to the expressions, and through them to the update
+  // nodes, so both are dropped together.
+  if (constructed.size() > Z3CacheSize) {
+    constructed.clear();
+    updateNodes.clear();
+  }
+  return constructCached(e);
+}
+
+Z3ASTHandle Z3Builder::constructCached(ref<Expr> e) {
+  if (isa<ConstantExpr>(e))
+    return constructActual(e);
+
+  ExprHashMap<Z3ASTHandle>::iterator it = constructed.find(e);
+  if (it != constructed.end())
+    return it->second;
+
+  Z3ASTHandle res = constructActual(e);
+  constructed.insert(std::make_pair(e, res));
+  return res;
+}
+
+Z3ASTHandle Z3Builder::constructActual(ref<Expr> e) {
+  ++stats::queryConstructs;
+
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    ConstantExpr *CE = cast<ConstantExpr>(e);
+    unsigned width = CE->getWidth();
+
+    if (width == 1)
+      return CE->isTrue() ? getTrue() : getFalse();
+    if (width <= 64)
+      return bvConst(width, CE->getZExtValue());
+
+    ref<ConstantExpr> Tmp = CE;
+    Z3ASTHandle Res = bvConst(64, Tmp->Extract(0, 64)->getZExtValue());
+    while (Tmp->getWidth() > 64) {
+      Tmp = Tmp->Extract(64, Tmp->getWidth()-64);
+      unsigned Width = std::min(64U, Tmp->getWidth());
+      Z3ASTHandle Hi = bvConst(Width, Tmp->Extract(0, Width)->getZExtValue());
+      Res = Z3ASTHandle(Z3_mk_concat(ctx, Hi, Res), ctx);
+    }
+    return Res;
+  }
+
+  // Special
+  case Expr::NotOptimized:
+    return constructCached(cast<NotOptimizedExpr>(e)->src);
+
+  case Expr::Read: {
+    ReadExpr *re = cast<ReadExpr>(e);
+    Z3ASTHandle array = getArrayForUpdate(re->updates.root, re->updates.head);
+    Z3ASTHandle index = constructCached(re->index);
+    return Z3ASTHandle(Z3_mk_select(ctx, array, index), ctx);
+  }
+
+  case Expr::Select: {
+    SelectExpr *se = cast<SelectExpr>(e);
+    Z3ASTHandle cond = constructCached(se->cond);
+    Z3ASTHandle tExpr = constructCached(se->trueExpr);
+    Z3ASTHandle fExpr = constructCached(se->falseExpr);
+    return Z3ASTHandle(Z3_mk_ite(ctx, cond, tExpr, fExpr), ctx);
+  }
+
+  case Expr::Concat: {
+    ConcatExpr *ce = cast<ConcatExpr>(e);
+    Z3ASTHandle left = toBv(constructCached(ce->getLeft()),
+                            ce->getLeft()->getWidth());
+    Z3ASTHandle right = toBv(constructCached(ce->getRight()),
+                             ce->getRight()->getWidth());
+    return Z3ASTHandle(Z3_mk_concat(ctx, left, right), ctx);
+  }
+
+  case Expr::Extract: {
+    ExtractExpr *ee = cast<ExtractExpr>(e);
+    unsigned srcWidth = ee->expr->getWidth();
+    Z3ASTHandle src = constructCached(ee->expr);
+    if (srcWidth == 1)
+      return src;
+    Z3ASTHandle res(Z3_mk_extract(ctx, ee->offset + ee->width - 1,
+                                  ee->offset, src), ctx);
+    if (ee->width != 1)
+      return res;
+    Z3ASTHandle one = bvOne(1);
+    return Z3ASTHandle(Z3_mk_eq(ctx, res, one), ctx);
+  }
+
+    // Casting
+
+  case Expr::ZExt: {
+    CastExpr *ce = cast<CastExpr>(e);
+    unsigned srcWidth = ce->src->getWidth();
+    Z3ASTHandle src = constructCached(ce->src);
+    if (srcWidth == 1) {
+      Z3ASTHandle one = bvOne(ce->width), zero = bvZero(ce->width);
+      return Z3ASTHandle(Z3_mk_ite(ctx, src, one, zero), ctx);
+    }
+    return Z3ASTHandle(Z3_mk_zero_ext(ctx, ce->width - srcWidth, src), ctx);
+  }
+
+  case Expr::SExt: {
+    CastExpr *ce = cast<CastExpr>(e);
+    unsigned srcWidth = ce->src->getWidth();
+    Z3ASTHandle src = constructCached(ce->src);
+    if (srcWidth == 1) {
+      Z3ASTHandle ones = bvMinusOne(ce->width), zero = bvZero(ce->width);
+      return Z3ASTHandle(Z3_mk_ite(ctx, src, ones, zero), ctx);
+    }
+    return Z3ASTHandle(Z3_mk_sign_ext(ctx, ce->width - srcWidth, src), ctx);
+  }
+
+    // Bitwise
+
+  case Expr::Not: {
+    NotExpr *ne = cast<NotExpr>(e);
+    Z3ASTHandle expr = constructCached(ne->expr);
+    if (ne->getWidth() == 1)
+      return Z3ASTHandle(Z3_mk_not(ctx, expr), ctx);
+    return Z3ASTHandle(Z3_mk_bvnot(ctx, expr), ctx);
+  }
+
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor: {
+    BinaryExpr *be = cast<BinaryExpr>(e);
+    Z3ASTHandle left = constructCached(be->left);
+    Z3ASTHandle right = constructCached(be->right);
+    if (be->getWidth() == 1) {
+      Z3_ast args[2] = { left, right };
+      switch (e->getKind()) {
+      case Expr::And: return Z3ASTHandle(Z3_mk_and(ctx, 2, args), ctx);
+      case Expr::Or: return Z3ASTHandle(Z3_mk_or(ctx, 2, args), ctx);
+      default: return Z3ASTHandle(Z3_mk_xor(ctx, left, right), ctx);
+      }
+    }
+    switch (e->getKind()) {
+    case Expr::And: return Z3ASTHandle(Z3_mk_bvand(ctx, left, right), ctx);
+    case Expr::Or: return Z3ASTHandle(Z3_mk_bvor(ctx, left, right), ctx);
+    default: return Z3ASTHandle(Z3_mk_bvxor(ctx, left, right), ctx);
+    }
+  }
+
+    // Comparison
+
+  case Expr::Eq: {
+    EqExpr *ee = cast<EqExpr>(e);
+    Z3ASTHandle right = constructCached(ee->right);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(ee->left)) {
+      if (CE->getWidth() == 1) {
+        if (CE->isTrue())
+          return right;
+        return Z3ASTHandle(Z3_mk_not(ctx, right), ctx);
+      }
+    }
+    Z3ASTHandle left = constructCached(ee->left);
+    return Z3ASTHandle(Z3_mk_eq(ctx, left, right), ctx);
+  }
+
+  default: {
+    // The remaining operations are binary operations on bitvectors.
+    BinaryExpr *be = cast<BinaryExpr>(e);
+    assert(be->left->getWidth() != 1 && "uncanonicalized expression");
+    Z3ASTHandle l = constructCached(be->left);
+    Z3ASTHandle r = constructCached(be->right);
+    Z3_ast res;
+    switch (e->getKind()) {
+    case Expr::Add: res = Z3_mk_bvadd(ctx, l, r); break;
+    case Expr::Sub: res = Z3_mk_bvsub(ctx, l, r); break;
+    case Expr::Mul: res = Z3_mk_bvmul(ctx, l, r); break;
+    case Expr::UDiv: res = Z3_mk_bvudiv(ctx, l, r); break;
+    case Expr::SDiv: res = Z3_mk_bvsdiv(ctx, l, r); break;
+    case Expr::URem: res = Z3_mk_bvurem(ctx, l, r); break;
+    case Expr::SRem: res = Z3_mk_bvsrem(ctx, l, r); break;
+    case Expr::Shl: res = Z3_mk_bvshl(ctx, l, r); break;
+    case Expr::LShr: res = Z3_mk_bvlshr(ctx, l, r); break;
+    case Expr::AShr: {
+      // Overshift to zero, as STPBuilder does.
+      Z3ASTHandle width = bvConst(be->getWidth(), be->getWidth());
+      Z3ASTHandle zero = bvZero(be->getWidth());
+      Z3ASTHandle inRange(Z3_mk_bvult(ctx, r, width), ctx);
+      Z3ASTHandle shifted(Z3_mk_bvashr(ctx, l, r), ctx);
+      res = Z3_mk_ite(ctx, inRange, shifted, zero);
+      break;
+    }
+    case Expr::Ne: res = Z3_mk_not(ctx, Z3_mk_eq(ctx, l, r)); break;
+    case Expr::Ult: res = Z3_mk_bvult(ctx, l, r); break;
+    case Expr::Ule: res = Z3_mk_bvule(ctx, l, r); break;
+    case Expr::Ugt: res = Z3_mk_bvugt(ctx, l, r); break;
+    case Expr::Uge: res = Z3_mk_bvuge(ctx, l, r); break;
+    case Expr::Slt: res = Z3_mk_bvslt(ctx, l, r); break;
+    case Expr::Sle: res = Z3_mk_bvsle(ctx, l, r); break;
+    case Expr::Sgt: res = Z3_mk_bvsgt(ctx, l, r); break;
+    case Expr::Sge: res = Z3_mk_bvsge(ctx, l, r); break;
+    default:
+      assert(0 && "unhandled Expr type");
+      return getTrue();
+    }
+    return Z3ASTHandle(res, ctx);
+  }
+  }
+}
+
+#endif /* SUPPORT_Z3 */
@@ -0,0 +1,109 @@
+//===-- Z3Builder.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __UTIL_Z3BUILDER_H__
+#define __UTIL_Z3BUILDER_H__
+
+#include "klee/Config/config.h"
+
+#ifdef SUPPORT_Z3
+
+#include "klee/util/ExprHashMap.h"
+
+#include <map>
+
+#include <z3.h>
+
+namespace klee {
+
+  inline Z3_ast toZ3AST(Z3_context ctx, Z3_ast node) { return node; }
+  inline Z3_ast toZ3AST(Z3_context ctx, Z3_sort node) {
+    return Z3_sort_to_ast(ctx, node);
+  }
+
+  /// Z3NodeHandle - Holds a reference to a node of a reference counted Z3
+  /// context.
+  template<typename T>
+  class Z3NodeHandle {
+    Z3_context ctx;
+    T node;
+
+  public:
+    Z3NodeHandle() : ctx(0), node(0) {}
+    Z3NodeHandle(T _node, Z3_context _ctx) : ctx(_ctx), node(_node) {
+      if (node)
+        Z3_inc_ref(ctx, toZ3AST(ctx, node));
+    }
+    Z3NodeHandle(const Z3NodeHandle &b) : ctx(b.ctx), node(b.node) {
+      if (node)
+        Z3_inc_ref(ctx, toZ3AST(ctx, node));
+    }
+    ~Z3NodeHandle() {
+      if (node)
+        Z3_dec_ref(ctx, toZ3AST(ctx, node));
+    }
+
+    Z3NodeHandle &operator=(const Z3NodeHandle &b) {
+      if (b.node)
+        Z3_inc_ref(b.ctx, toZ3AST(b.ctx, b.node));
+      if (node)
+        Z3_dec_ref(ctx, toZ3AST(ctx, node));
+      ctx = b.ctx;
+      node = b.node;
+      return *this;
+    }
+
+    operator T () const { return node; }
+  };
+
+  typedef Z3NodeHandle<Z3_ast> Z3ASTHandle;
+  typedef Z3NodeHandle<Z3_sort> Z3SortHandle;
+
+class Z3Builder {
+  Z3_context ctx;
+
+  /// The constructed expressions are kept across queries, as the native
+  /// backend solves incrementally and sees the same constraints over and
+  /// over. Width 1 expressions are constructed as Z3 booleans.
+  ExprHashMap<Z3ASTHandle> constructed;
+  std::map<const Array*, Z3ASTHandle> arrays;
+  std::map<const UpdateNode*, Z3ASTHandle> updateNodes;
+
+  Z3SortHandle getBvSort(unsigned width);
+  Z3SortHandle getArraySort(unsigned domain, unsigned range);
+
+  Z3ASTHandle bvConst(unsigned width, uint64_t value);
+  Z3ASTHandle bvZero(unsigned width) { return bvConst(width, 0); }
+  Z3ASTHandle bvOne(unsigned width) { return bvConst(width, 1); }
+  Z3ASTHandle bvMinusOne(unsigned width);
+  Z3ASTHandle toBv(Z3ASTHandle e, unsigned width);
+
+  Z3ASTHandle getArrayForUpdate(const Array *root, const UpdateNode *un);
+
+  Z3ASTHandle constructActual(ref<Expr> e);
+  Z3ASTHandle constructCached(ref<Expr> e);
+
+public:
+  Z3Builder(Z3_context _ctx) : ctx(_ctx) {}
+
+  Z3ASTHandle getTrue();
+  Z3ASTHandle getFalse();
+  Z3ASTHandle getInitialArray(const Array *root);
+  Z3ASTHandle getInitialRead(const Array *root, unsigned index);
+
+  /// construct - Translate an expression, the result is a Z3 boolean for
+  /// width 1 expressions and a bitvector otherwise.
+  Z3ASTHandle construct(ref<Expr> e);
+};
+
+}
+
+#endif /* SUPPORT_Z3 */
+
+#endif
@@ -0,0 +1,287 @@
+//===-- Z3Solver.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/config.h"
+
+#ifdef SUPPORT_Z3
+
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+
+#include "SolverStats.h"
+#include "Z3Builder.h"
+
+#include "klee/Constraints.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprUtil.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace klee;
+
+/***/
+
+/// Z3SolverImpl - A solver using the Z3 C API in-process.
+///
+/// The constraints of the last query are kept asserted, each in its own
+/// scope, so that a query sharing a prefix of constraints with the previous
+/// one only pops and asserts the constraints which differ.
+class Z3SolverImpl : public SolverImpl {
+private:
+  Z3_context ctx;
+  Z3_solver solver;
+  Z3Builder *builder;
+  double timeout;
+  SolverRunStatus runStatusCode;
+
+  /// The constraints asserted in the solver, constraint i in scope i + 1.
+  std::vector< ref<Expr> > asserted;
+
+  void setConstraints(const ConstraintManager &constraints);
+
+public:
+  Z3SolverImpl();
+  ~Z3SolverImpl();
+
+  char *getConstraintLog(const Query&);
+  void setCoreSolverTimeout(double _timeout);
+
+  bool computeTruth(const Query&, bool &isValid);
+  bool computeValue(const Query&, ref<Expr> &result, const Query& full_query);
+  bool computeInitialValues(const Query&,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+};
+
+static void z3_error_handler(Z3_context ctx, Z3_error_code ec) {
+  fprintf(stderr, "error: Z3 Error: %s\n", Z3_get_error_msg(ctx, ec));
+  abort();
+}
+
+Z3SolverImpl::Z3SolverImpl()
+  : timeout(0.0),
+    runStatusCode(SOLVER_RUN_STATUS_FAILURE)
+{
+  Z3_config cfg = Z3_mk_config();
+  ctx = Z3_mk_context_rc(cfg);
+  Z3_del_config(cfg);
+  assert(ctx && "unable to create Z3 context");
+  Z3_set_error_handler(ctx, ::z3_error_handler);
+
+  solver = Z3_mk_solver(ctx);
+  Z3_solver_inc_ref(ctx, solver);
+  builder = new Z3Builder(ctx);
+}
+
+Z3SolverImpl::~Z3SolverImpl() {
+  delete builder;
+  Z3_solver_dec_ref(ctx, solver);
+  Z3_del_context(ctx);
+}
+
+void Z3SolverImpl::setCoreSolverTimeout(double _timeout) {
+  timeout = _timeout;
+
+  // Z3 takes the timeout in milliseconds, and UINT_MAX disables it.
+  unsigned ms = timeout > 0 ? (unsigned) (timeout * 1000) : ~0U;
+  Z3_params params = Z3_mk_params(ctx);
+  Z3_params_inc_ref(ctx, params);
+  Z3_params_set_uint(ctx, params, Z3_mk_string_symbol(ctx, "timeout"), ms);
+  Z3_solver_set_params(ctx, solver, params);
+  Z3_params_dec_ref(ctx, params);
+}
+
+/***/
+
+Z3Solver::Z3Solver()
+  : Solver(new Z3SolverImpl())
+{
+}
+
+char *Z3Solver::getConstraintLog(const Query &query) {
+  return impl->getConstraintLog(query);
+}
+
+void Z3Solver::setCoreSolverTimeout(double timeout) {
+  impl->setCoreSolverTimeout(timeout);
+}
+
+/***/
+
+char *Z3SolverImpl::getConstraintLog(const Query &query) {
+  std::vector<Z3ASTHandle> constraints;
+  for (ConstraintManager::const_iterator it = query.constraints.begin(),
+         ie = query.constraints.end(); it != ie; ++it)
+    constraints.push_back(builder->construct(*it));
+  assert(query.expr == ConstantExpr::alloc(0, Expr::Bool) &&
+         "Unexpected expression in query!");
+
+  std::vector<Z3_ast> assumptions(constraints.begin(), constraints.end());
+  Z3ASTHandle formula = builder->getFalse();
+  return strdup(Z3_benchmark_to_smtlib_string(ctx, "", "QF_AUFBV", "unknown",
+                                              "", assumptions.size(),
+                                              assumptions.empty() ? 0 :
+                                              &assumptions[0],
+                                              formula));
+}
+
+bool Z3SolverImpl::computeTruth(const Query& query,
+                                bool &isValid) {
+  std::vector<const Array*> objects;
+  std::vector< std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  if (!computeInitialValues(query, objects, values, hasSolution))
+    return false;
+
+  isValid = !hasSolution;
+  return true;
+}
+
+bool Z3SolverImpl::computeValue(const Query& query,
+                                ref<Expr> &result,
+                                const Query& full_query) {
+  std::vector<const Array*> objects;
+  std::vector< std::vector<unsigned char> > values;
+  bool hasSolution;
+
+  // Find the object used in the expression, and compute an assignment
+  // for them.
+  findSymbolicObjects(query.expr, objects);
+  if (!computeInitialValues(full_query.withFalse(), objects, values,
+                            hasSolution))
+    return false;
+  assert(hasSolution && "state has invalid constraint set");
+
+  // Evaluate the expression with the computed assignment.
+  Assignment a(objects, values);
+  result = a.evaluate(query.expr);
+
+  return true;
+}
+
+void Z3SolverImpl::setConstraints(const ConstraintManager &constraints) {
+  unsigned common = 0;
+  ConstraintManager::const_iterator it = constraints.begin(),
+    ie = constraints.end();
+  for (; it != ie && common < asserted.size() && *it == asserted[common];
+       ++it, ++common)
+    ;
+
+  if (common < asserted.size()) {
+    Z3_solver_pop(ctx, solver, asserted.size() - common);
+    asserted.resize(common);
+  }
+
+  for (; it != ie; ++it) {
+    Z3ASTHandle e = builder->construct(*it);
+    Z3_solver_push(ctx, solver);
+    Z3_solver_assert(ctx, solver, e);
+    asserted.push_back(*it);
+  }
+}
+
+bool
+Z3SolverImpl::computeInitialValues(const Query &query,
+                                   const std::vector<const Array*>
+                                     &objects,
+                                   std::vector< std::vector<unsigned char> >
+                                     &values,
+                                   bool &hasSolution) {
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  TimerStatIncrementer t(stats::queryTime);
+
+  setConstraints(query.constraints);
+
+  ++stats::queries;
+  ++stats::queryCounterexamples;
+
+  // The query is valid iff the constraints and its negation are
+  // unsatisfiable.
+  Z3_solver_push(ctx, solver);
+  if (!query.expr->isFalse()) {
+    Z3ASTHandle e = builder->construct(Expr::createIsZero(query.expr));
+    Z3_solver_assert(ctx, solver, e);
+  }
+
+  bool success = true;
+  switch (Z3_solver_check(ctx, solver)) {
+  case Z3_L_TRUE: {
+    hasSolution = true;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+
+    Z3_model model = Z3_solver_get_model(ctx, solver);
+    Z3_model_inc_ref(ctx, model);
+    values.reserve(objects.size());
+    for (std::vector<const Array*>::const_iterator
+           it = objects.begin(), ie = objects.end(); it != ie; ++it) {
+      const Array *array = *it;
+      std::vector<unsigned char> data;
+
+      data.reserve(array->size);
+      for (unsigned offset = 0; offset < array->size; offset++) {
+        Z3ASTHandle read = builder->getInitialRead(array, offset);
+        Z3_ast value;
+        unsigned byte = 0;
+        bool evaluated = Z3_model_eval(ctx, model, read, true, &value);
+        assert(evaluated && "unable to evaluate model");
+        (void) evaluated;
+        Z3ASTHandle valueHandle(value, ctx);
+        Z3_get_numeral_uint(ctx, valueHandle, &byte);
+        data.push_back(byte);
+      }
+
+      values.push_back(data);
+    }
+    Z3_model_dec_ref(ctx, model);
+    break;
+  }
+
+  case Z3_L_FALSE:
+    hasSolution = false;
+    runStatusCode = SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+    break;
+
+  default: {
+    std::string reason = Z3_solver_get_reason_unknown(ctx, solver);
+    if (reason == "timeout" || reason == "canceled") {
+      fprintf(stderr, "error: Z3 timed out\n");
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+    } else {
+      fprintf(stderr, "error: Z3 returned unknown: %s\n", reason.c_str());
+      runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+    }
+    success = false;
+    break;
+  }
+  }
+
+  if (success) {
+    if (hasSolution)
+      ++stats::queriesInvalid;
+    else
+      ++stats::queriesValid;
+  }
+
+  Z3_solver_pop(ctx, solver, 1);
+
+  return success;
+}
+
+SolverImpl::SolverRunStatus Z3SolverImpl::getOperationStatusCode() {
+  return runStatusCode;
+}
+
+#endif /* SUPPORT_Z3 */
@@ -12,6 +12,7 @@
 
 #include "klee/Internal/Support/Debug.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iomanip>
 #include <fstream>
@@ -19,27 +20,153 @@
 #include <map>
 
 #include "llvm/Support/raw_ostream.h"
+#include <fcntl.h>
+#include <pthread.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace klee;
 
+/* The stream file is a sequence of records, each starting with the id of
+   the stream it belongs to and a tag:
+
+     tag & (1<<31)   the stream forked, the child id is tag ^ (1<<31)
+     tag & (1<<30)   (tag ^ (1<<30)) bytes each '0' or '1' stored as bits
+     otherwise       tag bytes of data
+
+   Path streams only ever contain '0' and '1', so they are stored packed. */
+
+static const unsigned ForkTag = 1U<<31;
+static const unsigned BitsTag = 1U<<30;
+
+/// Blocks of records handed from the executor to the writer thread. The
+/// executor owns the block at head and only takes the lock when it is
+/// full, the writer thread writes the blocks from tail to head.
+struct TreeStreamWriter::AsyncOutput {
+  static const unsigned blockSize = 64*1024;
+  static const unsigned numBlocks = 16;
+
+  struct Block {
+    unsigned size;
+    char data[blockSize];
+  };
+
+  std::ofstream *output;
+  Block blocks[numBlocks];
+  unsigned head, tail;
+  bool stop;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  explicit AsyncOutput(std::ofstream *_output)
+    : output(_output), head(0), tail(0), stop(false) {
+    blocks[0].size = 0;
+    pthread_mutex_init(&lock, 0);
+    pthread_cond_init(&cond, 0);
+  }
+
+  ~AsyncOutput() {
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+  }
+
+  static void *run(void *arg) {
+    AsyncOutput *a = static_cast<AsyncOutput*>(arg);
+    pthread_mutex_lock(&a->lock);
+    for (;;) {
+      while (a->tail == a->head && !a->stop)
+        pthread_cond_wait(&a->cond, &a->lock);
+      if (a->tail == a->head)
+        break;
+      Block &b = a->blocks[a->tail % numBlocks];
+      pthread_mutex_unlock(&a->lock);
+      a->output->write(b.data, b.size);
+      pthread_mutex_lock(&a->lock);
+      ++a->tail;
+      pthread_cond_broadcast(&a->cond);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return 0;
+  }
+
+  /// Pass the current block to the writer thread and start a new one.
+  void publish() {
+    if (!blocks[head % numBlocks].size)
+      return;
+    pthread_mutex_lock(&lock);
+    ++head;
+    pthread_cond_broadcast(&cond);
+    while (head - tail == numBlocks)
+      pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+    blocks[head % numBlocks].size = 0;
+  }
+
+  void write(const char *s, unsigned size) {
+    while (size) {
+      Block &b = blocks[head % numBlocks];
+      unsigned n = std::min(size, blockSize - b.size);
+      memcpy(&b.data[b.size], s, n);
+      b.size += n;
+      s += n;
+      size -= n;
+      if (b.size == blockSize)
+        publish();
+    }
+  }
+
+  /// Wait until everything written so far is in the output.
+  void drain() {
+    publish();
+    pthread_mutex_lock(&lock);
+    while (tail != head)
+      pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+  }
+
+  void finish() {
+    drain();
+    pthread_mutex_lock(&lock);
+    stop = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, 0);
+  }
+};
+
 ///
 
-TreeStreamWriter::TreeStreamWriter(const std::string &_path) 
+TreeStreamWriter::TreeStreamWriter(const std::string &_path, bool asyncOutput)
   : lastID(0),
     bufferCount(0),
     path(_path),
     output(new std::ofstream(path.c_str(), 
                              std::ios::out | std::ios::binary)),
-    ids(1) {
+    ids(1),
+    parents(1, 0),
+    async(0) {
   if (!output->good()) {
     delete output;
     output = 0;
+  } else if (asyncOutput) {
+    async = new AsyncOutput(output);
+    if (pthread_create(&async->thread, 0, &AsyncOutput::run, async)) {
+      delete async;
+      async = 0;
+    }
   }
 }
 
 TreeStreamWriter::~TreeStreamWriter() {
   flush();
+  if (async) {
+    async->finish();
+    delete async;
+  }
   if (output)
     delete output;
 }
@@ -56,14 +183,14 @@ TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
   assert(output && os.writer==this);
   flushBuffer();
   unsigned id = ids++;
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  unsigned tag = id | (1<<31);
-  output->write(reinterpret_cast<const char*>(&tag), 4);
+  parents.push_back(os.id);
+  emit(reinterpret_cast<const char*>(&os.id), 4);
+  unsigned tag = id | ForkTag;
+  emit(reinterpret_cast<const char*>(&tag), 4);
   return TreeOStream(*this, id);
 }
 
 void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
-#if 1
   if (bufferCount && 
       (os.id!=lastID || size+bufferCount>bufferSize))
     flushBuffer();
@@ -75,28 +202,58 @@ void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
     memcpy(buffer, s, size);
     bufferCount = size;
   } else {
-    output->write(reinterpret_cast<const char*>(&os.id), 4);
-    output->write(reinterpret_cast<const char*>(&size), 4);
-    output->write(buffer, size);
+    writeRecord(os.id, s, size);
+  }
+}
+
+void TreeStreamWriter::writeRecord(unsigned id, const char *s,
+                                   unsigned size) {
+  assert(size < BitsTag && "record too large");
+  emit(reinterpret_cast<const char*>(&id), 4);
+
+  unsigned numBits = 0;
+  while (numBits<size && (s[numBits]=='0' || s[numBits]=='1'))
+    ++numBits;
+  if (numBits!=size) {
+    emit(reinterpret_cast<const char*>(&size), 4);
+    emit(s, size);
+    return;
+  }
+
+  unsigned tag = size | BitsTag;
+  emit(reinterpret_cast<const char*>(&tag), 4);
+  unsigned char bits[bufferSize / 8];
+  for (unsigned i=0; i<size; i+=8*sizeof(bits)) {
+    unsigned n = std::min(size - i, (unsigned) (8*sizeof(bits)));
+    memset(bits, 0, (n+7)/8);
+    for (unsigned j=0; j<n; ++j)
+      if (s[i+j]=='1')
+        bits[j/8] |= 1<<(j%8);
+    emit(reinterpret_cast<const char*>(bits), (n+7)/8);
+  }
+}
+
+void TreeStreamWriter::emit(const char *s, unsigned size) {
+  if (async) {
+    async->write(s, size);
+  } else {
+    output->write(s, size);
   }
-#else
-  output->write(reinterpret_cast<const char*>(&os.id), 4);
-  output->write(reinterpret_cast<const char*>(&size), 4);
-  output->write(s, size);
-#endif
 }
 
 void TreeStreamWriter::flushBuffer() {
   if (bufferCount) {    
-    output->write(reinterpret_cast<const char*>(&lastID), 4);
-    output->write(reinterpret_cast<const char*>(&bufferCount), 4);
-    output->write(buffer, bufferCount);
+    writeRecord(lastID, buffer, bufferCount);
     bufferCount = 0;
   }
 }
 
 void TreeStreamWriter::flush() {
+  if (!output)
+    return;
   flushBuffer();
+  if (async)
+    async->drain();
   output->flush();
 }
 
@@ -104,40 +261,13 @@ void TreeStreamWriter::readStream(TreeStreamID streamID,
                                   std::vector<unsigned char> &out) {
   assert(streamID>0 && streamID<ids);
   flush();
-  
-  std::ifstream is(path.c_str(),
-                   std::ios::in | std::ios::binary);
-  assert(is.good());
+
   KLEE_DEBUG(llvm::errs() << "finding chain for: " << streamID << "\n");
 
-  std::map<unsigned,unsigned> parents;
   std::vector<unsigned> roots;
-  for (;;) {
-    assert(is.good());
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-
-      if (child==streamID) {
-        roots.push_back(child);
-        while (id) {
-          roots.push_back(id);
-          std::map<unsigned, unsigned>::iterator it = parents.find(id);
-          assert(it!=parents.end());
-          id = it->second;
-        } 
-        break;
-      } else {
-        parents.insert(std::make_pair(child,id));
-      }
-    } else {
-      unsigned size = tag;
-      while (size--) is.get();
-    }
-  }
+  for (unsigned id=streamID; id; id=parents[id])
+    roots.push_back(id);
+
   KLEE_DEBUG({
       llvm::errs() << "roots: ";
       for (size_t i = 0, e = roots.size(); i < e; ++i) {
@@ -145,26 +275,45 @@ void TreeStreamWriter::readStream(TreeStreamID streamID,
       }
       llvm::errs() << "\n";
     });
-  is.seekg(0, std::ios::beg);
-  for (;;) {
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  assert(fd >= 0 && "unable to open tree stream");
+  struct stat st;
+  if (fstat(fd, &st) || !st.st_size) {
+    ::close(fd);
+    return;
+  }
+  void *map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  assert(map != MAP_FAILED && "unable to map tree stream");
+
+  const char *pos = static_cast<const char*>(map);
+  const char *end = pos + st.st_size;
+  while (end - pos >= 8) {
     unsigned id;
     unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (!is.good()) break;
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
+    memcpy(&id, pos, 4);
+    memcpy(&tag, pos + 4, 4);
+    pos += 8;
+    if (tag&ForkTag) { // fork
+      unsigned child = tag ^ ForkTag;
       if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
         roots.pop_back();
+    } else if (tag&BitsTag) {
+      unsigned size = tag ^ BitsTag;
+      if (id==roots.back())
+        for (unsigned i=0; i<size; ++i)
+          out.push_back((pos[i/8] >> (i%8)) & 1 ? '1' : '0');
+      pos += (size+7)/8;
     } else {
       unsigned size = tag;
-      if (id==roots.back()) {
-        while (size--) out.push_back(is.get());
-      } else {
-        while (size--) is.get();
-      }
+      if (id==roots.back())
+        out.insert(out.end(), pos, pos + size);
+      pos += size;
     }
-  }  
+  }
+
+  munmap(map, st.st_size);
 }
 
 ///
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+# -*- encoding: utf-8 -*-
+"""Measure the instructions per second klee executes on bitcode files.
+
+Each program is run once per configuration, by default with and without
+--use-concrete-fast-path, so the programs should be mostly concrete (e.g.
+the ones under test/Concrete, or real programs run without symbolic
+input). The best of --repeat runs is reported."""
+
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+INSTRUCTIONS = re.compile(r'KLEE: done: total instructions = (\d+)')
+
+CONFIGS = {
+    'fast': ['--use-concrete-fast-path=true'],
+    'nofast': ['--use-concrete-fast-path=false'],
+}
+
+
+def runKlee(klee, path, configArgs, extraArgs, programArgs):
+    outDir = tempfile.mkdtemp(prefix='klee-bench-')
+    # klee wants to create the directory itself.
+    os.rmdir(outDir)
+    args = [klee, '--output-dir=' + outDir, '--no-output']
+    args.extend(configArgs)
+    args.extend(extraArgs)
+    args.append(path)
+    args.extend(programArgs)
+
+    try:
+        start = time.time()
+        proc = subprocess.Popen(args, stdout=subprocess.PIPE,
+                                stderr=subprocess.PIPE)
+        out, err = proc.communicate()
+        elapsed = time.time() - start
+    finally:
+        shutil.rmtree(outDir, ignore_errors=True)
+
+    m = INSTRUCTIONS.search(err.decode('utf-8', 'replace'))
+    if proc.returncode != 0 or not m:
+        raise RuntimeError('%s failed:\n%s' %
+                           (' '.join(args), err.decode('utf-8', 'replace')))
+    return int(m.group(1)), elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('programs', nargs='+', metavar='FILE',
+                        help='bitcode file')
+    parser.add_argument('--klee', default='klee',
+                        help='klee binary to use (default=klee)')
+    parser.add_argument('-c', '--config', action='append', dest='configs',
+                        choices=sorted(CONFIGS), metavar='CONFIG',
+                        help='configuration to run, can be repeated '
+                        '(default=fast and nofast)')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='runs per program and configuration '
+                        '(default=3)')
+    parser.add_argument('--klee-arg', action='append', dest='kleeArgs',
+                        default=[], metavar='ARG',
+                        help='extra argument for klee, can be repeated')
+    parser.add_argument('--program-arg', action='append', dest='programArgs',
+                        default=[], metavar='ARG',
+                        help='argument for the programs, can be repeated')
+    args = parser.parse_args()
+
+    configs = args.configs or ['fast', 'nofast']
+    totals = dict((c, [0, 0.0]) for c in configs)
+
+    print('%-40s %s' % ('file (instructions/s)',
+                        ' '.join('%12s' % c for c in configs)))
+    for path in args.programs:
+        rates = {}
+        for c in configs:
+            best = None
+            for _ in range(max(args.repeat, 1)):
+                try:
+                    instructions, elapsed = runKlee(args.klee, path,
+                                                    CONFIGS[c], args.kleeArgs,
+                                                    args.programArgs)
+                except (OSError, RuntimeError) as e:
+                    print('error: %s' % e, file=sys.stderr)
+                    return 1
+                if best is None or elapsed < best[1]:
+                    best = (instructions, elapsed)
+            totals[c][0] += best[0]
+            totals[c][1] += best[1]
+            rates[c] = best[0] / max(best[1], 1e-6)
+
+        print('%-40s %s' % (os.path.basename(path)[-40:],
+                            ' '.join('%12.0f' % rates[c] for c in configs)))
+
+    print('%-40s %s' % ('total',
+                        ' '.join('%12.0f' % (totals[c][0] /
+                                             max(totals[c][1], 1e-6))
+                                 for c in configs)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
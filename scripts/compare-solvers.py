@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+# -*- encoding: utf-8 -*-
+"""Compare the core solver backends of kleaver on logged .pc queries.
+
+Each query file (e.g. a solver-queries.pc written with
+--use-query-log=solver:pc) is run through kleaver once per backend. The
+script reports the time each backend took and any query on which the
+backends disagree."""
+
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+RESULT = re.compile(r'^Query (\d+):\s+(VALID|INVALID|FAIL)')
+
+
+def runKleaver(kleaver, backend, path, extraArgs, timeout):
+    args = [kleaver, '--solver-backend=' + backend]
+    if timeout:
+        args.append('--max-solver-time=%d' % timeout)
+    args.extend(extraArgs)
+    args.append(path)
+
+    start = time.time()
+    proc = subprocess.Popen(args, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE)
+    out, err = proc.communicate()
+    elapsed = time.time() - start
+    if proc.returncode != 0:
+        raise RuntimeError('%s failed on %s:\n%s' %
+                           (' '.join(args), path,
+                            err.decode('utf-8', 'replace')))
+
+    results = {}
+    for line in out.decode('utf-8', 'replace').splitlines():
+        m = RESULT.match(line)
+        if m:
+            results[int(m.group(1))] = m.group(2)
+    return elapsed, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('queries', nargs='+', metavar='FILE',
+                        help='.pc query file')
+    parser.add_argument('--kleaver', default='kleaver',
+                        help='kleaver binary to use (default=kleaver)')
+    parser.add_argument('-b', '--backend', action='append',
+                        dest='backends', metavar='BACKEND',
+                        help='backend to compare, can be repeated '
+                        '(default=stp and z3)')
+    parser.add_argument('--timeout', type=int, default=0, metavar='SECONDS',
+                        help='per query solver timeout (default=off)')
+    parser.add_argument('--with-caches', action='store_true',
+                        help='keep the caching solvers in front of the '
+                        'backend, by default queries reach it directly')
+    args = parser.parse_args()
+
+    backends = args.backends or ['stp', 'z3']
+    extraArgs = []
+    if not args.with_caches:
+        extraArgs = ['--use-cache=false', '--use-cex-cache=false',
+                     '--use-independent-solver=false']
+
+    totals = dict((b, 0.0) for b in backends)
+    mismatches = 0
+    failures = dict((b, 0) for b in backends)
+
+    print('%-40s %s' % ('file', ' '.join('%12s' % b for b in backends)))
+    for path in args.queries:
+        times = {}
+        results = {}
+        for b in backends:
+            try:
+                times[b], results[b] = runKleaver(args.kleaver, b, path,
+                                                  extraArgs, args.timeout)
+            except (OSError, RuntimeError) as e:
+                print('error: %s' % e, file=sys.stderr)
+                return 1
+            totals[b] += times[b]
+            failures[b] += sum(1 for r in results[b].values() if r == 'FAIL')
+
+        print('%-40s %s' % (os.path.basename(path)[-40:],
+                            ' '.join('%11.3fs' % times[b] for b in backends)))
+
+        # Only compare the queries every backend answered.
+        reference = results[backends[0]]
+        for index in sorted(reference):
+            answers = [results[b].get(index) for b in backends]
+            if 'FAIL' in answers or len(set(answers)) == 1:
+                continue
+            mismatches += 1
+            print('  mismatch on query %d: %s' %
+                  (index, ', '.join('%s=%s' % (b, a)
+                                    for b, a in zip(backends, answers))))
+
+    print('%-40s %s' % ('total',
+                        ' '.join('%11.3fs' % totals[b] for b in backends)))
+    print('%-40s %s' % ('failed queries',
+                        ' '.join('%12d' % failures[b] for b in backends)))
+    if mismatches:
+        print('%d mismatching queries' % mismatches)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,49 @@
+; RUN: %S/ConcreteTest.py --klee='%klee' --lli=%lli %s
+
+declare void @print_i32(i32)
+declare void @print_i64(i64)
+
+define i32 @main() {
+entry:
+	%minus7 = sub i32 0, 7
+	%minus1 = sub i32 0, 1
+	%a = sdiv i32 %minus7, %minus1
+	call void @print_i32(i32 %a)
+	%b = srem i32 %minus7, 2
+	%bn = sub i32 0, %b
+	call void @print_i32(i32 %bn)
+	%c = srem i32 %minus7, %minus1
+	call void @print_i32(i32 %c)
+	%d = udiv i32 %minus7, 3
+	call void @print_i32(i32 %d)
+
+	%e8 = trunc i32 %minus7 to i8
+	%e = ashr i8 %e8, 1
+	%ez = zext i8 %e to i32
+	call void @print_i32(i32 %ez)
+	%f = sext i8 %e8 to i64
+	%fn = sub i64 0, %f
+	call void @print_i64(i64 %fn)
+
+	%big = add i64 4294967296, 3
+	%g = mul i64 %big, %big
+	call void @print_i64(i64 %g)
+	%h = lshr i64 %g, 33
+	call void @print_i64(i64 %h)
+
+	%arr = alloca i32, i32 4
+	%p3 = getelementptr i32* %arr, i32 3
+	store i32 42, i32* %p3
+	%p1 = getelementptr i32* %arr, i32 1
+	store i32 7, i32* %p1
+	%minus2 = sub i32 %minus1, 1
+	%p = getelementptr i32* %p3, i32 %minus2
+	%x = load i32* %p
+	call void @print_i32(i32 %x)
+
+	%lt = icmp slt i32 %minus7, %minus1
+	%sel = select i1 %lt, i32* %p3, i32* %p1
+	%y = load i32* %sel
+	call void @print_i32(i32 %y)
+	ret i32 0
+}
@@ -0,0 +1,42 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.klee-out2 --use-bulk-memory=false %t1.bc 2>&1 | FileCheck %s
+
+#include <assert.h>
+#include <string.h>
+
+int main() {
+  char sym[8], buf[16];
+  unsigned n;
+  klee_make_symbolic(sym, sizeof(sym), "sym");
+  klee_make_symbolic(&n, sizeof(n), "n");
+
+  // Concrete and symbolic bytes are copied as they are.
+  memset(buf, 'x', sizeof(buf));
+  memcpy(buf + 4, sym, sizeof(sym));
+  assert(buf[3] == 'x' && buf[12] == 'x');
+  assert(buf[4] == sym[0] && buf[11] == sym[7]);
+
+  // Overlapping moves in both directions.
+  memmove(buf + 1, buf, 12);
+  assert(buf[1] == 'x' && buf[5] == sym[0] && buf[12] == sym[7]);
+  memmove(buf, buf + 2, 12);
+  assert(buf[3] == sym[0] && buf[10] == sym[7]);
+
+  // A symbolic fill value.
+  memset(buf, sym[1], 4);
+  assert(buf[0] == sym[1] && buf[3] == sym[1]);
+
+  if (sym[0] == 'a') {
+    // CHECK: memory error: out of bound pointer
+    memcpy(buf + 8, sym, 16);
+  }
+
+  // A symbolic length goes through the runtime's loop.
+  if (n < 3)
+    memset(buf, 0, n);
+
+  // CHECK: KLEE: done: completed paths = 5
+  return 0;
+}
@@ -0,0 +1,29 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out --deterministic-allocation %t1.bc 2>&1 | grep "^ptr" > %t.log1
+// RUN: %klee --output-dir=%t.klee-out2 --deterministic-allocation %t1.bc 2>&1 | grep "^ptr" > %t.log2
+// RUN: diff %t.log1 %t.log2
+// RUN: not test -f %t.klee-out/test000001.assert.err
+
+#include <assert.h>
+#include <stdlib.h>
+
+int main() {
+  char *p = malloc(32), *q, *r;
+  klee_print_expr("ptr p", p);
+
+  // A freed object's range goes to the next object of the same size.
+  free(p);
+  q = malloc(30);
+  klee_print_expr("ptr q", q);
+  assert(p == q);
+
+  // Ranges do not touch, so a pointer past the end is out of bounds.
+  r = malloc(32);
+  klee_print_expr("ptr r", r);
+  assert(r != q + 32);
+
+  free(q);
+  free(r);
+  return 0;
+}
@@ -0,0 +1,23 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-dynamic-merge --search=dfs %t1.bc 2>&1 | FileCheck %s
+// RUN: test -f %t.klee-out/test000001.assert.err -o -f %t.klee-out/test000002.assert.err
+
+#include <assert.h>
+
+int main() {
+  char s[8];
+  unsigned i, count = 0;
+  klee_make_symbolic(s, sizeof(s), "s");
+
+  // Without merging, every byte doubles the number of paths.
+  for (i = 0; i < sizeof(s); ++i)
+    if (s[i] == 'a')
+      ++count;
+
+  // CHECK: ASSERTION FAIL
+  assert(count != sizeof(s));
+
+  // CHECK: KLEE: done: generated tests = 2
+  return 0;
+}
@@ -0,0 +1,21 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.cache %t.klee-out %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out --module-cache-dir=%t.cache %t1.bc 2>&1 | FileCheck -check-prefix=CHECK-FIRST %s
+// RUN: %klee --output-dir=%t.klee-out2 --module-cache-dir=%t.cache %t1.bc 2>&1 | FileCheck -check-prefix=CHECK-CACHED %s
+// RUN: cmp %t.klee-out/assembly.ll %t.klee-out2/assembly.ll
+// RUN: rm -rf %t.klee-out3
+// RUN: %klee --output-dir=%t.klee-out3 --module-cache-dir=%t.cache --check-div-zero=false %t1.bc 2>&1 | FileCheck -check-prefix=CHECK-FIRST %s
+
+#include <assert.h>
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  // CHECK-FIRST-NOT: Using cached module
+  // CHECK-CACHED: Using cached module
+  if (x > 10)
+    assert(x != 0);
+  // CHECK-FIRST: KLEE: done: completed paths = 2
+  // CHECK-CACHED: KLEE: done: completed paths = 2
+  return 0;
+}
@@ -7,6 +7,10 @@
 // RUN: %klee --output-dir=%t.klee-out-2 --replay-path %t.klee-out/test000001.path %t2.bc > %t3.log
 // RUN: diff %t3.log %t3.good
 
+// RUN: rm -rf %t.klee-out-3
+// RUN: %klee --output-dir=%t.klee-out-3 --write-paths --async-path-writes=false %t1.bc > %t4.good
+// RUN: diff %t.klee-out/test000001.path %t.klee-out-3/test000001.path
+
 #include <unistd.h>
 #include <stdio.h>
 
@@ -0,0 +1,25 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -DFAIL -c -o %t2.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --seed-out-dir=%t.klee-out --seed-workers=2 --only-replay-seeds %t2.bc
+// RUN: ls %t.klee-out-2 | grep -c assert.err | grep 1
+
+// Each worker runs one of the seeds, and both reach the same error. It is
+// written once.
+
+#include <assert.h>
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x < 5)
+    y = 1;
+  else
+    y = 2;
+#ifdef FAIL
+  assert(y == 0);
+#endif
+  return y;
+}
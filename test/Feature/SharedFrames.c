@@ -0,0 +1,35 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2>&1 | FileCheck %s
+// RUN: %klee --output-dir=%t.klee-out2 --reuse-registers=false %t1.bc 2>&1 | FileCheck %s
+
+#include <assert.h>
+
+// States fork in every frame of the recursion, and then write to the
+// registers of frames they share with the states they were forked from.
+int count(const char *s, int n) {
+  int r;
+  if (n == 0)
+    return 0;
+  r = count(s, n - 1);
+  if (s[n - 1] == 'x')
+    return r + 1;
+  return r;
+}
+
+int main() {
+  char s[4];
+  int i, expected = 0;
+  klee_make_symbolic(s, sizeof(s), "s");
+
+  int c = count(s, sizeof(s));
+  for (i = 0; i < sizeof(s); ++i)
+    if (s[i] == 'x')
+      ++expected;
+
+  // CHECK-NOT: ASSERTION FAIL
+  assert(c == expected);
+
+  // CHECK: KLEE: done: completed paths = 16
+  return 0;
+}
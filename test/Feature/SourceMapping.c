@@ -5,6 +5,9 @@
 // RUN: rm -rf %t.klee-out
 // RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc
 // RUN: FileCheck < %t.klee-out/run.istats %s
+// RUN: rm -rf %t.klee-out-bin
+// RUN: %klee --output-dir=%t.klee-out-bin --exit-on-error --binary-istats %t1.bc
+// RUN: klee-istats %t.klee-out-bin/run.istats.bin | FileCheck %s
 
 // CHECK: positions: instr line
 // CHECK: ob={{.*}}/SourceMapping.c{{.*}}/assembly.ll
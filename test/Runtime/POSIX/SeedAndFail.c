@@ -4,6 +4,13 @@
 // RUN: rm -rf %t.klee-out-2
 // RUN: %klee --output-dir=%t.klee-out-2 --seed-out-dir=%t.klee-out --zero-seed-extension --libc=uclibc --posix-runtime %t.bc --sym-files 1 10 --max-fail 1
 // RUN: ls %t.klee-out-2 | grep -c assert | grep 4
+// RUN: rm -rf %t.klee-out-3
+// RUN: %klee --output-dir=%t.klee-out-3 --seed-out-dir=%t.klee-out --seed-workers=2 --zero-seed-extension --libc=uclibc --posix-runtime %t.bc --sym-files 1 10 --max-fail 1
+// RUN: ls %t.klee-out-3 | grep -c assert | grep 4
+// RUN: ls %t.klee-out-2 | grep -c ktest > %t.tests2
+// RUN: ls %t.klee-out-3 | grep -c ktest > %t.tests3
+// RUN: diff %t.tests2 %t.tests3
+// RUN: ls %t.klee-out-3 | not grep seed-worker
 
 #include <string.h>
 #include <assert.h>
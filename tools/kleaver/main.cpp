@@ -252,11 +252,20 @@ static bool EvaluateInputAST(const char *Filename,
     llvm::errs() << "Starting MetaSMTSolver(" << backend << ") ...\n";
   }
   else {
-    coreSolver = UseDummySolver ? createDummySolver() : new STPSolver(UseForkedCoreSolver);
+    coreSolver = UseDummySolver ? createDummySolver()
+                                : createCoreSolverFromOptions(
+                                    UseForkedCoreSolver, true);
   }
 #else
-  coreSolver = UseDummySolver ? createDummySolver() : new STPSolver(UseForkedCoreSolver);
+  coreSolver = UseDummySolver ? createDummySolver()
+                              : createCoreSolverFromOptions(
+                                  UseForkedCoreSolver, true);
 #endif /* SUPPORT_METASMT */
+  if (!coreSolver) {
+    llvm::errs() << "Unsupported solver backend, rebuild kleaver with its "
+                 << "library.\n";
+    return false;
+  }
   
   
   if (!UseDummySolver) {
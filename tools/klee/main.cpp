@@ -7,6 +7,7 @@
 #include "klee/Expr.h"
 #include "klee/Interpreter.h"
 #include "klee/Statistics.h"
+#include "klee/Config/config.h"
 #include "klee/Config/Version.h"
 #include "klee/Internal/ADT/KTest.h"
 #include "klee/Internal/ADT/TreeStream.h"
@@ -54,6 +55,7 @@
 #include <dirent.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
@@ -105,6 +107,15 @@ namespace {
   WriteCov("write-cov", 
            cl::desc("Write coverage information for each test case"));
   
+  cl::opt<bool>
+  WriteAFLCov("write-afl-cov",
+              cl::desc("Write an AFL style coverage map (.aflmap) for each test case"));
+
+  cl::opt<unsigned>
+  AFLMapSize("afl-map-size",
+             cl::desc("Size in bytes of the maps written by --write-afl-cov, a power of two (default=65536)"),
+             cl::init(1 << 16));
+
   cl::opt<bool>
   WriteTestInfo("write-test-info", 
                 cl::desc("Write additional test case information"));
@@ -116,6 +127,11 @@ namespace {
   cl::opt<bool>
   WriteSymPaths("write-sym-paths", 
                 cl::desc("Write .sym.path files for each test case"));
+
+  cl::opt<bool>
+  AsyncPathWrites("async-path-writes",
+                  cl::desc("Write the path streams used by --write-paths and --write-sym-paths from a separate thread (default=on)"),
+                  cl::init(true));
     
   cl::opt<bool>
   ExitOnError("exit-on-error", 
@@ -156,6 +172,11 @@ namespace {
                cl::desc("Inject checks for overshift"),
                cl::init(true));
 
+  cl::opt<std::string>
+  ModuleCacheDir("module-cache-dir",
+                 cl::desc("Keep the prepared module in this directory, keyed by the input, the runtime libraries and the options it is prepared with, and reuse it on later runs. Entries are not invalidated when klee itself changes (default=off)"),
+                 cl::init(""));
+
   cl::opt<std::string>
   OutputDir("output-dir", 
             cl::desc("Directory to write results in (defaults to klee-out-N)"),
@@ -234,6 +255,9 @@ private:
 
   unsigned m_testIndex;  // number of tests written so far
   unsigned m_pathsExplored; // number of paths explored so far
+  // number of tests written so far by this and forked processes, in
+  // shared memory, once shareTestIndex() was called
+  unsigned *m_sharedTestIndex;
 
   // used for writing .ktest files
   int m_argc;
@@ -244,7 +268,9 @@ public:
   ~KleeHandler();
 
   llvm::raw_ostream &getInfoStream() const { return *m_infoFile; }
-  unsigned getNumTestCases() { return m_testIndex; }
+  unsigned getNumTestCases() {
+    return m_sharedTestIndex ? *m_sharedTestIndex : m_testIndex;
+  }
   unsigned getNumPathsExplored() { return m_pathsExplored; }
   void incPathsExplored() { m_pathsExplored++; }
 
@@ -253,6 +279,7 @@ public:
   void processTestCase(const ExecutionState  &state,
                        const char *errorMessage, 
                        const char *errorSuffix);
+  bool shareTestIndex();
 
   std::string getOutputFilename(const std::string &filename);
   llvm::raw_fd_ostream *openOutputFile(const std::string &filename);
@@ -287,6 +314,7 @@ KleeHandler::KleeHandler(int argc, char **argv)
     m_targetFunctions(),
     m_testIndex(0),
     m_pathsExplored(0),
+    m_sharedTestIndex(0),
     m_argc(argc),
     m_argv(argv) {
 
@@ -361,6 +389,7 @@ KleeHandler::KleeHandler(int argc, char **argv)
 KleeHandler::~KleeHandler() {
   if (m_pathWriter) delete m_pathWriter;
   if (m_symPathWriter) delete m_symPathWriter;
+  if (m_sharedTestIndex) munmap(m_sharedTestIndex, sizeof(unsigned));
   fclose(klee_warning_file);
   fclose(klee_message_file);
   delete m_infoFile;
@@ -370,13 +399,15 @@ void KleeHandler::setInterpreter(Interpreter *i) {
   m_interpreter = i;
 
   if (WritePaths) {
-    m_pathWriter = new TreeStreamWriter(getOutputFilename("paths.ts"));
+    m_pathWriter = new TreeStreamWriter(getOutputFilename("paths.ts"),
+                                        AsyncPathWrites);
     assert(m_pathWriter->good());
     m_interpreter->setPathWriter(m_pathWriter);
   }
 
   if (WriteSymPaths) {
-    m_symPathWriter = new TreeStreamWriter(getOutputFilename("symPaths.ts"));
+    m_symPathWriter = new TreeStreamWriter(getOutputFilename("symPaths.ts"),
+                                           AsyncPathWrites);
     assert(m_symPathWriter->good());
     m_interpreter->setSymbolicPathWriter(m_symPathWriter);
   }
@@ -423,6 +454,18 @@ llvm::raw_fd_ostream *KleeHandler::openTestFile(const std::string &suffix,
 }
 
 
+bool KleeHandler::shareTestIndex() {
+  if (!m_sharedTestIndex) {
+    void *p = mmap(0, sizeof(unsigned), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANON, -1, 0);
+    if (p == MAP_FAILED)
+      return false;
+    m_sharedTestIndex = static_cast<unsigned*>(p);
+    *m_sharedTestIndex = m_testIndex;
+  }
+  return true;
+}
+
 /* Outputs all files (.ktest, .pc, .cov etc.) describing a test case */
 void KleeHandler::processTestCase(const ExecutionState &state,
                                   const char *errorMessage, 
@@ -448,7 +491,8 @@ void KleeHandler::processTestCase(const ExecutionState &state,
 
     double start_time = util::getWallTime();
 
-    unsigned id = ++m_testIndex;
+    unsigned id = m_sharedTestIndex ?
+      __sync_add_and_fetch(m_sharedTestIndex, 1) : ++m_testIndex;
 
     if (success) {
       KTest b;      
@@ -546,7 +590,17 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       delete f;
     }
 
-    if (m_testIndex == StopAfterNTests)
+    if (WriteAFLCov) {
+      std::vector<unsigned char> map(AFLMapSize);
+      m_interpreter->getCoverageMap(state, map);
+      llvm::raw_ostream *f = openTestFile("aflmap", id);
+      f->write(reinterpret_cast<const char*>(&map[0]), map.size());
+      delete f;
+    }
+
+    // With seed workers the index is shared, and another process may have
+    // taken the Nth one.
+    if (StopAfterNTests && id >= StopAfterNTests)
       m_interpreter->setHaltExecution(true);
 
     if (WriteTestInfo) {
@@ -1187,6 +1241,113 @@ static llvm::Module *linkWithUclibc(llvm::Module *mainModule, StringRef libDir)
 }
 #endif
 
+static std::string getKleeLibcPath(StringRef libDir) {
+  SmallString<128> Path(libDir);
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
+  llvm::sys::path::append(Path, "klee-libc.bc");
+#else
+  llvm::sys::path::append(Path, "libklee-libc.bca");
+#endif
+  return Path.str();
+}
+
+static std::string getPOSIXRuntimePath(StringRef libDir) {
+  SmallString<128> Path(libDir);
+  llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
+  return Path.str();
+}
+
+/// Return the base name of the module cache entry for the input and the
+/// options of this run, or an empty string if it cannot be cached. The key
+/// includes the klee version and a hash of the klee binary, so entries
+/// written by another build are never reused.
+static std::string getModuleCachePath(const char *argv0,
+                                      const Interpreter::ModuleOptions &Opts) {
+  if (InputFile == "-")
+    return "";
+  uint64_t inputHash = getFileHash(InputFile);
+  if (!inputHash)
+    return "";
+
+  void *MainExecAddr = (void *)(intptr_t)getModuleCachePath;
+  std::string kleeBinary =
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,4)
+    llvm::sys::fs::getMainExecutable(argv0, MainExecAddr);
+#else
+    llvm::sys::Path::GetMainExecutable(argv0, MainExecAddr).str();
+#endif
+  uint64_t kleeHash = getFileHash(kleeBinary);
+  if (!kleeHash)
+    return "";
+
+  std::ostringstream key;
+  key << std::hex << "klee=" PACKAGE_VERSION " binary=" << kleeHash
+      << " input=" << inputHash << " libc=" << Libc;
+  switch (Libc) {
+  case NoLibc:
+    break;
+  case KleeLibc:
+    key << " klee-libc=" << getFileHash(getKleeLibcPath(Opts.LibraryDir));
+    break;
+  case UcLibc: {
+#ifdef SUPPORT_KLEE_UCLIBC
+    SmallString<128> uclibcBCA(Opts.LibraryDir);
+    llvm::sys::path::append(uclibcBCA, KLEE_UCLIBC_BCA_NAME);
+    key << " uclibc=" << getFileHash(uclibcBCA.c_str());
+#endif
+    break;
+  }
+  }
+  if (WithPOSIXRuntime)
+    key << " posix=" << getFileHash(getPOSIXRuntimePath(Opts.LibraryDir));
+  key << " " << Interpreter::getModuleCacheKey(Opts);
+
+  if (mkdir(ModuleCacheDir.c_str(), 0775) != 0 && errno != EEXIST)
+    return "";
+
+  std::ostringstream name;
+  name << "module-" << std::hex << std::setfill('0') << std::setw(16)
+       << getStringHash(key.str());
+  SmallString<128> path(ModuleCacheDir);
+  llvm::sys::path::append(path, name.str());
+  return path.str();
+}
+
+/// Load the prepared module of a module cache entry, or return null if
+/// there is no complete entry.
+static Module *loadCachedModule(const std::string &path) {
+  std::string bitcodePath = path + ".bc";
+  std::string infoPath = path + ".info";
+  if (access(bitcodePath.c_str(), R_OK) != 0 ||
+      access(infoPath.c_str(), R_OK) != 0)
+    return 0;
+
+  std::string ErrorMsg;
+  Module *module = 0;
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+  OwningPtr<MemoryBuffer> Buffer;
+  if (error_code ec = MemoryBuffer::getFile(bitcodePath.c_str(), Buffer))
+    ErrorMsg = ec.message();
+  else
+    module = ParseBitcodeFile(Buffer.get(), getGlobalContext(), &ErrorMsg);
+#else
+  auto Buffer = MemoryBuffer::getFile(bitcodePath.c_str());
+  if (!Buffer) {
+    ErrorMsg = Buffer.getError().message();
+  } else {
+    auto moduleOrError = parseBitcodeFile(Buffer->get(), getGlobalContext());
+    if (moduleOrError)
+      module = *moduleOrError;
+    else
+      ErrorMsg = moduleOrError.getError().message();
+  }
+#endif
+  if (!module)
+    klee_warning("unable to load cached module %s: %s", bitcodePath.c_str(),
+                 ErrorMsg.c_str());
+  return module;
+}
+
 int main(int argc, char **argv, char **envp) {
   atexit(llvm_shutdown);  // Call llvm_shutdown() on exit.
 
@@ -1195,6 +1356,9 @@ int main(int argc, char **argv, char **envp) {
   parseArguments(argc, argv);
   sys::PrintStackTraceOnErrorSignal();
 
+  if (WriteAFLCov && (!AFLMapSize || (AFLMapSize & (AFLMapSize - 1))))
+    klee_error("--afl-map-size must be a power of two");
+
   if (Watchdog) {
     if (MaxTime==0) {
       klee_error("--watchdog used without --max-time");
@@ -1260,96 +1424,105 @@ int main(int argc, char **argv, char **envp) {
 
   sys::SetInterruptFunction(interrupt_handle);
 
+  std::string LibraryDir = KleeHandler::getRunTimeLibraryPath(argv[0]);
+  Interpreter::ModuleOptions Opts(LibraryDir.c_str(),
+                                  /*Optimize=*/OptimizeModule, 
+                                  /*CheckDivZero=*/CheckDivZero,
+                                  /*CheckOvershift=*/CheckOvershift);
+
   // Load the bytecode...
   std::string ErrorMsg;
   Module *mainModule = 0;
+  if (ModuleCacheDir != "") {
+    Opts.CachePath = getModuleCachePath(argv[0], Opts);
+    if (Opts.CachePath.empty())
+      klee_warning("unable to use the module cache for: %s",
+                   InputFile.c_str());
+    else if ((mainModule = loadCachedModule(Opts.CachePath))) {
+      Opts.Cached = true;
+      klee_message("NOTE: Using cached module: %s.bc",
+                   Opts.CachePath.c_str());
+    }
+  }
+
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
   OwningPtr<MemoryBuffer> BufferPtr;
-  error_code ec=MemoryBuffer::getFileOrSTDIN(InputFile.c_str(), BufferPtr);
-  if (ec) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
+#endif
+  if (!mainModule) {
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+    error_code ec=MemoryBuffer::getFileOrSTDIN(InputFile.c_str(), BufferPtr);
+    if (ec) {
+      klee_error("error loading program '%s': %s", InputFile.c_str(),
+                 ec.message().c_str());
+    }
 
-  mainModule = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
+    mainModule = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
 
-  if (mainModule) {
-    if (mainModule->MaterializeAllPermanently(&ErrorMsg)) {
-      delete mainModule;
-      mainModule = 0;
+    if (mainModule) {
+      if (mainModule->MaterializeAllPermanently(&ErrorMsg)) {
+        delete mainModule;
+        mainModule = 0;
+      }
     }
-  }
-  if (!mainModule)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ErrorMsg.c_str());
+    if (!mainModule)
+      klee_error("error loading program '%s': %s", InputFile.c_str(),
+                 ErrorMsg.c_str());
 #else
-  auto Buffer = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
-  if (!Buffer)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               Buffer.getError().message().c_str());
+    auto Buffer = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
+    if (!Buffer)
+      klee_error("error loading program '%s': %s", InputFile.c_str(),
+                 Buffer.getError().message().c_str());
 
-  auto mainModuleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
+    auto mainModuleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
 
-  if (!mainModuleOrError) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               mainModuleOrError.getError().message().c_str());
-  }
-  else {
-    // The module has taken ownership of the MemoryBuffer so release it
-    // from the std::unique_ptr
-    Buffer->release();
-  }
+    if (!mainModuleOrError) {
+      klee_error("error loading program '%s': %s", InputFile.c_str(),
+                 mainModuleOrError.getError().message().c_str());
+    }
+    else {
+      // The module has taken ownership of the MemoryBuffer so release it
+      // from the std::unique_ptr
+      Buffer->release();
+    }
 
-  mainModule = *mainModuleOrError;
-  if (auto ec = mainModule->materializeAllPermanently()) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
+    mainModule = *mainModuleOrError;
+    if (auto ec = mainModule->materializeAllPermanently()) {
+      klee_error("error loading program '%s': %s", InputFile.c_str(),
+                 ec.message().c_str());
+    }
 #endif
 
+    if (WithPOSIXRuntime) {
+      int r = initEnv(mainModule);
+      if (r != 0)
+        return r;
+    }
 
-  if (WithPOSIXRuntime) {
-    int r = initEnv(mainModule);
-    if (r != 0)
-      return r;
-  }
+    switch (Libc) {
+    case NoLibc: /* silence compiler warning */
+      break;
 
-  std::string LibraryDir = KleeHandler::getRunTimeLibraryPath(argv[0]);
-  Interpreter::ModuleOptions Opts(LibraryDir.c_str(),
-                                  /*Optimize=*/OptimizeModule, 
-                                  /*CheckDivZero=*/CheckDivZero,
-                                  /*CheckOvershift=*/CheckOvershift);
-  
-  switch (Libc) {
-  case NoLibc: /* silence compiler warning */
-    break;
+    case KleeLibc: {
+      // FIXME: Find a reasonable solution for this.
+      mainModule = klee::linkWithLibrary(mainModule,
+                                         getKleeLibcPath(LibraryDir));
+      assert(mainModule && "unable to link with klee-libc");
+      break;
+    }
 
-  case KleeLibc: {
-    // FIXME: Find a reasonable solution for this.
-    SmallString<128> Path(Opts.LibraryDir);
-#if LLVM_VERSION_CODE >= LLVM_VERSION(3,3)
-    llvm::sys::path::append(Path, "klee-libc.bc");
-#else
-    llvm::sys::path::append(Path, "libklee-libc.bca");
-#endif
-    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-    assert(mainModule && "unable to link with klee-libc");
-    break;
-  }
+    case UcLibc:
+      mainModule = linkWithUclibc(mainModule, LibraryDir);
+      break;
+    }
 
-  case UcLibc:
-    mainModule = linkWithUclibc(mainModule, LibraryDir);
-    break;
+    if (WithPOSIXRuntime) {
+      std::string Path = getPOSIXRuntimePath(LibraryDir);
+      klee_message("NOTE: Using model: %s", Path.c_str());
+      mainModule = klee::linkWithLibrary(mainModule, Path);
+      assert(mainModule && "unable to link with simple model");
+    }
   }
 
-  if (WithPOSIXRuntime) {
-    SmallString<128> Path(Opts.LibraryDir);
-    llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
-    klee_message("NOTE: Using model: %s", Path.c_str());
-    mainModule = klee::linkWithLibrary(mainModule, Path.c_str());
-    assert(mainModule && "unable to link with simple model");
-  }  
-
   // Get the desired main function.  klee_main initializes uClibc
   // locale and other data and then calls main.
   Function *mainFn = mainModule->getFunction("main");
@@ -1554,6 +1727,10 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("QueriesCEX");
   uint64_t queryConstructs = 
     *theStatisticManager->getStatisticByName("QueriesConstructs");
+  uint64_t queryConstructCacheHits =
+    *theStatisticManager->getStatisticByName("QueryConstructCacheHits");
+  uint64_t queryConstructTime =
+    *theStatisticManager->getStatisticByName("QueryConstructTime");
   uint64_t instructions = 
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks = 
@@ -1568,6 +1745,17 @@ int main(int argc, char **argv, char **envp) {
     handler->getInfoStream() 
       << "KLEE: done: avg. constructs per query = " 
                              << queryConstructs / queries << "\n";  
+  if (queries && queryConstructs) {
+    // Estimate the time saved by reusing translations from earlier queries
+    // from the average time of the translations which were done.
+    double saved = (double) queryConstructCacheHits * queryConstructTime /
+      queryConstructs / 1000000.;
+    handler->getInfoStream()
+      << "KLEE: done: avg. reused constructs per query = "
+                             << queryConstructCacheHits / queries << "\n"
+      << "KLEE: done: est. construct time saved per query = "
+                             << saved / queries << "s\n";
+  }
   handler->getInfoStream() 
     << "KLEE: done: total queries = " << queries << "\n"
     << "KLEE: done: valid queries = " << queriesValid << "\n"
@@ -0,0 +1,89 @@
+//===-- CoverageBitmapTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/CoverageBitmap.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(CoverageBitmapTest, SetAndTest) {
+  CoverageBitmap b;
+  EXPECT_FALSE(b.test(3));
+  EXPECT_TRUE(b.set(3));
+  EXPECT_FALSE(b.set(3));
+  EXPECT_TRUE(b.test(3));
+  EXPECT_TRUE(b.set(100000));
+  EXPECT_TRUE(b.test(100000));
+  EXPECT_FALSE(b.test(99999));
+  EXPECT_EQ(2u, b.count());
+}
+
+TEST(CoverageBitmapTest, CopyOnWrite) {
+  CoverageBitmap a;
+  a.set(1);
+  CoverageBitmap b(a);
+  b.set(2);
+  a.set(3000);
+  EXPECT_TRUE(b.test(1));
+  EXPECT_TRUE(b.test(2));
+  EXPECT_FALSE(b.test(3000));
+  EXPECT_FALSE(a.test(2));
+  EXPECT_TRUE(a.test(3000));
+}
+
+TEST(CoverageBitmapTest, Union) {
+  CoverageBitmap a, b, global;
+  a.set(1);
+  a.set(5000);
+  b.set(2);
+  b.set(5000);
+  global.unionWith(a);
+  global.unionWith(b);
+  EXPECT_EQ(3u, global.count());
+
+  // Writing the union must not affect the states it was built from.
+  global.set(7);
+  EXPECT_FALSE(a.test(7));
+  EXPECT_FALSE(b.test(7));
+  EXPECT_EQ(2u, a.count());
+}
+
+TEST(CoverageBitmapTest, GetIds) {
+  CoverageBitmap b;
+  b.set(70000);
+  b.set(4);
+  b.set(63);
+  b.set(64);
+  std::vector<unsigned> ids;
+  b.getIds(ids);
+  ASSERT_EQ(4u, ids.size());
+  EXPECT_EQ(4u, ids[0]);
+  EXPECT_EQ(63u, ids[1]);
+  EXPECT_EQ(64u, ids[2]);
+  EXPECT_EQ(70000u, ids[3]);
+}
+
+TEST(CoverageBitmapTest, AFLMap) {
+  CoverageBitmap b;
+  for (unsigned i=0; i<256; i+=2)
+    b.set(i);
+  std::vector<unsigned char> map(256);
+  b.toAFLMap(&map[0], map.size());
+  unsigned hits = 0;
+  for (unsigned i=0; i<map.size(); ++i)
+    hits += map[i];
+  EXPECT_EQ(128u, hits);
+}
+
+}
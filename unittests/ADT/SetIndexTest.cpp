@@ -0,0 +1,130 @@
+//===-- SetIndexTest.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/SetIndex.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+std::set<int> makeSet(unsigned bits) {
+  std::set<int> s;
+  for (int i = 0; i < 12; ++i)
+    if (bits & (1 << i))
+      s.insert(i * 7);
+  return s;
+}
+
+struct Any {
+  bool operator()(unsigned) const { return true; }
+};
+
+struct Odd {
+  bool operator()(unsigned v) const { return v & 1; }
+};
+
+TEST(SetIndexTest, Lookup) {
+  SetIndex<int, unsigned> index;
+  EXPECT_EQ(0, index.lookup(makeSet(3)));
+  index.insert(makeSet(3), 3);
+  index.insert(makeSet(0), 7);
+  ASSERT_NE((unsigned*) 0, index.lookup(makeSet(3)));
+  EXPECT_EQ(3u, *index.lookup(makeSet(3)));
+  EXPECT_EQ(7u, *index.lookup(makeSet(0)));
+  EXPECT_EQ(0, index.lookup(makeSet(1)));
+
+  index.insert(makeSet(3), 5);
+  EXPECT_EQ(5u, *index.lookup(makeSet(3)));
+  EXPECT_EQ(2u, index.size());
+
+  index.clear();
+  EXPECT_EQ(0, index.lookup(makeSet(3)));
+}
+
+TEST(SetIndexTest, SubsetsAndSupersets) {
+  SetIndex<int, unsigned> index;
+  std::vector<unsigned> stored;
+  for (unsigned bits = 1; bits < 4096; bits = (bits * 37 + 11) % 4096) {
+    if (std::find(stored.begin(), stored.end(), bits) != stored.end())
+      break;
+    index.insert(makeSet(bits), bits);
+    stored.push_back(bits);
+  }
+
+  for (unsigned query = 0; query < 4096; query += 5) {
+    bool hasSubset = false, hasOddSubset = false;
+    bool hasSuperset = false, hasOddSuperset = false;
+    for (unsigned i = 0; i < stored.size(); ++i) {
+      if ((stored[i] & query) == stored[i]) {
+        hasSubset = true;
+        hasOddSubset |= stored[i] & 1;
+      }
+      if ((stored[i] & query) == query) {
+        hasSuperset = true;
+        hasOddSuperset |= stored[i] & 1;
+      }
+    }
+
+    std::set<int> s = makeSet(query);
+    unsigned *res = index.findSubset(s, Any());
+    EXPECT_EQ(hasSubset, res != 0);
+    if (res)
+      EXPECT_EQ(*res, *res & query);
+    res = index.findSubset(s, Odd());
+    EXPECT_EQ(hasOddSubset, res != 0);
+
+    res = index.findSuperset(s, Any());
+    EXPECT_EQ(hasSuperset, res != 0);
+    if (res)
+      EXPECT_EQ(query, *res & query);
+    res = index.findSuperset(s, Odd());
+    EXPECT_EQ(hasOddSuperset, res != 0);
+  }
+
+  // Sets with elements never stored have no supersets.
+  std::set<int> s = makeSet(1);
+  s.insert(1000);
+  EXPECT_EQ(0, index.findSuperset(s, Any()));
+  EXPECT_NE((unsigned*) 0, index.findSubset(s, Any()));
+}
+
+TEST(SetIndexTest, Eviction) {
+  SetIndex<int, unsigned> index(64);
+  for (unsigned bits = 1; bits <= 64; ++bits)
+    index.insert(makeSet(bits), bits);
+
+  // Keep the first set in use while adding more.
+  for (unsigned bits = 65; bits < 1000; ++bits) {
+    ASSERT_NE((unsigned*) 0, index.lookup(makeSet(1)));
+    index.insert(makeSet(bits), bits);
+    EXPECT_LE(index.size(), 64u);
+  }
+
+  EXPECT_EQ(1u, *index.lookup(makeSet(1)));
+  EXPECT_EQ(999u, *index.lookup(makeSet(999)));
+  EXPECT_EQ(0, index.lookup(makeSet(2)));
+
+  std::vector<unsigned> values;
+  index.getValues(values);
+  EXPECT_EQ(index.size(), values.size());
+  EXPECT_NE(values.end(), std::find(values.begin(), values.end(), 1u));
+  EXPECT_EQ(values.end(), std::find(values.begin(), values.end(), 2u));
+
+  unsigned *res = index.findSubset(makeSet(999 | 1), Odd());
+  ASSERT_NE((unsigned*) 0, res);
+  EXPECT_EQ(*res, *res & (999 | 1));
+}
+
+}
@@ -0,0 +1,152 @@
+//===-- ByteRangesTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ByteRanges.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  UpdateList ul(array, 0);
+  return ReadExpr::create(ul, ConstantExpr::alloc(index, Expr::Int32));
+}
+
+TEST(ByteRangesTest, Digit) {
+  const Array *array = Array::CreateArray("br_digit", 4);
+  ref<Expr> c = readByte(array, 0);
+  ref<Expr> c32 = ZExtExpr::create(c, Expr::Int32);
+
+  // isdigit(c) as compiled: (unsigned) (c - '0') < 10
+  ByteRanges ranges;
+  ranges.addConstraint(
+    UltExpr::create(AddExpr::create(ConstantExpr::alloc(-48, Expr::Int32),
+                                    c32),
+                    ConstantExpr::alloc(10, Expr::Int32)));
+
+  ByteRanges::Byte b = ranges.getByte(array, 0);
+  EXPECT_EQ('0', b.min);
+  EXPECT_EQ('9', b.max);
+
+  bool value;
+  ASSERT_TRUE(ranges.evaluate(EqExpr::create(ConstantExpr::alloc('x', 8), c),
+                              value));
+  EXPECT_FALSE(value);
+  ASSERT_TRUE(ranges.evaluate(UleExpr::create(c32,
+                                              ConstantExpr::alloc('9', 32)),
+                              value));
+  EXPECT_TRUE(value);
+  EXPECT_FALSE(ranges.evaluate(EqExpr::create(ConstantExpr::alloc('5', 8), c),
+                               value));
+
+  // Other bytes are unaffected.
+  EXPECT_FALSE(ranges.evaluate(EqExpr::create(ConstantExpr::alloc('x', 8),
+                                              readByte(array, 1)),
+                               value));
+
+  // Copies are independent.
+  ByteRanges copy = ranges;
+  copy.addConstraint(EqExpr::create(ConstantExpr::alloc('5', 8), c));
+  ASSERT_TRUE(copy.evaluate(EqExpr::create(ConstantExpr::alloc('5', 8), c),
+                            value));
+  EXPECT_TRUE(value);
+  EXPECT_FALSE(ranges.evaluate(EqExpr::create(ConstantExpr::alloc('5', 8), c),
+                               value));
+}
+
+TEST(ByteRangesTest, Word) {
+  const Array *array = Array::CreateArray("br_word", 4);
+  ref<Expr> word = ConcatExpr::create4(readByte(array, 3), readByte(array, 2),
+                                       readByte(array, 1), readByte(array, 0));
+
+  ByteRanges ranges;
+  ranges.addConstraint(EqExpr::create(ConstantExpr::alloc(0x01020304, 32),
+                                      word));
+  for (unsigned i = 0; i != 4; ++i) {
+    ByteRanges::Byte b = ranges.getByte(array, i);
+    EXPECT_EQ(4 - i, b.min);
+    EXPECT_EQ(4 - i, b.max);
+  }
+
+  bool value;
+  ASSERT_TRUE(ranges.evaluate(SltExpr::create(word,
+                                              ConstantExpr::alloc(0, 32)),
+                              value));
+  EXPECT_FALSE(value);
+}
+
+TEST(ByteRangesTest, Exclude) {
+  const Array *array = Array::CreateArray("br_exclude", 1);
+  ref<Expr> c = readByte(array, 0);
+  ref<Expr> zero = ConstantExpr::alloc(0, 8);
+
+  ByteRanges ranges;
+  ranges.addConstraint(Expr::createIsZero(EqExpr::create(zero, c)));
+
+  bool value;
+  ASSERT_TRUE(ranges.evaluate(EqExpr::create(zero, c), value));
+  EXPECT_FALSE(value);
+  ASSERT_TRUE(ranges.evaluate(UltExpr::create(zero, c), value));
+  EXPECT_TRUE(value);
+}
+
+// Check every decided condition against all values of a single byte.
+TEST(ByteRangesTest, Exhaustive) {
+  const Array *array = Array::CreateArray("br_exhaustive", 1);
+  ref<Expr> c = readByte(array, 0);
+  ref<Expr> c32 = ZExtExpr::create(c, Expr::Int32);
+  ref<Expr> s32 = SExtExpr::create(c, Expr::Int32);
+
+  std::vector< ref<Expr> > exprs;
+  for (unsigned k = 0; k < 256; k += 37) {
+    ref<Expr> k8 = ConstantExpr::alloc(k, 8);
+    ref<Expr> k32 = ConstantExpr::alloc(k, 32);
+    exprs.push_back(EqExpr::create(k8, c));
+    exprs.push_back(UltExpr::create(c, k8));
+    exprs.push_back(UleExpr::create(k8, c));
+    exprs.push_back(SltExpr::create(s32, k32));
+    exprs.push_back(UltExpr::create(AddExpr::create(k32, c32),
+                                    ConstantExpr::alloc(100, 32)));
+    exprs.push_back(UltExpr::create(SubExpr::create(c, k8),
+                                    ConstantExpr::alloc(26, 8)));
+    exprs.push_back(EqExpr::create(ConstantExpr::alloc(k & 0xF0, 8),
+                                   AndExpr::create(c,
+                                                   ConstantExpr::alloc(0xF0,
+                                                                       8))));
+  }
+
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    for (unsigned polarity = 0; polarity != 2; ++polarity) {
+      ref<Expr> constraint = polarity ? exprs[i] : Expr::createIsZero(exprs[i]);
+      ByteRanges ranges;
+      ranges.addConstraint(constraint);
+
+      for (unsigned j = 0; j != exprs.size(); ++j) {
+        bool value;
+        if (!ranges.evaluate(exprs[j], value))
+          continue;
+        for (unsigned v = 0; v != 256; ++v) {
+          Assignment a;
+          a.bindings[array] = std::vector<unsigned char>(1, v);
+          if (a.evaluate(constraint)->isFalse())
+            continue;
+          EXPECT_EQ(value, a.evaluate(exprs[j])->isTrue())
+            << "constraint " << constraint << ", expr " << exprs[j]
+            << ", value " << v;
+        }
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,90 @@
+//===-- ConstraintsTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  UpdateList ul(array, 0);
+  return ReadExpr::create(ul, ConstantExpr::alloc(index, Expr::Int32));
+}
+
+ref<Expr> ult(ref<Expr> e, unsigned bound) {
+  return UltExpr::create(e, ConstantExpr::alloc(bound, Expr::Int8));
+}
+
+TEST(ConstraintsTest, CopyOnWrite) {
+  const Array *array = Array::CreateArray("cm_cow", 4);
+  ConstraintManager a;
+  a.addConstraint(ult(readByte(array, 0), 10));
+  ConstraintManager b(a);
+  EXPECT_TRUE(a == b);
+  EXPECT_EQ(a.hash(), b.hash());
+
+  b.addConstraint(ult(readByte(array, 1), 20));
+  EXPECT_EQ(1u, a.size());
+  EXPECT_EQ(2u, b.size());
+  EXPECT_FALSE(a == b);
+
+  a = b;
+  EXPECT_TRUE(a == b);
+  a.addConstraint(ult(readByte(array, 2), 30));
+  EXPECT_EQ(3u, a.size());
+  EXPECT_EQ(2u, b.size());
+}
+
+TEST(ConstraintsTest, Hash) {
+  const Array *array = Array::CreateArray("cm_hash", 4);
+  std::vector< ref<Expr> > constraints;
+  constraints.push_back(ult(readByte(array, 0), 10));
+  constraints.push_back(ult(readByte(array, 1), 20));
+
+  // Managers built independently from the same constraints are equal and
+  // hash the same.
+  ConstraintManager a, b(constraints);
+  a.addConstraint(constraints[0]);
+  a.addConstraint(constraints[1]);
+  EXPECT_TRUE(a == b);
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_NE(ConstraintManager().hash(), a.hash());
+
+  // Rewriting an existing constraint by an equality keeps the hash in
+  // step with the constraints.
+  ConstraintManager c(a);
+  c.addConstraint(EqExpr::create(ConstantExpr::alloc(5, Expr::Int8),
+                                 readByte(array, 0)));
+  std::vector< ref<Expr> > rewritten(c.begin(), c.end());
+  EXPECT_EQ(ConstraintManager(rewritten).hash(), c.hash());
+}
+
+TEST(ConstraintsTest, Generation) {
+  const Array *array = Array::CreateArray("cm_generation", 4);
+  ConstraintManager a;
+  a.addConstraint(ult(readByte(array, 0), 10));
+  ConstraintManager b(a);
+  EXPECT_EQ(a.generation(), b.generation());
+
+  // Every write gives the written constraints a generation never seen
+  // before, whether they are copied first or not.
+  uint64_t shared = a.generation();
+  b.addConstraint(ult(readByte(array, 1), 20));
+  EXPECT_NE(shared, b.generation());
+  EXPECT_EQ(shared, a.generation());
+  a.addConstraint(ult(readByte(array, 2), 30));
+  EXPECT_NE(shared, a.generation());
+  EXPECT_NE(a.generation(), b.generation());
+}
+
+}
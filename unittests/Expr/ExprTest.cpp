@@ -11,6 +11,8 @@
 #include "gtest/gtest.h"
 
 #include "klee/Expr.h"
+#include "klee/util/Assignment.h"
+#include "klee/util/ExprProgram.h"
 
 using namespace klee;
 
@@ -110,4 +112,93 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, CompiledEvaluation) {
+  const Array *array = Array::CreateArray("arr4", 8);
+  ref<ConstantExpr> constants[4] = { ConstantExpr::alloc(3, 8),
+                                     ConstantExpr::alloc(0x80, 8),
+                                     ConstantExpr::alloc(0, 8),
+                                     ConstantExpr::alloc(0xff, 8) };
+  const Array *constantArray =
+    Array::CreateArray("arr5", 4, constants, constants + 4);
+
+  // Reads through an update list with a symbolic index.
+  UpdateList ul(array, 0);
+  ul.extend(ZExtExpr::create(Expr::createTempRead(array, 8), Expr::Int32),
+            ConstantExpr::alloc(42, 8));
+  ul.extend(ConstantExpr::alloc(1, 32), ConstantExpr::alloc(7, 8));
+  ref<Expr> index = ZExtExpr::create(ExtractExpr::create(
+      Expr::createTempRead(array, 8), 0, 3), Expr::Int32);
+
+  std::vector< ref<Expr> > leaves;
+  leaves.push_back(Expr::createTempRead(array, 8));
+  leaves.push_back(Expr::createTempRead(array, 16));
+  leaves.push_back(Expr::createTempRead(array, 32));
+  leaves.push_back(Expr::createTempRead(array, 64));
+  leaves.push_back(ReadExpr::create(ul, index));
+  leaves.push_back(ReadExpr::create(UpdateList(constantArray, 0),
+                                    ZExtExpr::create(ExtractExpr::create(
+                                      Expr::createTempRead(array, 8), 0, 3),
+                                      Expr::Int32)));
+
+  // Build expressions of every kind over reads of equal width.
+  std::vector< ref<Expr> > exprs;
+  for (unsigned i = 0; i < leaves.size(); ++i) {
+    for (unsigned j = 0; j < leaves.size(); ++j) {
+      ref<Expr> l = leaves[i], r = leaves[j];
+      if (l->getWidth() != r->getWidth()) {
+        r = ZExtExpr::create(r, l->getWidth());
+        if (r->getWidth() != l->getWidth())
+          continue;
+      }
+      for (int k = Expr::Add; k <= Expr::Sge; ++k) {
+        if (k == Expr::Not)
+          continue;
+        std::vector<Expr::CreateArg> args;
+        args.push_back(Expr::CreateArg(l));
+        args.push_back(Expr::CreateArg(r));
+        exprs.push_back(Expr::createFromKind((Expr::Kind) k, args));
+      }
+      exprs.push_back(SelectExpr::create(
+          EqExpr::create(l, ZExtExpr::create(leaves[0], l->getWidth())),
+          l, r));
+      exprs.push_back(NotExpr::create(l));
+      exprs.push_back(SExtExpr::create(leaves[0], l->getWidth()));
+      if (l->getWidth() <= 32)
+        exprs.push_back(ConcatExpr::create(l, r));
+      if (l->getWidth() > 1)
+        exprs.push_back(ExtractExpr::create(l, 1, l->getWidth() - 1));
+    }
+  }
+
+  unsigned known = 0, total = 0;
+  for (unsigned seed = 1; seed < 20; ++seed) {
+    std::vector<unsigned char> values(8);
+    for (unsigned i = 0; i < values.size(); ++i)
+      values[i] = (seed * 0x9e3779b9u >> (i * 3)) ^ (seed & i ? 0x80 : 0);
+    if (seed % 5 == 0)
+      values[seed % 8] = 0;
+    Assignment a;
+    a.bindings.insert(std::make_pair(array, values));
+
+    for (unsigned i = 0; i < exprs.size(); ++i) {
+      ref<Expr> value = a.evaluate(exprs[i]);
+      if (!isa<ConstantExpr>(value))
+        continue;
+      ref<Expr> eq = EqExpr::create(exprs[i], value);
+      ref<Expr> ne = Expr::createIsZero(eq);
+      ExprProgram eqProgram(&eq, &eq + 1);
+      ExprProgram neProgram(&ne, &ne + 1);
+      ASSERT_TRUE(eqProgram.isValid());
+
+      // Unknown is only allowed where the tree walk must be used.
+      ExprProgram::Result res = eqProgram.evaluate(a);
+      EXPECT_NE(ExprProgram::False, res);
+      EXPECT_NE(ExprProgram::True, neProgram.evaluate(a));
+      known += res != ExprProgram::Unknown;
+      ++total;
+    }
+  }
+  EXPECT_GT(known, total * 9 / 10);
+}
+
 }
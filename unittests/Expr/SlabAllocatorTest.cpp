@@ -0,0 +1,69 @@
+//===-- SlabAllocatorTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr.h"
+#include "klee/util/BitArray.h"
+#include "klee/util/SlabAllocator.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(SlabAllocatorTest, ReusesFreedObjects) {
+  void *p = SlabAllocator::allocate(40);
+  size_t free = SlabAllocator::getFreeBytes();
+  SlabAllocator::deallocate(p, 40);
+  EXPECT_EQ(free + 48, SlabAllocator::getFreeBytes());
+  // Any size of the same class gets the object back.
+  EXPECT_EQ(p, SlabAllocator::allocate(33));
+  EXPECT_EQ(free, SlabAllocator::getFreeBytes());
+  SlabAllocator::deallocate(p, 33);
+}
+
+TEST(SlabAllocatorTest, ObjectsDoNotOverlap) {
+  std::vector<char*> objects;
+  for (unsigned i = 0; i < 10000; ++i) {
+    size_t size = 1 + i % 600;
+    char *p = static_cast<char*>(SlabAllocator::allocate(size));
+    memset(p, i & 0xFF, size);
+    objects.push_back(p);
+  }
+  for (unsigned i = 0; i < objects.size(); ++i) {
+    size_t size = 1 + i % 600;
+    for (size_t j = 0; j < size; ++j)
+      ASSERT_EQ((char) (i & 0xFF), objects[i][j]);
+    SlabAllocator::deallocate(objects[i], size);
+  }
+}
+
+TEST(SlabAllocatorTest, CountsAllocations) {
+  uint64_t before = stats::slabAllocations;
+  ref<Expr> e = AddExpr::create(Expr::createTempRead(Array::CreateArray("sa0",
+                                                                        4), 8),
+                                ConstantExpr::create(1, 8));
+  EXPECT_LT(before, (uint64_t) stats::slabAllocations);
+  EXPECT_LT(0u, (uint64_t) stats::slabBytes);
+}
+
+TEST(SlabAllocatorTest, BitArray) {
+  BitArray *a = new BitArray(1000, true);
+  a->unset(999);
+  BitArray *b = new BitArray(*a, 1000);
+  delete a;
+  EXPECT_TRUE(b->get(0));
+  EXPECT_FALSE(b->get(999));
+  delete b;
+}
+
+}
@@ -0,0 +1,260 @@
+//===-- BitBlasterTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "../../lib/Solver/BitBlaster.h"
+#include "../../lib/Solver/SATSolver.h"
+
+#include "klee/Expr.h"
+#include "klee/util/Assignment.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef SATSolver::Lit Lit;
+
+const uint64_t g_values[] = { 0, 1, 2, 3, 7, 8, 23, 24, 25, 100, 127, 128,
+                              200, 255, 0x800000, 0xfffffe, 0xffffff };
+
+/// A symbolic operand of a given width (which need not be a power of two),
+/// read from its own array.
+struct Operand {
+  const Array *array;
+  Expr::Width width;
+  ref<Expr> expr;
+
+  Operand(const char *name, Expr::Width _width)
+    : array(Array::CreateArray(name, 4)), width(_width) {
+    ref<Expr> word = Expr::createTempRead(array, Expr::Int32);
+    expr = width == Expr::Int32 ? word : ExtractExpr::create(word, 0, width);
+  }
+
+  uint64_t truncate(uint64_t value) const {
+    return value & (((uint64_t) 1 << width) - 1);
+  }
+
+  void bind(Assignment &a, uint64_t value) const {
+    std::vector<unsigned char> bytes(4);
+    for (unsigned i = 0; i != 4; ++i)
+      bytes[i] = truncate(value) >> (8 * i);
+    a.bindings[array] = bytes;
+  }
+};
+
+/// BlastFixture - Bit-blasts expressions over two operands and reads their
+/// value back from a model in which the operands are fixed.
+struct BlastFixture {
+  SATSolver sat;
+  BitBlaster blaster;
+  Operand x, y;
+
+  BlastFixture(Expr::Width width)
+    : blaster(sat), x("bbx", width), y("bby", width) {}
+
+  /// Solve with the operands fixed to vx and vy, returning the value of e.
+  uint64_t blastValue(ref<Expr> e, uint64_t vx, uint64_t vy) {
+    std::vector<Lit> assumptions;
+    assumptions.push_back(blaster.constructBool(
+      EqExpr::create(ConstantExpr::create(x.truncate(vx), x.width), x.expr)));
+    assumptions.push_back(blaster.constructBool(
+      EqExpr::create(ConstantExpr::create(y.truncate(vy), y.width), y.expr)));
+    BitBlaster::Bits bits = blaster.construct(e);
+    EXPECT_EQ(SATSolver::Satisfiable, sat.solve(assumptions, 0));
+    uint64_t res = 0;
+    for (unsigned i = 0, n = bits.size(); i != n; ++i)
+      if (sat.modelValue(bits[i]))
+        res |= (uint64_t) 1 << i;
+    return res;
+  }
+
+  uint64_t evalValue(ref<Expr> e, uint64_t vx, uint64_t vy) {
+    Assignment a;
+    x.bind(a, vx);
+    y.bind(a, vy);
+    ref<Expr> res = a.evaluate(e);
+    EXPECT_TRUE(isa<ConstantExpr>(res)) << "evaluation failed: " << e;
+    return isa<ConstantExpr>(res) ? cast<ConstantExpr>(res)->getZExtValue() : 0;
+  }
+};
+
+/// Compare the circuit of an operation against the evaluator on pairs of
+/// concrete operands. Divisions skip a zero divisor, which the evaluator
+/// leaves unevaluated, and shifts amounts of the width or more, which
+/// differ between APInt versions and are checked on their own.
+void testBinary(Expr::Kind kind, Expr::Width width) {
+  BlastFixture f(width);
+  std::vector<Expr::CreateArg> args;
+  args.push_back(Expr::CreateArg(f.x.expr));
+  args.push_back(Expr::CreateArg(f.y.expr));
+  ref<Expr> e = Expr::createFromKind(kind, args);
+
+  bool isDiv = kind == Expr::UDiv || kind == Expr::SDiv ||
+    kind == Expr::URem || kind == Expr::SRem;
+  bool isShift = kind == Expr::Shl || kind == Expr::LShr ||
+    kind == Expr::AShr;
+  for (unsigned i = 0; i != sizeof(g_values) / sizeof(g_values[0]); ++i) {
+    for (unsigned j = 0; j != sizeof(g_values) / sizeof(g_values[0]); ++j) {
+      uint64_t vx = f.x.truncate(g_values[i]), vy = f.y.truncate(g_values[j]);
+      if ((isDiv && !vy) || (isShift && vy >= width))
+        continue;
+      EXPECT_EQ(f.evalValue(e, vx, vy), f.blastValue(e, vx, vy))
+        << e << " with " << vx << ", " << vy;
+    }
+  }
+}
+
+TEST(BitBlasterTest, Division) {
+  for (unsigned w = 0; w != 2; ++w) {
+    Expr::Width width = w ? 24 : Expr::Int8;
+    testBinary(Expr::UDiv, width);
+    testBinary(Expr::SDiv, width);
+    testBinary(Expr::URem, width);
+    testBinary(Expr::SRem, width);
+  }
+}
+
+TEST(BitBlasterTest, Shifts) {
+  for (unsigned w = 0; w != 2; ++w) {
+    Expr::Width width = w ? 24 : Expr::Int8;
+    testBinary(Expr::Shl, width);
+    testBinary(Expr::LShr, width);
+    testBinary(Expr::AShr, width);
+  }
+}
+
+TEST(BitBlasterTest, Overshift) {
+  // Shifting by the width or more gives zero, whatever the sign, also for
+  // widths which are not a power of two.
+  BlastFixture f(24);
+  ref<Expr> shl = ShlExpr::create(f.x.expr, f.y.expr);
+  ref<Expr> lshr = LShrExpr::create(f.x.expr, f.y.expr);
+  ref<Expr> ashr = AShrExpr::create(f.x.expr, f.y.expr);
+  const uint64_t amounts[] = { 24, 25, 31, 32, 0xffffff };
+  for (unsigned i = 0; i != sizeof(amounts) / sizeof(amounts[0]); ++i) {
+    EXPECT_EQ(0u, f.blastValue(shl, 0xffffff, amounts[i]));
+    EXPECT_EQ(0u, f.blastValue(lshr, 0xffffff, amounts[i]));
+    EXPECT_EQ(0u, f.blastValue(ashr, 0x800000, amounts[i]));
+  }
+  EXPECT_EQ(0xffffffu, f.blastValue(ashr, 0x800000, 23));
+}
+
+TEST(BitBlasterTest, SignedCompares) {
+  for (unsigned w = 0; w != 2; ++w) {
+    Expr::Width width = w ? 24 : Expr::Int8;
+    testBinary(Expr::Slt, width);
+    testBinary(Expr::Sle, width);
+    testBinary(Expr::Sgt, width);
+    testBinary(Expr::Sge, width);
+  }
+}
+
+TEST(BitBlasterTest, ConstantOperands) {
+  // Both factors are constant bits without being ConstantExprs.
+  BlastFixture f(Expr::Int8);
+  ref<Expr> zeroX = AndExpr::create(f.x.expr, NotExpr::create(f.x.expr));
+  ref<Expr> zeroY = AndExpr::create(f.y.expr, NotExpr::create(f.y.expr));
+  ref<Expr> onesX = OrExpr::create(f.x.expr, NotExpr::create(f.x.expr));
+  ref<Expr> onesY = OrExpr::create(f.y.expr, NotExpr::create(f.y.expr));
+
+  EXPECT_EQ(0u, f.blastValue(MulExpr::create(zeroX, zeroY), 3, 5));
+  // 0xff * 0xff = 0xfe01
+  EXPECT_EQ(1u, f.blastValue(MulExpr::create(onesX, onesY), 3, 5));
+  EXPECT_EQ(15u, f.blastValue(MulExpr::create(f.x.expr, onesY), 241, 5));
+  EXPECT_EQ(15u, f.blastValue(MulExpr::create(onesX, f.y.expr), 3, 241));
+}
+
+TEST(BitBlasterTest, IncrementalReuse) {
+  BlastFixture f(Expr::Int8);
+  ref<Expr> e = MulExpr::create(AddExpr::create(f.x.expr, f.y.expr),
+                                f.y.expr);
+  EXPECT_EQ(f.evalValue(e, 3, 5), f.blastValue(e, 3, 5));
+  unsigned vars = f.sat.numVariables();
+
+  // The circuit of the expression is reused, only the equalities fixing
+  // the operands to new values need new variables (a gate per bit at most).
+  EXPECT_EQ(f.evalValue(e, 200, 7), f.blastValue(e, 200, 7));
+  EXPECT_EQ(f.evalValue(e, 3, 5), f.blastValue(e, 3, 5));
+  EXPECT_LE(f.sat.numVariables(), vars + 2 * 8);
+
+  // A contradicting assumption makes the same circuit unsatisfiable.
+  std::vector<Lit> assumptions;
+  assumptions.push_back(f.blaster.constructBool(
+    EqExpr::create(ConstantExpr::create(3, Expr::Int8), f.x.expr)));
+  assumptions.push_back(f.blaster.constructBool(
+    EqExpr::create(ConstantExpr::create(5, Expr::Int8), f.y.expr)));
+  assumptions.push_back(f.blaster.constructBool(
+    EqExpr::create(ConstantExpr::create(0, Expr::Int8), e)));
+  EXPECT_EQ(SATSolver::Unsatisfiable, f.sat.solve(assumptions, 0));
+  EXPECT_EQ(f.evalValue(e, 1, 2), f.blastValue(e, 1, 2));
+}
+
+/***/
+
+TEST(SATSolverTest, Pigeonhole) {
+  // Three pigeons do not fit in two holes.
+  SATSolver sat;
+  Lit p[3][2];
+  for (unsigned i = 0; i != 3; ++i)
+    for (unsigned j = 0; j != 2; ++j)
+      p[i][j] = SATSolver::mkLit(sat.newVariable());
+  for (unsigned i = 0; i != 3; ++i) {
+    std::vector<Lit> somewhere(p[i], p[i] + 2);
+    EXPECT_TRUE(sat.addClause(somewhere));
+  }
+  for (unsigned j = 0; j != 2; ++j) {
+    for (unsigned i = 0; i != 3; ++i) {
+      for (unsigned k = i + 1; k != 3; ++k) {
+        std::vector<Lit> apart;
+        apart.push_back(SATSolver::negate(p[i][j]));
+        apart.push_back(SATSolver::negate(p[k][j]));
+        sat.addClause(apart);
+      }
+    }
+  }
+  EXPECT_EQ(SATSolver::Unsatisfiable, sat.solve(std::vector<Lit>(), 0));
+}
+
+TEST(SATSolverTest, Assumptions) {
+  // a -> b, b -> c
+  SATSolver sat;
+  Lit a = SATSolver::mkLit(sat.newVariable());
+  Lit b = SATSolver::mkLit(sat.newVariable());
+  Lit c = SATSolver::mkLit(sat.newVariable());
+  std::vector<Lit> clause(2);
+  clause[0] = SATSolver::negate(a);
+  clause[1] = b;
+  sat.addClause(clause);
+  clause[0] = SATSolver::negate(b);
+  clause[1] = c;
+  sat.addClause(clause);
+
+  std::vector<Lit> assumptions(1, a);
+  ASSERT_EQ(SATSolver::Satisfiable, sat.solve(assumptions, 0));
+  EXPECT_TRUE(sat.modelValue(b));
+  EXPECT_TRUE(sat.modelValue(c));
+
+  assumptions.push_back(SATSolver::negate(c));
+  EXPECT_EQ(SATSolver::Unsatisfiable, sat.solve(assumptions, 0));
+
+  // Assumptions do not stick, clauses added later do.
+  assumptions.assign(1, SATSolver::negate(c));
+  ASSERT_EQ(SATSolver::Satisfiable, sat.solve(assumptions, 0));
+  EXPECT_FALSE(sat.modelValue(a));
+  std::vector<Lit> unit(1, a);
+  sat.addClause(unit);
+  EXPECT_EQ(SATSolver::Unsatisfiable, sat.solve(assumptions, 0));
+  ASSERT_EQ(SATSolver::Satisfiable, sat.solve(std::vector<Lit>(), 0));
+  EXPECT_TRUE(sat.modelValue(c));
+}
+
+}
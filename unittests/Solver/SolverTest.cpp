@@ -121,12 +121,13 @@ void testOpcode(Solver &solver, bool tryBool = true, bool tryZero = true,
   }
 }
 
-TEST(SolverTest, Evaluation) {
-  STPSolver *stpSolver = new STPSolver(true); 
-  Solver *solver = stpSolver;
+void testSolver(Solver *coreSolver, bool canonical = false) {
+  Solver *solver = coreSolver;
 
   solver = createCexCachingSolver(solver);
   solver = createCachingSolver(solver);
+  if (canonical)
+    solver = createCanonicalSolver(solver);
   solver = createIndependentSolver(solver);
 
   testOpcode<SelectExpr>(*solver);
@@ -161,4 +162,31 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+TEST(SolverTest, Evaluation) {
+  testSolver(new STPSolver(true));
+}
+
+TEST(SolverTest, CanonicalEvaluation) {
+  testSolver(new STPSolver(true), true);
+}
+
+#ifdef SUPPORT_Z3
+TEST(SolverTest, Z3Evaluation) {
+  testSolver(new Z3Solver());
+}
+#endif
+
+TEST(SolverTest, BitBlastEvaluation) {
+  testSolver(createBitBlastSolver(new STPSolver(true)));
+}
+
+TEST(SolverTest, PortfolioEvaluation) {
+  std::vector<CoreSolverType> types;
+  types.push_back(STP_SOLVER);
+#ifdef SUPPORT_Z3
+  types.push_back(Z3_SOLVER);
+#endif
+  testSolver(createPortfolioSolver(types));
+}
+
 }